@@ -5,14 +5,22 @@
 #ifndef PROJECT_BASE_COMMON_H
 #define PROJECT_BASE_COMMON_H
 #include <string>
-#include <fstream>
-#include <sstream>
+#include <stb_image.h>
+#include <learnopengl/filesystem.h>
 
 std::string readFileContents(std::string path) {
-    std::ifstream in(path);
-    std::stringstream buffer;
-    buffer << in.rdbuf();
-    return buffer.str();
+    rg::AssetData file;
+    FileSystem::read(path, file);
+    return std::string((const char*)file.Data(), file.Size());
+}
+
+// stbi_load through FileSystem, so packed images are decoded straight from the mapping
+inline unsigned char* loadImageFile(const std::string& path, int* width, int* height, int* channels) {
+    rg::AssetData file;
+    if (!FileSystem::read(path, file) || file.Size() > (size_t)INT32_MAX) {
+        return nullptr;
+    }
+    return stbi_load_from_memory(file.Data(), (int)file.Size(), width, height, channels, 0);
 }
 
 
@@ -3,6 +3,7 @@
 
 #include <string>
 #include <cstdlib>
+#include <rg/AssetPack.h>
 #include "root_directory.h" // This is a configuration file generated by CMake.
 
 class FileSystem
@@ -17,7 +18,53 @@ public:
     return (*pathBuilder)(path);
   }
 
+  // serves every later read of a path inside the pack from it; mount before loading starts,
+  // reads themselves are thread safe
+  static bool mount(const std::string& packPath)
+  {
+    return pack().Open(packPath);
+  }
+
+  static bool mounted()
+  {
+    return pack().IsOpen();
+  }
+
+  // the bytes of a file, by the same path given to getPath or already resolved by it: from the
+  // mounted pack without a copy when it has the file, from disk otherwise
+  static bool read(const std::string& path, rg::AssetData& data)
+  {
+    if (pack().IsOpen() && pack().Read(packName(path), data))
+      return true;
+    return rg::ReadLooseFile(path, data);
+  }
+
+  static bool exists(const std::string& path)
+  {
+    if (pack().IsOpen() && pack().Find(packName(path)))
+      return true;
+    return access(path.c_str(), R_OK) == 0;
+  }
+
 private:
+  static rg::AssetPack& pack()
+  {
+    static rg::AssetPack mountedPack;
+    return mountedPack;
+  }
+
+  // packs are keyed by the path relative to the root, as the packer is run from there
+  static std::string packName(const std::string& path)
+  {
+    std::string name = path;
+    const std::string& root = getRoot();
+    if (!root.empty() && name.compare(0, root.size() + 1, root + "/") == 0)
+      name = name.substr(root.size() + 1);
+    while (name.compare(0, 2, "./") == 0)
+      name = name.substr(2);
+    return name;
+  }
+
   static std::string const & getRoot()
   {
     static char const * envRoot = getenv("LOGL_ROOT_PATH");
@@ -23,6 +23,8 @@ struct Vertex {
     glm::vec3 Tangent;
     // bitangent
     glm::vec3 Bitangent;
+    // lightmap atlas coordinates, zero until a baked lightmap provides them
+    glm::vec2 LightmapCoords;
 };
 
 
@@ -42,31 +44,66 @@ public:
 
     unsigned int VAO;
     std::string glslIdentifierPrefix;
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    // constructor; without upload the mesh stays CPU only (no GL context needed) and can't be drawn
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, bool upload = true)
     {
         this->vertices = vertices;
         this->indices = indices;
         this->textures = textures;
 
+        // the sampler names only change with the prefix, Draw rebuilds them then
+        samplerNames = SamplerNames();
+        samplerPrefix = glslIdentifierPrefix;
+
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        VAO = VBO = EBO = 0;
+        if (upload)
+            setupMesh();
     }
 
     // render the mesh
     void Draw(Shader &shader)
     {
         // bind appropriate textures
+        if (samplerPrefix != glslIdentifierPrefix || samplerNames.size() != textures.size())
+        {
+            samplerNames = SamplerNames();
+            samplerPrefix = glslIdentifierPrefix;
+        }
+        for(unsigned int i = 0; i < textures.size(); i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
+            // now set the sampler to the correct texture unit
+            glUniform1i(glGetUniformLocation(shader.ID, samplerNames[i].c_str()), i);
+            // and finally bind the texture
+            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+        }
+
+        // draw mesh
+        glBindVertexArray(VAO);
+        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+        glBindVertexArray(0);
+
+        // always good practice to set everything back to defaults once configured.
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // the sampler uniform for each texture, e.g. material.texture_diffuse1, numbered per type
+    vector<string> SamplerNames() const
+    {
+        vector<string> names;
+        names.reserve(textures.size());
         unsigned int diffuseNr  = 1;
         unsigned int specularNr = 1;
         unsigned int normalNr   = 1;
         unsigned int heightNr   = 1;
+        unsigned int roughnessNr = 1;
+        unsigned int metallicNr  = 1;
         for(unsigned int i = 0; i < textures.size(); i++)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
             // retrieve texture number (the N in diffuse_textureN)
             string number;
-            string name = textures[i].type;
+            const string &name = textures[i].type;
             if(name == "texture_diffuse")
                 number = std::to_string(diffuseNr++);
             else if(name == "texture_specular")
@@ -75,27 +112,29 @@ public:
                 number = std::to_string(normalNr++); // transfer unsigned int to stream
             else if(name == "texture_height")
                 number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            else if(name == "texture_roughness")
+                number = std::to_string(roughnessNr++);
+            else if(name == "texture_metallic")
+                number = std::to_string(metallicNr++);
+            names.push_back(glslIdentifierPrefix + name + number);
         }
+        return names;
+    }
 
-
-
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+    // uploads the vertices again after they changed on the CPU, e.g. got lightmap coordinates
+    void UpdateVertices()
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(Vertex), &vertices[0]);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
     }
 
 private:
     // render data
     unsigned int VBO, EBO;
+    // SamplerNames() for the textures and the prefix they were built with
+    vector<string> samplerNames;
+    string samplerPrefix;
 
     // initializes all the buffer objects/arrays
     void setupMesh()
@@ -132,6 +171,9 @@ private:
         // vertex bitangent
         glEnableVertexAttribArray(4);
         glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+        // vertex lightmap coords
+        glEnableVertexAttribArray(5);
+        glVertexAttribPointer(5, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, LightmapCoords));
 
         glBindVertexArray(0);
     }
@@ -12,7 +12,11 @@
 
 #include <learnopengl/mesh.h>
 #include <learnopengl/shader.h>
+#include <rg/AssetPackIO.h>
+#include <rg/Hierarchy.h>
+#include <rg/Profiler.h>
 
+#include <functional>
 #include <string>
 #include <fstream>
 #include <sstream>
@@ -31,73 +35,63 @@ public:
     // model data
     vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
     vector<Mesh>    meshes;
+    rg::NodeHierarchy nodes;     // assimp node tree, flattened parent-before-child
+    vector<int>     meshNodes;   // node that owns meshes[i]
     string directory;
     bool gammaCorrection;
 
+    // loads one material texture and returns its GL name, e.g. through a streamer; without one
+    // textures go through TextureFromFile
+    typedef std::function<unsigned int(const string &path, const string &directory)> TextureLoader;
+    TextureLoader textureLoader;
+    bool uploadMeshes;           // false keeps the meshes CPU only, e.g. for the software renderer
+
     // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    Model(string const &path, bool gamma = false, TextureLoader loader = TextureLoader(), bool upload = true)
+        : gammaCorrection(gamma), textureLoader(loader), uploadMeshes(upload)
     {
         loadModel(path);
     }
 
-    // draws the model, and thus all its meshes
-    void Draw(Shader &shader)
+    // draws the model, and thus all its meshes, each placed by the world matrix of its node
+    void Draw(Shader &shader, const glm::mat4 &model)
     {
-        for(unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
+        Draw(shader, model, nodes.world);
     }
 
-    void SetShaderTextureNamePrefix(std::string prefix) {
-        for (Mesh& mesh: meshes) {
-            mesh.glslIdentifierPrefix = prefix;
-        }
-    }
-private:
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
-    void loadModel(string const &path)
+    // same, with node world matrices captured elsewhere (the render thread draws from a snapshot)
+    void Draw(Shader &shader, const glm::mat4 &model, const vector<glm::mat4> &nodeWorld)
     {
-        // read file via ASSIMP
-        Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
-        // check for errors
-        if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
+        for(unsigned int i = 0; i < meshes.size(); i++)
         {
-            cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
-            return;
+            shader.setMat4("model", model * nodeWorld[meshNodes[i]]);
+            meshes[i].Draw(shader);
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
+    }
 
-        // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+    // replaces the local transform of a node; takes effect on the next UpdateNodeTransforms()
+    void SetNodeTransform(int node, const glm::mat4 &transform)
+    {
+        nodes.SetLocal(node, transform);
     }
 
-    // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    // recomputes world matrices of the dirty subtrees only, free when nothing changed
+    void UpdateNodeTransforms()
     {
-        // process each mesh located at the current node
-        for(unsigned int i = 0; i < node->mNumMeshes; i++)
-        {
-            // the node object only contains indices to index the actual objects in the scene.
-            // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
-            aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
-        }
-        // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
-        for(unsigned int i = 0; i < node->mNumChildren; i++)
-        {
-            processNode(node->mChildren[i], scene);
-        }
+        nodes.Update();
+    }
 
+    void SetShaderTextureNamePrefix(std::string prefix) {
+        for (Mesh& mesh: meshes) {
+            mesh.glslIdentifierPrefix = prefix;
+        }
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    // converts the vertices of an assimp mesh into our vertex layout
+    static vector<Vertex> ExtractVertices(const aiMesh *mesh)
     {
-        // data to fill
         vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
-
+        vertices.reserve(mesh->mNumVertices);
         // walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
         {
@@ -138,19 +132,91 @@ private:
             }
             else
                 vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+            vertex.LightmapCoords = glm::vec2(0.0f, 0.0f);
 
             vertices.push_back(vertex);
-
-
         }
+        return vertices;
+    }
+
+    // flattens the faces (triangles after aiProcess_Triangulate) into an index list
+    static vector<unsigned int> ExtractIndices(const aiMesh *mesh)
+    {
+        vector<unsigned int> indices;
+        indices.reserve((size_t)mesh->mNumFaces * 3);
         // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
         for(unsigned int i = 0; i < mesh->mNumFaces; i++)
         {
-            aiFace face = mesh->mFaces[i];
+            const aiFace &face = mesh->mFaces[i];
             // retrieve all indices of the face and store them in the indices vector
             for(unsigned int j = 0; j < face.mNumIndices; j++)
                 indices.push_back(face.mIndices[j]);
         }
+        return indices;
+    }
+private:
+    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
+    void loadModel(string const &path)
+    {
+        RG_PROFILE_SCOPE("loadModel");
+        // read file via ASSIMP
+        Assimp::Importer importer;
+        if (FileSystem::mounted())
+            importer.SetIOHandler(new rg::AssetIOSystem); // the importer deletes it
+        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        // check for errors
+        if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
+        {
+            cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+            return;
+        }
+        // retrieve the directory path of the filepath
+        directory = path.substr(0, path.find_last_of('/'));
+
+        // process ASSIMP's root node recursively
+        processNode(scene->mRootNode, scene, -1);
+        nodes.Update();
+    }
+
+    // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
+    // the node itself is appended to the flattened hierarchy before its children, keeping its local transform
+    void processNode(aiNode *node, const aiScene *scene, int parent)
+    {
+        int index = nodes.AddNode(node->mName.C_Str(), parent, toGlm(node->mTransformation));
+        // process each mesh located at the current node
+        for(unsigned int i = 0; i < node->mNumMeshes; i++)
+        {
+            // the node object only contains indices to index the actual objects in the scene.
+            // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
+            aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+            meshes.push_back(processMesh(mesh, scene));
+            meshNodes.push_back(index);
+        }
+        // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
+        for(unsigned int i = 0; i < node->mNumChildren; i++)
+        {
+            processNode(node->mChildren[i], scene, index);
+        }
+
+    }
+
+    // assimp matrices are row-major, glm is column-major
+    static glm::mat4 toGlm(const aiMatrix4x4 &m)
+    {
+        return glm::mat4(m.a1, m.b1, m.c1, m.d1,
+                         m.a2, m.b2, m.c2, m.d2,
+                         m.a3, m.b3, m.c3, m.d3,
+                         m.a4, m.b4, m.c4, m.d4);
+    }
+
+    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    {
+        RG_PROFILE_SCOPE("processMesh");
+        // data to fill
+        vector<Vertex> vertices = ExtractVertices(mesh);
+        vector<unsigned int> indices = ExtractIndices(mesh);
+        vector<Texture> textures;
+
         // process materials
         aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
         // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
@@ -159,6 +225,8 @@ private:
         // diffuse: texture_diffuseN
         // specular: texture_specularN
         // normal: texture_normalN
+        // roughness: texture_roughnessN
+        // metallic: texture_metallicN
         aiColor3D color(0.0f, 0.0f, 0.0f);
         material->Get(AI_MATKEY_COLOR_AMBIENT, color);
 
@@ -175,11 +243,16 @@ private:
         // 4. height maps
         std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
         textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
+        // 5. metallic/roughness maps; the OBJ importer reports map_Ns as shininess and map_refl as reflection
+        std::vector<Texture> roughnessMaps = loadMaterialTextures(material, aiTextureType_SHININESS, "texture_roughness");
+        textures.insert(textures.end(), roughnessMaps.begin(), roughnessMaps.end());
+        std::vector<Texture> metallicMaps = loadMaterialTextures(material, aiTextureType_REFLECTION, "texture_metallic");
+        textures.insert(textures.end(), metallicMaps.begin(), metallicMaps.end());
 
 
 
         // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        return Mesh(vertices, indices, textures, uploadMeshes);
     }
 
     // checks all material textures of a given type and loads the textures if they're not loaded yet.
@@ -205,7 +278,7 @@ private:
             if(!skip)
             {   // if texture hasn't been loaded already, load it
                 Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
+                texture.id = textureLoader ? textureLoader(str.C_Str(), this->directory) : TextureFromFile(str.C_Str(), this->directory);
                 texture.type = typeName;
                 texture.path = str.C_Str();
                 textures.push_back(texture);
@@ -219,6 +292,7 @@ private:
 
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
 {
+    RG_PROFILE_SCOPE("TextureFromFile");
     string filename = string(path);
     filename = directory + '/' + filename;
 
@@ -226,7 +300,7 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
     glGenTextures(1, &textureID);
 
     int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
+    unsigned char *data = loadImageFile(filename, &width, &height, &nrComponents);
     if (data)
     {
         GLenum format;
@@ -9,6 +9,7 @@
 #include <sstream>
 #include <iostream>
 #include <common.h>
+#include <rg/Profiler.h>
 class Shader
 {
 public:
@@ -17,6 +18,7 @@ public:
     // ------------------------------------------------------------------------
     Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
     {
+        RG_PROFILE_SCOPE("Shader");
         std::string vertexPathString(vertexPath);
         std::string fragmentPathString(fragmentPath);
 
@@ -26,41 +28,18 @@ public:
         std::string vertexCode;
         std::string fragmentCode;
         std::string geometryCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        std::ifstream gShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        gShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        try 
+        // through FileSystem, so shaders come from the mounted asset pack when there is one
+        rg::AssetData vShaderFile, fShaderFile, gShaderFile;
+        bool read = FileSystem::read(vertexPath, vShaderFile) && FileSystem::read(fragmentPath, fShaderFile);
+        vertexCode.assign((const char*)vShaderFile.Data(), vShaderFile.Size());
+        fragmentCode.assign((const char*)fShaderFile.Data(), fShaderFile.Size());
+        // if geometry shader path is present, also load a geometry shader
+        if(geometryPath != nullptr)
         {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();		
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();			
-            // if geometry shader path is present, also load a geometry shader
-            if(geometryPath != nullptr)
-            {
-                std::string geometryPathString(geometryPath);
-                geometryPath = geometryPathString.c_str();
-                gShaderFile.open(geometryPath);
-                std::stringstream gShaderStream;
-                gShaderStream << gShaderFile.rdbuf();
-                gShaderFile.close();
-                geometryCode = gShaderStream.str();
-            }
+            read = read && FileSystem::read(geometryPath, gShaderFile);
+            geometryCode.assign((const char*)gShaderFile.Data(), gShaderFile.Size());
         }
-        catch (std::ifstream::failure& e)
+        if(!read)
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
         }
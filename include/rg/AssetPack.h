@@ -0,0 +1,343 @@
+#ifndef PROJECT_BASE_ASSETPACK_H
+#define PROJECT_BASE_ASSETPACK_H
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+    // LZ4 block format (no frame): sequences of a token, literals and a back reference of at
+    // least four bytes up to 64KB back, the last five bytes always literals. Enough to read
+    // and write the packed entries, no dependency on liblz4.
+    inline bool Lz4Decompress(const unsigned char* src, size_t srcSize, unsigned char* dst, size_t dstSize) {
+        const unsigned char* ip = src;
+        const unsigned char* ipEnd = src + srcSize;
+        unsigned char* op = dst;
+        unsigned char* opEnd = dst + dstSize;
+        // the 4-bit lengths of the token continue in bytes while they are 255
+        auto readLength = [&](size_t length, size_t& result) {
+            if (length == 15) {
+                unsigned char more;
+                do {
+                    if (ip >= ipEnd) {
+                        return false;
+                    }
+                    more = *ip++;
+                    length += more;
+                } while (more == 255);
+            }
+            result = length;
+            return true;
+        };
+        while (ip < ipEnd) {
+            unsigned token = *ip++;
+            size_t literals, match;
+            if (!readLength(token >> 4, literals) || (size_t)(ipEnd - ip) < literals || (size_t)(opEnd - op) < literals) {
+                return false;
+            }
+            std::memcpy(op, ip, literals);
+            op += literals;
+            ip += literals;
+            if (ip == ipEnd) {
+                break; // the last sequence has literals only
+            }
+            if (ipEnd - ip < 2) {
+                return false;
+            }
+            size_t offset = ip[0] | (size_t)ip[1] << 8;
+            ip += 2;
+            if (offset == 0 || offset > (size_t)(op - dst) || !readLength(token & 15, match)) {
+                return false;
+            }
+            match += 4;
+            if ((size_t)(opEnd - op) < match) {
+                return false;
+            }
+            const unsigned char* from = op - offset;
+            if (offset >= match) {
+                std::memcpy(op, from, match);
+            } else {
+                // overlapping, repeats the last offset bytes
+                for (size_t i = 0; i < match; i++) {
+                    op[i] = from[i];
+                }
+            }
+            op += match;
+        }
+        return op == opEnd;
+    }
+
+    // greedy single-probe match finder: far from the best ratio, but fast and all the packer needs
+    inline std::vector<unsigned char> Lz4Compress(const unsigned char* src, size_t size) {
+        const size_t LastLiterals = 5;
+        const size_t MatchStartLimit = 12; // no match starts within the last 12 bytes
+        std::vector<unsigned char> out;
+        out.reserve(size + size / 255 + 16);
+        auto writeLength = [&](size_t length) {
+            for (length -= 15; length >= 255; length -= 255) {
+                out.push_back(255);
+            }
+            out.push_back((unsigned char)length);
+        };
+        auto emit = [&](size_t anchor, size_t literals, size_t offset, size_t match) {
+            unsigned char token = (unsigned char)(std::min<size_t>(literals, 15) << 4);
+            if (match) {
+                token |= (unsigned char)std::min<size_t>(match - 4, 15);
+            }
+            out.push_back(token);
+            if (literals >= 15) {
+                writeLength(literals);
+            }
+            out.insert(out.end(), src + anchor, src + anchor + literals);
+            if (match) {
+                out.push_back((unsigned char)(offset & 0xff));
+                out.push_back((unsigned char)(offset >> 8));
+                if (match - 4 >= 15) {
+                    writeLength(match - 4);
+                }
+            }
+        };
+        auto read32 = [src](size_t position) {
+            uint32_t value;
+            std::memcpy(&value, src + position, sizeof(value));
+            return value;
+        };
+
+        std::vector<uint32_t> table(1u << 16, UINT32_MAX); // last position of each hashed 4-byte sequence
+        size_t anchor = 0;
+        size_t position = 0;
+        while (size > MatchStartLimit && position + MatchStartLimit <= size) {
+            uint32_t sequence = read32(position);
+            uint32_t hash = (sequence * 2654435761u) >> 16;
+            size_t candidate = table[hash];
+            table[hash] = (uint32_t)position;
+            if (candidate != UINT32_MAX && position - candidate <= 65535 && read32(candidate) == sequence) {
+                size_t match = 4;
+                while (position + match < size - LastLiterals && src[candidate + match] == src[position + match]) {
+                    match++;
+                }
+                emit(anchor, position - anchor, position - candidate, match);
+                position += match;
+                anchor = position;
+            } else {
+                position++;
+            }
+        }
+        emit(anchor, size - anchor, 0, 0);
+        return out;
+    }
+
+    // Bytes of one asset: a view into a mapped pack when the entry is stored as is, otherwise
+    // a buffer of its own (decompressed entries, loose files).
+    class AssetData {
+    public:
+        const unsigned char* Data() const {
+            return owned.empty() ? mapped : owned.data();
+        }
+
+        size_t Size() const {
+            return owned.empty() ? mappedSize : owned.size();
+        }
+
+        // a view straight into a pack, nothing was copied
+        bool Mapped() const {
+            return mapped != nullptr;
+        }
+
+    private:
+        friend class AssetPack;
+        friend bool ReadLooseFile(const std::string& path, AssetData& data);
+
+        const unsigned char* mapped = nullptr;
+        size_t mappedSize = 0;
+        std::vector<unsigned char> owned;
+    };
+
+    // one read of the whole file, no stream buffers in between
+    inline bool ReadLooseFile(const std::string& path, AssetData& data) {
+        data = AssetData();
+        int file = ::open(path.c_str(), O_RDONLY);
+        struct stat info;
+        if (file < 0) {
+            return false;
+        }
+        bool ok = ::fstat(file, &info) == 0;
+        if (ok) {
+            data.owned.resize((size_t)info.st_size);
+            size_t done = 0;
+            while (ok && done < data.owned.size()) {
+                ssize_t count = ::read(file, data.owned.data() + done, data.owned.size() - done);
+                ok = count > 0;
+                done += ok ? (size_t)count : 0;
+            }
+        }
+        ::close(file);
+        return ok;
+    }
+
+    // Read-only view of a pack written by project_base_assetpack, mapped once and shared by every
+    // loader; lookups and reads are const and so safe from any thread. Layout, little endian:
+    //
+    //   Header   magic "RGPACK1", entry count, entry alignment, index and name table offsets
+    //   entries  each at a multiple of the alignment, stored as is or LZ4 compressed
+    //   Entry[]  sorted by name, for a binary search
+    //   names    the relative paths, not terminated
+    class AssetPack {
+    public:
+        static const uint32_t Stored = 0;
+        static const uint32_t Lz4 = 1;
+
+        struct Header {
+            char magic[8];
+            uint32_t entryCount;
+            uint32_t alignment;
+            uint64_t indexOffset;
+            uint64_t namesOffset;
+        };
+
+        struct Entry {
+            uint64_t offset;
+            uint64_t storedSize;
+            uint64_t size;
+            uint32_t nameOffset;
+            uint32_t nameLength;
+            uint32_t compression;
+            uint32_t reserved;
+        };
+
+        AssetPack() = default;
+        AssetPack(const AssetPack&) = delete;
+        AssetPack& operator=(const AssetPack&) = delete;
+
+        ~AssetPack() {
+            Close();
+        }
+
+        static const char* Magic() {
+            return "RGPACK1";
+        }
+
+        bool Open(const std::string& path) {
+            Close();
+            int file = ::open(path.c_str(), O_RDONLY);
+            if (file < 0) {
+                return false;
+            }
+            struct stat info;
+            void* mapping = MAP_FAILED;
+            if (::fstat(file, &info) == 0 && info.st_size >= (off_t)sizeof(Header)) {
+                mapping = ::mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+            }
+            // the mapping keeps the file alive
+            ::close(file);
+            if (mapping == MAP_FAILED) {
+                return false;
+            }
+            base = (const unsigned char*)mapping;
+            length = (size_t)info.st_size;
+            if (!validate()) {
+                Close();
+                return false;
+            }
+            return true;
+        }
+
+        void Close() {
+            if (base) {
+                ::munmap((void*)base, length);
+            }
+            base = nullptr;
+            length = 0;
+            entries = nullptr;
+            names = nullptr;
+            count = 0;
+        }
+
+        bool IsOpen() const {
+            return base != nullptr;
+        }
+
+        size_t EntryCount() const {
+            return count;
+        }
+
+        const Entry* Find(const std::string& name) const {
+            const Entry* end = entries + count;
+            const Entry* entry = std::lower_bound(entries, end, name, [this](const Entry& e, const std::string& key) {
+                return compare(e, key) < 0;
+            });
+            return entry != end && compare(*entry, name) == 0 ? entry : nullptr;
+        }
+
+        // stored entries are handed out as a view into the mapping, compressed ones are inflated
+        bool Read(const std::string& name, AssetData& data) const {
+            data = AssetData();
+            const Entry* entry = Find(name);
+            if (!entry) {
+                return false;
+            }
+            const unsigned char* stored = base + entry->offset;
+            if (entry->compression == Stored) {
+                data.mapped = stored;
+                data.mappedSize = (size_t)entry->size;
+                return true;
+            }
+            data.owned.resize((size_t)entry->size);
+            if (!Lz4Decompress(stored, (size_t)entry->storedSize, data.owned.data(), data.owned.size())) {
+                data = AssetData();
+                return false;
+            }
+            return true;
+        }
+
+    private:
+        const unsigned char* base = nullptr;
+        size_t length = 0;
+        const Entry* entries = nullptr;
+        const char* names = nullptr;
+        uint32_t count = 0;
+
+        int compare(const Entry& entry, const std::string& key) const {
+            int order = std::memcmp(names + entry.nameOffset, key.data(), std::min<size_t>(entry.nameLength, key.size()));
+            if (order != 0) {
+                return order;
+            }
+            return entry.nameLength < key.size() ? -1 : entry.nameLength > key.size() ? 1 : 0;
+        }
+
+        // everything an entry points at has to be inside the file, a truncated pack is rejected
+        bool validate() {
+            Header header;
+            std::memcpy(&header, base, sizeof(header));
+            if (std::memcmp(header.magic, Magic(), 8) != 0 || header.indexOffset % alignof(Entry) != 0 ||
+                header.indexOffset > length || header.namesOffset > length ||
+                (length - header.indexOffset) / sizeof(Entry) < header.entryCount) {
+                return false;
+            }
+            entries = (const Entry*)(base + header.indexOffset);
+            names = (const char*)(base + header.namesOffset);
+            count = header.entryCount;
+            size_t namesLength = length - header.namesOffset;
+            for (uint32_t i = 0; i < count; i++) {
+                const Entry& entry = entries[i];
+                if (entry.offset > length || entry.storedSize > length - entry.offset ||
+                    entry.nameOffset > namesLength || entry.nameLength > namesLength - entry.nameOffset ||
+                    entry.compression > Lz4 || (entry.compression == Stored && entry.size != entry.storedSize)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+
+};
+
+#endif //PROJECT_BASE_ASSETPACK_H
@@ -0,0 +1,87 @@
+#ifndef PROJECT_BASE_ASSETPACKIO_H
+#define PROJECT_BASE_ASSETPACKIO_H
+
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
+
+#include <learnopengl/filesystem.h>
+#include <rg/AssetPack.h>
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace rg {
+
+    // assimp file over the bytes FileSystem hands out, read-only
+    class AssetStream : public Assimp::IOStream {
+    public:
+        explicit AssetStream(AssetData data) : data(std::move(data)) {}
+
+        size_t Read(void* buffer, size_t size, size_t count) override {
+            if (size == 0) {
+                return 0;
+            }
+            count = std::min(count, (data.Size() - position) / size);
+            std::memcpy(buffer, data.Data() + position, size * count);
+            position += size * count;
+            return count;
+        }
+
+        size_t Write(const void* buffer, size_t size, size_t count) override {
+            return 0;
+        }
+
+        aiReturn Seek(size_t offset, aiOrigin origin) override {
+            size_t target = origin == aiOrigin_SET ? offset :
+                            origin == aiOrigin_CUR ? position + offset : data.Size() - offset;
+            if (target > data.Size() || (origin == aiOrigin_END && offset > data.Size())) {
+                return aiReturn_FAILURE;
+            }
+            position = target;
+            return aiReturn_SUCCESS;
+        }
+
+        size_t Tell() const override {
+            return position;
+        }
+
+        size_t FileSize() const override {
+            return data.Size();
+        }
+
+        void Flush() override {}
+
+    private:
+        AssetData data;
+        size_t position = 0;
+    };
+
+    // Lets assimp open a model and the files it pulls in (.mtl) through FileSystem, so they come
+    // out of the mounted asset pack; set on an Importer, which takes ownership.
+    class AssetIOSystem : public Assimp::IOSystem {
+    public:
+        bool Exists(const char* file) const override {
+            return FileSystem::exists(file);
+        }
+
+        char getOsSeparator() const override {
+            return '/';
+        }
+
+        Assimp::IOStream* Open(const char* file, const char* mode = "rb") override {
+            AssetData data;
+            if (std::strchr(mode, 'w') || std::strchr(mode, 'a') || !FileSystem::read(file, data)) {
+                return nullptr;
+            }
+            return new AssetStream(std::move(data));
+        }
+
+        void Close(Assimp::IOStream* stream) override {
+            delete stream;
+        }
+    };
+
+};
+
+#endif //PROJECT_BASE_ASSETPACKIO_H
@@ -0,0 +1,179 @@
+#ifndef PROJECT_BASE_AUTOEXPOSURE_H
+#define PROJECT_BASE_AUTOEXPOSURE_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/shader.h>
+#include <rg/Error.h>
+#include <rg/PostGraph.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+
+namespace rg {
+
+    struct ExposureSettings {
+        float key = 0.25f;       // exposure times average luminance
+        float minExposure = 0.1f;
+        float maxExposure = 1.5f;
+        float speedUp = 3.0f;    // adaptation rate towards a brighter scene, per second
+        float speedDown = 1.0f;  // and towards a darker one; eyes adjust to the dark slower
+    };
+
+    // Exposure from the average scene luminance, computed on the GPU. The scene is reduced to the
+    // log luminance of a 256x256 grid, then averaged 4x4 texels per pass down to one texel, so the
+    // result is the geometric mean and a few bright pixels can't darken the frame. The adaptation
+    // pass moves a persistent 1x1 texture towards that mean and the composite reads it directly,
+    // so the CPU never waits on it. A copy still comes back through a ring of pixel buffers with
+    // fences, read only once the GPU is done with it, for the UI.
+    class AutoExposure {
+    public:
+        static const int GridSize = 256;
+        static const int ReadbackLatency = 3; // pixel buffers in the ring
+
+        AutoExposure()
+                : luminanceShader("resources/shaders/7.blur.vs", "resources/shaders/luminance.fs"),
+                  reduceShader("resources/shaders/7.blur.vs", "resources/shaders/luminance_reduce.fs"),
+                  adaptShader("resources/shaders/7.blur.vs", "resources/shaders/exposure_adapt.fs") {
+            luminanceShader.use();
+            luminanceShader.setInt("scene", 0);
+            reduceShader.use();
+            reduceShader.setInt("source", 0);
+            adaptShader.use();
+            adaptShader.setInt("averageLog", 0);
+            adaptShader.setInt("previous", 1);
+
+            glGenTextures(2, adapted);
+            for (GLuint texture : adapted) {
+                glBindTexture(GL_TEXTURE_2D, texture);
+                GLCALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, 1, 1, 0, GL_RED, GL_FLOAT, NULL));
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            }
+            glBindTexture(GL_TEXTURE_2D, 0);
+
+            glGenBuffers(ReadbackLatency, pixelBuffers);
+            for (GLuint buffer : pixelBuffers) {
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+                glBufferData(GL_PIXEL_PACK_BUFFER, sizeof(float), NULL, GL_STREAM_READ);
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        }
+
+        AutoExposure(const AutoExposure&) = delete;
+        AutoExposure& operator=(const AutoExposure&) = delete;
+
+        // declares the reduction and adaptation of scene (the HDR color), returns the adapted
+        // luminance for the composite; drawQuad draws a full-screen quad
+        PostGraph::Resource AddPasses(PostGraph& graph, PostGraph::Resource scene, uint64_t frameIndex, float deltaTime,
+                                      const ExposureSettings& settings, std::function<void()> drawQuad) {
+            PostGraph::Resource grid = graph.Create("log luminance", TargetDesc(GL_R16F, GridSize, GridSize));
+            graph.AddPass("exposure", {scene}, {grid}, [this, scene, drawQuad](const PostGraph::PassContext& pass) {
+                luminanceShader.use();
+                luminanceShader.setFloat("outputTexel", 1.0f / (float)GridSize);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, pass.Texture(scene));
+                drawQuad();
+            });
+
+            PostGraph::Resource input = grid;
+            for (int size = GridSize / 4; size >= 1; size /= 4) {
+                PostGraph::Resource output = graph.Create("log luminance", TargetDesc(GL_R16F, size, size));
+                graph.AddPass("exposure", {input}, {output}, [this, input, drawQuad](const PostGraph::PassContext& pass) {
+                    reduceShader.use();
+                    glActiveTexture(GL_TEXTURE0);
+                    glBindTexture(GL_TEXTURE_2D, pass.Texture(input));
+                    drawQuad();
+                });
+                input = output;
+            }
+
+            // the adapted value ping-pongs between two textures that outlive the frame; after a gap
+            // in the frames the old value is stale, so it starts from the measured one
+            bool reset = !adaptedValid || frameIndex != lastFrame + 1;
+            adaptedValid = true;
+            lastFrame = frameIndex;
+            PostGraph::Resource previous = graph.ImportTexture("adapted luminance", adapted[current], GL_R32F, 1, 1);
+            current = 1 - current;
+            PostGraph::Resource next = graph.ImportTexture("adapted luminance", adapted[current], GL_R32F, 1, 1);
+            PostGraph::Resource average = input;
+            graph.AddPass("exposure", {average, previous}, {next},
+                          [this, average, previous, reset, deltaTime, settings, drawQuad](const PostGraph::PassContext& pass) {
+                adaptShader.use();
+                adaptShader.setBool("reset", reset);
+                adaptShader.setFloat("deltaTime", deltaTime);
+                adaptShader.setFloat("speedUp", settings.speedUp);
+                adaptShader.setFloat("speedDown", settings.speedDown);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, pass.Texture(average));
+                glActiveTexture(GL_TEXTURE1);
+                glBindTexture(GL_TEXTURE_2D, pass.Texture(previous));
+                drawQuad();
+                glActiveTexture(GL_TEXTURE0);
+                readBack();
+            });
+            return next;
+        }
+
+        // sets the uniforms bloom.fs needs to turn the adapted luminance into an exposure
+        static void SetUniforms(const Shader& shader, const ExposureSettings& settings) {
+            shader.setFloat("exposureKey", settings.key);
+            shader.setFloat("minExposure", settings.minExposure);
+            shader.setFloat("maxExposure", settings.maxExposure);
+        }
+
+        // adapted luminance as of a few frames ago, negative until the first copy arrives;
+        // callable from any thread
+        float AdaptedLuminance() const {
+            return readLuminance.load(std::memory_order_relaxed);
+        }
+
+    private:
+        Shader luminanceShader;
+        Shader reduceShader;
+        Shader adaptShader;
+        GLuint adapted[2] = {0, 0};
+        int current = 0;
+        bool adaptedValid = false;
+        uint64_t lastFrame = 0;
+
+        GLuint pixelBuffers[ReadbackLatency] = {};
+        GLsync fences[ReadbackLatency] = {};
+        int nextBuffer = 0;
+        std::atomic<float> readLuminance{-1.0f};
+
+        // runs with the adapted texture bound for drawing: collects finished copies, then queues
+        // a copy of this frame's value unless its buffer is still waiting on the GPU
+        void readBack() {
+            for (int i = 0; i < ReadbackLatency; i++) {
+                int buffer = (nextBuffer + i) % ReadbackLatency; // oldest first
+                if (!fences[buffer]) {
+                    continue;
+                }
+                GLenum status = glClientWaitSync(fences[buffer], 0, 0);
+                if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+                    continue;
+                }
+                glDeleteSync(fences[buffer]);
+                fences[buffer] = 0;
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[buffer]);
+                if (const float* value = (const float*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, sizeof(float), GL_MAP_READ_BIT)) {
+                    readLuminance.store(*value, std::memory_order_relaxed);
+                    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+                }
+            }
+
+            if (!fences[nextBuffer]) {
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[nextBuffer]);
+                glReadPixels(0, 0, 1, 1, GL_RED, GL_FLOAT, 0);
+                fences[nextBuffer] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+                nextBuffer = (nextBuffer + 1) % ReadbackLatency;
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        }
+    };
+
+};
+
+#endif //PROJECT_BASE_AUTOEXPOSURE_H
@@ -0,0 +1,434 @@
+#ifndef PROJECT_BASE_BVH_H
+#define PROJECT_BASE_BVH_H
+
+#include <glm/glm.hpp>
+
+#if defined(__SSE2__)
+#include <xmmintrin.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace rg {
+
+    struct Ray {
+        glm::vec3 origin;
+        glm::vec3 direction;
+        float tMax = std::numeric_limits<float>::max();
+    };
+
+    struct RayHit {
+        float t = std::numeric_limits<float>::max();
+        uint32_t triangle = UINT32_MAX; // index into the triangles given to Build
+        float u = 0.0f, v = 0.0f;       // barycentrics of the second and third vertex
+
+        bool Hit() const {
+            return triangle != UINT32_MAX;
+        }
+    };
+
+    // Four rays traced together, one per SIMD lane, laid out structure of arrays. Rays that
+    // start at the same point and go roughly the same way (a hemisphere's worth from one
+    // lightmap texel) visit mostly the same nodes, so one box test serves all four.
+    struct RayPacket {
+        float ox[4], oy[4], oz[4];
+        float dx[4], dy[4], dz[4];
+        float tMax[4];
+        RayHit hits[4];
+
+        void Set(int lane, const Ray& ray) {
+            ox[lane] = ray.origin.x;
+            oy[lane] = ray.origin.y;
+            oz[lane] = ray.origin.z;
+            dx[lane] = ray.direction.x;
+            dy[lane] = ray.direction.y;
+            dz[lane] = ray.direction.z;
+            tMax[lane] = ray.tMax;
+            hits[lane] = RayHit();
+        }
+    };
+
+    // Bounding volume hierarchy over a triangle soup, built with binned SAH. Closest hit and
+    // any hit queries for single rays, closest hit for packets of four. Built once and then
+    // only read, so any number of threads can trace against it.
+    class Bvh {
+    public:
+        // three positions per triangle
+        void Build(const std::vector<glm::vec3>& positions) {
+            size_t count = positions.size() / 3;
+            std::vector<Reference> references(count);
+            for (size_t i = 0; i < count; i++) {
+                Reference& reference = references[i];
+                reference.min = glm::min(positions[3 * i], glm::min(positions[3 * i + 1], positions[3 * i + 2]));
+                reference.max = glm::max(positions[3 * i], glm::max(positions[3 * i + 1], positions[3 * i + 2]));
+                reference.centroid = (reference.min + reference.max) * 0.5f;
+                reference.triangle = (uint32_t)i;
+            }
+            nodes.clear();
+            nodes.reserve(count ? 2 * count : 1);
+            nodes.push_back(Node());
+            if (count > 0) {
+                build(references, 0, 0, count);
+            } else {
+                nodes[0].min = glm::vec3(1.0f);
+                nodes[0].max = glm::vec3(-1.0f);
+            }
+            // triangles in leaf order, so a leaf reads one contiguous run
+            triangles.resize(count);
+            vertices.resize(3 * count);
+            for (size_t i = 0; i < count; i++) {
+                triangles[i] = references[i].triangle;
+                for (int k = 0; k < 3; k++) {
+                    vertices[3 * i + k] = positions[3 * references[i].triangle + k];
+                }
+            }
+        }
+
+        size_t NodeCount() const {
+            return nodes.size();
+        }
+
+        bool Intersect(const Ray& ray, RayHit& hit) const {
+            glm::vec3 inverse = 1.0f / ray.direction;
+            float tMax = std::min(ray.tMax, hit.t);
+            uint32_t stack[64];
+            int top = 0;
+            stack[top++] = 0;
+            bool found = false;
+            while (top > 0) {
+                const Node& node = nodes[stack[--top]];
+                if (!boxHit(node, ray.origin, inverse, tMax)) {
+                    continue;
+                }
+                if (node.count > 0) {
+                    for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                        float t, u, v;
+                        if (triangleHit(i, ray.origin, ray.direction, tMax, t, u, v)) {
+                            tMax = t;
+                            hit.t = t;
+                            hit.triangle = triangles[i];
+                            hit.u = u;
+                            hit.v = v;
+                            found = true;
+                        }
+                    }
+                    continue;
+                }
+                // the near child goes on top
+                bool flip = ray.direction[node.axis] < 0.0f;
+                stack[top++] = node.first + (flip ? 0 : 1);
+                stack[top++] = node.first + (flip ? 1 : 0);
+            }
+            return found;
+        }
+
+        // anything between the origin and tMax, for shadow and occlusion rays
+        bool Occluded(const Ray& ray) const {
+            glm::vec3 inverse = 1.0f / ray.direction;
+            uint32_t stack[64];
+            int top = 0;
+            stack[top++] = 0;
+            while (top > 0) {
+                const Node& node = nodes[stack[--top]];
+                if (!boxHit(node, ray.origin, inverse, ray.tMax)) {
+                    continue;
+                }
+                if (node.count > 0) {
+                    for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                        float t, u, v;
+                        if (triangleHit(i, ray.origin, ray.direction, ray.tMax, t, u, v)) {
+                            return true;
+                        }
+                    }
+                    continue;
+                }
+                stack[top++] = node.first;
+                stack[top++] = node.first + 1;
+            }
+            return false;
+        }
+
+        // closest hits of all four rays of the packet
+        void Intersect(RayPacket& packet) const {
+            float idx[4], idy[4], idz[4];
+            for (int lane = 0; lane < 4; lane++) {
+                idx[lane] = 1.0f / packet.dx[lane];
+                idy[lane] = 1.0f / packet.dy[lane];
+                idz[lane] = 1.0f / packet.dz[lane];
+            }
+            uint32_t stack[64];
+            int top = 0;
+            stack[top++] = 0;
+            while (top > 0) {
+                const Node& node = nodes[stack[--top]];
+                if (!packetBoxHit(node, packet, idx, idy, idz)) {
+                    continue;
+                }
+                if (node.count > 0) {
+                    for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                        packetTriangleHit(i, packet);
+                    }
+                    continue;
+                }
+                bool flip = (node.axis == 0 ? packet.dx[0] : node.axis == 1 ? packet.dy[0] : packet.dz[0]) < 0.0f;
+                stack[top++] = node.first + (flip ? 0 : 1);
+                stack[top++] = node.first + (flip ? 1 : 0);
+            }
+        }
+
+    private:
+        // interior nodes have count 0 and their children at first and first + 1
+        struct Node {
+            glm::vec3 min;
+            uint32_t first = 0;
+            glm::vec3 max;
+            uint16_t count = 0;
+            uint16_t axis = 0;
+        };
+
+        struct Reference {
+            glm::vec3 min, max, centroid;
+            uint32_t triangle;
+        };
+
+        std::vector<Node> nodes;
+        std::vector<uint32_t> triangles; // original index of each triangle in leaf order
+        std::vector<glm::vec3> vertices;
+
+        static float halfArea(const glm::vec3& min, const glm::vec3& max) {
+            glm::vec3 e = glm::max(max - min, glm::vec3(0.0f));
+            return e.x * e.y + e.y * e.z + e.z * e.x;
+        }
+
+        // binned SAH over the centroids, 16 bins per axis; stops at 4 triangles or when no
+        // split is cheaper than the leaf. Recursion depth stays far below the traversal stack
+        void build(std::vector<Reference>& references, uint32_t index, size_t begin, size_t end) {
+            const int binCount = 16;
+            const size_t leafSize = 4;
+            glm::vec3 min = references[begin].min, max = references[begin].max;
+            glm::vec3 centroidMin = references[begin].centroid, centroidMax = centroidMin;
+            for (size_t i = begin; i < end; i++) {
+                min = glm::min(min, references[i].min);
+                max = glm::max(max, references[i].max);
+                centroidMin = glm::min(centroidMin, references[i].centroid);
+                centroidMax = glm::max(centroidMax, references[i].centroid);
+            }
+            nodes[index].min = min;
+            nodes[index].max = max;
+            size_t count = end - begin;
+
+            int bestAxis = -1;
+            int bestSplit = 0;
+            float bestCost = (float)count * halfArea(min, max);
+            if (count > leafSize) {
+                for (int axis = 0; axis < 3; axis++) {
+                    float extent = centroidMax[axis] - centroidMin[axis];
+                    if (extent <= 0.0f) {
+                        continue;
+                    }
+                    struct Bin {
+                        glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+                        glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+                        size_t count = 0;
+                    } bins[binCount];
+                    float scale = binCount / extent;
+                    for (size_t i = begin; i < end; i++) {
+                        int bin = std::min(binCount - 1, (int)((references[i].centroid[axis] - centroidMin[axis]) * scale));
+                        bins[bin].min = glm::min(bins[bin].min, references[i].min);
+                        bins[bin].max = glm::max(bins[bin].max, references[i].max);
+                        bins[bin].count++;
+                    }
+                    // sweep from the right, then from the left
+                    float rightCost[binCount];
+                    glm::vec3 boundsMin = bins[binCount - 1].min, boundsMax = bins[binCount - 1].max;
+                    size_t rightCount = 0;
+                    for (int split = binCount - 1; split > 0; split--) {
+                        boundsMin = glm::min(boundsMin, bins[split].min);
+                        boundsMax = glm::max(boundsMax, bins[split].max);
+                        rightCount += bins[split].count;
+                        rightCost[split] = rightCount ? rightCount * halfArea(boundsMin, boundsMax) : 0.0f;
+                    }
+                    boundsMin = bins[0].min;
+                    boundsMax = bins[0].max;
+                    size_t leftCount = 0;
+                    for (int split = 1; split < binCount; split++) {
+                        boundsMin = glm::min(boundsMin, bins[split - 1].min);
+                        boundsMax = glm::max(boundsMax, bins[split - 1].max);
+                        leftCount += bins[split - 1].count;
+                        if (leftCount == 0 || leftCount == count) {
+                            continue;
+                        }
+                        float cost = leftCount * halfArea(boundsMin, boundsMax) + rightCost[split];
+                        if (cost < bestCost) {
+                            bestCost = cost;
+                            bestAxis = axis;
+                            bestSplit = split;
+                        }
+                    }
+                }
+            }
+            if (bestAxis < 0) {
+                nodes[index].first = (uint32_t)begin;
+                nodes[index].count = (uint16_t)count;
+                if (count <= UINT16_MAX) {
+                    return;
+                }
+                // identical centroids in bulk; halve them anyway to keep leaves small
+                bestAxis = 0;
+            }
+
+            size_t middle;
+            if (bestSplit > 0) {
+                float scale = binCount / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+                auto right = std::partition(references.begin() + begin, references.begin() + end,
+                                            [&](const Reference& reference) {
+                    int bin = std::min(binCount - 1, (int)((reference.centroid[bestAxis] - centroidMin[bestAxis]) * scale));
+                    return bin < bestSplit;
+                });
+                middle = right - references.begin();
+            } else {
+                middle = begin + count / 2;
+            }
+            uint32_t children = (uint32_t)nodes.size();
+            nodes[index].first = children;
+            nodes[index].count = 0;
+            nodes[index].axis = (uint16_t)bestAxis;
+            nodes.push_back(Node());
+            nodes.push_back(Node());
+            build(references, children, begin, middle);
+            build(references, children + 1, middle, end);
+        }
+
+        static bool boxHit(const Node& node, const glm::vec3& origin, const glm::vec3& inverse, float tMax) {
+            glm::vec3 t0 = (node.min - origin) * inverse;
+            glm::vec3 t1 = (node.max - origin) * inverse;
+            glm::vec3 near = glm::min(t0, t1), far = glm::max(t0, t1);
+            float enter = std::max(std::max(near.x, near.y), std::max(near.z, 0.0f));
+            float exit = std::min(std::min(far.x, far.y), std::min(far.z, tMax));
+            return enter <= exit;
+        }
+
+        // Moller-Trumbore, both sides
+        bool triangleHit(uint32_t i, const glm::vec3& origin, const glm::vec3& direction, float tMax,
+                         float& t, float& u, float& v) const {
+            const glm::vec3& v0 = vertices[3 * i];
+            glm::vec3 e1 = vertices[3 * i + 1] - v0, e2 = vertices[3 * i + 2] - v0;
+            glm::vec3 p = glm::cross(direction, e2);
+            float det = glm::dot(e1, p);
+            if (std::fabs(det) < 1e-12f) {
+                return false;
+            }
+            float invDet = 1.0f / det;
+            glm::vec3 s = origin - v0;
+            u = glm::dot(s, p) * invDet;
+            if (u < 0.0f || u > 1.0f) {
+                return false;
+            }
+            glm::vec3 q = glm::cross(s, e1);
+            v = glm::dot(direction, q) * invDet;
+            if (v < 0.0f || u + v > 1.0f) {
+                return false;
+            }
+            t = glm::dot(e2, q) * invDet;
+            return t > 0.0f && t < tMax;
+        }
+
+        bool packetBoxHit(const Node& node, const RayPacket& packet, const float* idx, const float* idy, const float* idz) const {
+#if defined(__SSE2__)
+            __m128 ox = _mm_loadu_ps(packet.ox), oy = _mm_loadu_ps(packet.oy), oz = _mm_loadu_ps(packet.oz);
+            __m128 ix = _mm_loadu_ps(idx), iy = _mm_loadu_ps(idy), iz = _mm_loadu_ps(idz);
+            __m128 x0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.min.x), ox), ix);
+            __m128 x1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.max.x), ox), ix);
+            __m128 y0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.min.y), oy), iy);
+            __m128 y1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.max.y), oy), iy);
+            __m128 z0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.min.z), oz), iz);
+            __m128 z1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.max.z), oz), iz);
+            __m128 enter = _mm_max_ps(_mm_max_ps(_mm_min_ps(x0, x1), _mm_min_ps(y0, y1)),
+                                      _mm_max_ps(_mm_min_ps(z0, z1), _mm_setzero_ps()));
+            __m128 exit = _mm_min_ps(_mm_min_ps(_mm_max_ps(x0, x1), _mm_max_ps(y0, y1)),
+                                     _mm_min_ps(_mm_max_ps(z0, z1), _mm_loadu_ps(packet.tMax)));
+            return _mm_movemask_ps(_mm_cmple_ps(enter, exit)) != 0;
+#else
+            for (int lane = 0; lane < 4; lane++) {
+                glm::vec3 origin(packet.ox[lane], packet.oy[lane], packet.oz[lane]);
+                if (boxHit(node, origin, glm::vec3(idx[lane], idy[lane], idz[lane]), packet.tMax[lane])) {
+                    return true;
+                }
+            }
+            return false;
+#endif
+        }
+
+        // one triangle against the four rays, the packet's tMax shrinks with every hit
+        void packetTriangleHit(uint32_t i, RayPacket& packet) const {
+            const glm::vec3& v0 = vertices[3 * i];
+            glm::vec3 e1 = vertices[3 * i + 1] - v0, e2 = vertices[3 * i + 2] - v0;
+#if defined(__SSE2__)
+            __m128 dx = _mm_loadu_ps(packet.dx), dy = _mm_loadu_ps(packet.dy), dz = _mm_loadu_ps(packet.dz);
+            __m128 e1x = _mm_set1_ps(e1.x), e1y = _mm_set1_ps(e1.y), e1z = _mm_set1_ps(e1.z);
+            __m128 e2x = _mm_set1_ps(e2.x), e2y = _mm_set1_ps(e2.y), e2z = _mm_set1_ps(e2.z);
+            // p = d x e2
+            __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+            __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+            __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+            __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+            __m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+            // s = o - v0
+            __m128 sx = _mm_sub_ps(_mm_loadu_ps(packet.ox), _mm_set1_ps(v0.x));
+            __m128 sy = _mm_sub_ps(_mm_loadu_ps(packet.oy), _mm_set1_ps(v0.y));
+            __m128 sz = _mm_sub_ps(_mm_loadu_ps(packet.oz), _mm_set1_ps(v0.z));
+            __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), invDet);
+            // q = s x e1
+            __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+            __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+            __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+            __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), invDet);
+            __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), invDet);
+            __m128 zero = _mm_setzero_ps();
+            __m128 absDet = _mm_max_ps(det, _mm_sub_ps(zero, det));
+            __m128 hit = _mm_and_ps(_mm_cmpge_ps(absDet, _mm_set1_ps(1e-12f)),
+                                    _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmpge_ps(v, zero)));
+            hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+            hit = _mm_and_ps(hit, _mm_and_ps(_mm_cmpgt_ps(t, zero), _mm_cmplt_ps(t, _mm_loadu_ps(packet.tMax))));
+            int mask = _mm_movemask_ps(hit);
+            if (!mask) {
+                return;
+            }
+            float ts[4], us[4], vs[4];
+            _mm_storeu_ps(ts, t);
+            _mm_storeu_ps(us, u);
+            _mm_storeu_ps(vs, v);
+            for (int lane = 0; lane < 4; lane++) {
+                if (mask & (1 << lane)) {
+                    record(packet, lane, i, ts[lane], us[lane], vs[lane]);
+                }
+            }
+#else
+            for (int lane = 0; lane < 4; lane++) {
+                glm::vec3 origin(packet.ox[lane], packet.oy[lane], packet.oz[lane]);
+                glm::vec3 direction(packet.dx[lane], packet.dy[lane], packet.dz[lane]);
+                float t, u, v;
+                if (triangleHit(i, origin, direction, packet.tMax[lane], t, u, v)) {
+                    record(packet, lane, i, t, u, v);
+                }
+            }
+#endif
+        }
+
+        void record(RayPacket& packet, int lane, uint32_t i, float t, float u, float v) const {
+            packet.tMax[lane] = t;
+            RayHit& hit = packet.hits[lane];
+            hit.t = t;
+            hit.triangle = triangles[i];
+            hit.u = u;
+            hit.v = v;
+        }
+    };
+
+};
+
+#endif //PROJECT_BASE_BVH_H
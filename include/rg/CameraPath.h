@@ -0,0 +1,100 @@
+#ifndef PROJECT_BASE_CAMERAPATH_H
+#define PROJECT_BASE_CAMERAPATH_H
+
+#include <glm/glm.hpp>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+    struct CameraKey {
+        float time = 0.0f; // seconds from the start of the path
+        glm::vec3 position = glm::vec3(0.0f);
+        float yaw = -90.0f; // degrees, same convention as Camera
+        float pitch = 0.0f;
+        float zoom = 45.0f;
+    };
+
+    // Recorded camera flight, sampled with linear interpolation between keys. Stored as text,
+    // one key per line: time x y z yaw pitch zoom. Lines starting with # are comments.
+    class CameraPath {
+    public:
+        std::vector<CameraKey> keys;
+
+        bool Load(const std::string& path) {
+            std::ifstream in(path);
+            if (!in) {
+                return false;
+            }
+            keys.clear();
+            std::string line;
+            while (std::getline(in, line)) {
+                if (line.empty() || line[0] == '#') {
+                    continue;
+                }
+                CameraKey key;
+                std::istringstream fields(line);
+                if (fields >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.yaw >> key.pitch) {
+                    fields >> key.zoom;
+                    keys.push_back(key);
+                }
+            }
+            return !keys.empty();
+        }
+
+        bool Save(const std::string& path) const {
+            std::ofstream out(path);
+            if (!out) {
+                return false;
+            }
+            out << "# time x y z yaw pitch zoom\n";
+            for (const CameraKey& key : keys) {
+                out << key.time << ' ' << key.position.x << ' ' << key.position.y << ' ' << key.position.z << ' '
+                    << key.yaw << ' ' << key.pitch << ' ' << key.zoom << '\n';
+            }
+            return (bool)out;
+        }
+
+        // keys must arrive in increasing time order
+        void Add(const CameraKey& key) {
+            keys.push_back(key);
+        }
+
+        float Duration() const {
+            return keys.empty() ? 0.0f : keys.back().time;
+        }
+
+        // clamps to the first and last key outside the recorded range
+        CameraKey Sample(float time) const {
+            if (keys.empty()) {
+                return CameraKey();
+            }
+            if (time <= keys.front().time) {
+                return keys.front();
+            }
+            if (time >= keys.back().time) {
+                return keys.back();
+            }
+            size_t next = 1;
+            while (keys[next].time < time) {
+                ++next;
+            }
+            const CameraKey& a = keys[next - 1];
+            const CameraKey& b = keys[next];
+            float t = b.time > a.time ? (time - a.time) / (b.time - a.time) : 1.0f;
+            CameraKey key;
+            key.time = time;
+            key.position = glm::mix(a.position, b.position, t);
+            key.yaw = a.yaw + (b.yaw - a.yaw) * t;
+            key.pitch = a.pitch + (b.pitch - a.pitch) * t;
+            key.zoom = a.zoom + (b.zoom - a.zoom) * t;
+            return key;
+        }
+    };
+
+};
+
+#endif //PROJECT_BASE_CAMERAPATH_H
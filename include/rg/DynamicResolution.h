@@ -0,0 +1,82 @@
+#ifndef PROJECT_BASE_DYNAMICRESOLUTION_H
+#define PROJECT_BASE_DYNAMICRESOLUTION_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace rg {
+
+    // Picks the render scale of the scene from measured GPU frame times. Cost grows with the pixel
+    // count, the square of the scale, so the step towards the budget is the square root of the
+    // ratio. The scale only goes up again with clear headroom, moves in fixed steps so the
+    // post-process pool sees a handful of sizes instead of a new one every frame, and waits for
+    // the measurements of a change to arrive before making the next one (GPU timings come back
+    // several frames late).
+    class DynamicResolution {
+    public:
+        static constexpr float Step = 0.05f;
+
+        bool enabled = true;
+        float targetMs = 14.0f; // GPU time budget per frame
+        float minScale = 0.5f;
+        float maxScale = 1.0f;
+        int settleFrames = 8;   // frames to wait after a change before measuring again
+
+        // feeds the GPU time of a finished frame; older or repeated frames are ignored
+        void Update(uint64_t frameIndex, float gpuMs) {
+            if (hasMeasurement && frameIndex <= lastFrame) {
+                return;
+            }
+            hasMeasurement = true;
+            lastFrame = frameIndex;
+            smoothedMs = smoothedMs <= 0.0f ? gpuMs : smoothedMs + (gpuMs - smoothedMs) * 0.1f;
+            if (!enabled) {
+                scale = maxScale;
+                return;
+            }
+            if (frameIndex < changedAt + (uint64_t)settleFrames) {
+                return;
+            }
+
+            float wanted = scale;
+            if (smoothedMs > targetMs) {
+                // at least one step down, rounded down so the result lands under the budget
+                wanted = std::floor(scale * std::sqrt(targetMs / smoothedMs) / Step + 0.001f) * Step;
+                wanted = std::min(wanted, scale - Step);
+            } else if (smoothedMs < targetMs * 0.8f) {
+                // grow slowly, one step at a time, so it doesn't oscillate around the budget
+                wanted = scale + Step;
+            }
+            wanted = std::min(maxScale, std::max(minScale, quantize(wanted)));
+            if (wanted != scale) {
+                scale = wanted;
+                changedAt = frameIndex;
+                // the average was measured at the old resolution
+                smoothedMs = 0.0f;
+            }
+        }
+
+        float Scale() const {
+            return scale;
+        }
+
+        float SmoothedMs() const {
+            return smoothedMs;
+        }
+
+    private:
+        float scale = 1.0f;
+        float smoothedMs = 0.0f;
+        uint64_t lastFrame = 0;
+        uint64_t changedAt = 0;
+        bool hasMeasurement = false;
+
+        static float quantize(float value) {
+            return std::floor(value / Step + 0.5f) * Step;
+        }
+    };
+
+};
+
+#endif //PROJECT_BASE_DYNAMICRESOLUTION_H
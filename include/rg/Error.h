@@ -8,47 +8,280 @@
 #include <iostream>
 #include <glad/glad.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
 #define LOG(stream) stream << "[" << __FILE__ << ", " << __func__ << ", " << __LINE__ << "] "
 #define BREAK_IF_FALSE(x) if (!(x)) __builtin_trap()
 #define ASSERT(x, msg) do { if (!(x)) { std::cerr << msg << '\n'; BREAK_IF_FALSE(false); } } while(0)
+
+// GL errors are reported by the driver's debug output (KHR_debug) instead of glGetError, which
+// can stall the pipeline until the GPU catches up. GLCALL only leaves a breadcrumb, one relaxed
+// store of a static call site, so a message can name the call that came last before it. Without
+// RG_GL_DEBUG (cmake -DRG_GL_DEBUG=ON, or a Debug build) all of it compiles away.
+#if defined(RG_GL_DEBUG)
+#define RG_GL_BREADCRUMB(what) \
+do{ static const rg::GlCallSite rgGlCallSite = {__FILE__, __LINE__, what}; \
+    rg::ThreadGlBreadcrumbs().call.store(&rgGlCallSite, std::memory_order_relaxed); } while (0)
+#else
+#define RG_GL_BREADCRUMB(what) do{} while (0)
+#endif
 #define GLCALL(x) \
-do{ rg::clearAllOpenGlErrors(); x; BREAK_IF_FALSE(rg::wasPreviousOpenGLCallSuccessful(__FILE__, __LINE__, #x)); } while (0)
+do{ RG_GL_BREADCRUMB(#x); x; } while (0)
+
+// KHR_debug, not in the 3.3 core glad
+#ifndef GL_DEBUG_OUTPUT
+#define GL_DEBUG_OUTPUT 0x92E0
+#define GL_DEBUG_OUTPUT_SYNCHRONOUS 0x8242
+#define GL_CONTEXT_FLAG_DEBUG_BIT 0x00000002
+#define GL_DEBUG_SOURCE_API 0x8246
+#define GL_DEBUG_SOURCE_WINDOW_SYSTEM 0x8247
+#define GL_DEBUG_SOURCE_SHADER_COMPILER 0x8248
+#define GL_DEBUG_SOURCE_THIRD_PARTY 0x8249
+#define GL_DEBUG_SOURCE_APPLICATION 0x824A
+#define GL_DEBUG_SOURCE_OTHER 0x824B
+#define GL_DEBUG_TYPE_ERROR 0x824C
+#define GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR 0x824D
+#define GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR 0x824E
+#define GL_DEBUG_TYPE_PORTABILITY 0x824F
+#define GL_DEBUG_TYPE_PERFORMANCE 0x8250
+#define GL_DEBUG_TYPE_OTHER 0x8251
+#define GL_DEBUG_TYPE_MARKER 0x8268
+#define GL_DEBUG_TYPE_PUSH_GROUP 0x8269
+#define GL_DEBUG_TYPE_POP_GROUP 0x826A
+#define GL_DEBUG_SEVERITY_NOTIFICATION 0x826B
+#define GL_DEBUG_SEVERITY_HIGH 0x9146
+#define GL_DEBUG_SEVERITY_MEDIUM 0x9147
+#define GL_DEBUG_SEVERITY_LOW 0x9148
+#endif
 
 namespace rg {
 
-    
-void clearAllOpenGlErrors();
-const char* openGLErrorToString(GLenum error);
-bool wasPreviousOpenGLCallSuccessful(const char* file, int line, const char* call);
+    struct GlCallSite {
+        const char* file;
+        int line;
+        const char* call;
+    };
 
-    void clearAllOpenGlErrors() {
-        while (glGetError() != GL_NO_ERROR) {
-            ;
-        }
-    }
-    const char* openGLErrorToString(GLenum error) {
-        switch(error) {
-            case GL_NO_ERROR: return "GL_NO_ERROR";
-            case GL_INVALID_ENUM: return "GL_INVALID_ENUM";
-            case GL_INVALID_VALUE: return "GL_INVALID_VALUE";
-            case GL_INVALID_OPERATION: return "GL_INVALID_OPERATION";
-            case GL_OUT_OF_MEMORY: return "GL_OUT_OF_MEMORY";
-        }
-        ASSERT(false, "Passed something that is not an error code");
-        return "THIS_SHOULD_NEVER_HAPPEN";
-    }
-    bool wasPreviousOpenGLCallSuccessful(const char* file, int line, const char* call) {
-        bool success = true;
-        while (GLenum error = glGetError()) {
-            std::cerr << "[OpenGL error] " << error << " " << openGLErrorToString(error)
-            << "\nFile: " << file
-            << "\nLine: " << line
-            << "\nCall: " << call
-            << "\n\n";
-            success = false;
-        }
-        return success;
+    // what a thread last did with GL: the last GLCALL and the GPU pass it is in. Atomic because
+    // the driver may deliver messages on a thread of its own
+    struct GlBreadcrumbs {
+        std::atomic<const GlCallSite*> call{nullptr};
+        std::atomic<const char*> pass{nullptr};
+    };
+
+    inline GlBreadcrumbs& ThreadGlBreadcrumbs() {
+        static thread_local GlBreadcrumbs breadcrumbs;
+        return breadcrumbs;
     }
 
+    // names the pass GL work is issued in for the debug messages, e.g. from GpuScope
+    class GlPassBreadcrumb {
+    public:
+        explicit GlPassBreadcrumb(const char* name) {
+#if defined(RG_GL_DEBUG)
+            previous = ThreadGlBreadcrumbs().pass.exchange(name, std::memory_order_relaxed);
+#endif
+        }
+
+        ~GlPassBreadcrumb() {
+#if defined(RG_GL_DEBUG)
+            ThreadGlBreadcrumbs().pass.store(previous, std::memory_order_relaxed);
+#endif
+        }
+
+        GlPassBreadcrumb(const GlPassBreadcrumb&) = delete;
+        GlPassBreadcrumb& operator=(const GlPassBreadcrumb&) = delete;
+
+    private:
+#if defined(RG_GL_DEBUG)
+        const char* previous = nullptr;
+#endif
+    };
+
+    struct GlDebugOptions {
+        GLenum minSeverity = GL_DEBUG_SEVERITY_LOW;    // quieter messages aren't even generated
+        GLenum breakSeverity = GL_DEBUG_SEVERITY_HIGH; // traps at this severity and above, GL_NONE never
+        bool synchronous = false;                      // exact call stacks in a debugger, at the cost of a sync per call
+        int repeats = 10;                              // times one message is printed before it is muted
+        std::vector<GLuint> ignoredIds = {131169, 131185, 131204, 131218}; // NVIDIA allocation and recompile chatter
+    };
+
+    // The driver's debug output for the current context, with the breadcrumbs of the thread
+    // that issues the GL calls. Enable it once the context is current and glad is loaded; a
+    // thread the context moves to afterwards calls AttachThread. Asks for KHR_debug (or GL 4.3)
+    // and falls back to ARB_debug_output; messages only come from a debug context.
+    class GlDebugOutput {
+    public:
+        static bool Enable(GLADloadproc load, const GlDebugOptions& options = GlDebugOptions()) {
+#if defined(RG_GL_DEBUG)
+            typedef void (APIENTRYP CallbackProc)(GLDEBUGPROC callback, const void* userParam);
+            typedef void (APIENTRYP ControlProc)(GLenum source, GLenum type, GLenum severity, GLsizei count,
+                                                 const GLuint* ids, GLboolean enabled);
+            bool khr = (GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 3)) || hasExtension("GL_KHR_debug");
+            bool arb = !khr && hasExtension("GL_ARB_debug_output");
+            CallbackProc callback = nullptr;
+            ControlProc control = nullptr;
+            if (khr || arb) {
+                callback = (CallbackProc)load(khr ? "glDebugMessageCallback" : "glDebugMessageCallbackARB");
+                control = (ControlProc)load(khr ? "glDebugMessageControl" : "glDebugMessageControlARB");
+            }
+            if (!callback || !control) {
+                std::cerr << "GL debug output unavailable, neither KHR_debug nor ARB_debug_output" << std::endl;
+                return false;
+            }
+            GLint flags = 0;
+            glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
+            if (!(flags & GL_CONTEXT_FLAG_DEBUG_BIT)) {
+                std::cerr << "GL context is not a debug context, the driver may report little" << std::endl;
+            }
+
+            State& s = state();
+            {
+                std::lock_guard<std::mutex> lock(s.mutex);
+                s.options = options;
+                s.counts.clear();
+            }
+            AttachThread();
+            if (khr) {
+                glEnable(GL_DEBUG_OUTPUT);
+            }
+            if (options.synchronous) {
+                glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+            } else {
+                glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+            }
+            // filtered in the driver, so muted severities cost nothing
+            const GLenum severities[4] = {GL_DEBUG_SEVERITY_NOTIFICATION, GL_DEBUG_SEVERITY_LOW,
+                                          GL_DEBUG_SEVERITY_MEDIUM, GL_DEBUG_SEVERITY_HIGH};
+            for (GLenum severity : severities) {
+                if (khr || severity != GL_DEBUG_SEVERITY_NOTIFICATION) {
+                    control(GL_DONT_CARE, GL_DONT_CARE, severity, 0, nullptr,
+                            rank(severity) >= rank(options.minSeverity) ? GL_TRUE : GL_FALSE);
+                }
+            }
+            callback(&GlDebugOutput::message, &s);
+            return true;
+#else
+            return false;
+#endif
+        }
+
+        // messages name the calling thread's breadcrumbs from now on
+        static void AttachThread() {
+#if defined(RG_GL_DEBUG)
+            state().breadcrumbs.store(&ThreadGlBreadcrumbs(), std::memory_order_relaxed);
+#endif
+        }
+
+    private:
+        struct State {
+            std::mutex mutex;
+            GlDebugOptions options;
+            std::map<std::string, int> counts; // by message, drivers reuse ids
+            std::atomic<GlBreadcrumbs*> breadcrumbs{nullptr};
+        };
+
+        static State& state() {
+            static State s;
+            return s;
+        }
+
+        static bool hasExtension(const char* name) {
+            GLint count = 0;
+            glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+            for (GLint i = 0; i < count; i++) {
+                const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+                if (extension && std::strcmp(extension, name) == 0) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        static int rank(GLenum severity) {
+            switch (severity) {
+                case GL_DEBUG_SEVERITY_HIGH: return 3;
+                case GL_DEBUG_SEVERITY_MEDIUM: return 2;
+                case GL_DEBUG_SEVERITY_LOW: return 1;
+                case GL_DEBUG_SEVERITY_NOTIFICATION: return 0;
+            }
+            return 4; // GL_NONE, above everything
+        }
+
+        static const char* sourceName(GLenum source) {
+            switch (source) {
+                case GL_DEBUG_SOURCE_API: return "API";
+                case GL_DEBUG_SOURCE_WINDOW_SYSTEM: return "window system";
+                case GL_DEBUG_SOURCE_SHADER_COMPILER: return "shader compiler";
+                case GL_DEBUG_SOURCE_THIRD_PARTY: return "third party";
+                case GL_DEBUG_SOURCE_APPLICATION: return "application";
+            }
+            return "other";
+        }
+
+        static const char* typeName(GLenum type) {
+            switch (type) {
+                case GL_DEBUG_TYPE_ERROR: return "error";
+                case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "deprecated";
+                case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR: return "undefined behavior";
+                case GL_DEBUG_TYPE_PORTABILITY: return "portability";
+                case GL_DEBUG_TYPE_PERFORMANCE: return "performance";
+                case GL_DEBUG_TYPE_MARKER: return "marker";
+            }
+            return "other";
+        }
+
+        static const char* severityName(GLenum severity) {
+            switch (severity) {
+                case GL_DEBUG_SEVERITY_HIGH: return "high";
+                case GL_DEBUG_SEVERITY_MEDIUM: return "medium";
+                case GL_DEBUG_SEVERITY_LOW: return "low";
+            }
+            return "notification";
+        }
+
+        static void APIENTRY message(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length,
+                                     const GLchar* text, const void* userParam) {
+            State& s = *(State*)userParam;
+            bool trap;
+            {
+                std::lock_guard<std::mutex> lock(s.mutex);
+                const std::vector<GLuint>& ignored = s.options.ignoredIds;
+                if (std::find(ignored.begin(), ignored.end(), id) != ignored.end()) {
+                    return;
+                }
+                std::string key(text, length >= 0 ? (size_t)length : std::strlen(text));
+                int count = ++s.counts[key];
+                trap = rank(severity) >= rank(s.options.breakSeverity);
+                if (count > s.options.repeats && !trap) {
+                    return;
+                }
+                std::cerr << "[OpenGL " << severityName(severity) << "] " << sourceName(source) << " " << typeName(type)
+                          << " " << id << ": ";
+                std::cerr << key;
+                const GlBreadcrumbs* breadcrumbs = s.breadcrumbs.load(std::memory_order_relaxed);
+                const GlCallSite* call = breadcrumbs ? breadcrumbs->call.load(std::memory_order_relaxed) : nullptr;
+                const char* pass = breadcrumbs ? breadcrumbs->pass.load(std::memory_order_relaxed) : nullptr;
+                if (pass) {
+                    std::cerr << "\nPass: " << pass;
+                }
+                if (call) {
+                    std::cerr << "\nAfter: " << call->call << "\nFile: " << call->file << "\nLine: " << call->line;
+                }
+                if (count == s.options.repeats) {
+                    std::cerr << "\n(muting further repeats of this message)";
+                }
+                std::cerr << "\n\n";
+            }
+            BREAK_IF_FALSE(!trap);
+        }
+    };
+
 };
 #endif //PROJECT_BASE_ERROR_H
@@ -0,0 +1,246 @@
+#ifndef PROJECT_BASE_FRAMEPACER_H
+#define PROJECT_BASE_FRAMEPACER_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <thread>
+
+namespace rg {
+
+    enum class PacingMode : int {
+        VSync,      // swap interval 1, up to two frames queued on the GPU
+        Capped,     // no vsync, the main thread sleeps to the target frame time
+        LowLatency, // vsync, input is sampled only once the previous frame finished on the GPU
+        Count
+    };
+
+    inline const char* PacingModeName(PacingMode mode) {
+        switch (mode) {
+            case PacingMode::VSync: return "VSync";
+            case PacingMode::Capped: return "Capped";
+            case PacingMode::LowLatency: return "Low latency";
+            default: return "?";
+        }
+    }
+
+    // Frame pacing shared by the main thread (BeginFrame/FrameQueued) and the render thread
+    // (SwapInterval/FrameSubmitted/Flush). A fence after every swap bounds the number of frames
+    // the driver may queue and tells when the frame really finished, which gives the latency
+    // from input sampling to GPU completion.
+    class FramePacer {
+    public:
+        typedef std::chrono::steady_clock Clock;
+
+        FramePacer() : start(Clock::now()), lastBegin(start), nextTick(start) {}
+
+        void SetMode(PacingMode newMode) {
+            mode = (int)newMode;
+        }
+
+        PacingMode Mode() const {
+            return (PacingMode)mode.load();
+        }
+
+        void SetTargetFps(float fps) {
+            targetFps = std::max(fps, 1.0f);
+        }
+
+        float TargetFps() const {
+            return targetFps.load();
+        }
+
+        // seconds since the pacer was created, the clock every timestamp here uses
+        double Now() const {
+            return std::chrono::duration<double>(Clock::now() - start).count();
+        }
+
+        // main thread, before sampling input: waits as the mode requires and returns the smoothed
+        // frame delta in seconds
+        float BeginFrame() {
+            PacingMode current = Mode();
+            if (current == PacingMode::Capped) {
+                Clock::duration period = std::chrono::duration_cast<Clock::duration>(
+                        std::chrono::duration<double>(1.0 / TargetFps()));
+                nextTick += period;
+                Clock::time_point now = Clock::now();
+                if (nextTick < now - period) {
+                    // fell more than a frame behind, do not try to catch up with a burst
+                    nextTick = now;
+                }
+                sleepUntil(nextTick);
+            } else {
+                if (current == PacingMode::LowLatency) {
+                    // nothing may be outstanding when input is sampled
+                    while (framesCompleted.load() < framesQueued) {
+                        std::this_thread::sleep_for(std::chrono::microseconds(50));
+                    }
+                }
+                nextTick = Clock::now();
+            }
+
+            Clock::time_point now = Clock::now();
+            float raw = std::chrono::duration<float>(now - lastBegin).count();
+            lastBegin = now;
+            raw = std::min(raw, 0.25f);
+
+            // a short moving average hides scheduler noise without lagging behind real changes
+            history[historyIndex] = raw;
+            historyIndex = (historyIndex + 1) % HistorySize;
+            if (historyCount < HistorySize) {
+                ++historyCount;
+            }
+            float sum = 0.0f;
+            for (int i = 0; i < historyCount; ++i) {
+                sum += history[i];
+            }
+            float smoothed = sum / historyCount;
+
+            float frameMs = raw * 1000.0f;
+            float average = averageFrameMs.load();
+            averageFrameMs = average + (frameMs - average) * 0.05f;
+            float jitter = jitterMs.load();
+            jitterMs = jitter + (std::fabs(frameMs - average) - jitter) * 0.05f;
+            return smoothed;
+        }
+
+        // main thread, after a packet was handed to the render thread
+        void FrameQueued() {
+            ++framesQueued;
+        }
+
+        // render thread, before swapping
+        int SwapInterval() const {
+            return Mode() == PacingMode::Capped ? 0 : 1;
+        }
+
+        // render thread, right after the swap; inputTime is Now() when the frame sampled input
+        void FrameSubmitted(double inputTime) {
+            Pending frame;
+            frame.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            frame.inputTime = inputTime;
+            pending.push_back(frame);
+
+            size_t maxInFlight = Mode() == PacingMode::LowLatency ? 1 : 2;
+            while (pending.size() > maxInFlight) {
+                retireOldest(true);
+            }
+            Poll();
+        }
+
+        // render thread, also while it waits for the next packet: retires the frames the GPU
+        // finished without blocking, which is what a LowLatency BeginFrame waits for
+        void Poll() {
+            while (!pending.empty() && retireOldest(false)) {
+            }
+            gpuFramesInFlight = (int)pending.size();
+        }
+
+        // render thread, before it gives up the context
+        void Flush() {
+            while (!pending.empty()) {
+                retireOldest(true);
+            }
+            gpuFramesInFlight = 0;
+        }
+
+        float FrameMs() const {
+            return averageFrameMs.load();
+        }
+
+        float JitterMs() const {
+            return jitterMs.load();
+        }
+
+        // input sampling to GPU completion, as observed by the render thread
+        float LatencyMs() const {
+            return latencyMs.load();
+        }
+
+        int GpuFramesInFlight() const {
+            return gpuFramesInFlight.load();
+        }
+
+    private:
+        struct Pending {
+            GLsync fence;
+            double inputTime;
+        };
+
+        static const int HistorySize = 8;
+
+        Clock::time_point start;
+        std::atomic<int> mode{(int)PacingMode::VSync};
+        std::atomic<float> targetFps{60.0f};
+
+        // main thread only
+        Clock::time_point lastBegin;
+        Clock::time_point nextTick;
+        float history[HistorySize] = {};
+        int historyIndex = 0;
+        int historyCount = 0;
+        uint64_t framesQueued = 0;
+
+        // render thread only
+        std::deque<Pending> pending;
+
+        // shared
+        std::atomic<uint64_t> framesCompleted{0};
+        std::atomic<float> averageFrameMs{0.0f};
+        std::atomic<float> jitterMs{0.0f};
+        std::atomic<float> latencyMs{0.0f};
+        std::atomic<int> gpuFramesInFlight{0};
+
+        // sleeps in coarse steps while far away, then yields until the deadline; plain sleep_for
+        // overshoots by a scheduler quantum which is a large part of a frame
+        static void sleepUntil(Clock::time_point deadline) {
+            const Clock::duration margin = std::chrono::milliseconds(2);
+            Clock::time_point now = Clock::now();
+            while (deadline - now > margin) {
+                std::this_thread::sleep_for(deadline - now - margin);
+                now = Clock::now();
+            }
+            while (Clock::now() < deadline) {
+                std::this_thread::yield();
+            }
+        }
+
+        // false if the oldest fence has not signaled and block is false. A blocking wait only
+        // returns once it signaled; a failed wait drops the frame without a latency sample
+        bool retireOldest(bool block) {
+            Pending& frame = pending.front();
+            GLuint64 timeout = block ? 1000000000ull : 0;
+            GLenum result = glClientWaitSync(frame.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+            while (result == GL_TIMEOUT_EXPIRED && block) {
+                std::cerr << "FramePacer: GPU frame still running after 1 s, waiting" << std::endl;
+                result = glClientWaitSync(frame.fence, 0, timeout);
+            }
+            if (result == GL_TIMEOUT_EXPIRED) {
+                return false;
+            }
+            if (result == GL_WAIT_FAILED) {
+                std::cerr << "FramePacer: glClientWaitSync failed, dropping the frame's fence" << std::endl;
+                glDeleteSync(frame.fence);
+                pending.pop_front();
+                ++framesCompleted;
+                return true;
+            }
+            float latency = (float)((Now() - frame.inputTime) * 1000.0);
+            float average = latencyMs.load();
+            latencyMs = average == 0.0f ? latency : average + (latency - average) * 0.1f;
+            glDeleteSync(frame.fence);
+            pending.pop_front();
+            ++framesCompleted;
+            return true;
+        }
+    };
+
+};
+
+#endif //PROJECT_BASE_FRAMEPACER_H
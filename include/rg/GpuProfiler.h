@@ -0,0 +1,292 @@
+#ifndef PROJECT_BASE_GPUPROFILER_H
+#define PROJECT_BASE_GPUPROFILER_H
+
+#include <glad/glad.h>
+#include <rg/Error.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+    // Per-pass GPU timings from GL_TIMESTAMP queries. Every scope writes a timestamp before and
+    // after its commands; the queries of a frame are read back FrameLatency frames later, when the
+    // GPU is long done with them, so reading never stalls the pipeline. If the results are still
+    // not there the frame is dropped instead of waited for.
+    //
+    // Begin/End/BeginFrame/EndFrame/Release run on the thread that owns the GL context;
+    // Stats() and WriteCsv() may be called from any thread.
+    class GpuProfiler {
+    public:
+        static const int FrameLatency = 4;
+
+        struct PassStats {
+            std::string name;
+            float lastMs = 0.0f;
+            float minMs = 0.0f;
+            float avgMs = 0.0f;
+            float p99Ms = 0.0f;
+        };
+
+        struct FrameTimes {
+            uint64_t frameIndex = 0;
+            std::vector<float> ms; // per pass in PassNames() order, negative if the pass did not run
+        };
+
+        // keeps the timings of the last historyFrames frames
+        explicit GpuProfiler(int historyFrames = 240) : history(historyFrames) {}
+
+        GpuProfiler(const GpuProfiler&) = delete;
+        GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+        void BeginFrame(uint64_t frameIndex) {
+            current = &frames[frameIndex % FrameLatency];
+            collect(*current);
+            current->frameIndex = frameIndex;
+            current->used = 0;
+        }
+
+        void EndFrame() {
+            current = nullptr;
+        }
+
+        // returns a handle for End(); -1 outside of BeginFrame/EndFrame
+        int Begin(const char* name) {
+            if (!current) {
+                return -1;
+            }
+            QueryFrame& frame = *current;
+            if (frame.used == frame.scopes.size()) {
+                Scope scope;
+                glGenQueries(2, scope.queries);
+                frame.scopes.push_back(scope);
+            }
+            Scope& scope = frame.scopes[frame.used];
+            scope.pass = passIndex(name);
+            glQueryCounter(scope.queries[0], GL_TIMESTAMP);
+            return (int)frame.used++;
+        }
+
+        void End(int handle) {
+            if (!current || handle < 0) {
+                return;
+            }
+            glQueryCounter(current->scopes[handle].queries[1], GL_TIMESTAMP);
+        }
+
+        // waits for the GPU and reads back every outstanding frame, for tools that stop measuring
+        void Finish() {
+            glFinish();
+            uint64_t newest = 0;
+            for (const QueryFrame& frame : frames) {
+                newest = std::max(newest, frame.frameIndex);
+            }
+            for (uint64_t index = newest + 1 - std::min<uint64_t>(newest + 1, FrameLatency); index <= newest; ++index) {
+                QueryFrame& frame = frames[index % FrameLatency];
+                collect(frame);
+                frame.used = 0;
+            }
+        }
+
+        // deletes the query objects, the profiler can be reused afterwards
+        void Release() {
+            for (QueryFrame& frame : frames) {
+                for (Scope& scope : frame.scopes) {
+                    glDeleteQueries(2, scope.queries);
+                }
+                frame.scopes.clear();
+                frame.used = 0;
+            }
+        }
+
+        std::vector<std::string> PassNames() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return names;
+        }
+
+        // the recorded frames, oldest first
+        std::vector<FrameTimes> History() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::vector<FrameTimes> result;
+            for (size_t i = 0; i < history.size(); ++i) {
+                const FrameRecord& record = history[(historyNext + i) % history.size()];
+                if (record.valid) {
+                    FrameTimes times;
+                    times.frameIndex = record.frameIndex;
+                    times.ms = record.ms;
+                    times.ms.resize(names.size(), -1.0f);
+                    result.push_back(times);
+                }
+            }
+            return result;
+        }
+
+        // the most recently collected frame; false until one has come back
+        bool LatestFrame(FrameTimes& times) const {
+            std::lock_guard<std::mutex> lock(mutex);
+            const FrameRecord& record = history[(historyNext + history.size() - 1) % history.size()];
+            if (!record.valid) {
+                return false;
+            }
+            times.frameIndex = record.frameIndex;
+            times.ms = record.ms;
+            return true;
+        }
+
+        // rolling statistics over the history, one entry per pass name
+        std::vector<PassStats> Stats() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::vector<PassStats> stats(names.size());
+            std::vector<float> samples;
+            for (size_t pass = 0; pass < names.size(); ++pass) {
+                samples.clear();
+                for (size_t i = 0; i < history.size(); ++i) {
+                    const FrameRecord& record = history[(historyNext + i) % history.size()];
+                    if (record.valid && pass < record.ms.size() && record.ms[pass] >= 0.0f) {
+                        samples.push_back(record.ms[pass]);
+                    }
+                }
+                stats[pass].name = names[pass];
+                if (samples.empty()) {
+                    continue;
+                }
+                stats[pass].lastMs = samples.back();
+                double sum = 0.0;
+                for (float ms : samples) {
+                    sum += ms;
+                }
+                stats[pass].avgMs = (float)(sum / samples.size());
+                std::sort(samples.begin(), samples.end());
+                stats[pass].minMs = samples.front();
+                size_t p99 = (size_t)std::ceil(samples.size() * 0.99) - 1;
+                stats[pass].p99Ms = samples[std::min(p99, samples.size() - 1)];
+            }
+            return stats;
+        }
+
+        // one row per frame in the history, one column per pass, milliseconds; empty cell if the
+        // pass did not run that frame
+        bool WriteCsv(const std::string& path) const {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::ofstream out(path);
+            if (!out) {
+                return false;
+            }
+            out << "frame";
+            for (const std::string& name : names) {
+                out << ',' << name;
+            }
+            out << '\n';
+            for (size_t i = 0; i < history.size(); ++i) {
+                const FrameRecord& record = history[(historyNext + i) % history.size()];
+                if (!record.valid) {
+                    continue;
+                }
+                out << record.frameIndex;
+                for (size_t pass = 0; pass < names.size(); ++pass) {
+                    out << ',';
+                    if (pass < record.ms.size() && record.ms[pass] >= 0.0f) {
+                        out << record.ms[pass];
+                    }
+                }
+                out << '\n';
+            }
+            return true;
+        }
+
+    private:
+        struct Scope {
+            GLuint queries[2] = {0, 0};
+            int pass = 0;
+        };
+
+        struct QueryFrame {
+            uint64_t frameIndex = 0;
+            std::vector<Scope> scopes;
+            size_t used = 0;
+        };
+
+        struct FrameRecord {
+            bool valid = false;
+            uint64_t frameIndex = 0;
+            std::vector<float> ms; // per pass, negative if the pass did not run
+        };
+
+        QueryFrame frames[FrameLatency];
+        QueryFrame* current = nullptr;
+
+        mutable std::mutex mutex;
+        std::vector<std::string> names;
+        std::vector<FrameRecord> history;
+        size_t historyNext = 0;
+
+        int passIndex(const char* name) {
+            for (size_t i = 0; i < names.size(); ++i) {
+                if (names[i] == name) {
+                    return (int)i;
+                }
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            names.push_back(name);
+            return (int)names.size() - 1;
+        }
+
+        // reads back the queries a ring slot holds from FrameLatency frames ago
+        void collect(QueryFrame& frame) {
+            if (frame.used == 0) {
+                return;
+            }
+            GLuint available = 0;
+            glGetQueryObjectuiv(frame.scopes[frame.used - 1].queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) {
+                return;
+            }
+            std::vector<float> ms(names.size(), -1.0f);
+            for (size_t i = 0; i < frame.used; ++i) {
+                GLuint64 begin = 0, end = 0;
+                glGetQueryObjectui64v(frame.scopes[i].queries[0], GL_QUERY_RESULT, &begin);
+                glGetQueryObjectui64v(frame.scopes[i].queries[1], GL_QUERY_RESULT, &end);
+                float& pass = ms[frame.scopes[i].pass];
+                // a pass that runs several times per frame is reported as its total
+                pass = std::max(pass, 0.0f) + (float)((double)(end - begin) / 1.0e6);
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            FrameRecord& record = history[historyNext];
+            record.valid = true;
+            record.frameIndex = frame.frameIndex;
+            record.ms.swap(ms);
+            historyNext = (historyNext + 1) % history.size();
+        }
+    };
+
+    // times the enclosing block on the GPU; a null profiler makes it a no-op
+    class GpuScope {
+    public:
+        // the name also goes into the GL debug breadcrumbs
+        GpuScope(GpuProfiler* profiler, const char* name)
+                : profiler(profiler), handle(profiler ? profiler->Begin(name) : -1), breadcrumb(name) {}
+
+        ~GpuScope() {
+            if (profiler) {
+                profiler->End(handle);
+            }
+        }
+
+        GpuScope(const GpuScope&) = delete;
+        GpuScope& operator=(const GpuScope&) = delete;
+
+    private:
+        GpuProfiler* profiler;
+        int handle;
+        GlPassBreadcrumb breadcrumb;
+    };
+
+};
+
+#endif //PROJECT_BASE_GPUPROFILER_H
@@ -0,0 +1,133 @@
+#ifndef PROJECT_BASE_HEADLESSCONTEXT_H
+#define PROJECT_BASE_HEADLESSCONTEXT_H
+
+#include <glad/glad.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <rg/Error.h>
+
+#include <string>
+
+namespace rg {
+
+    // GL 3.3 core context without a window, for the tools. Prefers Mesa's surfaceless platform so
+    // it runs on llvmpipe in a container with no display and no GPU; otherwise takes the default
+    // EGL display. Draws go to a pbuffer of the requested size, though the renderer only ever
+    // reads back its own framebuffers.
+    class HeadlessContext {
+    public:
+        HeadlessContext() = default;
+        HeadlessContext(const HeadlessContext&) = delete;
+        HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+        ~HeadlessContext() {
+            Destroy();
+        }
+
+        // makes the context current on the calling thread and loads the GL entry points
+        bool Create(int width, int height) {
+            display = EGL_NO_DISPLAY;
+            PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+                    (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+            if (getPlatformDisplay) {
+                display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+            }
+#endif
+            EGLint major = 0, minor = 0;
+            if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+                display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+                if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+                    return fail("no EGL display");
+                }
+            }
+
+            const EGLint configAttributes[] = {
+                    EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+                    EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                    EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+                    EGL_DEPTH_SIZE, 24,
+                    EGL_NONE
+            };
+            EGLConfig config;
+            EGLint configCount = 0;
+            if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0) {
+                return fail("no EGL config with desktop GL and pbuffer support");
+            }
+
+            const EGLint surfaceAttributes[] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+            surface = eglCreatePbufferSurface(display, config, surfaceAttributes);
+            if (surface == EGL_NO_SURFACE) {
+                return fail("eglCreatePbufferSurface failed");
+            }
+
+            if (!eglBindAPI(EGL_OPENGL_API)) {
+                return fail("eglBindAPI(EGL_OPENGL_API) failed");
+            }
+            const EGLint contextAttributes[] = {
+                    EGL_CONTEXT_MAJOR_VERSION, 3,
+                    EGL_CONTEXT_MINOR_VERSION, 3,
+                    EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+#if defined(RG_GL_DEBUG)
+                    EGL_CONTEXT_OPENGL_DEBUG, EGL_TRUE,
+#endif
+                    EGL_NONE
+            };
+            context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+            if (context == EGL_NO_CONTEXT) {
+                return fail("no GL 3.3 core context");
+            }
+            if (!eglMakeCurrent(display, surface, surface, context)) {
+                return fail("eglMakeCurrent failed");
+            }
+            if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress)) {
+                return fail("failed to load GL functions");
+            }
+            GlDebugOutput::Enable((GLADloadproc)eglGetProcAddress);
+            return true;
+        }
+
+        void Destroy() {
+            if (display == EGL_NO_DISPLAY) {
+                return;
+            }
+            eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            if (context != EGL_NO_CONTEXT) {
+                eglDestroyContext(display, context);
+            }
+            if (surface != EGL_NO_SURFACE) {
+                eglDestroySurface(display, surface);
+            }
+            eglTerminate(display);
+            display = EGL_NO_DISPLAY;
+            context = EGL_NO_CONTEXT;
+            surface = EGL_NO_SURFACE;
+        }
+
+        // what went wrong in the last failed Create()
+        const std::string& Error() const {
+            return error;
+        }
+
+        // GL_RENDERER of the current context, e.g. "llvmpipe (LLVM 15.0.7, 256 bits)"
+        static std::string RendererName() {
+            const GLubyte* name = glGetString(GL_RENDERER);
+            return name ? std::string((const char*)name) : std::string("unknown");
+        }
+
+    private:
+        EGLDisplay display = EGL_NO_DISPLAY;
+        EGLSurface surface = EGL_NO_SURFACE;
+        EGLContext context = EGL_NO_CONTEXT;
+        std::string error;
+
+        bool fail(const char* message) {
+            error = message;
+            Destroy();
+            return false;
+        }
+    };
+
+};
+
+#endif //PROJECT_BASE_HEADLESSCONTEXT_H
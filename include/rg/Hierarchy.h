@@ -0,0 +1,84 @@
+#ifndef PROJECT_BASE_HIERARCHY_H
+#define PROJECT_BASE_HIERARCHY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace rg {
+
+    // Transform hierarchy flattened into parent-before-child (pre-order) arrays. Every subtree is
+    // the contiguous range [node, subtreeEnd[node]), so Update() is a single forward pass that
+    // skips clean subtrees and recomputes dirty ones without recursion.
+    class NodeHierarchy {
+    public:
+        std::vector<std::string> names;
+        std::vector<int> parents;
+        std::vector<int> subtreeEnd;
+        std::vector<glm::mat4> local;
+        std::vector<glm::mat4> world;
+
+        // nodes must be added in pre-order, i.e. the parent is always added before its children
+        int AddNode(const std::string& name, int parent, const glm::mat4& transform) {
+            int node = (int)names.size();
+            names.push_back(name);
+            parents.push_back(parent);
+            subtreeEnd.push_back(node + 1);
+            local.push_back(transform);
+            world.push_back(transform);
+            dirty.push_back(1);
+            anyDirty = true;
+            for (int ancestor = parent; ancestor >= 0; ancestor = parents[ancestor]) {
+                subtreeEnd[ancestor] = node + 1;
+            }
+            return node;
+        }
+
+        int Find(const std::string& name) const {
+            for (size_t i = 0; i < names.size(); ++i) {
+                if (names[i] == name) {
+                    return (int)i;
+                }
+            }
+            return -1;
+        }
+
+        void SetLocal(int node, const glm::mat4& transform) {
+            local[node] = transform;
+            dirty[node] = 1;
+            anyDirty = true;
+        }
+
+        size_t Size() const {
+            return names.size();
+        }
+
+        void Update() {
+            if (!anyDirty) {
+                return;
+            }
+            int count = (int)names.size();
+            for (int i = 0; i < count; ) {
+                if (!dirty[i]) {
+                    ++i;
+                    continue;
+                }
+                int end = subtreeEnd[i];
+                for (int j = i; j < end; ++j) {
+                    world[j] = parents[j] < 0 ? local[j] : world[parents[j]] * local[j];
+                    dirty[j] = 0;
+                }
+                i = end;
+            }
+            anyDirty = false;
+        }
+
+    private:
+        std::vector<uint8_t> dirty;
+        bool anyDirty = false;
+    };
+
+};
+
+#endif //PROJECT_BASE_HIERARCHY_H
@@ -0,0 +1,174 @@
+#ifndef PROJECT_BASE_IBL_H
+#define PROJECT_BASE_IBL_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+    // IEEE half floats, the storage format of the baked maps; round to nearest, no denormals
+    inline uint16_t FloatToHalf(float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        uint32_t sign = (bits >> 16) & 0x8000u;
+        int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+        uint32_t mantissa = bits & 0x7fffffu;
+        if (exponent <= 0) {
+            return (uint16_t)sign;
+        }
+        if (exponent >= 31) {
+            return (uint16_t)(sign | 0x7c00u);
+        }
+        uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+        // round to nearest; a carry into the exponent is still the right value
+        return (uint16_t)(half + ((mantissa >> 12) & 1u));
+    }
+
+    inline float HalfToFloat(uint16_t value) {
+        uint32_t sign = (uint32_t)(value & 0x8000u) << 16;
+        uint32_t exponent = (value >> 10) & 0x1fu;
+        uint32_t mantissa = value & 0x3ffu;
+        uint32_t bits;
+        if (exponent == 0) {
+            bits = sign;
+        } else if (exponent == 31) {
+            bits = sign | 0x7f800000u | (mantissa << 13);
+        } else {
+            bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+        }
+        float result;
+        std::memcpy(&result, &bits, sizeof(result));
+        return result;
+    }
+
+    // Image based lighting of one environment as baked by project_base_iblbake: a diffuse
+    // irradiance cubemap and a specular cubemap prefiltered with GGX for a roughness per mip,
+    // from 0 at mip 0 to 1 at the last. Faces are in GL order (+x, -x, +y, -y, +z, -z) with rows
+    // as GL uploads them, texels are RGB half floats. Stored as-is behind a small header, written
+    // to a file and read back from its bytes.
+    struct IblEnvironment {
+        static const int MaxSize = 4096; // per face edge, far beyond what the baker writes
+
+        int irradianceSize = 0;
+        int specularSize = 0;
+        int specularMips = 0;
+        std::vector<uint16_t> irradiance; // 6 faces
+        std::vector<uint16_t> specular;   // mip after mip, 6 faces each
+
+        // offset of a face of a mip in specular, in halves
+        size_t SpecularOffset(int mip, int face) const {
+            size_t offset = 0;
+            for (int level = 0; level < mip; level++) {
+                offset += 6 * faceHalves(MipSize(level));
+            }
+            return offset + face * faceHalves(MipSize(mip));
+        }
+
+        int MipSize(int mip) const {
+            return std::max(1, specularSize >> mip);
+        }
+
+        bool Write(const std::string& path) const {
+            std::ofstream out(path, std::ios::binary);
+            if (!out) {
+                return false;
+            }
+            int32_t header[3] = {irradianceSize, specularSize, specularMips};
+            out.write(magic(), 8);
+            out.write((const char*)header, sizeof(header));
+            out.write((const char*)irradiance.data(), (std::streamsize)(irradiance.size() * sizeof(uint16_t)));
+            out.write((const char*)specular.data(), (std::streamsize)(specular.size() * sizeof(uint16_t)));
+            return (bool)out;
+        }
+
+        // from the bytes of a file, e.g. as FileSystem hands them out
+        bool Read(const unsigned char* bytes, size_t length) {
+            int32_t header[3];
+            if (length < 8 + sizeof(header) || std::memcmp(bytes, magic(), 8) != 0) {
+                return false;
+            }
+            std::memcpy(header, bytes + 8, sizeof(header));
+            irradianceSize = header[0];
+            specularSize = header[1];
+            specularMips = header[2];
+            // capped so the sizes below can't overflow, and checked against the file before
+            // anything is allocated
+            if (irradianceSize <= 0 || specularSize <= 0 || irradianceSize > MaxSize || specularSize > MaxSize ||
+                specularMips <= 0 || specularMips > 16) {
+                return false;
+            }
+            size_t irradianceBytes = 6 * faceHalves(irradianceSize) * sizeof(uint16_t);
+            size_t specularBytes = SpecularOffset(specularMips, 0) * sizeof(uint16_t);
+            if (length - 8 - sizeof(header) < irradianceBytes + specularBytes) {
+                return false;
+            }
+            irradiance.resize(irradianceBytes / sizeof(uint16_t));
+            specular.resize(specularBytes / sizeof(uint16_t));
+            const unsigned char* data = bytes + 8 + sizeof(header);
+            std::memcpy(irradiance.data(), data, irradianceBytes);
+            std::memcpy(specular.data(), data + irradianceBytes, specularBytes);
+            return true;
+        }
+
+    private:
+        // eight bytes with the terminator
+        static const char* magic() {
+            return "RGIBL01";
+        }
+
+        static size_t faceHalves(int size) {
+            return (size_t)size * size * 3;
+        }
+    };
+
+    // Split-sum BRDF lookup: scale and bias of F0 for the specular term, by n.v along x and
+    // roughness along y. Independent of the environment, RG half floats.
+    struct BrdfLut {
+        int size = 0;
+        std::vector<uint16_t> rg;
+
+        bool Write(const std::string& path) const {
+            std::ofstream out(path, std::ios::binary);
+            if (!out) {
+                return false;
+            }
+            int32_t header = size;
+            out.write(magic(), 8);
+            out.write((const char*)&header, sizeof(header));
+            out.write((const char*)rg.data(), (std::streamsize)(rg.size() * sizeof(uint16_t)));
+            return (bool)out;
+        }
+
+        bool Read(const unsigned char* bytes, size_t length) {
+            int32_t header = 0;
+            if (length < 8 + sizeof(header) || std::memcmp(bytes, magic(), 8) != 0) {
+                return false;
+            }
+            std::memcpy(&header, bytes + 8, sizeof(header));
+            if (header <= 0 || header > 4096) {
+                return false;
+            }
+            size_t rgBytes = (size_t)header * header * 2 * sizeof(uint16_t);
+            if (length - 8 - sizeof(header) < rgBytes) {
+                return false;
+            }
+            size = header;
+            rg.resize(rgBytes / sizeof(uint16_t));
+            std::memcpy(rg.data(), bytes + 8 + sizeof(header), rgBytes);
+            return true;
+        }
+
+    private:
+        static const char* magic() {
+            return "RGBRDF1";
+        }
+    };
+
+};
+
+#endif //PROJECT_BASE_IBL_H
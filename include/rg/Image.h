@@ -0,0 +1,147 @@
+#ifndef PROJECT_BASE_IMAGE_H
+#define PROJECT_BASE_IMAGE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+    // 8-bit RGB image, rows top to bottom, for golden-image comparisons in the tools.
+    struct Image {
+        int width = 0;
+        int height = 0;
+        std::vector<uint8_t> rgb;
+
+        Image() = default;
+        Image(int width, int height) : width(width), height(height), rgb((size_t)width * height * 3, 0) {}
+
+        bool Empty() const {
+            return rgb.empty();
+        }
+
+        // binary PPM (P6), readable by nearly every image viewer and trivially diffable
+        bool WritePpm(const std::string& path) const {
+            std::ofstream out(path, std::ios::binary);
+            if (!out) {
+                return false;
+            }
+            out << "P6\n" << width << ' ' << height << "\n255\n";
+            out.write((const char*)rgb.data(), (std::streamsize)rgb.size());
+            return (bool)out;
+        }
+
+        bool ReadPpm(const std::string& path) {
+            std::ifstream in(path, std::ios::binary);
+            std::string magic;
+            int maxValue = 0;
+            if (!in || !(in >> magic) || magic != "P6") {
+                return false;
+            }
+            if (!(readHeaderInt(in, width) && readHeaderInt(in, height) && readHeaderInt(in, maxValue)) || maxValue != 255) {
+                return false;
+            }
+            in.get(); // the single whitespace byte before the pixels
+            rgb.resize((size_t)width * height * 3);
+            in.read((char*)rgb.data(), (std::streamsize)rgb.size());
+            return (bool)in;
+        }
+
+        // absolute per-channel difference, amplified so small errors are visible
+        static Image Difference(const Image& a, const Image& b, int gain = 8) {
+            Image diff(a.width, a.height);
+            if (a.width != b.width || a.height != b.height) {
+                return diff;
+            }
+            for (size_t i = 0; i < a.rgb.size(); ++i) {
+                diff.rgb[i] = (uint8_t)std::min(255, std::abs((int)a.rgb[i] - (int)b.rgb[i]) * gain);
+            }
+            return diff;
+        }
+
+        // peak signal to noise ratio over all channels in dB; infinity for identical images
+        static double Psnr(const Image& a, const Image& b) {
+            if (a.width != b.width || a.height != b.height || a.Empty()) {
+                return 0.0;
+            }
+            double squared = 0.0;
+            for (size_t i = 0; i < a.rgb.size(); ++i) {
+                double d = (double)a.rgb[i] - (double)b.rgb[i];
+                squared += d * d;
+            }
+            if (squared == 0.0) {
+                return std::numeric_limits<double>::infinity();
+            }
+            double mse = squared / (double)a.rgb.size();
+            return 10.0 * std::log10(255.0 * 255.0 / mse);
+        }
+
+        // mean structural similarity of the luma, over 8x8 windows with a stride of 4; 1 is identical
+        static double Ssim(const Image& a, const Image& b) {
+            if (a.width != b.width || a.height != b.height || a.width < Window || a.height < Window) {
+                return 0.0;
+            }
+            std::vector<float> lumaA = a.luma();
+            std::vector<float> lumaB = b.luma();
+            const double c1 = (0.01 * 255.0) * (0.01 * 255.0);
+            const double c2 = (0.03 * 255.0) * (0.03 * 255.0);
+            const double n = Window * Window;
+            double sum = 0.0;
+            int windows = 0;
+            for (int y = 0; y + Window <= a.height; y += Window / 2) {
+                for (int x = 0; x + Window <= a.width; x += Window / 2) {
+                    double sumA = 0.0, sumB = 0.0, sumAA = 0.0, sumBB = 0.0, sumAB = 0.0;
+                    for (int wy = 0; wy < Window; ++wy) {
+                        const size_t row = (size_t)(y + wy) * a.width + x;
+                        for (int wx = 0; wx < Window; ++wx) {
+                            double pa = lumaA[row + wx];
+                            double pb = lumaB[row + wx];
+                            sumA += pa;
+                            sumB += pb;
+                            sumAA += pa * pa;
+                            sumBB += pb * pb;
+                            sumAB += pa * pb;
+                        }
+                    }
+                    double meanA = sumA / n, meanB = sumB / n;
+                    double varA = sumAA / n - meanA * meanA;
+                    double varB = sumBB / n - meanB * meanB;
+                    double covariance = sumAB / n - meanA * meanB;
+                    sum += ((2.0 * meanA * meanB + c1) * (2.0 * covariance + c2)) /
+                           ((meanA * meanA + meanB * meanB + c1) * (varA + varB + c2));
+                    ++windows;
+                }
+            }
+            return sum / windows;
+        }
+
+    private:
+        static const int Window = 8;
+
+        std::vector<float> luma() const {
+            std::vector<float> result((size_t)width * height);
+            for (size_t i = 0; i < result.size(); ++i) {
+                result[i] = 0.299f * rgb[i * 3] + 0.587f * rgb[i * 3 + 1] + 0.114f * rgb[i * 3 + 2];
+            }
+            return result;
+        }
+
+        // header fields may be separated by whitespace and # comments
+        static bool readHeaderInt(std::istream& in, int& value) {
+            in >> std::ws;
+            while (in.peek() == '#') {
+                std::string comment;
+                std::getline(in, comment);
+                in >> std::ws;
+            }
+            return (bool)(in >> value);
+        }
+    };
+
+};
+
+#endif //PROJECT_BASE_IMAGE_H
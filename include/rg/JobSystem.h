@@ -0,0 +1,251 @@
+#ifndef PROJECT_BASE_JOBSYSTEM_H
+#define PROJECT_BASE_JOBSYSTEM_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <rg/Profiler.h>
+
+namespace rg {
+
+    // Work-stealing thread pool. Every worker owns a deque: it pushes and pops its own jobs at the
+    // back and steals from the front of the others when it runs dry. Threads that are not workers
+    // (the main thread) share queue 0 and help out while they wait, so waiting never deadlocks even
+    // when jobs spawn and wait on other jobs.
+    class JobSystem {
+    public:
+        typedef std::function<void()> Job;
+
+        explicit JobSystem(unsigned int workerCount = defaultWorkerCount()) {
+            queues.emplace_back(new Queue);
+            for (unsigned int i = 0; i < workerCount; ++i) {
+                queues.emplace_back(new Queue);
+            }
+            for (unsigned int i = 0; i < workerCount; ++i) {
+                workers.emplace_back([this, i]() { workerLoop(i + 1); });
+            }
+        }
+
+        ~JobSystem() {
+            {
+                std::lock_guard<std::mutex> lock(sleepMutex);
+                quit = true;
+            }
+            wake.notify_all();
+            for (std::thread& worker : workers) {
+                worker.join();
+            }
+        }
+
+        JobSystem(const JobSystem&) = delete;
+        JobSystem& operator=(const JobSystem&) = delete;
+
+        // total number of threads that execute jobs, including the one that waits
+        unsigned int ThreadCount() const {
+            return (unsigned int)workers.size() + 1;
+        }
+
+        void Submit(Job job) {
+            Queue& queue = *queues[threadIndex() < queues.size() ? threadIndex() : 0];
+            {
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                queue.jobs.push_back(std::move(job));
+            }
+            ++pending;
+            {
+                // pairs with the predicate check in workerLoop so a wakeup is never lost
+                std::lock_guard<std::mutex> lock(sleepMutex);
+            }
+            wake.notify_one();
+        }
+
+        // runs one queued job on the calling thread, false if there was nothing to do
+        bool RunPending() {
+            Job job;
+            if (!pop(job)) {
+                return false;
+            }
+            job();
+            return true;
+        }
+
+        // keeps the calling thread busy with other jobs until the counter drops to zero
+        void Wait(const std::atomic<int>& counter) {
+            while (counter.load() > 0) {
+                if (!RunPending()) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+
+        // splits [0, count) into chunks of at most grain items and blocks until all of them ran
+        void ParallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body) {
+            if (count == 0) {
+                return;
+            }
+            grain = std::max<size_t>(1, grain);
+            size_t chunks = (count + grain - 1) / grain;
+            if (chunks == 1) {
+                body(0, count);
+                return;
+            }
+            std::atomic<int> remaining((int)chunks);
+            for (size_t chunk = 1; chunk < chunks; ++chunk) {
+                size_t begin = chunk * grain;
+                size_t end = std::min(count, begin + grain);
+                Submit([&body, &remaining, begin, end]() {
+                    body(begin, end);
+                    --remaining;
+                });
+            }
+            body(0, std::min(count, grain));
+            --remaining;
+            Wait(remaining);
+        }
+
+    private:
+        struct Queue {
+            std::mutex mutex;
+            std::deque<Job> jobs;
+        };
+
+        std::vector<std::unique_ptr<Queue>> queues;
+        std::vector<std::thread> workers;
+        std::atomic<int> pending{0};
+        std::mutex sleepMutex;
+        std::condition_variable wake;
+        bool quit = false;
+
+        static unsigned int defaultWorkerCount() {
+            unsigned int cores = std::thread::hardware_concurrency();
+            return cores > 1 ? cores - 1 : 1;
+        }
+
+        // 0 for threads outside the pool, 1..N for workers
+        static size_t& threadIndex() {
+            static thread_local size_t index = 0;
+            return index;
+        }
+
+        bool pop(Job& job) {
+            size_t self = threadIndex() < queues.size() ? threadIndex() : 0;
+            {
+                Queue& own = *queues[self];
+                std::lock_guard<std::mutex> lock(own.mutex);
+                if (!own.jobs.empty()) {
+                    job = std::move(own.jobs.back());
+                    own.jobs.pop_back();
+                    --pending;
+                    return true;
+                }
+            }
+            for (size_t i = 1; i < queues.size(); ++i) {
+                Queue& victim = *queues[(self + i) % queues.size()];
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if (!victim.jobs.empty()) {
+                    job = std::move(victim.jobs.front());
+                    victim.jobs.pop_front();
+                    --pending;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void workerLoop(size_t index) {
+            threadIndex() = index;
+            Profiler::Instance().SetThreadName("worker " + std::to_string(index));
+            while (true) {
+                if (RunPending()) {
+                    continue;
+                }
+                std::unique_lock<std::mutex> lock(sleepMutex);
+                wake.wait(lock, [this]() { return quit || pending.load() > 0; });
+                if (quit) {
+                    return;
+                }
+            }
+        }
+    };
+
+    // Per-frame DAG of CPU stages. The graph is built once; Run() executes every task as soon as
+    // all of its dependencies finished, spreading independent tasks over the job system, and
+    // returns when the whole graph is done. GL work stays outside the graph, on the context thread.
+    class TaskGraph {
+    public:
+        typedef int Task;
+
+        Task Add(const std::string& name, std::function<void()> body, std::initializer_list<Task> dependencies = {}) {
+            Task task = (Task)nodes.size();
+            nodes.emplace_back(new Node);
+            nodes.back()->name = name;
+            nodes.back()->body = std::move(body);
+            for (Task dependency : dependencies) {
+                nodes[dependency]->successors.push_back(task);
+                nodes.back()->dependencyCount++;
+            }
+            return task;
+        }
+
+        const std::string& Name(Task task) const {
+            return nodes[task]->name;
+        }
+
+        size_t Size() const {
+            return nodes.size();
+        }
+
+        void Run(JobSystem& jobs) {
+            remaining = (int)nodes.size();
+            for (std::unique_ptr<Node>& node : nodes) {
+                node->waitingOn = node->dependencyCount;
+            }
+            for (Task task = 0; task < (Task)nodes.size(); ++task) {
+                if (nodes[task]->dependencyCount == 0) {
+                    schedule(jobs, task);
+                }
+            }
+            jobs.Wait(remaining);
+        }
+
+    private:
+        struct Node {
+            std::string name;
+            std::function<void()> body;
+            std::vector<Task> successors;
+            int dependencyCount = 0;
+            std::atomic<int> waitingOn{0};
+        };
+
+        std::vector<std::unique_ptr<Node>> nodes;
+        std::atomic<int> remaining{0};
+
+        void schedule(JobSystem& jobs, Task task) {
+            jobs.Submit([this, &jobs, task]() {
+                Node& node = *nodes[task];
+                {
+                    RG_PROFILE_SCOPE(node.name.c_str());
+                    node.body();
+                }
+                for (Task successor : node.successors) {
+                    if (--nodes[successor]->waitingOn == 0) {
+                        schedule(jobs, successor);
+                    }
+                }
+                --remaining;
+            });
+        }
+    };
+
+};
+
+#endif //PROJECT_BASE_JOBSYSTEM_H
@@ -0,0 +1,237 @@
+#ifndef PROJECT_BASE_LIGHTCLUSTERS_H
+#define PROJECT_BASE_LIGHTCLUSTERS_H
+
+#include <glm/glm.hpp>
+#include <rg/JobSystem.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <xmmintrin.h>
+#endif
+
+namespace rg {
+
+    struct PointLight {
+        glm::vec3 position = glm::vec3(0.0f);
+        glm::vec3 ambient = glm::vec3(0.05f);
+        glm::vec3 diffuse = glm::vec3(0.7f, 0.7f, 1.1f);
+        glm::vec3 specular = glm::vec3(0.3f);
+        float constant = 1.0f;
+        float linear = 0.07f;
+        float quadratic = 0.17f;
+        bool baked = false; // its diffuse light is in the dam's lightmap, the dam skips it
+    };
+
+    // per-cluster light lists as the shader reads them
+    struct ClusterLists {
+        std::vector<uint32_t> ranges;  // offset and count into indices, two per cluster
+        std::vector<uint16_t> indices; // light indices, cluster after cluster
+        float sliceScale = 0.0f;       // slice = log(view depth) * sliceScale + sliceBias
+        float sliceBias = 0.0f;
+    };
+
+    // Clustered light assignment. The view frustum is cut into TilesX x TilesY screen tiles and
+    // Slices depth slices, spaced exponentially so near clusters stay small; every cluster gets the
+    // list of lights whose sphere of influence touches its view space bounds. A fragment then
+    // shades only the lights of its own cluster instead of all of them. Slices are built in
+    // parallel, each testing four lights per step against the boxes of its tiles.
+    class LightClusters {
+    public:
+        static const int TilesX = 16;
+        static const int TilesY = 9;
+        static const int Slices = 24;
+        static const int ClusterCount = TilesX * TilesY * Slices;
+
+        // distance at which the light falls below 5/256 of its brightest channel, about where an
+        // 8-bit output stops changing
+        static float InfluenceRadius(const PointLight& light) {
+            float brightest = std::max(std::max(glm::max(light.diffuse.x, glm::max(light.diffuse.y, light.diffuse.z)),
+                                                glm::max(light.specular.x, glm::max(light.specular.y, light.specular.z))),
+                                       glm::max(light.ambient.x, glm::max(light.ambient.y, light.ambient.z)));
+            float c = light.constant - brightest * 256.0f / 5.0f;
+            if (c >= 0.0f) {
+                return 0.0f;
+            }
+            if (light.quadratic <= 0.0f) {
+                return light.linear > 0.0f ? -c / light.linear : 1e30f;
+            }
+            return (-light.linear + std::sqrt(light.linear * light.linear - 4.0f * light.quadratic * c)) / (2.0f * light.quadratic);
+        }
+
+        // projection must be a symmetric perspective projection like glm::perspective's
+        void Build(const std::vector<PointLight>& lights, const glm::mat4& view, const glm::mat4& projection, JobSystem& jobs) {
+            nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+            farPlane = projection[3][2] / (projection[2][2] + 1.0f);
+            float logRatio = std::log(farPlane / nearPlane);
+            lists.sliceScale = Slices / logRatio;
+            lists.sliceBias = -Slices * std::log(nearPlane) / logRatio;
+
+            // view space centers and radii
+            lightCount = std::min(lights.size(), (size_t)MaxLights);
+            lightX.resize(lightCount);
+            lightY.resize(lightCount);
+            lightZ.resize(lightCount);
+            lightRadius.resize(lightCount);
+            for (size_t i = 0; i < lightCount; i++) {
+                glm::vec3 center = glm::vec3(view * glm::vec4(lights[i].position, 1.0f));
+                lightX[i] = center.x;
+                lightY[i] = center.y;
+                lightZ[i] = center.z;
+                lightRadius[i] = InfluenceRadius(lights[i]);
+            }
+
+            scratch.resize((size_t)Slices);
+            lists.ranges.resize(2 * (size_t)ClusterCount);
+            float invProjX = 1.0f / projection[0][0];
+            float invProjY = 1.0f / projection[1][1];
+            jobs.ParallelFor(Slices, 1, [this, invProjX, invProjY](size_t begin, size_t end) {
+                for (size_t slice = begin; slice < end; ++slice) {
+                    buildSlice((int)slice, invProjX, invProjY);
+                }
+            });
+
+            // slices filled their clusters' counts; offsets follow the cluster order
+            lists.indices.clear();
+            maxPerCluster = 0;
+            for (int slice = 0; slice < Slices; slice++) {
+                const SliceScratch& s = scratch[slice];
+                uint32_t base = (uint32_t)lists.indices.size();
+                int first = slice * TilesX * TilesY;
+                for (int i = 0; i < TilesX * TilesY; i++) {
+                    lists.ranges[2 * (first + i)] += base;
+                    maxPerCluster = std::max(maxPerCluster, (int)lists.ranges[2 * (first + i) + 1]);
+                }
+                lists.indices.insert(lists.indices.end(), s.indices.begin(), s.indices.end());
+            }
+        }
+
+        const ClusterLists& Lists() const {
+            return lists;
+        }
+
+        int LightCount() const {
+            return (int)lightCount;
+        }
+
+        int MaxPerCluster() const {
+            return maxPerCluster;
+        }
+
+        float AveragePerCluster() const {
+            return (float)lists.indices.size() / (float)ClusterCount;
+        }
+
+    private:
+        static const size_t MaxLights = 65535; // indices are 16 bit
+
+        struct SliceScratch {
+            std::vector<uint16_t> indices;
+            std::vector<uint16_t> candidates;
+            std::vector<float> x, y, z, radius; // candidates, structure of arrays
+        };
+
+        ClusterLists lists;
+        std::vector<float> lightX, lightY, lightZ, lightRadius;
+        size_t lightCount = 0;
+        std::vector<SliceScratch> scratch;
+        float nearPlane = 0.1f;
+        float farPlane = 100.0f;
+        int maxPerCluster = 0;
+
+        float sliceDepth(int slice) const {
+            return nearPlane * std::pow(farPlane / nearPlane, (float)slice / (float)Slices);
+        }
+
+        void buildSlice(int slice, float invProjX, float invProjY) {
+            SliceScratch& s = scratch[slice];
+            s.indices.clear();
+            s.candidates.clear();
+            s.x.clear();
+            s.y.clear();
+            s.z.clear();
+            s.radius.clear();
+
+            // the view looks down -z, depths are positive distances
+            float sliceNear = sliceDepth(slice);
+            float sliceFar = sliceDepth(slice + 1);
+            for (size_t i = 0; i < lightCount; i++) {
+                float depth = -lightZ[i];
+                if (depth + lightRadius[i] >= sliceNear && depth - lightRadius[i] <= sliceFar) {
+                    s.candidates.push_back((uint16_t)i);
+                    s.x.push_back(lightX[i]);
+                    s.y.push_back(lightY[i]);
+                    s.z.push_back(lightZ[i]);
+                    s.radius.push_back(lightRadius[i] * lightRadius[i]);
+                }
+            }
+            // padded to a multiple of four with lights that touch nothing
+            while (s.candidates.size() & 3) {
+                s.candidates.push_back(0);
+                s.x.push_back(0.0f);
+                s.y.push_back(0.0f);
+                s.z.push_back(0.0f);
+                s.radius.push_back(-1.0f);
+            }
+
+            for (int tileY = 0; tileY < TilesY; tileY++) {
+                float ndcY0 = -1.0f + 2.0f * tileY / TilesY;
+                float ndcY1 = -1.0f + 2.0f * (tileY + 1) / TilesY;
+                float minY = std::min(ndcY0 * sliceNear, ndcY0 * sliceFar) * invProjY;
+                float maxY = std::max(ndcY1 * sliceNear, ndcY1 * sliceFar) * invProjY;
+                for (int tileX = 0; tileX < TilesX; tileX++) {
+                    float ndcX0 = -1.0f + 2.0f * tileX / TilesX;
+                    float ndcX1 = -1.0f + 2.0f * (tileX + 1) / TilesX;
+                    float minX = std::min(ndcX0 * sliceNear, ndcX0 * sliceFar) * invProjX;
+                    float maxX = std::max(ndcX1 * sliceNear, ndcX1 * sliceFar) * invProjX;
+                    int cluster = tileX + TilesX * (tileY + TilesY * slice);
+                    uint32_t offset = (uint32_t)s.indices.size();
+                    testBox(s, glm::vec3(minX, minY, -sliceFar), glm::vec3(maxX, maxY, -sliceNear));
+                    lists.ranges[2 * cluster] = offset;
+                    lists.ranges[2 * cluster + 1] = (uint32_t)s.indices.size() - offset;
+                }
+            }
+        }
+
+        // appends every candidate whose sphere overlaps the box; radius holds the squared radius
+        static void testBox(SliceScratch& s, const glm::vec3& boxMin, const glm::vec3& boxMax) {
+            size_t count = s.candidates.size();
+#if defined(__SSE2__)
+            __m128 zero = _mm_setzero_ps();
+            __m128 minX = _mm_set1_ps(boxMin.x), minY = _mm_set1_ps(boxMin.y), minZ = _mm_set1_ps(boxMin.z);
+            __m128 maxX = _mm_set1_ps(boxMax.x), maxY = _mm_set1_ps(boxMax.y), maxZ = _mm_set1_ps(boxMax.z);
+            for (size_t i = 0; i < count; i += 4) {
+                __m128 x = _mm_loadu_ps(&s.x[i]);
+                __m128 y = _mm_loadu_ps(&s.y[i]);
+                __m128 z = _mm_loadu_ps(&s.z[i]);
+                // distance from the center to the box along each axis, zero inside
+                __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minX, x), _mm_sub_ps(x, maxX)), zero);
+                __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minY, y), _mm_sub_ps(y, maxY)), zero);
+                __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minZ, z), _mm_sub_ps(z, maxZ)), zero);
+                __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+                int mask = _mm_movemask_ps(_mm_cmple_ps(distance, _mm_loadu_ps(&s.radius[i])));
+                for (int lane = 0; mask; lane++, mask >>= 1) {
+                    if (mask & 1) {
+                        s.indices.push_back(s.candidates[i + lane]);
+                    }
+                }
+            }
+#else
+            for (size_t i = 0; i < count; i++) {
+                float dx = std::max(std::max(boxMin.x - s.x[i], s.x[i] - boxMax.x), 0.0f);
+                float dy = std::max(std::max(boxMin.y - s.y[i], s.y[i] - boxMax.y), 0.0f);
+                float dz = std::max(std::max(boxMin.z - s.z[i], s.z[i] - boxMax.z), 0.0f);
+                if (dx * dx + dy * dy + dz * dz <= s.radius[i]) {
+                    s.indices.push_back(s.candidates[i]);
+                }
+            }
+#endif
+        }
+    };
+
+};
+
+#endif //PROJECT_BASE_LIGHTCLUSTERS_H
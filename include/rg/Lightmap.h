@@ -0,0 +1,160 @@
+#ifndef PROJECT_BASE_LIGHTMAP_H
+#define PROJECT_BASE_LIGHTMAP_H
+
+#include <glm/glm.hpp>
+
+#include <rg/AssetPack.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+    // GL_RGB9_E5: three 9-bit mantissas sharing a 5-bit exponent, HDR in four bytes. Packed as
+    // the GL spec describes, rounding to nearest
+    inline uint32_t PackRgb9e5(const glm::vec3& color) {
+        const float maxValue = 65408.0f; // (2^9 - 1) / 2^9 * 2^16
+        float r = std::min(std::max(color.r, 0.0f), maxValue);
+        float g = std::min(std::max(color.g, 0.0f), maxValue);
+        float b = std::min(std::max(color.b, 0.0f), maxValue);
+        float largest = std::max(r, std::max(g, b));
+        if (largest <= 0.0f) {
+            return 0;
+        }
+        int exponent = std::max(-16, (int)std::floor(std::log2(largest))) + 1 + 15;
+        float scale = std::ldexp(1.0f, exponent - 15 - 9);
+        if ((int)std::floor(largest / scale + 0.5f) == 512) {
+            exponent++;
+            scale *= 2.0f;
+        }
+        uint32_t rs = (uint32_t)std::floor(r / scale + 0.5f);
+        uint32_t gs = (uint32_t)std::floor(g / scale + 0.5f);
+        uint32_t bs = (uint32_t)std::floor(b / scale + 0.5f);
+        return rs | gs << 9 | bs << 18 | (uint32_t)exponent << 27;
+    }
+
+    inline glm::vec3 UnpackRgb9e5(uint32_t packed) {
+        float scale = std::ldexp(1.0f, (int)(packed >> 27) - 15 - 9);
+        return glm::vec3((float)(packed & 0x1ff), (float)((packed >> 9) & 0x1ff), (float)((packed >> 18) & 0x1ff)) * scale;
+    }
+
+    // Static lighting of the dam as baked by project_base_lightbake: an atlas of diffuse light
+    // per sky (day first, like the IBL), direct and bounced, in the units the Blinn-Phong path
+    // multiplies the albedo with, plus ambient occlusion. Texels are RGB9_E5 and 8-bit AO, rows
+    // bottom first as GL uploads them. The lightmap coordinates of every vertex of every dam
+    // mesh come with it, and the dam's world matrix the bake is valid for. Everything after the
+    // header is LZ4 compressed.
+    struct Lightmap {
+        static const int Layers = 2;
+
+        int width = 0;
+        int height = 0;
+        glm::mat4 transform = glm::mat4(1.0f);
+        std::vector<std::vector<glm::vec2>> coords; // per mesh, per vertex
+        std::vector<uint32_t> light[Layers];
+        std::vector<uint8_t> occlusion;
+
+        bool Write(const std::string& path) const {
+            std::vector<unsigned char> payload;
+            for (const std::vector<glm::vec2>& mesh : coords) {
+                uint32_t count = (uint32_t)mesh.size();
+                append(payload, &count, sizeof(count));
+                append(payload, mesh.data(), mesh.size() * sizeof(glm::vec2));
+            }
+            for (int layer = 0; layer < Layers; layer++) {
+                append(payload, light[layer].data(), light[layer].size() * sizeof(uint32_t));
+            }
+            append(payload, occlusion.data(), occlusion.size());
+            std::vector<unsigned char> compressed = Lz4Compress(payload.data(), payload.size());
+
+            std::ofstream out(path, std::ios::binary);
+            if (!out) {
+                return false;
+            }
+            uint32_t header[5] = {(uint32_t)width, (uint32_t)height, (uint32_t)coords.size(),
+                                  (uint32_t)payload.size(), (uint32_t)compressed.size()};
+            out.write(magic(), 8);
+            out.write((const char*)header, sizeof(header));
+            out.write((const char*)&transform[0][0], sizeof(float) * 16);
+            out.write((const char*)compressed.data(), (std::streamsize)compressed.size());
+            return (bool)out;
+        }
+
+        // from the bytes of a file, e.g. as FileSystem hands them out
+        bool Read(const unsigned char* bytes, size_t length) {
+            uint32_t header[5];
+            size_t headerSize = 8 + sizeof(header) + sizeof(float) * 16;
+            if (length < headerSize || std::memcmp(bytes, magic(), 8) != 0) {
+                return false;
+            }
+            std::memcpy(header, bytes + 8, sizeof(header));
+            std::memcpy(&transform[0][0], bytes + 8 + sizeof(header), sizeof(float) * 16);
+            width = (int)header[0];
+            height = (int)header[1];
+            if (width <= 0 || height <= 0 || width > 16384 || height > 16384 || header[4] > length - headerSize) {
+                return false;
+            }
+            // the payload is the texels (the RGB9_E5 layers and AO) plus a count and the
+            // coordinates per mesh, and LZ4 expands at most 255 times, so a broken header can't
+            // ask for more than the file could hold
+            size_t texelBytes = (size_t)width * height * (Layers * sizeof(uint32_t) + 1);
+            if (header[3] > (size_t)header[4] * 255 || header[3] < texelBytes ||
+                (header[3] - texelBytes) / sizeof(uint32_t) < header[2]) {
+                return false;
+            }
+            std::vector<unsigned char> payload(header[3]);
+            if (!Lz4Decompress(bytes + headerSize, header[4], payload.data(), payload.size())) {
+                return false;
+            }
+            size_t offset = 0;
+            coords.assign(header[2], std::vector<glm::vec2>());
+            for (std::vector<glm::vec2>& mesh : coords) {
+                uint32_t count;
+                if (!take(payload, offset, &count, sizeof(count)) || count > payload.size() / sizeof(glm::vec2)) {
+                    return false;
+                }
+                mesh.resize(count);
+                if (!take(payload, offset, mesh.data(), count * sizeof(glm::vec2))) {
+                    return false;
+                }
+            }
+            size_t texels = (size_t)width * height;
+            for (int layer = 0; layer < Layers; layer++) {
+                light[layer].resize(texels);
+                if (!take(payload, offset, light[layer].data(), texels * sizeof(uint32_t))) {
+                    return false;
+                }
+            }
+            occlusion.resize(texels);
+            return take(payload, offset, occlusion.data(), texels);
+        }
+
+    private:
+        // eight bytes with the terminator
+        static const char* magic() {
+            return "RGLMAP1";
+        }
+
+        static void append(std::vector<unsigned char>& out, const void* data, size_t size) {
+            const unsigned char* bytes = (const unsigned char*)data;
+            out.insert(out.end(), bytes, bytes + size);
+        }
+
+        static bool take(const std::vector<unsigned char>& in, size_t& offset, void* data, size_t size) {
+            if (in.size() - offset < size) {
+                return false;
+            }
+            std::memcpy(data, in.data() + offset, size);
+            offset += size;
+            return true;
+        }
+    };
+
+};
+
+#endif //PROJECT_BASE_LIGHTMAP_H
@@ -0,0 +1,133 @@
+#ifndef PROJECT_BASE_MIPBLOOM_H
+#define PROJECT_BASE_MIPBLOOM_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+#include <rg/PostGraph.h>
+
+#include <functional>
+
+namespace rg {
+
+    enum class BloomMode {
+        Gaussian, // ten full-resolution separable blur passes
+        MipChain, // progressive downsample, tent-filtered upsample
+        Count
+    };
+
+    inline const char* BloomModeName(BloomMode mode) {
+        switch (mode) {
+            case BloomMode::Gaussian: return "gaussian";
+            case BloomMode::MipChain: return "mip chain";
+            default: return "?";
+        }
+    }
+
+    enum class BloomQuality {
+        Low,    // 4 mips, 4-tap box downsample
+        Medium, // 5 mips, 13-tap downsample
+        High,   // 6 mips, 13-tap downsample
+        Count
+    };
+
+    inline const char* BloomQualityName(BloomQuality quality) {
+        switch (quality) {
+            case BloomQuality::Low: return "low";
+            case BloomQuality::Medium: return "medium";
+            case BloomQuality::High: return "high";
+            default: return "?";
+        }
+    }
+
+    // Bloom over a half-resolution mip chain. The scene colors over the bright threshold are
+    // filtered down level by level (13-tap, or a 4-tap box on Low), then every level is tent-filtered back up and added onto the
+    // one above it. The largest level has a quarter of the pixels of the screen and every further
+    // level a quarter of that, so each direction shades about a third of a screen's worth of pixels,
+    // and the blur radius grows with the number of levels instead of the pass count. The levels are
+    // transient targets of the post-process graph.
+    class MipBloom {
+    public:
+        static const int MaxLevels = 6;
+
+        MipBloom()
+                : downsampleShader("resources/shaders/7.blur.vs", "resources/shaders/bloom_downsample.fs"),
+                  upsampleShader("resources/shaders/7.blur.vs", "resources/shaders/bloom_upsample.fs") {
+            downsampleShader.use();
+            downsampleShader.setInt("source", 0);
+            upsampleShader.use();
+            upsampleShader.setInt("source", 0);
+        }
+
+        MipBloom(const MipBloom&) = delete;
+        MipBloom& operator=(const MipBloom&) = delete;
+
+        // declares the passes filtering source (the HDR scene color, thresholded while building the
+        // first level) through the chain, returns the level to composite; drawQuad draws a
+        // full-screen quad
+        PostGraph::Resource AddPasses(PostGraph& graph, PostGraph::Resource source, BloomQuality quality,
+                                      std::function<void()> drawQuad) {
+            int levelCount = LevelCount(quality);
+            PostGraph::Resource levels[MaxLevels];
+            PostGraph::Resource input = source;
+            float scale = 1.0f;
+            for (int i = 0; i < levelCount; i++) {
+                scale *= 0.5f;
+                levels[i] = graph.Create("bloom mip", TargetDesc(GL_RGB16F, scale));
+                bool thirteenTap = quality != BloomQuality::Low;
+                // the first level averages in luma-weighted groups so single very bright pixels don't flicker
+                bool karisAverage = i == 0;
+                bool brightPass = i == 0;
+                graph.AddPass("bloom_mips", {input}, {levels[i]},
+                              [this, input, thirteenTap, karisAverage, brightPass, drawQuad](const PostGraph::PassContext& pass) {
+                    downsampleShader.use();
+                    downsampleShader.setBool("thirteenTap", thirteenTap);
+                    downsampleShader.setBool("karisAverage", karisAverage);
+                    downsampleShader.setBool("brightPass", brightPass);
+                    glActiveTexture(GL_TEXTURE0);
+                    glBindTexture(GL_TEXTURE_2D, pass.Texture(input));
+                    drawQuad();
+                });
+                input = levels[i];
+            }
+
+            for (int i = levelCount - 1; i > 0; i--) {
+                PostGraph::Resource smaller = levels[i];
+                graph.AddPass("bloom_mips", {smaller, levels[i - 1]}, {levels[i - 1]},
+                              [this, smaller, drawQuad](const PostGraph::PassContext& pass) {
+                    upsampleShader.use();
+                    glEnable(GL_BLEND);
+                    glBlendFunc(GL_ONE, GL_ONE);
+                    glBlendEquation(GL_FUNC_ADD);
+                    glActiveTexture(GL_TEXTURE0);
+                    glBindTexture(GL_TEXTURE_2D, pass.Texture(smaller));
+                    drawQuad();
+                    glDisable(GL_BLEND);
+                });
+            }
+            return levels[0];
+        }
+
+        // how strongly the chain is added in the composite; the levels sum up, so deeper chains
+        // are scaled down to keep the overall brightness comparable to the Gaussian path
+        static float Strength(BloomQuality quality) {
+            return 1.0f / (float)LevelCount(quality);
+        }
+
+        static int LevelCount(BloomQuality quality) {
+            switch (quality) {
+                case BloomQuality::Low: return 4;
+                case BloomQuality::Medium: return 5;
+                default: return MaxLevels;
+            }
+        }
+
+    private:
+        Shader downsampleShader;
+        Shader upsampleShader;
+    };
+
+};
+
+#endif //PROJECT_BASE_MIPBLOOM_H
@@ -0,0 +1,315 @@
+#ifndef PROJECT_BASE_OCCLUSION_H
+#define PROJECT_BASE_OCCLUSION_H
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <vector>
+#include <glm/glm.hpp>
+#include <rg/Scene.h>
+#include <rg/JobSystem.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace rg {
+
+    // CPU software occlusion culling. A handful of occluder meshes are rasterized into a small
+    // depth buffer (NDC depth, nearest wins), the buffer is reduced into a max-depth pyramid and
+    // bounding boxes are then tested against the coarsest level that covers them. Everything stays
+    // on the CPU, so there is no GPU readback and no frame of latency.
+    class OcclusionCuller {
+    public:
+        explicit OcclusionCuller(int depthWidth = 256, int depthHeight = 128, int tileSizeX = 32, int tileSizeY = 32)
+                : width((depthWidth + 3) & ~3)
+                , height(depthHeight)
+                , tileWidth((tileSizeX + 3) & ~3)
+                , tileHeight(tileSizeY) {
+            tilesX = (width + tileWidth - 1) / tileWidth;
+            tilesY = (height + tileHeight - 1) / tileHeight;
+            bins.resize(tilesX * tilesY);
+
+            int w = width, h = height;
+            levelSizes.push_back(glm::ivec2(w, h));
+            levels.push_back(std::vector<float>(w * h, 1.0f));
+            while (w > 1 || h > 1) {
+                w = std::max(1, (w + 1) / 2);
+                h = std::max(1, (h + 1) / 2);
+                levelSizes.push_back(glm::ivec2(w, h));
+                levels.push_back(std::vector<float>(w * h, 1.0f));
+            }
+        }
+
+        // registers an occluder mesh in model space, returns its id for SetOccluderTransform
+        int AddOccluder(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices) {
+            Occluder occluder;
+            occluder.positions = positions;
+            occluder.indices = indices;
+            occluder.model = glm::mat4(1.0f);
+            occluders.push_back(occluder);
+            return (int)occluders.size() - 1;
+        }
+
+        void SetOccluderTransform(int occluder, const glm::mat4& model) {
+            occluders[occluder].model = model;
+        }
+
+        // rasterizes all occluders from the given camera and rebuilds the depth pyramid
+        void Render(const glm::mat4& viewProjection, JobSystem& jobs) {
+            this->viewProjection = viewProjection;
+            tested = 0;
+            culled = 0;
+
+            setupTriangles();
+
+            // tiles own disjoint parts of the depth buffer, so jobs never touch the same pixel
+            jobs.ParallelFor(tilesX * tilesY, 1, [this](size_t begin, size_t end) {
+                for (size_t tile = begin; tile < end; ++tile) {
+                    rasterizeTile((int)tile);
+                }
+            });
+
+            buildPyramid();
+        }
+
+        // false only if the box is outside the frustum or entirely behind rasterized occluders
+        bool IsVisible(const AABB& bounds) const {
+            ++tested;
+            glm::vec3 ndcMin(1e30f), ndcMax(-1e30f);
+            for (int i = 0; i < 8; ++i) {
+                glm::vec4 corner((i & 1) ? bounds.max.x : bounds.min.x,
+                                 (i & 2) ? bounds.max.y : bounds.min.y,
+                                 (i & 4) ? bounds.max.z : bounds.min.z, 1.0f);
+                glm::vec4 clip = viewProjection * corner;
+                if (clip.w <= nearW) {
+                    // straddles the camera plane, projected extents are meaningless
+                    return true;
+                }
+                glm::vec3 ndc = glm::vec3(clip) / clip.w;
+                ndcMin = glm::min(ndcMin, ndc);
+                ndcMax = glm::max(ndcMax, ndc);
+            }
+            if (ndcMax.x < -1.0f || ndcMin.x > 1.0f || ndcMax.y < -1.0f || ndcMin.y > 1.0f || ndcMin.z > 1.0f) {
+                ++culled;
+                return false;
+            }
+
+            int x0 = std::max(0, (int)((ndcMin.x * 0.5f + 0.5f) * width));
+            int x1 = std::min(width - 1, (int)((ndcMax.x * 0.5f + 0.5f) * width));
+            int y0 = std::max(0, (int)((ndcMin.y * 0.5f + 0.5f) * height));
+            int y1 = std::min(height - 1, (int)((ndcMax.y * 0.5f + 0.5f) * height));
+
+            // walk up the pyramid until the rectangle covers at most 2x2 texels
+            int level = 0;
+            while (level + 1 < (int)levels.size() && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1)) {
+                ++level;
+            }
+            const std::vector<float>& depth = levels[level];
+            int levelWidth = levelSizes[level].x;
+            float maxDepth = -1.0f;
+            for (int y = y0 >> level; y <= (y1 >> level); ++y) {
+                for (int x = x0 >> level; x <= (x1 >> level); ++x) {
+                    maxDepth = std::max(maxDepth, depth[y * levelWidth + x]);
+                }
+            }
+            if (ndcMin.z > maxDepth) {
+                ++culled;
+                return false;
+            }
+            return true;
+        }
+
+        int TestedCount() const {
+            return tested;
+        }
+
+        int CulledCount() const {
+            return culled;
+        }
+
+        int TriangleCount() const {
+            return (int)triangles.size();
+        }
+
+    private:
+        struct Occluder {
+            std::vector<glm::vec3> positions;
+            std::vector<unsigned int> indices;
+            glm::mat4 model;
+        };
+
+        // screen-space triangle in edge-function form: inside where all three edges are >= 0
+        struct Triangle {
+            float edgeA[3], edgeB[3], edgeC[3];
+            float depthA, depthB, depthC;
+            int minX, minY, maxX, maxY;
+        };
+
+        const float nearW = 1e-3f;
+
+        int width, height;
+        int tileWidth, tileHeight;
+        int tilesX, tilesY;
+        glm::mat4 viewProjection = glm::mat4(1.0f);
+        std::vector<Occluder> occluders;
+        std::vector<Triangle> triangles;
+        std::vector<std::vector<unsigned int>> bins;
+        std::vector<std::vector<float>> levels;
+        std::vector<glm::ivec2> levelSizes;
+        std::vector<glm::vec4> clipPositions;
+        mutable std::atomic<int> tested{0};
+        mutable std::atomic<int> culled{0};
+
+        void setupTriangles() {
+            triangles.clear();
+            for (std::vector<unsigned int>& bin : bins) {
+                bin.clear();
+            }
+
+            for (const Occluder& occluder : occluders) {
+                glm::mat4 mvp = viewProjection * occluder.model;
+                clipPositions.resize(occluder.positions.size());
+                for (size_t i = 0; i < occluder.positions.size(); ++i) {
+                    clipPositions[i] = mvp * glm::vec4(occluder.positions[i], 1.0f);
+                }
+
+                for (size_t i = 0; i + 2 < occluder.indices.size(); i += 3) {
+                    glm::vec4 v[3] = {
+                            clipPositions[occluder.indices[i]],
+                            clipPositions[occluder.indices[i + 1]],
+                            clipPositions[occluder.indices[i + 2]]
+                    };
+                    // dropping a triangle only makes the culler more conservative, so near-plane
+                    // crossings are skipped instead of clipped
+                    if (v[0].w <= nearW || v[1].w <= nearW || v[2].w <= nearW) {
+                        continue;
+                    }
+                    glm::vec3 s[3];
+                    for (int k = 0; k < 3; ++k) {
+                        s[k] = glm::vec3((v[k].x / v[k].w * 0.5f + 0.5f) * width,
+                                         (v[k].y / v[k].w * 0.5f + 0.5f) * height,
+                                         v[k].z / v[k].w);
+                    }
+                    float area = (s[1].x - s[0].x) * (s[2].y - s[0].y) - (s[2].x - s[0].x) * (s[1].y - s[0].y);
+                    if (std::fabs(area) < 1e-6f) {
+                        continue;
+                    }
+                    if (area < 0.0f) {
+                        std::swap(s[1], s[2]);
+                        area = -area;
+                    }
+
+                    Triangle tri;
+                    tri.minX = std::max(0, (int)std::floor(std::min(s[0].x, std::min(s[1].x, s[2].x))));
+                    tri.maxX = std::min(width - 1, (int)std::ceil(std::max(s[0].x, std::max(s[1].x, s[2].x))));
+                    tri.minY = std::max(0, (int)std::floor(std::min(s[0].y, std::min(s[1].y, s[2].y))));
+                    tri.maxY = std::min(height - 1, (int)std::ceil(std::max(s[0].y, std::max(s[1].y, s[2].y))));
+                    if (tri.minX > tri.maxX || tri.minY > tri.maxY) {
+                        continue;
+                    }
+
+                    for (int k = 0; k < 3; ++k) {
+                        const glm::vec3& a = s[(k + 1) % 3];
+                        const glm::vec3& b = s[(k + 2) % 3];
+                        tri.edgeA[k] = -(b.y - a.y);
+                        tri.edgeB[k] = b.x - a.x;
+                        tri.edgeC[k] = (b.y - a.y) * a.x - (b.x - a.x) * a.y;
+                    }
+                    float dzdx = ((s[1].z - s[0].z) * (s[2].y - s[0].y) - (s[2].z - s[0].z) * (s[1].y - s[0].y)) / area;
+                    float dzdy = ((s[2].z - s[0].z) * (s[1].x - s[0].x) - (s[1].z - s[0].z) * (s[2].x - s[0].x)) / area;
+                    tri.depthA = dzdx;
+                    tri.depthB = dzdy;
+                    tri.depthC = s[0].z - dzdx * s[0].x - dzdy * s[0].y;
+
+                    unsigned int index = (unsigned int)triangles.size();
+                    triangles.push_back(tri);
+                    for (int ty = tri.minY / tileHeight; ty <= tri.maxY / tileHeight; ++ty) {
+                        for (int tx = tri.minX / tileWidth; tx <= tri.maxX / tileWidth; ++tx) {
+                            bins[ty * tilesX + tx].push_back(index);
+                        }
+                    }
+                }
+            }
+        }
+
+        void rasterizeTile(int tile) {
+            std::vector<float>& depth = levels[0];
+            int tileX0 = (tile % tilesX) * tileWidth;
+            int tileY0 = (tile / tilesX) * tileHeight;
+            int tileX1 = std::min(width, tileX0 + tileWidth) - 1;
+            int tileY1 = std::min(height, tileY0 + tileHeight) - 1;
+
+            for (int y = tileY0; y <= tileY1; ++y) {
+                std::fill(depth.begin() + y * width + tileX0, depth.begin() + y * width + tileX1 + 1, 1.0f);
+            }
+
+            for (unsigned int index : bins[tile]) {
+                const Triangle& tri = triangles[index];
+                // pixel columns are processed four at a time, so start on a 4-aligned column
+                int x0 = std::max(tileX0, tri.minX) & ~3;
+                int x1 = std::min(tileX1, tri.maxX);
+                int y0 = std::max(tileY0, tri.minY);
+                int y1 = std::min(tileY1, tri.maxY);
+                for (int y = y0; y <= y1; ++y) {
+                    float py = y + 0.5f;
+                    float* row = &depth[y * width];
+#if defined(__SSE2__)
+                    __m128 rowEdge[3], edgeA[3];
+                    for (int k = 0; k < 3; ++k) {
+                        rowEdge[k] = _mm_set1_ps(tri.edgeB[k] * py + tri.edgeC[k]);
+                        edgeA[k] = _mm_set1_ps(tri.edgeA[k]);
+                    }
+                    __m128 rowDepth = _mm_set1_ps(tri.depthB * py + tri.depthC);
+                    __m128 depthA = _mm_set1_ps(tri.depthA);
+                    __m128 zero = _mm_setzero_ps();
+                    for (int x = x0; x <= x1; x += 4) {
+                        __m128 px = _mm_add_ps(_mm_set1_ps((float)x), _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f));
+                        __m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[0], px), rowEdge[0]), zero);
+                        inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[1], px), rowEdge[1]), zero));
+                        inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[2], px), rowEdge[2]), zero));
+                        if (_mm_movemask_ps(inside) == 0) {
+                            continue;
+                        }
+                        __m128 z = _mm_add_ps(_mm_mul_ps(depthA, px), rowDepth);
+                        __m128 stored = _mm_loadu_ps(row + x);
+                        __m128 nearest = _mm_min_ps(stored, z);
+                        _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, stored)));
+                    }
+#else
+                    for (int x = x0; x <= x1; ++x) {
+                        float px = x + 0.5f;
+                        bool inside = true;
+                        for (int k = 0; k < 3; ++k) {
+                            inside = inside && tri.edgeA[k] * px + tri.edgeB[k] * py + tri.edgeC[k] >= 0.0f;
+                        }
+                        if (inside) {
+                            row[x] = std::min(row[x], tri.depthA * px + tri.depthB * py + tri.depthC);
+                        }
+                    }
+#endif
+                }
+            }
+        }
+
+        void buildPyramid() {
+            for (size_t level = 1; level < levels.size(); ++level) {
+                const std::vector<float>& src = levels[level - 1];
+                std::vector<float>& dst = levels[level];
+                glm::ivec2 srcSize = levelSizes[level - 1];
+                glm::ivec2 dstSize = levelSizes[level];
+                for (int y = 0; y < dstSize.y; ++y) {
+                    int sy0 = std::min(2 * y, srcSize.y - 1), sy1 = std::min(2 * y + 1, srcSize.y - 1);
+                    for (int x = 0; x < dstSize.x; ++x) {
+                        int sx0 = std::min(2 * x, srcSize.x - 1), sx1 = std::min(2 * x + 1, srcSize.x - 1);
+                        dst[y * dstSize.x + x] = std::max(std::max(src[sy0 * srcSize.x + sx0], src[sy0 * srcSize.x + sx1]),
+                                                          std::max(src[sy1 * srcSize.x + sx0], src[sy1 * srcSize.x + sx1]));
+                    }
+                }
+            }
+        }
+    };
+
+};
+
+#endif //PROJECT_BASE_OCCLUSION_H
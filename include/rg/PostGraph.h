@@ -0,0 +1,459 @@
+#ifndef PROJECT_BASE_POSTGRAPH_H
+#define PROJECT_BASE_POSTGRAPH_H
+
+#include <glad/glad.h>
+
+#include <rg/Error.h>
+#include <rg/GpuProfiler.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+    // size and format of a render target; the size is a scale of the graph's base size unless
+    // width and height are given
+    struct TargetDesc {
+        GLenum format = GL_RGBA16F;
+        float scale = 1.0f;
+        int width = 0;
+        int height = 0;
+
+        TargetDesc() = default;
+        TargetDesc(GLenum format, float scale = 1.0f) : format(format), scale(scale) {}
+        TargetDesc(GLenum format, int width, int height) : format(format), width(width), height(height) {}
+    };
+
+    // Render passes declared per frame with the targets they read and write. Execute() drops passes
+    // whose results nothing reads, then runs the rest in declaration order. Transient targets come
+    // from a pool when a pass first touches them and go back right after their last use, so targets
+    // whose lifetimes don't overlap share the same texture: a chain of blur passes needs two
+    // textures, not one per pass. Textures of a size or format no target of the frame has are
+    // deleted right away, so resizes and resolution steps don't pile up sets of old targets;
+    // the rest go when the pool hasn't handed them out for a while (e.g. bloom turned off).
+    class PostGraph {
+    public:
+        typedef int Resource; // -1 is none
+
+        static const int EvictAfterFrames = 120;
+
+        struct Stats {
+            int passes = 0;
+            int culledPasses = 0;
+            int resources = 0;       // transient targets declared this frame
+            int textures = 0;        // textures in the pool
+            size_t pooledBytes = 0;  // what the pool holds
+            size_t declaredBytes = 0; // what this frame's transient targets would take without aliasing
+            size_t writtenBytes = 0; // every target written once per pass that ran, a floor on write bandwidth
+            size_t readBytes = 0;    // every target read once per pass that ran
+        };
+
+        // what a pass sees while it runs
+        class PassContext {
+        public:
+            PassContext(const PostGraph& graph, int width, int height) : graph(graph), width(width), height(height) {}
+
+            GLuint Texture(Resource resource) const {
+                return graph.resources[resource].texture;
+            }
+
+            // size of the targets the pass renders to
+            int Width() const { return width; }
+            int Height() const { return height; }
+
+        private:
+            const PostGraph& graph;
+            int width;
+            int height;
+        };
+
+        typedef std::function<void(const PassContext&)> PassFunction;
+
+        PostGraph() = default;
+        PostGraph(const PostGraph&) = delete;
+        PostGraph& operator=(const PostGraph&) = delete;
+
+        // starts declaring a new frame; scaled targets are relative to width x height
+        void Begin(int width, int height) {
+            baseWidth = width;
+            baseHeight = height;
+            passes.clear();
+            resources.clear();
+        }
+
+        Resource Create(const char* name, const TargetDesc& desc) {
+            ResourceNode node;
+            node.name = name;
+            node.format = desc.format;
+            node.width = desc.width > 0 ? desc.width : std::max(1, (int)(baseWidth * desc.scale));
+            node.height = desc.height > 0 ? desc.height : std::max(1, (int)(baseHeight * desc.scale));
+            resources.push_back(node);
+            return (Resource)resources.size() - 1;
+        }
+
+        // the default framebuffer; passes writing it always run
+        Resource ImportBackbuffer(int width, int height) {
+            ResourceNode node;
+            node.name = "backbuffer";
+            node.width = width;
+            node.height = height;
+            node.imported = true;
+            resources.push_back(node);
+            return (Resource)resources.size() - 1;
+        }
+
+        // a texture owned outside the graph, kept across frames; passes writing it always run
+        Resource ImportTexture(const char* name, GLuint texture, GLenum format, int width, int height) {
+            ResourceNode node;
+            node.name = name;
+            node.format = format;
+            node.width = width;
+            node.height = height;
+            node.imported = true;
+            node.texture = texture;
+            resources.push_back(node);
+            return (Resource)resources.size() - 1;
+        }
+
+        // name doubles as the GPU profiler scope, passes sharing a name are timed together; a pass
+        // that blends onto a target lists it in reads as well as writes
+        void AddPass(const char* name, std::vector<Resource> reads, std::vector<Resource> writes, PassFunction execute) {
+            PassNode pass;
+            pass.name = name;
+            pass.reads = std::move(reads);
+            pass.writes = std::move(writes);
+            pass.execute = std::move(execute);
+            passes.push_back(std::move(pass));
+        }
+
+        void Execute(GpuProfiler* profiler = nullptr) {
+            cull();
+            computeLifetimes();
+            frame++;
+
+            stats = Stats();
+            stats.passes = (int)passes.size();
+            for (const ResourceNode& resource : resources) {
+                if (!resource.imported && resource.firstUse >= 0) {
+                    stats.resources++;
+                    stats.declaredBytes += TargetBytes(resource.format, resource.width, resource.height);
+                }
+            }
+
+            for (int p = 0; p < (int)passes.size(); p++) {
+                PassNode& pass = passes[p];
+                if (!pass.needed) {
+                    stats.culledPasses++;
+                    continue;
+                }
+                for (Resource r : pass.writes) {
+                    acquire(resources[r]);
+                    stats.writtenBytes += trafficBytes(resources[r]);
+                }
+                for (Resource r : pass.reads) {
+                    acquire(resources[r]);
+                    stats.readBytes += trafficBytes(resources[r]);
+                }
+                int width = 0, height = 0;
+                bindTargets(pass, width, height);
+                {
+                    GpuScope scope(profiler, pass.name);
+                    pass.execute(PassContext(*this, width, height));
+                }
+                for (Resource r : pass.writes) {
+                    releaseAfter(resources[r], p);
+                }
+                for (Resource r : pass.reads) {
+                    releaseAfter(resources[r], p);
+                }
+            }
+            GLCALL(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+            evict();
+
+            stats.textures = (int)pool.size();
+            for (const Target& target : pool) {
+                stats.pooledBytes += TargetBytes(target.format, target.width, target.height);
+            }
+        }
+
+        const Stats& LastStats() const {
+            return stats;
+        }
+
+        // deletes every pooled texture and framebuffer; the graph can be used again afterwards
+        void Release() {
+            for (const Target& target : pool) {
+                glDeleteTextures(1, &target.texture);
+            }
+            pool.clear();
+            for (const Framebuffer& framebuffer : framebuffers) {
+                glDeleteFramebuffers(1, &framebuffer.fbo);
+            }
+            framebuffers.clear();
+        }
+
+        // estimated video memory of a target; drivers pad 3-channel 16-bit formats to 4 channels
+        static size_t TargetBytes(GLenum format, int width, int height) {
+            size_t pixel = 4;
+            switch (format) {
+                case GL_RGBA16F:
+                case GL_RGB16F:
+                    pixel = 8;
+                    break;
+                case GL_RGBA32F:
+                    pixel = 16;
+                    break;
+                case GL_R16F:
+                    pixel = 2;
+                    break;
+                default:
+                    pixel = 4; // RGBA8, R11F_G11F_B10F, R32F, 24-bit depth
+                    break;
+            }
+            return pixel * (size_t)width * (size_t)height;
+        }
+
+    private:
+        struct ResourceNode {
+            const char* name = "";
+            GLenum format = GL_RGBA16F;
+            int width = 0;
+            int height = 0;
+            bool imported = false;
+            int firstUse = -1;
+            int lastUse = -1;
+            GLuint texture = 0;
+            int poolIndex = -1;
+        };
+
+        struct PassNode {
+            const char* name = "";
+            std::vector<Resource> reads;
+            std::vector<Resource> writes;
+            PassFunction execute;
+            bool needed = false;
+        };
+
+        struct Target {
+            GLuint texture = 0;
+            GLenum format = GL_RGBA16F;
+            int width = 0;
+            int height = 0;
+            bool inUse = false;
+            uint64_t lastFrame = 0;
+        };
+
+        struct Framebuffer {
+            std::vector<GLuint> attachments; // color textures, then depth (0 if none)
+            GLuint fbo = 0;
+        };
+
+        std::vector<PassNode> passes;
+        std::vector<ResourceNode> resources;
+        std::vector<Target> pool;
+        std::vector<Framebuffer> framebuffers;
+        std::vector<GLuint> attachmentKey;
+        int baseWidth = 0;
+        int baseHeight = 0;
+        uint64_t frame = 0;
+        Stats stats;
+
+        static bool isDepth(GLenum format) {
+            return format == GL_DEPTH_COMPONENT16 || format == GL_DEPTH_COMPONENT24 || format == GL_DEPTH_COMPONENT32F;
+        }
+
+        // the backbuffer is counted as 8-bit RGBA
+        static size_t trafficBytes(const ResourceNode& resource) {
+            return resource.imported && resource.texture == 0 ? 4 * (size_t)resource.width * (size_t)resource.height
+                                     : TargetBytes(resource.format, resource.width, resource.height);
+        }
+
+        // walks back from the passes that write the backbuffer, keeping only what they depend on
+        void cull() {
+            std::vector<bool> live(resources.size(), false);
+            for (int p = (int)passes.size() - 1; p >= 0; p--) {
+                PassNode& pass = passes[p];
+                pass.needed = false;
+                for (Resource r : pass.writes) {
+                    if (resources[r].imported || live[r]) {
+                        pass.needed = true;
+                    }
+                }
+                if (pass.needed) {
+                    for (Resource r : pass.reads) {
+                        live[r] = true;
+                    }
+                }
+            }
+        }
+
+        void computeLifetimes() {
+            for (int p = 0; p < (int)passes.size(); p++) {
+                if (!passes[p].needed) {
+                    continue;
+                }
+                auto touch = [this, p](Resource r) {
+                    ResourceNode& resource = resources[r];
+                    if (resource.firstUse < 0) {
+                        resource.firstUse = p;
+                    }
+                    resource.lastUse = p;
+                };
+                for (Resource r : passes[p].writes) {
+                    touch(r);
+                }
+                for (Resource r : passes[p].reads) {
+                    touch(r);
+                }
+            }
+        }
+
+        // hands out a free pooled texture of the same format and size, or creates one
+        void acquire(ResourceNode& resource) {
+            if (resource.imported || resource.poolIndex >= 0) {
+                return;
+            }
+            for (size_t i = 0; i < pool.size(); i++) {
+                Target& target = pool[i];
+                if (!target.inUse && target.format == resource.format &&
+                    target.width == resource.width && target.height == resource.height) {
+                    target.inUse = true;
+                    target.lastFrame = frame;
+                    resource.poolIndex = (int)i;
+                    resource.texture = target.texture;
+                    return;
+                }
+            }
+            Target target;
+            target.format = resource.format;
+            target.width = resource.width;
+            target.height = resource.height;
+            target.inUse = true;
+            target.lastFrame = frame;
+            target.texture = createTexture(resource.format, resource.width, resource.height);
+            pool.push_back(target);
+            resource.poolIndex = (int)pool.size() - 1;
+            resource.texture = target.texture;
+        }
+
+        void releaseAfter(ResourceNode& resource, int pass) {
+            if (resource.poolIndex >= 0 && resource.lastUse == pass) {
+                pool[resource.poolIndex].inUse = false;
+            }
+        }
+
+        static GLuint createTexture(GLenum format, int width, int height) {
+            GLenum pixelFormat = GL_RGBA, type = GL_FLOAT;
+            GLint filter = GL_LINEAR;
+            if (isDepth(format)) {
+                pixelFormat = GL_DEPTH_COMPONENT;
+                filter = GL_NEAREST;
+            } else if (format == GL_RGB16F || format == GL_R11F_G11F_B10F) {
+                pixelFormat = GL_RGB;
+            } else if (format == GL_R16F || format == GL_R32F) {
+                pixelFormat = GL_RED;
+            } else if (format == GL_RGBA8) {
+                type = GL_UNSIGNED_BYTE;
+            }
+            GLuint texture;
+            glGenTextures(1, &texture);
+            glBindTexture(GL_TEXTURE_2D, texture);
+            GLCALL(glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, pixelFormat, type, NULL));
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glBindTexture(GL_TEXTURE_2D, 0);
+            return texture;
+        }
+
+        // binds a framebuffer with the pass's targets attached, cached per combination of textures
+        void bindTargets(const PassNode& pass, int& width, int& height) {
+            attachmentKey.clear();
+            GLuint depth = 0;
+            for (Resource r : pass.writes) {
+                const ResourceNode& resource = resources[r];
+                width = resource.width;
+                height = resource.height;
+                if (resource.imported && resource.texture == 0) {
+                    GLCALL(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+                    glViewport(0, 0, width, height);
+                    return;
+                }
+                if (isDepth(resource.format)) {
+                    depth = resource.texture;
+                } else {
+                    attachmentKey.push_back(resource.texture);
+                }
+            }
+            attachmentKey.push_back(depth);
+
+            for (const Framebuffer& framebuffer : framebuffers) {
+                if (framebuffer.attachments == attachmentKey) {
+                    GLCALL(glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.fbo));
+                    glViewport(0, 0, width, height);
+                    return;
+                }
+            }
+
+            Framebuffer framebuffer;
+            framebuffer.attachments = attachmentKey;
+            glGenFramebuffers(1, &framebuffer.fbo);
+            GLCALL(glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.fbo));
+            std::vector<GLenum> drawBuffers;
+            for (size_t i = 0; i + 1 < attachmentKey.size(); i++) {
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + (GLenum)i, GL_TEXTURE_2D, attachmentKey[i], 0);
+                drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + (GLenum)i);
+            }
+            if (depth) {
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+            }
+            GLCALL(glDrawBuffers((GLsizei)drawBuffers.size(), drawBuffers.data()));
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                std::cout << "Framebuffer not complete for pass " << pass.name << std::endl;
+            framebuffers.push_back(framebuffer);
+            glViewport(0, 0, width, height);
+        }
+
+        bool declaredThisFrame(const Target& target) const {
+            for (const ResourceNode& resource : resources) {
+                if (!resource.imported && resource.firstUse >= 0 && resource.format == target.format &&
+                    resource.width == target.width && resource.height == target.height) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // drops textures of sizes this frame no longer declares, and those nobody asked for in a
+        // while, with the framebuffers that use them
+        void evict() {
+            for (size_t i = 0; i < pool.size();) {
+                bool stale = frame - pool[i].lastFrame >= (uint64_t)EvictAfterFrames || !declaredThisFrame(pool[i]);
+                if (pool[i].inUse || !stale) {
+                    i++;
+                    continue;
+                }
+                GLuint texture = pool[i].texture;
+                for (size_t f = 0; f < framebuffers.size();) {
+                    const std::vector<GLuint>& attachments = framebuffers[f].attachments;
+                    if (std::find(attachments.begin(), attachments.end(), texture) != attachments.end()) {
+                        glDeleteFramebuffers(1, &framebuffers[f].fbo);
+                        framebuffers.erase(framebuffers.begin() + f);
+                    } else {
+                        f++;
+                    }
+                }
+                glDeleteTextures(1, &texture);
+                pool.erase(pool.begin() + i);
+            }
+        }
+    };
+
+};
+
+#endif //PROJECT_BASE_POSTGRAPH_H
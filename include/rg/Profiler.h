@@ -0,0 +1,220 @@
+#ifndef PROJECT_BASE_PROFILER_H
+#define PROJECT_BASE_PROFILER_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define RG_PROFILE_TSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define RG_PROFILE_TSC 1
+#endif
+
+// times the rest of the enclosing block; name must stay valid until the capture is exported,
+// which string literals always do
+#define RG_PROFILE_CONCAT_INNER(a, b) a##b
+#define RG_PROFILE_CONCAT(a, b) RG_PROFILE_CONCAT_INNER(a, b)
+#define RG_PROFILE_SCOPE(name) rg::ProfileZone RG_PROFILE_CONCAT(rgProfileZone, __LINE__)(name)
+#define RG_PROFILE_FUNCTION() RG_PROFILE_SCOPE(__FUNCTION__)
+
+namespace rg {
+
+    // CPU zone profiler. Every thread records completed zones into its own ring buffer, so a zone
+    // costs two timestamp reads and a few stores with no lock and no allocation. Old zones are
+    // overwritten once a ring is full. WriteChromeTrace() dumps what the rings hold as Chrome
+    // trace JSON, loadable in chrome://tracing or ui.perfetto.dev.
+    class Profiler {
+    public:
+        static const size_t RingSize = 1 << 16; // zones kept per thread, a power of two
+
+        struct ZoneTotal {
+            int count = 0;
+            double totalMs = 0.0;
+        };
+
+        static Profiler& Instance() {
+            static Profiler profiler;
+            return profiler;
+        }
+
+        // raw timestamp, converted to nanoseconds only on export
+        static uint64_t Now() {
+#if defined(RG_PROFILE_TSC)
+            return __rdtsc();
+#else
+            return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+        }
+
+        void Record(const char* name, uint64_t begin, uint64_t end) {
+            ThreadBuffer& buffer = localBuffer();
+            uint64_t head = buffer.head.load(std::memory_order_relaxed);
+            Zone& zone = buffer.zones[head & (RingSize - 1)];
+            zone.name = name;
+            zone.begin = begin;
+            zone.end = end;
+            buffer.head.store(head + 1, std::memory_order_release);
+        }
+
+        // shows up as the track name in the trace viewer
+        void SetThreadName(const std::string& name) {
+            ThreadBuffer& buffer = localBuffer();
+            std::lock_guard<std::mutex> lock(mutex);
+            buffer.name = name;
+        }
+
+        // may run while other threads keep recording; zones overwritten during the copy are skipped
+        bool WriteChromeTrace(const std::string& path) {
+            std::ofstream out(path);
+            if (!out) {
+                return false;
+            }
+            double ticksPerNs = calibrate();
+            std::lock_guard<std::mutex> lock(mutex);
+            out << "{\"traceEvents\":[\n";
+            bool firstEvent = true;
+            std::vector<Zone> zones;
+            for (const std::unique_ptr<ThreadBuffer>& buffer : buffers) {
+                out << (firstEvent ? "" : ",\n");
+                firstEvent = false;
+                out << "{\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->id
+                    << ",\"name\":\"thread_name\",\"args\":{\"name\":\"" << escape(buffer->name) << "\"}}";
+
+                uint64_t oldest, newest;
+                copyZones(*buffer, zones, oldest, newest);
+                for (uint64_t i = oldest; i < newest; ++i) {
+                    const Zone& zone = zones[i & (RingSize - 1)];
+                    double ts = toMicroseconds(zone.begin, ticksPerNs);
+                    double dur = (double)(zone.end - zone.begin) / ticksPerNs / 1000.0;
+                    out << ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->id
+                        << ",\"name\":\"" << escape(zone.name) << "\",\"ts\":" << ts << ",\"dur\":" << dur << "}";
+                }
+            }
+            out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+            return (bool)out;
+        }
+
+        // count and summed duration per zone name over everything still in the rings; nested zones
+        // are counted in their own entry and again inside their parent
+        std::map<std::string, ZoneTotal> Totals() {
+            double ticksPerNs = calibrate();
+            std::lock_guard<std::mutex> lock(mutex);
+            std::map<std::string, ZoneTotal> totals;
+            std::vector<Zone> zones;
+            for (const std::unique_ptr<ThreadBuffer>& buffer : buffers) {
+                uint64_t oldest, newest;
+                copyZones(*buffer, zones, oldest, newest);
+                for (uint64_t i = oldest; i < newest; ++i) {
+                    const Zone& zone = zones[i & (RingSize - 1)];
+                    ZoneTotal& total = totals[zone.name];
+                    total.count++;
+                    total.totalMs += (double)(zone.end - zone.begin) / ticksPerNs / 1.0e6;
+                }
+            }
+            return totals;
+        }
+
+    private:
+        struct Zone {
+            const char* name = "";
+            uint64_t begin = 0;
+            uint64_t end = 0;
+        };
+
+        struct ThreadBuffer {
+            int id = 0;
+            std::string name;
+            Zone zones[RingSize];
+            std::atomic<uint64_t> head{0};
+        };
+
+        std::mutex mutex;
+        std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+        uint64_t startTicks;
+        std::chrono::steady_clock::time_point startTime;
+
+        Profiler() : startTicks(Now()), startTime(std::chrono::steady_clock::now()) {}
+
+        // the first zone of a thread registers its ring, every later one is a thread_local read
+        ThreadBuffer& localBuffer() {
+            static thread_local ThreadBuffer* buffer = nullptr;
+            if (!buffer) {
+                std::lock_guard<std::mutex> lock(mutex);
+                buffers.emplace_back(new ThreadBuffer);
+                buffer = buffers.back().get();
+                buffer->id = (int)buffers.size();
+                buffer->name = "thread " + std::to_string(buffer->id);
+            }
+            return *buffer;
+        }
+
+        // copies a ring while its thread may keep writing; [oldest, newest) are the usable zones
+        static void copyZones(const ThreadBuffer& buffer, std::vector<Zone>& zones, uint64_t& oldest, uint64_t& newest) {
+            newest = buffer.head.load(std::memory_order_acquire);
+            oldest = newest > RingSize ? newest - RingSize : 0;
+            zones.assign(buffer.zones, buffer.zones + RingSize);
+            uint64_t headAfter = buffer.head.load(std::memory_order_acquire);
+            // slots the writer reached while we copied, including the one it may be in, are torn
+            if (headAfter + 1 > RingSize && headAfter + 1 - RingSize > oldest) {
+                oldest = std::min(newest, headAfter + 1 - RingSize);
+            }
+        }
+
+        // timestamp ticks per nanosecond, measured against the steady clock since startup
+        double calibrate() const {
+#if defined(RG_PROFILE_TSC)
+            uint64_t ticks = Now() - startTicks;
+            double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - startTime).count();
+            return ns > 0.0 ? (double)ticks / ns : 1.0;
+#else
+            return 1.0;
+#endif
+        }
+
+        double toMicroseconds(uint64_t ticks, double ticksPerNs) const {
+            return ((double)ticks - (double)startTicks) / ticksPerNs / 1000.0;
+        }
+
+        static std::string escape(const std::string& text) {
+            std::string result;
+            for (char c : text) {
+                if (c == '"' || c == '\\') {
+                    result += '\\';
+                }
+                result += c;
+            }
+            return result;
+        }
+    };
+
+    class ProfileZone {
+    public:
+        explicit ProfileZone(const char* name) : name(name), begin(Profiler::Now()) {}
+
+        ~ProfileZone() {
+            Profiler::Instance().Record(name, begin, Profiler::Now());
+        }
+
+        ProfileZone(const ProfileZone&) = delete;
+        ProfileZone& operator=(const ProfileZone&) = delete;
+
+    private:
+        const char* name;
+        uint64_t begin;
+    };
+
+};
+
+#endif //PROJECT_BASE_PROFILER_H
@@ -0,0 +1,855 @@
+#ifndef PROJECT_BASE_RENDERER_H
+#define PROJECT_BASE_RENDERER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <stb_image.h>
+
+#include <learnopengl/filesystem.h>
+#include <learnopengl/shader.h>
+#include <learnopengl/model.h>
+#include <rg/AutoExposure.h>
+#include <rg/Error.h>
+#include <rg/GpuProfiler.h>
+#include <rg/Ibl.h>
+#include <rg/LightClusters.h>
+#include <rg/Lightmap.h>
+#include <rg/MipBloom.h>
+#include <rg/PostGraph.h>
+#include <rg/Primitives.h>
+#include <rg/Profiler.h>
+#include <rg/ShadowMaps.h>
+#include <rg/SkyboxCache.h>
+#include <rg/TextureStreamer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <initializer_list>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+    // Everything needed to draw one frame. The simulation thread fills a packet and hands it over;
+    // from then on it is read-only until the render thread gives it back, so the renderer never
+    // looks at live simulation state.
+    struct FramePacket {
+        uint64_t frameIndex = 0;
+        double inputTime = 0.0; // when input for this frame was sampled, on the frame pacer clock
+        float deltaTime = 1.0f / 60.0f; // time since the previous frame, drives exposure adaptation
+        int viewportWidth = 0;
+        int viewportHeight = 0;
+        float renderScale = 1.0f; // scene resolution relative to the viewport, upscaled in the composite
+        float sharpness = 0.0f;   // unsharp mask strength of the upscale, 0 is plain bilinear
+
+        // camera
+        glm::mat4 projection = glm::mat4(1.0f);
+        glm::mat4 view = glm::mat4(1.0f);
+        glm::vec3 cameraPosition = glm::vec3(0.0f);
+        glm::vec3 cameraFront = glm::vec3(0.0f, 0.0f, -1.0f);
+
+        // lighting and post-processing state
+        glm::vec3 clearColor = glm::vec3(0.0f);
+        bool changeTheSetting = false; // false is night, true is day
+        bool prewarmSky = false;       // load the other skybox ahead of a day/night switch
+        bool pbr = true;               // metallic/roughness shading of the dam, Blinn-Phong when off
+        bool lightmap = true;          // the dam's baked static light, when a lightmap for it is loaded
+        bool spotlightOn = false;
+        glm::vec3 sunDirection = glm::vec3(-0.2f, -1.0f, -0.3f);
+        bool shadows = true;
+        uint64_t staticVersion = 0; // changes whenever static geometry moves, invalidates cached shadow maps
+        bool bloom = true;
+        BloomMode bloomMode = BloomMode::MipChain;
+        BloomQuality bloomQuality = BloomQuality::Medium;
+        bool compactHdr = false; // R11F_G11F_B10F scene color: half the bytes of RGBA16F, no alpha, ~3 digits of precision
+        float exposure = 0.4f; // used as is unless autoExposure is set
+        bool autoExposure = false;
+        ExposureSettings exposureSettings;
+        std::vector<PointLight> pointLights;
+        ClusterLists lightClusters; // which of pointLights each view frustum cluster needs
+
+        // visible draw list, already culled and sorted
+        glm::mat4 dam = glm::mat4(1.0f);
+        std::vector<glm::mat4> damNodes;
+        std::vector<glm::mat4> moonNodes;
+        std::vector<glm::mat4> grass;
+        std::vector<glm::mat4> boxes;
+        std::vector<glm::mat4> moons;
+        std::vector<glm::mat4> boxCasters; // every box, visible or not, for the shadow maps
+        std::vector<TextureDemand> textureDemands; // how finely each model texture is seen, drives mip streaming
+        size_t textureBudgetBytes = 64u << 20;    // streamed mips above the always resident floor
+        float textureBias = 0.0f;                 // added to the wanted mip, positive is blurrier
+    };
+
+    // The sun as the Blinn-Phong shaders get it. Shared by the GL renderer, the software renderer
+    // and the lightmap bake, so a baked sun always matches the live one.
+    struct DirLight {
+        glm::vec3 ambient, diffuse, specular;
+
+        // at night the dam gets a bluer, weaker sun than the boxes
+        static DirLight Dam(bool day) {
+            if (day) {
+                return {glm::vec3(0.1f), glm::vec3(0.5f), glm::vec3(0.1f)};
+            }
+            return {glm::vec3(0.01f, 0.01f, 0.09f), glm::vec3(0.0f, 0.0f, 0.05f), glm::vec3(0.05f)};
+        }
+
+        static DirLight Boxes(bool day) {
+            if (day) {
+                return {glm::vec3(0.1f), glm::vec3(0.5f), glm::vec3(0.1f)};
+            }
+            return {glm::vec3(0.01f, 0.01f, 0.1f), glm::vec3(0.05f), glm::vec3(0.05f)};
+        }
+    };
+
+    // Owns every GL resource of the scene and turns frame packets into GL calls. It knows nothing
+    // about windows or UI, so anything with a current GL context can drive it. The constructor
+    // and Render() must run on the thread that holds the context.
+    class Renderer {
+    public:
+        // model textures keep only their small mips resident until a frame needs more; declared
+        // before the models, which load through it
+        TextureStreamer textureStreamer;
+
+        // texture unit of the specular map for meshes that come without one, like the dam
+        static const int DefaultSpecularUnit = 5;
+        // its value, the dam material's Ks; the software renderer uses the same
+        static const unsigned char DefaultSpecular = 128;
+
+        // meshes and textures of the models stay readable from other threads; node matrices are
+        // updated by the World on the main thread, so draws take them from the packet
+        Model damModel;
+        Model moonModel;
+
+        // the offscreen targets are transient, declared every frame in the post-process graph at
+        // the size the packet asks for
+        Renderer()
+                : damModel("resources/objects/dam_obj/dam1.obj", false, streamedTextures()),
+                  moonModel("resources/objects/sphere/moon.obj", false, streamedTextures()),
+                  damShader("resources/shaders/2.model_lighting.vs", "resources/shaders/2.model_lighting.fs"),
+                  skyboxShader("resources/shaders/skybox_daylight.vs", "resources/shaders/skybox_daylight.fs"),
+                  vegetationShader("resources/shaders/vegetation.vs", "resources/shaders/vegetation.fs"),
+                  boxShader("resources/shaders/boxes.vs", "resources/shaders/boxes.fs"),
+                  moonShader("resources/shaders/sphere.vs", "resources/shaders/sphere.fs"),
+                  blurShader("resources/shaders/7.blur.vs", "resources/shaders/7.blur.fs"),
+                  bloomShader("resources/shaders/bloom.vs", "resources/shaders/bloom.fs") {
+            moonModel.SetShaderTextureNamePrefix("material.");
+            damModel.SetShaderTextureNamePrefix("material.");
+
+            // configure global opengl state
+            glEnable(GL_DEPTH_TEST);
+            // rough prefiltered mips are a few texels wide, filter across cube faces
+            glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+            createTextures();
+            createGeometry();
+            createLightBuffers();
+            createIbl();
+            createLightmap();
+
+            skyboxShader.use();
+            skyboxShader.setInt("skybox", 0);
+
+            damShader.use();
+            // Mesh::Draw sets the samplers of the maps a mesh has; one with a specular map would
+            // point material.texture_specular1 at its own unit instead
+            damShader.setInt("material.texture_specular1", DefaultSpecularUnit);
+            damShader.setInt("lightmap", 6);
+            damShader.setInt("occlusionMap", 7);
+            // above the units the model's own textures take
+            damShader.setInt("lightData", 8);
+            damShader.setInt("clusterRanges", 9);
+            damShader.setInt("clusterLights", 10);
+            // shadow map units are set by ShadowMaps::SetUniforms
+            damShader.setInt("irradianceMap", 13);
+            damShader.setInt("prefilteredMap", 14);
+            damShader.setInt("brdfLut", 15);
+
+            boxShader.use();
+            boxShader.setInt("material.diffuse", 0);
+            boxShader.setInt("material.specular", 1);
+
+            blurShader.use();
+            blurShader.setInt("image", 0);
+            bloomShader.use();
+            bloomShader.setInt("scene", 0);
+            bloomShader.setInt("bloomBlur", 1);
+            bloomShader.setInt("adaptedLuminance", 2);
+        }
+
+        Renderer(const Renderer&) = delete;
+        Renderer& operator=(const Renderer&) = delete;
+
+        // brings the streamed textures to what the frame asks for and decodes its sky, blocking;
+        // Render then finds nothing left to load and draws the right sky in its first frame
+        void FlushTextureStreaming(const FramePacket& frame) {
+            textureStreamer.budgetBytes = frame.textureBudgetBytes;
+            textureStreamer.bias = frame.textureBias;
+            textureStreamer.Flush(frame.textureDemands, RenderHeight(frame));
+            skyboxes.Finish(frame.changeTheSetting ? daySky : nightSky);
+        }
+
+        // the profiler, if given, must be between BeginFrame and EndFrame
+        void Render(const FramePacket& frame, GpuProfiler* profiler = nullptr) {
+            RG_PROFILE_SCOPE("Renderer::Render");
+            textureStreamer.budgetBytes = frame.textureBudgetBytes;
+            textureStreamer.bias = frame.textureBias;
+            textureStreamer.Update(frame.textureDemands, RenderHeight(frame));
+            if (frame.shadows) {
+                renderShadows(frame, profiler);
+            }
+            // before the graph starts, so a wait for a decode isn't charged to the scene pass
+            int sky = frame.changeTheSetting ? daySky : nightSky;
+            skyTexture = skyboxes.Acquire(sky, frame.prewarmSky ? daySky + nightSky - sky : -1, frame.frameIndex);
+            graph.Begin(RenderWidth(frame), RenderHeight(frame));
+
+            // a single color target, the bloom paths apply the bright threshold while reading it
+            PostGraph::Resource hdrColor = graph.Create("hdr color", TargetDesc(frame.compactHdr ? GL_R11F_G11F_B10F : GL_RGBA16F));
+            PostGraph::Resource depth = graph.Create("depth", TargetDesc(GL_DEPTH_COMPONENT24));
+            graph.AddPass("scene", {}, {hdrColor, depth}, [this, &frame](const PostGraph::PassContext&) {
+                drawScene(frame);
+            });
+
+            // both bloom paths are always declared, the graph culls whatever the composite doesn't read
+            PostGraph::Resource gaussian = addGaussianBlur(hdrColor);
+            PostGraph::Resource mips = mipBloom.AddPasses(graph, hdrColor, frame.bloomQuality, [this]() { renderQuad(); });
+            PostGraph::Resource bloom = -1;
+            float bloomStrength = 1.0f;
+            if (frame.bloom) {
+                bool mipChain = frame.bloomMode == BloomMode::MipChain;
+                bloom = mipChain ? mips : gaussian;
+                bloomStrength = mipChain ? MipBloom::Strength(frame.bloomQuality) : 1.0f;
+            }
+
+            PostGraph::Resource luminance = -1;
+            if (frame.autoExposure) {
+                luminance = autoExposure.AddPasses(graph, hdrColor, frame.frameIndex, frame.deltaTime,
+                                                   frame.exposureSettings, [this]() { renderQuad(); });
+            }
+
+            PostGraph::Resource backbuffer = graph.ImportBackbuffer(frame.viewportWidth, frame.viewportHeight);
+            std::vector<PostGraph::Resource> compositeInputs = {hdrColor};
+            if (bloom >= 0) {
+                compositeInputs.push_back(bloom);
+            }
+            if (luminance >= 0) {
+                compositeInputs.push_back(luminance);
+            }
+            graph.AddPass("composite", compositeInputs, {backbuffer},
+                          [this, &frame, hdrColor, bloom, luminance, bloomStrength](const PostGraph::PassContext& pass) {
+                composite(frame, pass.Texture(hdrColor), bloom >= 0 ? pass.Texture(bloom) : 0,
+                          luminance >= 0 ? pass.Texture(luminance) : 0, bloomStrength);
+            });
+
+            graph.Execute(profiler);
+            std::lock_guard<std::mutex> lock(statsMutex);
+            postStats = graph.LastStats();
+        }
+
+        // size of the scene targets for a packet
+        static int RenderWidth(const FramePacket& frame) {
+            return std::max(1, (int)std::lround(frame.viewportWidth * frame.renderScale));
+        }
+
+        static int RenderHeight(const FramePacket& frame) {
+            return std::max(1, (int)std::lround(frame.viewportHeight * frame.renderScale));
+        }
+
+        // static caster renders of the shadow maps, last frame and in total; callable from any thread
+        int ShadowStaticRenders() const {
+            return shadowMaps.LastStaticRenders();
+        }
+
+        int ShadowTotalStaticRenders() const {
+            return shadowMaps.TotalStaticRenders();
+        }
+
+        // the day and night skyboxes, loaded on demand; callable from any thread
+        const SkyboxCache& Skyboxes() const {
+            return skyboxes;
+        }
+
+        // average scene luminance the auto exposure has adapted to, a few frames old; negative
+        // before the first readback. Callable from any thread
+        float AdaptedLuminance() const {
+            return autoExposure.AdaptedLuminance();
+        }
+
+        // targets and memory of the last frame's post-process graph; callable from any thread
+        PostGraph::Stats PostStats() const {
+            std::lock_guard<std::mutex> lock(statsMutex);
+            return postStats;
+        }
+
+    private:
+        Shader damShader;
+        Shader skyboxShader;
+        Shader vegetationShader;
+        Shader boxShader;
+        Shader moonShader;
+        Shader blurShader;
+        Shader bloomShader;
+        MipBloom mipBloom;
+        AutoExposure autoExposure;
+        ShadowMaps shadowMaps;
+        SkyboxCache skyboxes;
+        int daySky = 0, nightSky = 0;
+        unsigned int skyTexture = 0; // the environment of the frame being drawn
+        PostGraph graph;
+        mutable std::mutex statsMutex;
+        PostGraph::Stats postStats;
+
+        unsigned int grassTexture = 0, boxDiffuse = 0, boxSpecular = 0;
+        unsigned int defaultSpecular = 0; // 1x1
+
+        // baked image based lighting per sky, day first; missing files turn the PBR path off
+        unsigned int irradianceMaps[2] = {0, 0}, prefilteredMaps[2] = {0, 0};
+        unsigned int brdfLut = 0;
+        float prefilteredMaxLod = 0.0f;
+        bool iblLoaded = false;
+
+        // baked static light of the dam per sky, day first, and its AO; only while the dam is
+        // where the bake put it
+        unsigned int lightmapTextures[Lightmap::Layers] = {0, 0};
+        unsigned int occlusionTexture = 0;
+        glm::mat4 lightmapTransform = glm::mat4(1.0f);
+        bool lightmapLoaded = false;
+
+        unsigned int grassVAO = 0, grassVBO = 0;
+        unsigned int boxVAO = 0, boxVBO = 0;
+        unsigned int skyboxVAO = 0, skyboxVBO = 0;
+        unsigned int quadVAO = 0, quadVBO = 0;
+
+        // clustered lights as buffer textures: light data (4 texels per light), per-cluster
+        // offset/count pairs and the light index lists
+        unsigned int lightBuffer = 0, lightTexture = 0;
+        unsigned int rangeBuffer = 0, rangeTexture = 0;
+        unsigned int indexBuffer = 0, indexTexture = 0;
+        std::vector<glm::vec4> lightTexels;
+
+        // 0. shadow maps, before the graph binds its targets. The dam is static and cached, the
+        // boxes are drawn on top every frame. The flashlight only shines at night
+        void renderShadows(const FramePacket& frame, GpuProfiler* profiler) {
+            RG_PROFILE_SCOPE("shadows");
+            ShadowMaps::Light light;
+            light.sunDirection = frame.sunDirection;
+            light.spot = frame.spotlightOn && !frame.changeTheSetting;
+            light.spotPosition = frame.cameraPosition;
+            light.spotDirection = frame.cameraFront;
+            light.camera = frame.cameraPosition;
+            light.staticVersion = frame.staticVersion;
+            shadowMaps.Update(light, [this, &frame](Shader& shader) {
+                damModel.Draw(shader, frame.dam, frame.damNodes);
+            }, [this, &frame](Shader& shader) {
+                glBindVertexArray(boxVAO);
+                for (const glm::mat4& model : frame.boxCasters) {
+                    shader.setMat4("model", model);
+                    GLCALL(glDrawArrays(GL_TRIANGLES, 0, BoxVertexCount));
+                }
+                glBindVertexArray(0);
+            }, profiler);
+        }
+
+        // 1. render scene into floating point framebuffers, bound by the graph
+        void drawScene(const FramePacket& frame) {
+            glClearColor(frame.clearColor.r, frame.clearColor.g, frame.clearColor.b, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            //rendering the dam (main model)
+            //setting up the lights first
+            damShader.use();
+            glEnable(GL_CULL_FACE);
+
+            setLights(frame);
+            shadowMaps.SetUniforms(damShader, frame.shadows);
+            setIbl(frame);
+            setLightmap(frame);
+            damShader.setFloat("material.shininess", 128.0f);
+            glActiveTexture(GL_TEXTURE0 + DefaultSpecularUnit);
+            glBindTexture(GL_TEXTURE_2D, defaultSpecular);
+            glActiveTexture(GL_TEXTURE0);
+            damShader.setVec2("clusterTileScale", (float)LightClusters::TilesX / RenderWidth(frame),
+                              (float)LightClusters::TilesY / RenderHeight(frame));
+            damShader.setVec2("clusterSlicing", frame.lightClusters.sliceScale, frame.lightClusters.sliceBias);
+            damShader.setMat4("projection", frame.projection);
+            damShader.setMat4("view", frame.view);
+            damModel.Draw(damShader, frame.dam, frame.damNodes);
+
+            glDisable(GL_CULL_FACE);
+
+            //render the grass texture
+            vegetationShader.use();
+            vegetationShader.setMat4("view", frame.view);
+            vegetationShader.setMat4("projection", frame.projection);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, grassTexture);
+            glBindVertexArray(grassVAO);
+            for (const glm::mat4& model : frame.grass) {
+                vegetationShader.setMat4("model", model);
+                GLCALL(glDrawArrays(GL_TRIANGLES, 0, GrassVertexCount));
+            }
+
+            //box texture and shader
+            boxShader.use();
+            setDirLight(boxShader, frame, DirLight::Boxes(frame.changeTheSetting));
+            setSpotlight(boxShader, frame);
+            shadowMaps.SetUniforms(boxShader, frame.shadows);
+            boxShader.setFloat("material.shininess", 128.0f);
+            boxShader.setMat4("view", frame.view);
+            boxShader.setMat4("projection", frame.projection);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, boxDiffuse);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, boxSpecular);
+            glBindVertexArray(boxVAO);
+            for (const glm::mat4& model : frame.boxes) {
+                boxShader.setMat4("model", model);
+                GLCALL(glDrawArrays(GL_TRIANGLES, 0, BoxVertexCount));
+            }
+
+            //sphere (moon/sun) shader and render
+            moonShader.use();
+            if (!frame.changeTheSetting) {
+                moonShader.setVec3("lightColor", glm::vec3(5.0f, 5.0f, 8.0f));
+            } else {
+                moonShader.setVec3("lightColor", glm::vec3(13.0f, 12.0f, 10.0f));
+            }
+            moonShader.setMat4("view", frame.view);
+            moonShader.setMat4("projection", frame.projection);
+            for (const glm::mat4& model : frame.moons) {
+                moonModel.Draw(moonShader, model, frame.moonNodes);
+            }
+
+            //skybox render
+            glDepthFunc(GL_LEQUAL);
+            glDepthMask(GL_FALSE);
+            skyboxShader.use();
+            skyboxShader.setMat4("view", glm::mat4(glm::mat3(frame.view)));
+            skyboxShader.setMat4("projection", frame.projection);
+            glBindVertexArray(skyboxVAO);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_CUBE_MAP, skyTexture);
+            GLCALL(glDrawArrays(GL_TRIANGLES, 0, 36));
+            glBindVertexArray(0);
+            glDepthMask(GL_TRUE);
+            glDepthFunc(GL_LESS);
+        }
+
+        // 2. blur bright fragments with two-pass Gaussian Blur, returns the blurred target; the first
+        // pass thresholds the scene color as it reads it. Each pass gets a new target, the graph
+        // aliases them down to two textures
+        PostGraph::Resource addGaussianBlur(PostGraph::Resource scene) {
+            const unsigned int amount = 10;
+            PostGraph::Resource input = scene;
+            for (unsigned int i = 0; i < amount; i++) {
+                bool horizontal = i % 2 == 0;
+                bool brightPass = i == 0;
+                PostGraph::Resource output = graph.Create("blur", TargetDesc(GL_RGBA16F));
+                graph.AddPass("blur", {input}, {output}, [this, input, horizontal, brightPass](const PostGraph::PassContext& pass) {
+                    blurShader.use();
+                    blurShader.setInt("horizontal", horizontal);
+                    blurShader.setBool("brightPass", brightPass);
+                    glActiveTexture(GL_TEXTURE0);
+                    glBindTexture(GL_TEXTURE_2D, pass.Texture(input));
+                    renderQuad();
+                });
+                input = output;
+            }
+            return input;
+        }
+
+        // 3. render floating point color buffer to 2D quad and tonemap HDR colors to default framebuffer's (clamped) color range
+        void composite(const FramePacket& frame, unsigned int sceneTexture, unsigned int bloomTexture,
+                       unsigned int luminanceTexture, float bloomStrength) {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            bloomShader.use();
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, sceneTexture);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, bloomTexture);
+            glActiveTexture(GL_TEXTURE2);
+            glBindTexture(GL_TEXTURE_2D, luminanceTexture);
+            bloomShader.setInt("bloom", frame.bloom);
+            bloomShader.setFloat("bloomStrength", bloomStrength);
+            // sharpening only helps when the scene is actually stretched
+            bloomShader.setFloat("sharpness", frame.renderScale < 1.0f ? frame.sharpness : 0.0f);
+            bloomShader.setFloat("exposure", frame.exposure);
+            bloomShader.setBool("autoExposure", luminanceTexture != 0);
+            AutoExposure::SetUniforms(bloomShader, frame.exposureSettings);
+            renderQuad();
+            glActiveTexture(GL_TEXTURE0);
+        }
+
+        static void setDirLight(Shader& shader, const FramePacket& frame, const DirLight& sun) {
+            shader.setVec3("dirLight.direction", frame.sunDirection);
+            shader.setVec3("dirLight.ambient", sun.ambient);
+            shader.setVec3("dirLight.diffuse", sun.diffuse);
+            shader.setVec3("dirLight.specular", sun.specular);
+        }
+
+        void setLights(const FramePacket& frame) {
+            RG_PROFILE_SCOPE("light setup");
+            //directional light
+            setDirLight(damShader, frame, DirLight::Dam(frame.changeTheSetting));
+            //NOTE: both point lights and spotlight are active only if the night skybox is active
+            uploadLights(frame);
+            setSpotlight(damShader, frame);
+        }
+
+        Model::TextureLoader streamedTextures() {
+            return [this](const std::string& path, const std::string& directory) {
+                return textureStreamer.Load(directory + '/' + path);
+            };
+        }
+
+        void setIbl(const FramePacket& frame) {
+            int sky = frame.changeTheSetting ? 0 : 1;
+            damShader.setBool("pbr", frame.pbr && iblLoaded);
+            damShader.setFloat("prefilteredMaxLod", prefilteredMaxLod);
+            damShader.setFloat("iblIntensity", 1.0f);
+            glActiveTexture(GL_TEXTURE13);
+            glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMaps[sky]);
+            glActiveTexture(GL_TEXTURE14);
+            glBindTexture(GL_TEXTURE_CUBE_MAP, prefilteredMaps[sky]);
+            glActiveTexture(GL_TEXTURE15);
+            glBindTexture(GL_TEXTURE_2D, brdfLut);
+            glActiveTexture(GL_TEXTURE0);
+        }
+
+        void setLightmap(const FramePacket& frame) {
+            bool lightmapped = lightmapLoaded && frame.lightmap;
+            for (int column = 0; column < 4 && lightmapped; column++) {
+                glm::vec4 difference = glm::abs(frame.dam[column] - lightmapTransform[column]);
+                lightmapped = std::max(std::max(difference.x, difference.y), std::max(difference.z, difference.w)) < 1e-4f;
+            }
+            damShader.setBool("lightmapped", lightmapped);
+            glActiveTexture(GL_TEXTURE6);
+            glBindTexture(GL_TEXTURE_2D, lightmapTextures[frame.changeTheSetting ? 0 : 1]);
+            glActiveTexture(GL_TEXTURE7);
+            glBindTexture(GL_TEXTURE_2D, occlusionTexture);
+            glActiveTexture(GL_TEXTURE0);
+        }
+
+        // the lightmap coordinates go into the dam's vertices, a file baked for another dam is ignored
+        void createLightmap() {
+            RG_PROFILE_SCOPE("load lightmap");
+            AssetData file;
+            Lightmap lightmap;
+            lightmapLoaded = FileSystem::read(FileSystem::getPath("resources/lightmaps/dam.lmap"), file) &&
+                             lightmap.Read(file.Data(), file.Size()) && lightmap.coords.size() == damModel.meshes.size();
+            for (size_t i = 0; i < damModel.meshes.size() && lightmapLoaded; i++) {
+                lightmapLoaded = lightmap.coords[i].size() == damModel.meshes[i].vertices.size();
+            }
+            if (!lightmapLoaded) {
+                std::cout << "No lightmap for this dam in resources/lightmaps, run project_base_lightbake; "
+                             "the dam is lit per fragment" << std::endl;
+                return;
+            }
+            for (size_t i = 0; i < damModel.meshes.size(); i++) {
+                Mesh& mesh = damModel.meshes[i];
+                for (size_t v = 0; v < mesh.vertices.size(); v++) {
+                    mesh.vertices[v].LightmapCoords = lightmap.coords[i][v];
+                }
+                mesh.UpdateVertices();
+            }
+            lightmapTransform = lightmap.transform;
+
+            auto create = [&lightmap](GLenum internalFormat, GLenum format, GLenum type, const void* texels) {
+                unsigned int texture;
+                glGenTextures(1, &texture);
+                glBindTexture(GL_TEXTURE_2D, texture);
+                GLCALL(glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, lightmap.width, lightmap.height, 0, format, type, texels));
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+                return texture;
+            };
+            for (int layer = 0; layer < Lightmap::Layers; layer++) {
+                lightmapTextures[layer] = create(GL_RGB9_E5, GL_RGB, GL_UNSIGNED_INT_5_9_9_9_REV, lightmap.light[layer].data());
+            }
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            occlusionTexture = create(GL_R8, GL_RED, GL_UNSIGNED_BYTE, lightmap.occlusion.data());
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+
+        // the maps are small (tens of texels for irradiance, 128 for specular), both skies stay resident
+        void createIbl() {
+            RG_PROFILE_SCOPE("load IBL");
+            const char* paths[2] = {"resources/ibl/day.ibl", "resources/ibl/night.ibl"};
+            AssetData file;
+            BrdfLut lut;
+            iblLoaded = FileSystem::read(FileSystem::getPath("resources/ibl/brdf.lut"), file) &&
+                        lut.Read(file.Data(), file.Size());
+            for (int sky = 0; sky < 2 && iblLoaded; sky++) {
+                IblEnvironment ibl;
+                if (!FileSystem::read(FileSystem::getPath(paths[sky]), file) || !ibl.Read(file.Data(), file.Size())) {
+                    iblLoaded = false;
+                    break;
+                }
+                irradianceMaps[sky] = createCubemap(ibl.irradianceSize, 1, [&ibl](int, int face) {
+                    return ibl.irradiance.data() + (size_t)face * ibl.irradianceSize * ibl.irradianceSize * 3;
+                });
+                prefilteredMaps[sky] = createCubemap(ibl.specularSize, ibl.specularMips, [&ibl](int mip, int face) {
+                    return ibl.specular.data() + ibl.SpecularOffset(mip, face);
+                });
+                prefilteredMaxLod = (float)(ibl.specularMips - 1);
+            }
+            if (!iblLoaded) {
+                std::cout << "IBL data missing in resources/ibl, run project_base_iblbake; PBR is off" << std::endl;
+                return;
+            }
+            glGenTextures(1, &brdfLut);
+            glBindTexture(GL_TEXTURE_2D, brdfLut);
+            GLCALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, lut.size, lut.size, 0, GL_RG, GL_HALF_FLOAT, lut.rg.data()));
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+
+        // RGB half float cubemap; faceData(mip, face) points at the texels of one face
+        template <typename FaceData>
+        static unsigned int createCubemap(int size, int mips, FaceData faceData) {
+            unsigned int texture;
+            glGenTextures(1, &texture);
+            glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+            for (int mip = 0; mip < mips; mip++) {
+                int mipSize = std::max(1, size >> mip);
+                for (int face = 0; face < 6; face++) {
+                    GLCALL(glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, mip, GL_RGB16F, mipSize, mipSize, 0, GL_RGB, GL_HALF_FLOAT, faceData(mip, face)));
+                }
+            }
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, mips - 1);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, mips > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+            glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+            return texture;
+        }
+
+        void createLightBuffers() {
+            auto create = [](unsigned int& buffer, unsigned int& texture, GLenum format) {
+                // a generated name is only a buffer object once it has been bound
+                glGenBuffers(1, &buffer);
+                glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+                glGenTextures(1, &texture);
+                glBindTexture(GL_TEXTURE_BUFFER, texture);
+                glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+                glBindBuffer(GL_TEXTURE_BUFFER, 0);
+            };
+            create(lightBuffer, lightTexture, GL_RGBA32F);
+            create(rangeBuffer, rangeTexture, GL_RG32UI);
+            create(indexBuffer, indexTexture, GL_R16UI);
+            glBindTexture(GL_TEXTURE_BUFFER, 0);
+        }
+
+        // one upload per buffer instead of seven uniforms per light; respecifying the whole store
+        // lets the driver orphan it instead of waiting for last frame's draws to finish reading it
+        void uploadLights(const FramePacket& frame) {
+            lightTexels.clear();
+            for (const PointLight& light : frame.pointLights) {
+                lightTexels.push_back(glm::vec4(light.position, light.constant));
+                lightTexels.push_back(glm::vec4(light.ambient, light.linear));
+                lightTexels.push_back(glm::vec4(light.diffuse, light.quadratic));
+                lightTexels.push_back(glm::vec4(light.specular, light.baked ? 1.0f : 0.0f));
+            }
+            // a buffer texture needs storage even when there is nothing in it
+            lightTexels.resize(std::max<size_t>(lightTexels.size(), 4));
+            uploadBuffer(lightBuffer, lightTexels.data(), lightTexels.size() * sizeof(glm::vec4));
+
+            const ClusterLists& clusters = frame.lightClusters;
+            static const uint32_t emptyRanges[2] = {0, 0};
+            static const uint16_t emptyIndices[1] = {0};
+            if (clusters.ranges.empty()) {
+                uploadBuffer(rangeBuffer, emptyRanges, sizeof(emptyRanges));
+            } else {
+                uploadBuffer(rangeBuffer, clusters.ranges.data(), clusters.ranges.size() * sizeof(uint32_t));
+            }
+            if (clusters.indices.empty()) {
+                uploadBuffer(indexBuffer, emptyIndices, sizeof(emptyIndices));
+            } else {
+                uploadBuffer(indexBuffer, clusters.indices.data(), clusters.indices.size() * sizeof(uint16_t));
+            }
+            glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+            glActiveTexture(GL_TEXTURE8);
+            glBindTexture(GL_TEXTURE_BUFFER, lightTexture);
+            glActiveTexture(GL_TEXTURE9);
+            glBindTexture(GL_TEXTURE_BUFFER, rangeTexture);
+            glActiveTexture(GL_TEXTURE10);
+            glBindTexture(GL_TEXTURE_BUFFER, indexTexture);
+            glActiveTexture(GL_TEXTURE0);
+        }
+
+        static void uploadBuffer(unsigned int buffer, const void* data, size_t size) {
+            glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+            glBufferData(GL_TEXTURE_BUFFER, size, data, GL_STREAM_DRAW);
+        }
+
+        void setSpotlight(Shader& shader, const FramePacket& frame) {
+            shader.setVec3("spotlight.position", frame.cameraPosition);
+            shader.setVec3("spotlight.direction", frame.cameraFront);
+            shader.setVec3("spotlight.ambient", 0.0f, 0.0f, 0.0f);
+            shader.setVec3("spotlight.diffuse", 0.5f, 0.5f, 0.8f);
+            shader.setVec3("spotlight.specular", 0.3f, 0.5f, 0.9f);
+            shader.setFloat("spotlight.constant", 1.0f);
+            shader.setFloat("spotlight.linear", 0.014f);
+            shader.setFloat("spotlight.quadratic", 0.0007f);
+            shader.setFloat("spotlight.cutOff", glm::cos(glm::radians(12.5f)));
+            shader.setFloat("spotlight.outerCutOff", glm::cos(glm::radians(17.5f)));
+            shader.setBool("spotlightOn", frame.spotlightOn);
+            shader.setVec3("viewPos", frame.cameraPosition);
+            shader.setBool("changeTheSetting", frame.changeTheSetting);
+        }
+
+        void createTextures() {
+            //the loading must follow the order
+            //right - px
+            //left - nx
+            //top - py
+            //bottom - ny
+            //front - pz
+            //back - nz
+            std::vector<std::string> clouds {
+                    FileSystem::getPath("resources/cubemaps/clouds/graycloud_lf.jpg"),
+                    FileSystem::getPath("resources/cubemaps/clouds/graycloud_rt.jpg"),
+                    FileSystem::getPath("resources/cubemaps/clouds/graycloud_up.jpg"),
+                    FileSystem::getPath("resources/cubemaps/clouds/graycloud_dn.jpg"),
+                    FileSystem::getPath("resources/cubemaps/clouds/graycloud_ft.jpg"),
+                    FileSystem::getPath("resources/cubemaps/clouds/graycloud_bk.jpg")
+            };
+            std::vector<std::string> stars {
+                    FileSystem::getPath("resources/cubemaps/cubemap/px.png"),
+                    FileSystem::getPath("resources/cubemaps/cubemap/nx.png"),
+                    FileSystem::getPath("resources/cubemaps/cubemap/py.png"),
+                    FileSystem::getPath("resources/cubemaps/cubemap/ny.png"),
+                    FileSystem::getPath("resources/cubemaps/cubemap/pz.png"),
+                    FileSystem::getPath("resources/cubemaps/cubemap/nz.png")
+            };
+            // decoded when first shown, not here
+            daySky = skyboxes.Add(clouds);
+            nightSky = skyboxes.Add(stars);
+
+            grassTexture = loadTexture(FileSystem::getPath("resources/textures/v2.png").c_str());
+            boxDiffuse = loadTexture(FileSystem::getPath("resources/textures/8640003215_50cc68f8cf_b.jpg").c_str());
+            boxSpecular = loadTexture(FileSystem::getPath("resources/textures/container3_specular.jpg").c_str());
+
+            const unsigned char specular[3] = {DefaultSpecular, DefaultSpecular, DefaultSpecular};
+            glGenTextures(1, &defaultSpecular);
+            glBindTexture(GL_TEXTURE_2D, defaultSpecular);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            GLCALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, specular));
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+
+        void createGeometry() {
+            static const float skyboxVertices[] = {
+                    // positions
+                    -1.0f,  1.0f, -1.0f,  -1.0f, -1.0f, -1.0f,   1.0f, -1.0f, -1.0f,
+                     1.0f, -1.0f, -1.0f,   1.0f,  1.0f, -1.0f,  -1.0f,  1.0f, -1.0f,
+
+                    -1.0f, -1.0f,  1.0f,  -1.0f, -1.0f, -1.0f,  -1.0f,  1.0f, -1.0f,
+                    -1.0f,  1.0f, -1.0f,  -1.0f,  1.0f,  1.0f,  -1.0f, -1.0f,  1.0f,
+
+                     1.0f, -1.0f, -1.0f,   1.0f, -1.0f,  1.0f,   1.0f,  1.0f,  1.0f,
+                     1.0f,  1.0f,  1.0f,   1.0f,  1.0f, -1.0f,   1.0f, -1.0f, -1.0f,
+
+                    -1.0f, -1.0f,  1.0f,  -1.0f,  1.0f,  1.0f,   1.0f,  1.0f,  1.0f,
+                     1.0f,  1.0f,  1.0f,   1.0f, -1.0f,  1.0f,  -1.0f, -1.0f,  1.0f,
+
+                    -1.0f,  1.0f, -1.0f,   1.0f,  1.0f, -1.0f,   1.0f,  1.0f,  1.0f,
+                     1.0f,  1.0f,  1.0f,  -1.0f,  1.0f,  1.0f,  -1.0f,  1.0f, -1.0f,
+
+                    -1.0f, -1.0f, -1.0f,  -1.0f, -1.0f,  1.0f,   1.0f, -1.0f, -1.0f,
+                     1.0f, -1.0f, -1.0f,  -1.0f, -1.0f,  1.0f,   1.0f, -1.0f,  1.0f
+            };
+            static const float quadVertices[] = {
+                    // positions        // texture Coords
+                    -1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
+                    -1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
+                     1.0f,  1.0f, 0.0f, 1.0f, 1.0f,
+                     1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
+            };
+
+            createVertexArray(grassVAO, grassVBO, GrassVertices, sizeof(GrassVertices), {3, 2});
+            createVertexArray(boxVAO, boxVBO, BoxVertices, sizeof(BoxVertices), {3, 3, 2});
+            createVertexArray(skyboxVAO, skyboxVBO, skyboxVertices, sizeof(skyboxVertices), {3});
+            createVertexArray(quadVAO, quadVBO, quadVertices, sizeof(quadVertices), {3, 2});
+            glBindVertexArray(0);
+        }
+
+        // interleaved float attributes, one entry per attribute location
+        static void createVertexArray(unsigned int& vao, unsigned int& vbo, const float* data, size_t size,
+                                      std::initializer_list<int> components) {
+            int stride = 0;
+            for (int count : components) {
+                stride += count;
+            }
+            glGenVertexArrays(1, &vao);
+            glGenBuffers(1, &vbo);
+            glBindVertexArray(vao);
+            glBindBuffer(GL_ARRAY_BUFFER, vbo);
+            glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
+            unsigned int location = 0;
+            size_t offset = 0;
+            for (int count : components) {
+                glEnableVertexAttribArray(location);
+                glVertexAttribPointer(location, count, GL_FLOAT, GL_FALSE, stride * sizeof(float), (void*)(offset * sizeof(float)));
+                offset += count;
+                location++;
+            }
+        }
+
+        void renderQuad() {
+            glBindVertexArray(quadVAO);
+            GLCALL(glDrawArrays(GL_TRIANGLE_STRIP, 0, 4));
+            glBindVertexArray(0);
+        }
+
+        static unsigned int loadTexture(char const* path) {
+            unsigned int textureID;
+            glGenTextures(1, &textureID);
+            glBindTexture(GL_TEXTURE_2D, textureID);
+
+            int width, height, nrChannels;
+            unsigned char *data = loadImageFile(path, &width, &height, &nrChannels);
+            GLenum format = GL_RED, internalFormat = GL_RED;
+            if (nrChannels == 3) {
+                format = GL_RGB;
+                internalFormat = GL_SRGB;
+            } else if (nrChannels == 4) {
+                format = GL_RGBA;
+                internalFormat = GL_SRGB_ALPHA;
+            }
+
+            if (data) {
+                GLCALL(glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, data));
+                glGenerateMipmap(GL_TEXTURE_2D);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            } else {
+                std::cout << "Texture failed to load at path: " << path << std::endl;
+            }
+            stbi_image_free(data);
+
+            return textureID;
+        }
+    };
+
+};
+
+#endif //PROJECT_BASE_RENDERER_H
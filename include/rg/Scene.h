@@ -0,0 +1,238 @@
+#ifndef PROJECT_BASE_SCENE_H
+#define PROJECT_BASE_SCENE_H
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#if defined(__SSE2__)
+#include <xmmintrin.h>
+#endif
+
+namespace rg {
+
+    struct AABB {
+        glm::vec3 min = glm::vec3(0.0f);
+        glm::vec3 max = glm::vec3(0.0f);
+    };
+
+    // transforms a box by center/extent so the result stays tight under rotation
+    inline AABB TransformBounds(const AABB& bounds, const glm::mat4& m) {
+        glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+        glm::vec3 extent = (bounds.max - bounds.min) * 0.5f;
+        glm::vec3 worldCenter = glm::vec3(m * glm::vec4(center, 1.0f));
+        glm::vec3 worldExtent;
+        for (int row = 0; row < 3; ++row) {
+            worldExtent[row] = std::fabs(m[0][row]) * extent.x
+                             + std::fabs(m[1][row]) * extent.y
+                             + std::fabs(m[2][row]) * extent.z;
+        }
+        AABB result;
+        result.min = worldCenter - worldExtent;
+        result.max = worldCenter + worldExtent;
+        return result;
+    }
+
+    // what the render loop should draw for an entity; PointLight entities only carry a transform
+    enum class RenderKind : uint8_t {
+        None,
+        Dam,
+        Grass,
+        Box,
+        Moon,
+        PointLight,
+        Count
+    };
+
+    typedef uint32_t Entity;
+
+    // Entity store with every component held in its own contiguous array (structure of arrays).
+    // Setters only flag the entity as dirty; Update() recomputes world matrices and bounds for
+    // the dirty entities and nothing else, so a static scene costs nothing per frame.
+    class SceneStore {
+    public:
+        // transform components
+        std::vector<float> posX, posY, posZ;
+        std::vector<float> rotX, rotY, rotZ, rotW; // unit quaternion
+        std::vector<float> scaleX, scaleY, scaleZ;
+        // bounds components
+        std::vector<AABB> localBounds;
+        std::vector<AABB> worldBounds;
+        // renderable components
+        std::vector<RenderKind> kinds;
+        std::vector<glm::mat4> worldMatrices;
+
+        Entity Create(RenderKind kind, const AABB& bounds = AABB()) {
+            Entity e = (Entity)kinds.size();
+            posX.push_back(0.0f); posY.push_back(0.0f); posZ.push_back(0.0f);
+            rotX.push_back(0.0f); rotY.push_back(0.0f); rotZ.push_back(0.0f); rotW.push_back(1.0f);
+            scaleX.push_back(1.0f); scaleY.push_back(1.0f); scaleZ.push_back(1.0f);
+            localBounds.push_back(bounds);
+            worldBounds.push_back(bounds);
+            kinds.push_back(kind);
+            worldMatrices.push_back(glm::mat4(1.0f));
+            dirty.push_back(0);
+            byKind[(int)kind].push_back(e);
+            markDirty(e);
+            return e;
+        }
+
+        void SetPosition(Entity e, const glm::vec3& p) {
+            if (posX[e] == p.x && posY[e] == p.y && posZ[e] == p.z) {
+                return;
+            }
+            posX[e] = p.x; posY[e] = p.y; posZ[e] = p.z;
+            markDirty(e);
+        }
+
+        // angle in radians around an arbitrary axis, same convention as glm::rotate
+        void SetRotation(Entity e, float angle, const glm::vec3& axis) {
+            glm::vec3 n = glm::normalize(axis);
+            float s = std::sin(angle * 0.5f);
+            float c = std::cos(angle * 0.5f);
+            if (rotX[e] == n.x * s && rotY[e] == n.y * s && rotZ[e] == n.z * s && rotW[e] == c) {
+                return;
+            }
+            rotX[e] = n.x * s; rotY[e] = n.y * s; rotZ[e] = n.z * s; rotW[e] = c;
+            markDirty(e);
+        }
+
+        void SetScale(Entity e, const glm::vec3& s) {
+            if (scaleX[e] == s.x && scaleY[e] == s.y && scaleZ[e] == s.z) {
+                return;
+            }
+            scaleX[e] = s.x; scaleY[e] = s.y; scaleZ[e] = s.z;
+            markDirty(e);
+        }
+
+        void SetLocalBounds(Entity e, const AABB& bounds) {
+            localBounds[e] = bounds;
+            markDirty(e);
+        }
+
+        glm::vec3 Position(Entity e) const {
+            return glm::vec3(posX[e], posY[e], posZ[e]);
+        }
+
+        const std::vector<Entity>& EntitiesOf(RenderKind kind) const {
+            return byKind[(int)kind];
+        }
+
+        size_t Size() const {
+            return kinds.size();
+        }
+
+        size_t DirtyCount() const {
+            return dirtyList.size();
+        }
+
+        // recomputes world matrices and world bounds of the entities touched since the last call
+        void Update() {
+            size_t i = 0;
+#if defined(__SSE2__)
+            for (; i + 4 <= dirtyList.size(); i += 4) {
+                composeBatch4(&dirtyList[i]);
+            }
+#endif
+            for (; i < dirtyList.size(); ++i) {
+                composeSingle(dirtyList[i]);
+            }
+            for (Entity e : dirtyList) {
+                updateWorldBounds(e);
+                dirty[e] = 0;
+            }
+            dirtyList.clear();
+        }
+
+    private:
+        std::vector<uint8_t> dirty;
+        std::vector<Entity> dirtyList;
+        std::vector<Entity> byKind[(int)RenderKind::Count];
+
+        void markDirty(Entity e) {
+            if (!dirty[e]) {
+                dirty[e] = 1;
+                dirtyList.push_back(e);
+            }
+        }
+
+        // world = T * R * S, written straight into the column-major glm layout
+        void composeSingle(Entity e) {
+            float x = rotX[e], y = rotY[e], z = rotZ[e], w = rotW[e];
+            float sx = scaleX[e], sy = scaleY[e], sz = scaleZ[e];
+            glm::mat4& m = worldMatrices[e];
+            m[0][0] = (1.0f - 2.0f * (y * y + z * z)) * sx;
+            m[0][1] = (2.0f * (x * y + w * z)) * sx;
+            m[0][2] = (2.0f * (x * z - w * y)) * sx;
+            m[0][3] = 0.0f;
+            m[1][0] = (2.0f * (x * y - w * z)) * sy;
+            m[1][1] = (1.0f - 2.0f * (x * x + z * z)) * sy;
+            m[1][2] = (2.0f * (y * z + w * x)) * sy;
+            m[1][3] = 0.0f;
+            m[2][0] = (2.0f * (x * z + w * y)) * sz;
+            m[2][1] = (2.0f * (y * z - w * x)) * sz;
+            m[2][2] = (1.0f - 2.0f * (x * x + y * y)) * sz;
+            m[2][3] = 0.0f;
+            m[3][0] = posX[e];
+            m[3][1] = posY[e];
+            m[3][2] = posZ[e];
+            m[3][3] = 1.0f;
+        }
+
+#if defined(__SSE2__)
+        // same math as composeSingle, four entities per lane-wide operation
+        void composeBatch4(const Entity* e) {
+            const __m128 one = _mm_set1_ps(1.0f);
+            const __m128 two = _mm_set1_ps(2.0f);
+            __m128 x = _mm_setr_ps(rotX[e[0]], rotX[e[1]], rotX[e[2]], rotX[e[3]]);
+            __m128 y = _mm_setr_ps(rotY[e[0]], rotY[e[1]], rotY[e[2]], rotY[e[3]]);
+            __m128 z = _mm_setr_ps(rotZ[e[0]], rotZ[e[1]], rotZ[e[2]], rotZ[e[3]]);
+            __m128 w = _mm_setr_ps(rotW[e[0]], rotW[e[1]], rotW[e[2]], rotW[e[3]]);
+            __m128 sx = _mm_setr_ps(scaleX[e[0]], scaleX[e[1]], scaleX[e[2]], scaleX[e[3]]);
+            __m128 sy = _mm_setr_ps(scaleY[e[0]], scaleY[e[1]], scaleY[e[2]], scaleY[e[3]]);
+            __m128 sz = _mm_setr_ps(scaleZ[e[0]], scaleZ[e[1]], scaleZ[e[2]], scaleZ[e[3]]);
+
+            __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+            __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+            __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+            __m128 c[9];
+            c[0] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+            c[1] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx);
+            c[2] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx);
+            c[3] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy);
+            c[4] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+            c[5] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy);
+            c[6] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz);
+            c[7] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz);
+            c[8] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+
+            alignas(16) float lanes[9][4];
+            for (int k = 0; k < 9; ++k) {
+                _mm_store_ps(lanes[k], c[k]);
+            }
+            for (int l = 0; l < 4; ++l) {
+                glm::mat4& m = worldMatrices[e[l]];
+                for (int col = 0; col < 3; ++col) {
+                    m[col][0] = lanes[col * 3 + 0][l];
+                    m[col][1] = lanes[col * 3 + 1][l];
+                    m[col][2] = lanes[col * 3 + 2][l];
+                    m[col][3] = 0.0f;
+                }
+                m[3][0] = posX[e[l]];
+                m[3][1] = posY[e[l]];
+                m[3][2] = posZ[e[l]];
+                m[3][3] = 1.0f;
+            }
+        }
+#endif
+
+        void updateWorldBounds(Entity e) {
+            worldBounds[e] = TransformBounds(localBounds[e], worldMatrices[e]);
+        }
+    };
+
+};
+
+#endif //PROJECT_BASE_SCENE_H
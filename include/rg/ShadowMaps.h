@@ -0,0 +1,285 @@
+#ifndef PROJECT_BASE_SHADOWMAPS_H
+#define PROJECT_BASE_SHADOWMAPS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/shader.h>
+#include <rg/Error.h>
+#include <rg/GpuProfiler.h>
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace rg {
+
+    // Shadow maps for the sun (three cascades around the camera) and the flashlight. Every map
+    // has a cached copy holding only the static casters, rendered when the light, the static
+    // content or the map's placement changes and otherwise kept. Each frame the cache is copied
+    // into the map the shaders sample and the few dynamic casters are drawn on top, which costs a
+    // depth blit and a handful of draws instead of the whole dam. The flashlight hangs off the
+    // camera and moves most frames, when a cache would be redrawn and copied for nothing: while it
+    // moves, all casters go straight into the sampled map, and its cache is only filled once it
+    // holds still.
+    //
+    // Cascades sit at a snapped position around the camera, in light space steps of a quarter of
+    // their size, so they only move when the camera has travelled that far. Moved cascades are
+    // re-rendered one per frame, nearest first; until then the old placement stays in use, and it
+    // still covers the camera.
+    class ShadowMaps {
+    public:
+        static const int CascadeCount = 3;
+        static const int CascadeSize = 2048;
+        static const int SpotSize = 1024;
+        static const int CascadeTextureUnit = 11;
+        static const int SpotTextureUnit = 12;
+
+        // casters drawn with the depth shader, which takes a "model" matrix per draw
+        typedef std::function<void(Shader&)> DrawCasters;
+
+        struct Light {
+            glm::vec3 sunDirection = glm::vec3(0.0f, -1.0f, 0.0f);
+            bool spot = false; // flashlight on
+            glm::vec3 spotPosition = glm::vec3(0.0f);
+            glm::vec3 spotDirection = glm::vec3(0.0f, 0.0f, -1.0f);
+            float spotAngle = 40.0f; // full cone in degrees
+            glm::vec3 camera = glm::vec3(0.0f);
+            uint64_t staticVersion = 0; // changes whenever static casters move
+        };
+
+        ShadowMaps() : depthShader("resources/shaders/shadow_depth.vs", "resources/shaders/shadow_depth.fs") {
+            cascadeStatic = createDepthArray(CascadeSize, CascadeCount, false);
+            cascadeLive = createDepthArray(CascadeSize, CascadeCount, true);
+            spotStatic = createDepth(SpotSize, false);
+            spotLive = createDepth(SpotSize, true);
+            glGenFramebuffers(1, &drawFramebuffer);
+            glGenFramebuffers(1, &readFramebuffer);
+            GLCALL(glBindFramebuffer(GL_FRAMEBUFFER, drawFramebuffer));
+            GLCALL(glDrawBuffer(GL_NONE));
+            glReadBuffer(GL_NONE);
+            GLCALL(glBindFramebuffer(GL_FRAMEBUFFER, readFramebuffer));
+            GLCALL(glDrawBuffer(GL_NONE));
+            glReadBuffer(GL_NONE);
+            GLCALL(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+        }
+
+        ShadowMaps(const ShadowMaps&) = delete;
+        ShadowMaps& operator=(const ShadowMaps&) = delete;
+
+        // refreshes the caches that need it and rebuilds the sampled maps; leaves framebuffer 0
+        // bound and the viewport changed
+        void Update(const Light& light, const DrawCasters& drawStatic, const DrawCasters& drawDynamic,
+                    GpuProfiler* profiler = nullptr) {
+            GpuScope scope(profiler, "shadows");
+            int staticRenders = 0;
+            glm::vec3 sun = glm::normalize(light.sunDirection);
+            bool lightChanged = sun != cachedSun || light.staticVersion != cachedVersion;
+            cachedSun = sun;
+            cachedVersion = light.staticVersion;
+
+            glEnable(GL_DEPTH_TEST);
+            glEnable(GL_POLYGON_OFFSET_FILL);
+            glPolygonOffset(2.0f, 4.0f);
+            depthShader.use();
+
+            // placements first: never rendered or changed light re-render now, moved ones one per frame
+            bool slicedRender = false;
+            for (int i = 0; i < CascadeCount; i++) {
+                Cascade& cascade = cascades[i];
+                glm::vec3 center = snappedCenter(sun, light.camera, CascadeExtents()[i]);
+                bool moved = center != cascade.center;
+                if (!cascade.valid || lightChanged || (moved && !slicedRender)) {
+                    slicedRender = slicedRender || (cascade.valid && !lightChanged);
+                    cascade.center = center;
+                    cascade.viewProjection = cascadeMatrix(sun, center, CascadeExtents()[i]);
+                    cascade.valid = true;
+                    renderLayer(cascadeStatic, i, CascadeSize, cascade.viewProjection, drawStatic, true);
+                    staticRenders++;
+                }
+            }
+            for (int i = 0; i < CascadeCount; i++) {
+                copyLayer(cascadeStatic, cascadeLive, i, CascadeSize);
+                renderLayer(cascadeLive, i, CascadeSize, cascades[i].viewProjection, drawDynamic, false);
+            }
+
+            if (light.spot) {
+                glm::vec3 direction = glm::normalize(light.spotDirection);
+                bool spotMoved = light.spotPosition != spotPosition || direction != spotDirection;
+                if (spotMoved) {
+                    spotPosition = light.spotPosition;
+                    spotDirection = direction;
+                    glm::vec3 up = std::abs(direction.y) > 0.99f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+                    spotMatrix = glm::perspective(glm::radians(light.spotAngle), 1.0f, 0.1f, 60.0f) *
+                                 glm::lookAt(spotPosition, spotPosition + direction, up);
+                    spotValid = false;
+                    renderLayer(spotLive, -1, SpotSize, spotMatrix, drawStatic, true);
+                    staticRenders++;
+                } else {
+                    if (!spotValid || lightChanged) {
+                        spotValid = true;
+                        renderLayer(spotStatic, -1, SpotSize, spotMatrix, drawStatic, true);
+                        staticRenders++;
+                    }
+                    copyLayer(spotStatic, spotLive, -1, SpotSize);
+                }
+                renderLayer(spotLive, -1, SpotSize, spotMatrix, drawDynamic, false);
+            }
+            spotEnabled = light.spot;
+
+            glDisable(GL_POLYGON_OFFSET_FILL);
+            GLCALL(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+            lastStaticRenders.store(staticRenders, std::memory_order_relaxed);
+            totalStaticRenders.fetch_add(staticRenders, std::memory_order_relaxed);
+        }
+
+        // binds the sampled maps and sets the matrices of a receiving shader
+        void SetUniforms(const Shader& shader, bool enabled) const {
+            glActiveTexture(GL_TEXTURE0 + CascadeTextureUnit);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, cascadeLive);
+            glActiveTexture(GL_TEXTURE0 + SpotTextureUnit);
+            glBindTexture(GL_TEXTURE_2D, spotLive);
+            glActiveTexture(GL_TEXTURE0);
+            shader.setInt("cascadeShadows", CascadeTextureUnit);
+            shader.setInt("spotShadow", SpotTextureUnit);
+            shader.setBool("sunShadows", enabled);
+            shader.setBool("spotShadows", enabled && spotEnabled);
+            for (int i = 0; i < CascadeCount; i++) {
+                shader.setMat4("cascadeMatrices[" + std::to_string(i) + "]", cascades[i].viewProjection);
+            }
+            shader.setMat4("spotMatrix", spotMatrix);
+        }
+
+        // half the width of each cascade, in world units
+        static const float* CascadeExtents() {
+            static const float extents[CascadeCount] = {12.0f, 40.0f, 120.0f};
+            return extents;
+        }
+
+        // static caster renders in the last Update() and since the start; callable from any thread
+        int LastStaticRenders() const {
+            return lastStaticRenders.load(std::memory_order_relaxed);
+        }
+
+        int TotalStaticRenders() const {
+            return totalStaticRenders.load(std::memory_order_relaxed);
+        }
+
+    private:
+        struct Cascade {
+            glm::mat4 viewProjection = glm::mat4(1.0f);
+            glm::vec3 center = glm::vec3(0.0f);
+            bool valid = false;
+        };
+
+        Shader depthShader;
+        GLuint cascadeStatic = 0, cascadeLive = 0;
+        GLuint spotStatic = 0, spotLive = 0;
+        GLuint drawFramebuffer = 0, readFramebuffer = 0;
+        Cascade cascades[CascadeCount];
+        glm::vec3 cachedSun = glm::vec3(0.0f);
+        uint64_t cachedVersion = 0;
+        bool spotValid = false;
+        bool spotEnabled = false;
+        glm::vec3 spotPosition = glm::vec3(0.0f);
+        glm::vec3 spotDirection = glm::vec3(0.0f);
+        glm::mat4 spotMatrix = glm::mat4(1.0f);
+        std::atomic<int> lastStaticRenders{0};
+        std::atomic<int> totalStaticRenders{0};
+
+        static void lightBasis(const glm::vec3& sun, glm::vec3& right, glm::vec3& up) {
+            glm::vec3 reference = std::abs(sun.y) > 0.99f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+            right = glm::normalize(glm::cross(sun, reference));
+            up = glm::cross(right, sun);
+        }
+
+        // the camera position rounded to a quarter of the cascade in each light space axis; a
+        // multiple of the texel size, so a re-rendered cascade doesn't shimmer either
+        static glm::vec3 snappedCenter(const glm::vec3& sun, const glm::vec3& camera, float extent) {
+            glm::vec3 right, up;
+            lightBasis(sun, right, up);
+            float step = extent * 0.5f;
+            float x = std::floor(glm::dot(camera, right) / step + 0.5f) * step;
+            float y = std::floor(glm::dot(camera, up) / step + 0.5f) * step;
+            float z = std::floor(glm::dot(camera, sun) / step + 0.5f) * step;
+            return right * x + up * y + sun * z;
+        }
+
+        static glm::mat4 cascadeMatrix(const glm::vec3& sun, const glm::vec3& center, float extent) {
+            glm::vec3 right, up;
+            lightBasis(sun, right, up);
+            const float depthRange = 150.0f; // light space depth on either side of the center
+            glm::mat4 view = glm::lookAt(center - sun * depthRange, center, up);
+            return glm::ortho(-extent, extent, -extent, extent, 0.0f, 2.0f * depthRange) * view;
+        }
+
+        static GLuint createDepth(int size, bool compare) {
+            GLuint texture;
+            glGenTextures(1, &texture);
+            glBindTexture(GL_TEXTURE_2D, texture);
+            GLCALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, size, size, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL));
+            setSampling(GL_TEXTURE_2D, compare);
+            glBindTexture(GL_TEXTURE_2D, 0);
+            return texture;
+        }
+
+        static GLuint createDepthArray(int size, int layers, bool compare) {
+            GLuint texture;
+            glGenTextures(1, &texture);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+            GLCALL(glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, size, size, layers, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL));
+            setSampling(GL_TEXTURE_2D_ARRAY, compare);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+            return texture;
+        }
+
+        // the sampled maps compare in hardware, with bilinear filtering that gives 2x2 PCF per tap
+        static void setSampling(GLenum target, bool compare) {
+            GLint filter = compare ? GL_LINEAR : GL_NEAREST;
+            glTexParameteri(target, GL_TEXTURE_MIN_FILTER, filter);
+            glTexParameteri(target, GL_TEXTURE_MAG_FILTER, filter);
+            glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            if (compare) {
+                glTexParameteri(target, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+                glTexParameteri(target, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+            }
+        }
+
+        // layer -1 is a plain 2D texture
+        static void attach(GLenum target, GLuint texture, int layer) {
+            if (layer < 0) {
+                glFramebufferTexture2D(target, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, texture, 0);
+            } else {
+                glFramebufferTextureLayer(target, GL_DEPTH_ATTACHMENT, texture, 0, layer);
+            }
+        }
+
+        void renderLayer(GLuint texture, int layer, int size, const glm::mat4& viewProjection,
+                         const DrawCasters& draw, bool clear) {
+            GLCALL(glBindFramebuffer(GL_FRAMEBUFFER, drawFramebuffer));
+            attach(GL_FRAMEBUFFER, texture, layer);
+            glViewport(0, 0, size, size);
+            if (clear) {
+                glClear(GL_DEPTH_BUFFER_BIT);
+            }
+            depthShader.use();
+            depthShader.setMat4("lightSpace", viewProjection);
+            draw(depthShader);
+        }
+
+        void copyLayer(GLuint from, GLuint to, int layer, int size) {
+            GLCALL(glBindFramebuffer(GL_READ_FRAMEBUFFER, readFramebuffer));
+            attach(GL_READ_FRAMEBUFFER, from, layer);
+            GLCALL(glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFramebuffer));
+            attach(GL_DRAW_FRAMEBUFFER, to, layer);
+            GLCALL(glBlitFramebuffer(0, 0, size, size, 0, 0, size, size, GL_DEPTH_BUFFER_BIT, GL_NEAREST));
+        }
+    };
+
+};
+
+#endif //PROJECT_BASE_SHADOWMAPS_H
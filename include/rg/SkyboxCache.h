@@ -0,0 +1,223 @@
+#ifndef PROJECT_BASE_SKYBOXCACHE_H
+#define PROJECT_BASE_SKYBOXCACHE_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <common.h>
+#include <rg/Error.h>
+#include <rg/Profiler.h>
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace rg {
+
+    // Cubemap environments loaded on demand. The faces are decoded on a background thread and
+    // uploaded on the GL thread once they are asked for; environments that are neither shown nor
+    // pre-warmed are deleted, least recently used first, while residency is over the budget.
+    // Every environment that is not resident is kept decoded in CPU memory, its decode started
+    // at the first Acquire and again after each eviction, so a switch only uploads. Only the
+    // very first Acquire waits for a decode; a switch asked for while the new faces are still
+    // decoding keeps the previous sky until they are done.
+    class SkyboxCache {
+    public:
+        size_t budgetBytes = 32u << 20; // enough for one 1024x1024 RGBA environment
+
+        SkyboxCache() = default;
+        SkyboxCache(const SkyboxCache&) = delete;
+        SkyboxCache& operator=(const SkyboxCache&) = delete;
+
+        ~SkyboxCache() {
+            for (std::unique_ptr<Environment>& environment : environments) {
+                if (environment->decoder.joinable()) {
+                    environment->decoder.join();
+                }
+                freeFaces(*environment);
+            }
+        }
+
+        // six face paths in +x, -x, +y, -y, +z, -z order; nothing is loaded yet
+        int Add(const std::vector<std::string>& faces) {
+            environments.emplace_back(new Environment);
+            environments.back()->paths = faces;
+            return (int)environments.size() - 1;
+        }
+
+        // starts decoding in the background unless it is already resident, decoded or on its way
+        void Prewarm(int index) {
+            Environment& environment = *environments[index];
+            if (environment.texture == 0 && !environment.decoded && !environment.decoder.joinable()) {
+                environment.ready.store(false);
+                environment.decoder = std::thread([&environment]() { decode(environment); });
+                loads.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        // waits for the decode of an environment, so the next Acquire of it doesn't keep the
+        // previous sky; for tools that need the right sky in their first frame
+        void Finish(int index) {
+            Environment& environment = *environments[index];
+            Prewarm(index);
+            if (environment.decoder.joinable()) {
+                environment.decoder.join();
+                environment.decoded = true;
+            }
+        }
+
+        // the texture of an environment, uploading its decoded faces if it isn't resident yet.
+        // Must run on the GL thread; keeps the environment and the pre-warmed one on the GPU,
+        // evicts the rest as far as the budget asks and keeps every other one decoded
+        GLuint Acquire(int index, int prewarm, uint64_t frameIndex) {
+            // finished decoders are about to exit, joining them doesn't wait
+            for (std::unique_ptr<Environment>& other : environments) {
+                if (other->decoder.joinable() && other->ready.load()) {
+                    other->decoder.join();
+                    other->decoded = true;
+                }
+            }
+            Environment& environment = *environments[index];
+            if (environment.texture == 0) {
+                Prewarm(index);
+                if (!environment.decoded) {
+                    if (shown >= 0 && environments[shown]->texture != 0) {
+                        return environments[shown]->texture;
+                    }
+                    RG_PROFILE_SCOPE("skybox wait");
+                    environment.decoder.join();
+                    environment.decoded = true;
+                }
+                upload(environment);
+            }
+            shown = index;
+            environment.lastUsed = frameIndex;
+            if (prewarm >= 0 && prewarm != index) {
+                Environment& next = *environments[prewarm];
+                next.lastUsed = frameIndex;
+                // pre-warmed ones go up as soon as they are decoded, so a switch only binds
+                if (next.texture == 0 && next.decoded) {
+                    upload(next);
+                }
+            }
+            evict(index, prewarm);
+            for (size_t i = 0; i < environments.size(); i++) {
+                Prewarm((int)i);
+            }
+            return environment.texture;
+        }
+
+        // GPU memory of the resident environments and counters; callable from any thread
+        size_t ResidentBytes() const {
+            return residentBytes.load(std::memory_order_relaxed);
+        }
+
+        int Loads() const {
+            return loads.load(std::memory_order_relaxed);
+        }
+
+        int Evictions() const {
+            return evictions.load(std::memory_order_relaxed);
+        }
+
+    private:
+        struct Face {
+            unsigned char* pixels = nullptr;
+            int width = 0, height = 0, channels = 0;
+        };
+
+        struct Environment {
+            std::vector<std::string> paths;
+            Face faces[6];
+            std::thread decoder;
+            std::atomic<bool> ready{false}; // faces decoded, decoder about to exit
+            bool decoded = false;           // faces in CPU memory, decoder joined
+            GLuint texture = 0;
+            size_t bytes = 0;
+            uint64_t lastUsed = 0;
+        };
+
+        std::vector<std::unique_ptr<Environment>> environments;
+        int shown = -1; // the environment of the last Acquire
+        std::atomic<size_t> residentBytes{0};
+        std::atomic<int> loads{0};
+        std::atomic<int> evictions{0};
+
+        // on the decoder thread, which is short lived and so not profiled
+        static void decode(Environment& environment) {
+            for (size_t i = 0; i < environment.paths.size() && i < 6; i++) {
+                Face& face = environment.faces[i];
+                face.pixels = loadImageFile(environment.paths[i], &face.width, &face.height, &face.channels);
+            }
+            environment.ready.store(true);
+        }
+
+        static void freeFaces(Environment& environment) {
+            for (Face& face : environment.faces) {
+                stbi_image_free(face.pixels);
+                face.pixels = nullptr;
+            }
+        }
+
+        void upload(Environment& environment) {
+            RG_PROFILE_SCOPE("skybox upload");
+            glGenTextures(1, &environment.texture);
+            glBindTexture(GL_TEXTURE_CUBE_MAP, environment.texture);
+            environment.bytes = 0;
+            for (unsigned int i = 0; i < 6; i++) {
+                const Face& face = environment.faces[i];
+                if (face.pixels) {
+                    GLenum internalFormat = GL_RED, dataFormat = GL_RED;
+                    if (face.channels == 3) {
+                        internalFormat = GL_SRGB;
+                        dataFormat = GL_RGB;
+                    } else if (face.channels == 4) {
+                        internalFormat = GL_SRGB_ALPHA;
+                        dataFormat = GL_RGBA;
+                    }
+                    GLCALL(glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, internalFormat, face.width, face.height, 0, dataFormat, GL_UNSIGNED_BYTE, face.pixels));
+                    // drivers pad RGB to four bytes per texel
+                    environment.bytes += (size_t)face.width * face.height * 4;
+                } else {
+                    std::cout << "Cubemap texture failed to load at path: " << environment.paths[i] << std::endl;
+                }
+            }
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+            glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+            freeFaces(environment);
+            environment.decoded = false;
+            residentBytes.fetch_add(environment.bytes, std::memory_order_relaxed);
+        }
+
+        void evict(int keep, int prewarm) {
+            while (residentBytes.load(std::memory_order_relaxed) > budgetBytes) {
+                Environment* oldest = nullptr;
+                for (size_t i = 0; i < environments.size(); i++) {
+                    Environment* environment = environments[i].get();
+                    if ((int)i != keep && (int)i != prewarm && environment->texture != 0 &&
+                        (!oldest || environment->lastUsed < oldest->lastUsed)) {
+                        oldest = environment;
+                    }
+                }
+                if (!oldest) {
+                    return;
+                }
+                glDeleteTextures(1, &oldest->texture);
+                oldest->texture = 0;
+                residentBytes.fetch_sub(oldest->bytes, std::memory_order_relaxed);
+                evictions.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    };
+
+};
+
+#endif //PROJECT_BASE_SKYBOXCACHE_H
@@ -0,0 +1,871 @@
+#ifndef PROJECT_BASE_SOFTRENDERER_H
+#define PROJECT_BASE_SOFTRENDERER_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/filesystem.h>
+#include <learnopengl/model.h>
+#include <rg/Image.h>
+#include <rg/JobSystem.h>
+#include <rg/LightClusters.h>
+#include <rg/Primitives.h>
+#include <rg/Profiler.h>
+#include <rg/Renderer.h>
+#include <rg/SoftTexture.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+    // Draws frame packets on the CPU, no GL context needed: the same draw list, lights and sky
+    // as Renderer's Blinn-Phong path, tonemapped into an Image. Triangles are transformed and
+    // clipped in batches on every core and binned into 64x64 pixel tiles; each tile is then
+    // rasterized by one job with fixed point edge functions, four pixels at a time, into a
+    // visibility buffer (depth, triangle, barycentrics) and shaded once per pixel afterwards,
+    // so overdraw costs a depth test and not a texture fetch. Tiles never share pixels, no
+    // locking is needed past the binning. Not drawn: shadows, image based lighting and bloom.
+    class SoftRenderer {
+    public:
+        static const int TileSize = 64;
+        // edge functions in 28.4 fixed point stay within 32 bits inside a tile up to this size
+        static const int MaxDimension = 8192;
+
+        struct Stats {
+            size_t draws = 0;
+            size_t triangles = 0;  // set up after clipping and culling
+            size_t binned = 0;     // triangle and tile pairs
+            double geometryMs = 0.0;
+            double rasterMs = 0.0; // rasterization and shading
+            double resolveMs = 0.0;
+        };
+
+        // CPU only copies of the models, readable from any thread like Renderer's
+        Model damModel;
+        Model moonModel;
+
+        SoftRenderer()
+                : damModel("resources/objects/dam_obj/dam1.obj", false, noTextures(), false),
+                  moonModel("resources/objects/sphere/moon.obj", false, noTextures(), false) {
+            RG_PROFILE_SCOPE("SoftRenderer load");
+            // paths as in Renderer::createTextures
+            skyPaths[0] = {
+                    FileSystem::getPath("resources/cubemaps/clouds/graycloud_lf.jpg"),
+                    FileSystem::getPath("resources/cubemaps/clouds/graycloud_rt.jpg"),
+                    FileSystem::getPath("resources/cubemaps/clouds/graycloud_up.jpg"),
+                    FileSystem::getPath("resources/cubemaps/clouds/graycloud_dn.jpg"),
+                    FileSystem::getPath("resources/cubemaps/clouds/graycloud_ft.jpg"),
+                    FileSystem::getPath("resources/cubemaps/clouds/graycloud_bk.jpg")
+            };
+            skyPaths[1] = {
+                    FileSystem::getPath("resources/cubemaps/cubemap/px.png"),
+                    FileSystem::getPath("resources/cubemaps/cubemap/nx.png"),
+                    FileSystem::getPath("resources/cubemaps/cubemap/py.png"),
+                    FileSystem::getPath("resources/cubemaps/cubemap/ny.png"),
+                    FileSystem::getPath("resources/cubemaps/cubemap/pz.png"),
+                    FileSystem::getPath("resources/cubemaps/cubemap/nz.png")
+            };
+            createMaterials();
+            createGeometry();
+        }
+
+        SoftRenderer(const SoftRenderer&) = delete;
+        SoftRenderer& operator=(const SoftRenderer&) = delete;
+
+        // the whole frame at the viewport size; renderScale and sharpness don't apply
+        Image Render(const FramePacket& frame, JobSystem& jobs) {
+            RG_PROFILE_SCOPE("SoftRenderer::Render");
+            stats = Stats();
+            const int maxDimension = MaxDimension;
+            width = std::min(std::max(frame.viewportWidth, 1), maxDimension);
+            height = std::min(std::max(frame.viewportHeight, 1), maxDimension);
+            tilesX = (width + TileSize - 1) / TileSize;
+            tilesY = (height + TileSize - 1) / TileSize;
+            setupFrame(frame);
+
+            Clock::time_point start = Clock::now();
+            collectDraws(frame);
+            if (outputs.size() < batches.size()) {
+                outputs.resize(batches.size());
+            }
+            jobs.ParallelFor(batches.size(), 1, [this](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    processBatch(batches[i], outputs[i]);
+                }
+            });
+            for (size_t i = 0; i < batches.size(); i++) {
+                stats.triangles += outputs[i].triangles.size();
+                for (const std::vector<uint32_t>& bin : outputs[i].bins) {
+                    stats.binned += bin.size();
+                }
+            }
+            stats.draws = draws.size();
+            Clock::time_point rasterStart = Clock::now();
+            stats.geometryMs = millisecondsBetween(start, rasterStart);
+
+            hdr.resize((size_t)width * height);
+            tileLogLuma.assign((size_t)tilesX * tilesY, 0.0);
+            jobs.ParallelFor((size_t)tilesX * tilesY, 1, [this](size_t begin, size_t end) {
+                TileBuffers buffers;
+                for (size_t tile = begin; tile < end; tile++) {
+                    renderTile((int)tile, buffers);
+                }
+            });
+            Clock::time_point resolveStart = Clock::now();
+            stats.rasterMs = millisecondsBetween(rasterStart, resolveStart);
+
+            Image image = resolve(frame, jobs);
+            stats.resolveMs = millisecondsBetween(resolveStart, Clock::now());
+            return image;
+        }
+
+        Stats LastStats() const {
+            return stats;
+        }
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        enum class Shading { Dam, Box, Grass, Moon };
+
+        // the maps the GL path samples through material.texture_diffuse1 and texture_specular1
+        struct Material {
+            Shading shading = Shading::Dam;
+            const SoftTexture* diffuse = nullptr;
+            const SoftTexture* specular = nullptr;
+            bool cullBack = false;  // GL_CULL_FACE is only on for the dam
+            bool alphaTest = false; // the grass discards alpha below 0.1
+        };
+
+        struct Geometry {
+            const std::vector<Vertex>* vertices = nullptr;
+            const std::vector<unsigned int>* indices = nullptr;
+        };
+
+        struct Draw {
+            Geometry geometry;
+            glm::mat4 model;
+            uint32_t material;
+        };
+
+        // a run of triangles of one draw, the unit of work of the geometry stage
+        struct Batch {
+            uint32_t draw;
+            uint32_t first;
+            uint32_t count;
+        };
+
+        // what the fragment shaders get: world position, world space normal (through the inverse
+        // transpose of the model matrix, like the vertex shaders) and texture coordinates
+        struct Attributes {
+            glm::vec3 position;
+            glm::vec3 normal;
+            glm::vec2 uv;
+        };
+
+        struct ClipVertex {
+            glm::vec4 clip;
+            Attributes attributes;
+        };
+
+        // screen space triangle, counter-clockwise as seen (positive area)
+        struct Triangle {
+            int32_t x[3], y[3];         // 28.4 fixed point, y down
+            int minX, minY, maxX, maxY; // pixels whose centers may be covered
+            float z[3];                 // window depth
+            float invW[3];
+            float invArea;
+            float l1dx, l1dy, l2dx, l2dy; // barycentric steps per pixel
+            uint32_t material;
+            Attributes vertices[3];
+        };
+
+        struct BatchOutput {
+            std::vector<Triangle> triangles;
+            std::vector<std::vector<uint32_t>> bins; // triangle indices per tile, in draw order
+        };
+
+        // visibility buffer of one tile; a few floats of padding for the four wide loads
+        struct TileBuffers {
+            float depth[TileSize * TileSize + 4];
+            float l1[TileSize * TileSize + 4];
+            float l2[TileSize * TileSize + 4];
+            const Triangle* triangle[TileSize * TileSize];
+        };
+
+        // per frame constants of the fragment stage
+        struct FrameSetup {
+            glm::mat4 viewProjection;
+            glm::mat4 view;
+            glm::mat4 inverseProjection;
+            glm::mat3 inverseViewRotation;
+            glm::vec3 viewPosition;
+            glm::vec3 cameraFront;
+            glm::vec3 sunDirection;
+            glm::vec3 clearColor;
+            bool day = false;
+            bool spotlight = false;
+            glm::vec2 clusterTileScale;
+            const std::vector<PointLight>* pointLights = nullptr;
+            const ClusterLists* clusters = nullptr;
+            const SoftCubemap* sky = nullptr;
+        };
+
+        std::vector<std::unique_ptr<SoftTexture>> textures;
+        std::vector<Material> materials;
+        std::vector<uint32_t> damMaterials, moonMaterials; // per mesh
+        uint32_t boxMaterial = 0, grassMaterial = 0;
+        std::vector<Vertex> boxVertices, grassVertices;
+        std::vector<unsigned int> boxIndices, grassIndices;
+        std::vector<std::string> skyPaths[2];
+        SoftCubemap skies[2];
+        int skyState[2] = {0, 0}; // 0 not loaded yet, 1 loaded, -1 failed
+
+        int width = 0, height = 0, tilesX = 0, tilesY = 0;
+        FrameSetup setup;
+        std::vector<Draw> draws;
+        std::vector<Batch> batches;
+        std::vector<BatchOutput> outputs;
+        std::vector<glm::vec3> hdr;
+        std::vector<double> tileLogLuma;
+        Stats stats;
+
+        static double millisecondsBetween(Clock::time_point start, Clock::time_point end) {
+            return std::chrono::duration<double, std::milli>(end - start).count();
+        }
+
+        // the meshes keep their texture paths, the textures are decoded by createMaterials
+        static Model::TextureLoader noTextures() {
+            return [](const std::string&, const std::string&) {
+                return 0u;
+            };
+        }
+
+        const SoftTexture* loadTexture(const std::string& path, bool srgb, bool repeat, bool mipmapped) {
+            std::unique_ptr<SoftTexture> texture(new SoftTexture);
+            texture->srgb = srgb;
+            texture->repeat = repeat;
+            texture->mipmapped = mipmapped;
+            // like an incomplete GL texture, a missing file samples black
+            if (!texture->Load(path)) {
+                std::cout << "Texture failed to load at path: " << path << std::endl;
+            }
+            textures.push_back(std::move(texture));
+            return textures.back().get();
+        }
+
+        // model textures as TextureStreamer uploads them (linear, repeat, mipmapped), the others
+        // as Renderer::loadTexture does (sRGB, clamped, sampled from the base level)
+        void createMaterials() {
+            std::map<std::string, const SoftTexture*> loaded;
+            // the mesh's map of a type, by the name Mesh::Draw binds it under
+            auto modelTexture = [this, &loaded](const Model& model, const Mesh& mesh, const std::string& type) -> const SoftTexture* {
+                for (const Texture& texture : mesh.textures) {
+                    if (texture.type != type) {
+                        continue;
+                    }
+                    std::string path = model.directory + '/' + texture.path;
+                    auto found = loaded.find(path);
+                    if (found == loaded.end()) {
+                        found = loaded.emplace(path, loadTexture(path, false, true, true)).first;
+                    }
+                    return found->second;
+                }
+                return nullptr;
+            };
+            // Renderer's default for meshes without a specular map
+            std::unique_ptr<SoftTexture> defaultTexture(new SoftTexture);
+            const unsigned char specular[3] = {Renderer::DefaultSpecular, Renderer::DefaultSpecular, Renderer::DefaultSpecular};
+            defaultTexture->Create(1, 1, 3, specular);
+            textures.push_back(std::move(defaultTexture));
+            const SoftTexture* defaultSpecular = textures.back().get();
+
+            for (const Mesh& mesh : damModel.meshes) {
+                Material material;
+                material.shading = Shading::Dam;
+                material.diffuse = modelTexture(damModel, mesh, "texture_diffuse");
+                material.specular = modelTexture(damModel, mesh, "texture_specular");
+                if (!material.specular) {
+                    material.specular = defaultSpecular;
+                }
+                material.cullBack = true;
+                damMaterials.push_back((uint32_t)materials.size());
+                materials.push_back(material);
+            }
+            for (const Mesh& mesh : moonModel.meshes) {
+                Material material;
+                material.shading = Shading::Moon;
+                material.diffuse = modelTexture(moonModel, mesh, "texture_diffuse");
+                moonMaterials.push_back((uint32_t)materials.size());
+                materials.push_back(material);
+            }
+
+            Material box;
+            box.shading = Shading::Box;
+            box.diffuse = loadTexture(FileSystem::getPath("resources/textures/8640003215_50cc68f8cf_b.jpg"), true, false, false);
+            box.specular = loadTexture(FileSystem::getPath("resources/textures/container3_specular.jpg"), true, false, false);
+            boxMaterial = (uint32_t)materials.size();
+            materials.push_back(box);
+
+            Material grass;
+            grass.shading = Shading::Grass;
+            grass.diffuse = loadTexture(FileSystem::getPath("resources/textures/v2.png"), true, false, false);
+            grass.alphaTest = true;
+            grassMaterial = (uint32_t)materials.size();
+            materials.push_back(grass);
+        }
+
+        // the box and grass arrays of Primitives.h as indexed meshes
+        void createGeometry() {
+            for (int i = 0; i < BoxVertexCount; i++) {
+                const float* v = BoxVertices + i * 8;
+                Vertex vertex = {};
+                vertex.Position = glm::vec3(v[0], v[1], v[2]);
+                vertex.Normal = glm::vec3(v[3], v[4], v[5]);
+                vertex.TexCoords = glm::vec2(v[6], v[7]);
+                boxVertices.push_back(vertex);
+                boxIndices.push_back(i);
+            }
+            for (int i = 0; i < GrassVertexCount; i++) {
+                const float* v = GrassVertices + i * 5;
+                Vertex vertex = {};
+                vertex.Position = glm::vec3(v[0], v[1], v[2]);
+                vertex.TexCoords = glm::vec2(v[3], v[4]);
+                grassVertices.push_back(vertex);
+                grassIndices.push_back(i);
+            }
+        }
+
+        const SoftCubemap* acquireSky(bool day) {
+            int sky = day ? 0 : 1;
+            if (skyState[sky] == 0) {
+                RG_PROFILE_SCOPE("SoftRenderer sky load");
+                skyState[sky] = skies[sky].Load(skyPaths[sky]) ? 1 : -1;
+            }
+            return skyState[sky] > 0 ? &skies[sky] : nullptr;
+        }
+
+        void setupFrame(const FramePacket& frame) {
+            setup.viewProjection = frame.projection * frame.view;
+            setup.view = frame.view;
+            setup.inverseProjection = glm::inverse(frame.projection);
+            setup.inverseViewRotation = glm::transpose(glm::mat3(frame.view));
+            setup.viewPosition = frame.cameraPosition;
+            setup.cameraFront = frame.cameraFront;
+            setup.sunDirection = frame.sunDirection;
+            setup.clearColor = frame.clearColor;
+            setup.day = frame.changeTheSetting;
+            setup.spotlight = frame.spotlightOn && !frame.changeTheSetting;
+            setup.clusterTileScale = glm::vec2((float)LightClusters::TilesX / width, (float)LightClusters::TilesY / height);
+            setup.pointLights = &frame.pointLights;
+            setup.clusters = &frame.lightClusters;
+            setup.sky = acquireSky(frame.changeTheSetting);
+        }
+
+        // same draws in the same order as Renderer::drawScene, the sky fills whatever is left
+        void collectDraws(const FramePacket& frame) {
+            draws.clear();
+            auto add = [this](const Mesh& mesh, const glm::mat4& model, uint32_t material) {
+                draws.push_back(Draw{Geometry{&mesh.vertices, &mesh.indices}, model, material});
+            };
+            for (size_t i = 0; i < damModel.meshes.size(); i++) {
+                int node = damModel.meshNodes[i];
+                glm::mat4 local = node < (int)frame.damNodes.size() ? frame.damNodes[node] : damModel.nodes.world[node];
+                add(damModel.meshes[i], frame.dam * local, damMaterials[i]);
+            }
+            for (const glm::mat4& model : frame.grass) {
+                draws.push_back(Draw{Geometry{&grassVertices, &grassIndices}, model, grassMaterial});
+            }
+            for (const glm::mat4& model : frame.boxes) {
+                draws.push_back(Draw{Geometry{&boxVertices, &boxIndices}, model, boxMaterial});
+            }
+            for (const glm::mat4& model : frame.moons) {
+                for (size_t i = 0; i < moonModel.meshes.size(); i++) {
+                    int node = moonModel.meshNodes[i];
+                    glm::mat4 local = node < (int)frame.moonNodes.size() ? frame.moonNodes[node] : moonModel.nodes.world[node];
+                    add(moonModel.meshes[i], model * local, moonMaterials[i]);
+                }
+            }
+
+            // up to this many triangles of one draw per job
+            const uint32_t batchSize = 1024;
+            batches.clear();
+            for (size_t draw = 0; draw < draws.size(); draw++) {
+                uint32_t count = (uint32_t)(draws[draw].geometry.indices->size() / 3);
+                for (uint32_t first = 0; first < count; first += batchSize) {
+                    batches.push_back(Batch{(uint32_t)draw, first, std::min(batchSize, count - first)});
+                }
+            }
+        }
+
+        // 1. geometry: transform, clip against the view frustum, set up and bin
+        void processBatch(const Batch& batch, BatchOutput& output) {
+            output.triangles.clear();
+            output.bins.resize((size_t)tilesX * tilesY);
+            for (std::vector<uint32_t>& bin : output.bins) {
+                bin.clear();
+            }
+            const Draw& draw = draws[batch.draw];
+            const std::vector<Vertex>& vertices = *draw.geometry.vertices;
+            const std::vector<unsigned int>& indices = *draw.geometry.indices;
+            glm::mat4 mvp = setup.viewProjection * draw.model;
+            glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(draw.model)));
+            for (uint32_t t = batch.first; t < batch.first + batch.count; t++) {
+                ClipVertex v[3];
+                unsigned int outside[3];
+                for (int k = 0; k < 3; k++) {
+                    const Vertex& in = vertices[indices[3 * t + k]];
+                    glm::vec4 position(in.Position, 1.0f);
+                    v[k].clip = mvp * position;
+                    v[k].attributes.position = glm::vec3(draw.model * position);
+                    v[k].attributes.normal = normalMatrix * in.Normal;
+                    v[k].attributes.uv = in.TexCoords;
+                    outside[k] = outcode(v[k].clip);
+                }
+                if (outside[0] & outside[1] & outside[2]) {
+                    continue;
+                }
+                if ((outside[0] | outside[1] | outside[2]) == 0) {
+                    setupTriangle(v[0], v[1], v[2], draw.material, output);
+                } else {
+                    clipTriangle(v, outside[0] | outside[1] | outside[2], draw.material, output);
+                }
+            }
+        }
+
+        // signed distance to the frustum planes -x, +x, -y, +y, near, far; inside is positive
+        static float planeDistance(const glm::vec4& clip, int plane) {
+            float value = plane & 1 ? -clip[plane >> 1] : clip[plane >> 1];
+            return clip.w + value;
+        }
+
+        static unsigned int outcode(const glm::vec4& clip) {
+            unsigned int code = 0;
+            for (int plane = 0; plane < 6; plane++) {
+                if (planeDistance(clip, plane) < 0.0f) {
+                    code |= 1u << plane;
+                }
+            }
+            return code;
+        }
+
+        static ClipVertex lerp(const ClipVertex& a, const ClipVertex& b, float t) {
+            ClipVertex v;
+            v.clip = a.clip + (b.clip - a.clip) * t;
+            v.attributes.position = a.attributes.position + (b.attributes.position - a.attributes.position) * t;
+            v.attributes.normal = a.attributes.normal + (b.attributes.normal - a.attributes.normal) * t;
+            v.attributes.uv = a.attributes.uv + (b.attributes.uv - a.attributes.uv) * t;
+            return v;
+        }
+
+        // Sutherland-Hodgman in homogeneous coordinates against the planes the triangle
+        // crosses, then a fan; attributes are linear in clip space, so plain lerps are exact
+        void clipTriangle(const ClipVertex* triangle, unsigned int planes, uint32_t material, BatchOutput& output) {
+            ClipVertex polygons[2][9];
+            int count = 3;
+            std::copy(triangle, triangle + 3, polygons[0]);
+            int current = 0;
+            for (int plane = 0; plane < 6 && count >= 3; plane++) {
+                if (!(planes & (1u << plane))) {
+                    continue;
+                }
+                const ClipVertex* in = polygons[current];
+                ClipVertex* out = polygons[current ^ 1];
+                int outCount = 0;
+                for (int i = 0; i < count; i++) {
+                    const ClipVertex& a = in[i];
+                    const ClipVertex& b = in[(i + 1) % count];
+                    float da = planeDistance(a.clip, plane);
+                    float db = planeDistance(b.clip, plane);
+                    if (da >= 0.0f) {
+                        out[outCount++] = a;
+                    }
+                    if ((da >= 0.0f) != (db >= 0.0f)) {
+                        out[outCount++] = lerp(a, b, da / (da - db));
+                    }
+                }
+                count = outCount;
+                current ^= 1;
+            }
+            for (int i = 1; i + 1 < count; i++) {
+                setupTriangle(polygons[current][0], polygons[current][i], polygons[current][i + 1], material, output);
+            }
+        }
+
+        void setupTriangle(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c, uint32_t material, BatchOutput& output) {
+            const ClipVertex* v[3] = {&a, &b, &c};
+            Triangle tri;
+            for (int k = 0; k < 3; k++) {
+                const glm::vec4& clip = v[k]->clip;
+                float invW = 1.0f / clip.w;
+                float x = (clip.x * invW * 0.5f + 0.5f) * width;
+                float y = (0.5f - clip.y * invW * 0.5f) * height;
+                tri.x[k] = (int32_t)std::lround(x * 16.0f);
+                tri.y[k] = (int32_t)std::lround(y * 16.0f);
+                tri.z[k] = clip.z * invW * 0.5f + 0.5f;
+                tri.invW[k] = invW;
+                tri.vertices[k] = v[k]->attributes;
+            }
+            // edge function of v0 -> v1 at v2, positive for counter-clockwise in GL's y up
+            int64_t area = (int64_t)(tri.x[2] - tri.x[0]) * (tri.y[1] - tri.y[0]) -
+                           (int64_t)(tri.y[2] - tri.y[0]) * (tri.x[1] - tri.x[0]);
+            if (area == 0 || (area < 0 && materials[material].cullBack)) {
+                return;
+            }
+            if (area < 0) {
+                std::swap(tri.x[1], tri.x[2]);
+                std::swap(tri.y[1], tri.y[2]);
+                std::swap(tri.z[1], tri.z[2]);
+                std::swap(tri.invW[1], tri.invW[2]);
+                std::swap(tri.vertices[1], tri.vertices[2]);
+                area = -area;
+            }
+            // pixel centers sit at 8 in 28.4
+            int minX = std::min(tri.x[0], std::min(tri.x[1], tri.x[2]));
+            int maxX = std::max(tri.x[0], std::max(tri.x[1], tri.x[2]));
+            int minY = std::min(tri.y[0], std::min(tri.y[1], tri.y[2]));
+            int maxY = std::max(tri.y[0], std::max(tri.y[1], tri.y[2]));
+            tri.minX = std::max(0, (minX - 8 + 15) >> 4);
+            tri.maxX = std::min(width - 1, (maxX - 8) >> 4);
+            tri.minY = std::max(0, (minY - 8 + 15) >> 4);
+            tri.maxY = std::min(height - 1, (maxY - 8) >> 4);
+            if (tri.minX > tri.maxX || tri.minY > tri.maxY) {
+                return;
+            }
+            tri.invArea = 1.0f / (float)area;
+            // l1 is the edge v2 -> v0 over the area, l2 the edge v0 -> v1
+            tri.l1dx = 16.0f * (tri.y[0] - tri.y[2]) * tri.invArea;
+            tri.l1dy = 16.0f * (tri.x[2] - tri.x[0]) * tri.invArea;
+            tri.l2dx = 16.0f * (tri.y[1] - tri.y[0]) * tri.invArea;
+            tri.l2dy = 16.0f * (tri.x[0] - tri.x[1]) * tri.invArea;
+            tri.material = material;
+
+            uint32_t index = (uint32_t)output.triangles.size();
+            output.triangles.push_back(tri);
+            for (int ty = tri.minY / TileSize; ty <= tri.maxY / TileSize; ty++) {
+                for (int tx = tri.minX / TileSize; tx <= tri.maxX / TileSize; tx++) {
+                    output.bins[(size_t)ty * tilesX + tx].push_back(index);
+                }
+            }
+        }
+
+        // 2. rasterize every triangle binned to the tile in draw order, then shade it
+        void renderTile(int tile, TileBuffers& buffers) {
+            int tileX = (tile % tilesX) * TileSize;
+            int tileY = (tile / tilesX) * TileSize;
+            std::fill(buffers.depth, buffers.depth + TileSize * TileSize + 4, 1.0f);
+            std::fill(buffers.triangle, buffers.triangle + TileSize * TileSize, nullptr);
+            for (size_t batch = 0; batch < batches.size(); batch++) {
+                const BatchOutput& output = outputs[batch];
+                for (uint32_t index : output.bins[tile]) {
+                    rasterize(output.triangles[index], tileX, tileY, buffers);
+                }
+            }
+            shadeTile(tile, tileX, tileY, buffers);
+        }
+
+        struct Edge {
+            int64_t value; // at the first pixel, top-left bias included
+            int32_t stepX, stepY;
+            bool inside;   // covers the whole rectangle, no test needed
+        };
+
+        void rasterize(const Triangle& tri, int tileX, int tileY, TileBuffers& buffers) const {
+            int x0 = std::max(tri.minX, tileX), x1 = std::min(tri.maxX, tileX + TileSize - 1);
+            int y0 = std::max(tri.minY, tileY), y1 = std::min(tri.maxY, tileY + TileSize - 1);
+            if (x0 > x1 || y0 > y1) {
+                return;
+            }
+            int64_t px = (int64_t)x0 * 16 + 8, py = (int64_t)y0 * 16 + 8;
+            Edge edges[3];
+            int64_t unbiased[3];
+            for (int k = 0; k < 3; k++) {
+                int a = k, b = (k + 1) % 3;
+                int32_t dy = tri.y[b] - tri.y[a];
+                int32_t dx = tri.x[a] - tri.x[b];
+                unbiased[k] = (px - tri.x[a]) * dy + (py - tri.y[a]) * dx;
+                // top-left rule: pixels exactly on a right or bottom edge belong to the neighbour
+                bool topLeft = dy > 0 || (dy == 0 && dx > 0);
+                Edge& edge = edges[k];
+                edge.value = unbiased[k] + (topLeft ? 0 : -1);
+                edge.stepX = dy * 16;
+                edge.stepY = dx * 16;
+                int64_t spanX = (int64_t)edge.stepX * (x1 - x0), spanY = (int64_t)edge.stepY * (y1 - y0);
+                int64_t low = edge.value + std::min<int64_t>(0, spanX) + std::min<int64_t>(0, spanY);
+                int64_t high = edge.value + std::max<int64_t>(0, spanX) + std::max<int64_t>(0, spanY);
+                if (high < 0) {
+                    return;
+                }
+                edge.inside = low >= 0;
+            }
+            const Material& material = materials[tri.material];
+            float l1Row = (float)((double)unbiased[2] * tri.invArea);
+            float l2Row = (float)((double)unbiased[0] * tri.invArea);
+            float dz1 = tri.z[1] - tri.z[0], dz2 = tri.z[2] - tri.z[0];
+            // an edge that isn't trivially inside crosses the rectangle, its values fit in 32 bits
+            int32_t rows[3];
+            for (int k = 0; k < 3; k++) {
+                rows[k] = edges[k].inside ? 0 : (int32_t)edges[k].value;
+            }
+
+            for (int y = y0; y <= y1; y++) {
+                int32_t e[3] = {rows[0], rows[1], rows[2]};
+                float l1 = l1Row, l2 = l2Row;
+                int offset = (y - tileY) * TileSize - tileX;
+                for (int x = x0; x <= x1; x += 4) {
+                    int valid = x1 - x >= 3 ? 0xF : (1 << (x1 - x + 1)) - 1;
+                    float z[4], bl1[4], bl2[4];
+                    int mask;
+#if defined(__SSE2__)
+                    __m128i outside = _mm_setzero_si128();
+                    for (int k = 0; k < 3; k++) {
+                        if (!edges[k].inside) {
+                            int32_t s = edges[k].stepX;
+                            __m128i values = _mm_add_epi32(_mm_set1_epi32(e[k]), _mm_setr_epi32(0, s, 2 * s, 3 * s));
+                            outside = _mm_or_si128(outside, values);
+                        }
+                    }
+                    mask = ~_mm_movemask_ps(_mm_castsi128_ps(outside)) & valid;
+                    if (mask) {
+                        __m128 lane = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+                        __m128 vl1 = _mm_add_ps(_mm_set1_ps(l1), _mm_mul_ps(lane, _mm_set1_ps(tri.l1dx)));
+                        __m128 vl2 = _mm_add_ps(_mm_set1_ps(l2), _mm_mul_ps(lane, _mm_set1_ps(tri.l2dx)));
+                        __m128 vz = _mm_add_ps(_mm_set1_ps(tri.z[0]),
+                                               _mm_add_ps(_mm_mul_ps(vl1, _mm_set1_ps(dz1)), _mm_mul_ps(vl2, _mm_set1_ps(dz2))));
+                        mask &= _mm_movemask_ps(_mm_cmplt_ps(vz, _mm_loadu_ps(buffers.depth + offset + x)));
+                        _mm_storeu_ps(z, vz);
+                        _mm_storeu_ps(bl1, vl1);
+                        _mm_storeu_ps(bl2, vl2);
+                    }
+#else
+                    mask = 0;
+                    for (int i = 0; i < 4; i++) {
+                        bool covered = (valid >> i) & 1;
+                        for (int k = 0; k < 3 && covered; k++) {
+                            covered = edges[k].inside || e[k] + i * edges[k].stepX >= 0;
+                        }
+                        bl1[i] = l1 + i * tri.l1dx;
+                        bl2[i] = l2 + i * tri.l2dx;
+                        z[i] = tri.z[0] + bl1[i] * dz1 + bl2[i] * dz2;
+                        if (covered && z[i] < buffers.depth[offset + x + i]) {
+                            mask |= 1 << i;
+                        }
+                    }
+#endif
+                    for (int i = 0; mask; i++, mask >>= 1) {
+                        if (!(mask & 1)) {
+                            continue;
+                        }
+                        // the grass discard happens before the depth write, like in GL
+                        if (material.alphaTest) {
+                            Attributes attributes = interpolate(tri, bl1[i], bl2[i]);
+                            if (material.diffuse->Sample(attributes.uv).a < 0.1f) {
+                                continue;
+                            }
+                        }
+                        int index = offset + x + i;
+                        buffers.depth[index] = z[i];
+                        buffers.l1[index] = bl1[i];
+                        buffers.l2[index] = bl2[i];
+                        buffers.triangle[index] = &tri;
+                    }
+                    for (int k = 0; k < 3; k++) {
+                        e[k] += 4 * edges[k].stepX;
+                    }
+                    l1 += 4.0f * tri.l1dx;
+                    l2 += 4.0f * tri.l2dx;
+                }
+                for (int k = 0; k < 3; k++) {
+                    rows[k] += edges[k].stepY;
+                }
+                l1Row += tri.l1dy;
+                l2Row += tri.l2dy;
+            }
+        }
+
+        // perspective correct attributes from the screen space barycentrics
+        static Attributes interpolate(const Triangle& tri, float l1, float l2) {
+            float w0 = (1.0f - l1 - l2) * tri.invW[0], w1 = l1 * tri.invW[1], w2 = l2 * tri.invW[2];
+            float scale = 1.0f / (w0 + w1 + w2);
+            w0 *= scale;
+            w1 *= scale;
+            w2 *= scale;
+            Attributes result;
+            result.position = tri.vertices[0].position * w0 + tri.vertices[1].position * w1 + tri.vertices[2].position * w2;
+            result.normal = tri.vertices[0].normal * w0 + tri.vertices[1].normal * w1 + tri.vertices[2].normal * w2;
+            result.uv = tri.vertices[0].uv * w0 + tri.vertices[1].uv * w1 + tri.vertices[2].uv * w2;
+            return result;
+        }
+
+        static glm::vec2 interpolateUv(const Triangle& tri, float l1, float l2) {
+            float w0 = (1.0f - l1 - l2) * tri.invW[0], w1 = l1 * tri.invW[1], w2 = l2 * tri.invW[2];
+            return (tri.vertices[0].uv * w0 + tri.vertices[1].uv * w1 + tri.vertices[2].uv * w2) * (1.0f / (w0 + w1 + w2));
+        }
+
+        // 3. one fragment per covered pixel, the sky behind the rest
+        void shadeTile(int tile, int tileX, int tileY, const TileBuffers& buffers) {
+            const int tileSize = TileSize;
+            int tileWidth = std::min(tileSize, width - tileX);
+            int tileHeight = std::min(tileSize, height - tileY);
+            double logLuma = 0.0;
+            for (int y = 0; y < tileHeight; y++) {
+                for (int x = 0; x < tileWidth; x++) {
+                    int index = y * TileSize + x;
+                    int pixelX = tileX + x, pixelY = tileY + y;
+                    const Triangle* tri = buffers.triangle[index];
+                    glm::vec3 color;
+                    if (tri) {
+                        float l1 = buffers.l1[index], l2 = buffers.l2[index];
+                        Attributes attributes = interpolate(*tri, l1, l2);
+                        // texture coordinates one pixel to the right and below give the derivatives
+                        glm::vec2 dx = interpolateUv(*tri, l1 + tri->l1dx, l2 + tri->l2dx) - attributes.uv;
+                        glm::vec2 dy = interpolateUv(*tri, l1 + tri->l1dy, l2 + tri->l2dy) - attributes.uv;
+                        color = shade(materials[tri->material], attributes, dx, dy, pixelX, pixelY);
+                    } else {
+                        color = sky(pixelX, pixelY);
+                    }
+                    hdr[(size_t)pixelY * width + pixelX] = color;
+                    float luma = glm::dot(color, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+                    logLuma += std::log(std::max(luma, 0.0001f));
+                }
+            }
+            tileLogLuma[tile] = logLuma;
+        }
+
+        glm::vec3 sky(int x, int y) const {
+            if (!setup.sky) {
+                return setup.clearColor;
+            }
+            glm::vec4 ndc((x + 0.5f) / width * 2.0f - 1.0f, 1.0f - (y + 0.5f) / height * 2.0f, 1.0f, 1.0f);
+            glm::vec4 view = setup.inverseProjection * ndc;
+            return setup.sky->Sample(setup.inverseViewRotation * (glm::vec3(view) / view.w));
+        }
+
+        static glm::vec3 sampleRgb(const SoftTexture* texture, glm::vec2 uv, glm::vec2 dx, glm::vec2 dy) {
+            if (!texture) {
+                return glm::vec3(0.0f);
+            }
+            return glm::vec3(texture->Sample(uv, texture->Lod(dx, dy)));
+        }
+
+        glm::vec3 shade(const Material& material, const Attributes& in, glm::vec2 dx, glm::vec2 dy, int x, int y) const {
+            glm::vec3 diffuse = sampleRgb(material.diffuse, in.uv, dx, dy);
+            switch (material.shading) {
+                case Shading::Grass:
+                    return diffuse;
+                case Shading::Moon:
+                    return diffuse * (setup.day ? glm::vec3(13.0f, 12.0f, 10.0f) : glm::vec3(5.0f, 5.0f, 8.0f));
+                default:
+                    break;
+            }
+            glm::vec3 specular = sampleRgb(material.specular, in.uv, dx, dy);
+            glm::vec3 normal = glm::normalize(in.normal);
+            glm::vec3 viewDir = glm::normalize(setup.viewPosition - in.position);
+            bool dam = material.shading == Shading::Dam;
+
+            DirLight sun = dam ? DirLight::Dam(setup.day) : DirLight::Boxes(setup.day);
+            glm::vec3 lightDir = glm::normalize(-setup.sunDirection);
+            glm::vec3 result = diffuse * sun.ambient + sun.diffuse * std::max(glm::dot(normal, lightDir), 0.0f) * diffuse +
+                               sun.specular * blinnPhong(normal, lightDir, viewDir) * specular;
+
+            if (dam && !setup.day) {
+                result += pointLights(in.position, normal, viewDir, diffuse, specular, x, y);
+            }
+            if (setup.spotlight) {
+                result += spotlight(in.position, normal, viewDir, diffuse, specular);
+            }
+            return result;
+        }
+
+        static float blinnPhong(const glm::vec3& normal, const glm::vec3& lightDir, const glm::vec3& viewDir) {
+            glm::vec3 halfway = glm::normalize(lightDir + viewDir);
+            return std::pow(std::max(glm::dot(normal, halfway), 0.0f), 128.0f);
+        }
+
+        // the lights of the cluster the pixel falls in, as the fragment shader finds them
+        glm::vec3 pointLights(const glm::vec3& position, const glm::vec3& normal, const glm::vec3& viewDir,
+                              const glm::vec3& diffuse, const glm::vec3& specular, int x, int y) const {
+            const ClusterLists& clusters = *setup.clusters;
+            if (clusters.ranges.empty()) {
+                return glm::vec3(0.0f);
+            }
+            float depth = std::max(-(setup.view * glm::vec4(position, 1.0f)).z, 0.0001f);
+            // gl_FragCoord counts rows from the bottom
+            int cx = (int)((x + 0.5f) * setup.clusterTileScale.x);
+            int cy = (int)((height - y - 0.5f) * setup.clusterTileScale.y);
+            int cz = (int)std::floor(std::log(depth) * clusters.sliceScale + clusters.sliceBias);
+            cx = std::min(std::max(cx, 0), LightClusters::TilesX - 1);
+            cy = std::min(std::max(cy, 0), LightClusters::TilesY - 1);
+            cz = std::min(std::max(cz, 0), LightClusters::Slices - 1);
+            size_t cluster = (size_t)cx + LightClusters::TilesX * ((size_t)cy + LightClusters::TilesY * (size_t)cz);
+            uint32_t offset = clusters.ranges[2 * cluster], count = clusters.ranges[2 * cluster + 1];
+
+            glm::vec3 result(0.0f);
+            for (uint32_t i = 0; i < count; i++) {
+                const PointLight& light = (*setup.pointLights)[clusters.indices[offset + i]];
+                glm::vec3 lightDir = glm::normalize(light.position - position);
+                float d = glm::length(light.position - position);
+                float attenuation = 1.0f / (light.constant + light.linear * d + light.quadratic * d * d);
+                result += (diffuse * light.ambient + light.diffuse * std::max(glm::dot(normal, lightDir), 0.0f) * diffuse +
+                           light.specular * blinnPhong(normal, lightDir, viewDir) * specular) * attenuation;
+            }
+            return result;
+        }
+
+        // Renderer::setSpotlight's flashlight; its ambient is zero
+        glm::vec3 spotlight(const glm::vec3& position, const glm::vec3& normal, const glm::vec3& viewDir,
+                            const glm::vec3& diffuse, const glm::vec3& specular) const {
+            const float cutOff = std::cos(glm::radians(12.5f)), outerCutOff = std::cos(glm::radians(17.5f));
+            glm::vec3 lightDir = glm::normalize(setup.viewPosition - position);
+            float d = glm::length(setup.viewPosition - position);
+            float attenuation = 1.0f / (1.0f + 0.014f * d + 0.0007f * d * d);
+            float theta = glm::dot(lightDir, glm::normalize(-setup.cameraFront));
+            float intensity = std::min(std::max((theta - outerCutOff) / (cutOff - outerCutOff), 0.0f), 1.0f);
+            return (glm::vec3(0.5f, 0.5f, 0.8f) * std::max(glm::dot(normal, lightDir), 0.0f) * diffuse +
+                    glm::vec3(0.3f, 0.5f, 0.9f) * blinnPhong(normal, lightDir, viewDir) * specular) * intensity * attenuation;
+        }
+
+        // 4. exposure and gamma as the composite pass applies them. Auto exposure uses this
+        // frame's geometric mean luminance right away, there is no adaptation over frames
+        Image resolve(const FramePacket& frame, JobSystem& jobs) {
+            float exposure = frame.exposure;
+            if (frame.autoExposure) {
+                double logSum = 0.0;
+                for (double value : tileLogLuma) {
+                    logSum += value;
+                }
+                float average = (float)std::exp(logSum / ((double)width * height));
+                const ExposureSettings& settings = frame.exposureSettings;
+                exposure = std::min(std::max(settings.key / std::max(average, 0.0001f), settings.minExposure), settings.maxExposure);
+            }
+            Image image(width, height);
+            jobs.ParallelFor((size_t)height, 16, [this, &image, exposure](size_t begin, size_t end) {
+                for (size_t y = begin; y < end; y++) {
+                    for (int x = 0; x < width; x++) {
+                        size_t index = y * width + x;
+                        glm::vec3 color = hdr[index];
+                        for (int c = 0; c < 3; c++) {
+                            float mapped = std::pow(1.0f - std::exp(-color[c] * exposure), 1.0f / 2.2f);
+                            image.rgb[index * 3 + c] = (uint8_t)std::lround(std::min(std::max(mapped, 0.0f), 1.0f) * 255.0f);
+                        }
+                    }
+                }
+            });
+            return image;
+        }
+    };
+
+};
+
+#endif //PROJECT_BASE_SOFTRENDERER_H
@@ -0,0 +1,232 @@
+#ifndef PROJECT_BASE_SOFTTEXTURE_H
+#define PROJECT_BASE_SOFTTEXTURE_H
+
+#include <glm/glm.hpp>
+#include <stb_image.h>
+
+#include <common.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+    // 8-bit texture sampled on the CPU the way the GL path samples its counterpart: sRGB or
+    // linear, repeat or clamp to edge, bilinear, and trilinear over a box filtered mip chain
+    // when the GL texture has mipmaps. Texels stay 8-bit RGBA and are decoded through a table
+    // per lookup, four bytes per texel instead of sixteen.
+    class SoftTexture {
+    public:
+        bool srgb = false;
+        bool repeat = true;
+        bool mipmapped = true;
+
+        bool Load(const std::string& path) {
+            int width, height, channels;
+            unsigned char* data = loadImageFile(path, &width, &height, &channels);
+            if (!data) {
+                levels.clear();
+                return false;
+            }
+            Create(width, height, channels, data);
+            stbi_image_free(data);
+            return true;
+        }
+
+        // pixels as stbi returns them, top row first like a GL upload
+        void Create(int width, int height, int channels, const unsigned char* pixels) {
+            levels.assign(1, Level());
+            Level& base = levels[0];
+            base.width = width;
+            base.height = height;
+            base.texels.resize((size_t)width * height * 4);
+            for (size_t i = 0; i < (size_t)width * height; i++) {
+                const unsigned char* in = pixels + i * channels;
+                unsigned char* out = &base.texels[i * 4];
+                // GL expands one channel textures to (r, 0, 0, 1)
+                out[0] = in[0];
+                out[1] = channels >= 3 ? in[1] : 0;
+                out[2] = channels >= 3 ? in[2] : 0;
+                out[3] = channels == 4 ? in[3] : 255;
+            }
+            while (mipmapped && (levels.back().width > 1 || levels.back().height > 1)) {
+                levels.push_back(downsample(levels.back()));
+            }
+        }
+
+        bool Empty() const {
+            return levels.empty();
+        }
+
+        int Width() const {
+            return levels.empty() ? 0 : levels[0].width;
+        }
+
+        int Height() const {
+            return levels.empty() ? 0 : levels[0].height;
+        }
+
+        // mip level for the texture coordinate derivatives along screen x and y, as GL picks it
+        float Lod(glm::vec2 dx, glm::vec2 dy) const {
+            if (levels.size() < 2) {
+                return 0.0f;
+            }
+            float sx = dx.x * Width(), sy = dx.y * Height();
+            float tx = dy.x * Width(), ty = dy.y * Height();
+            float rho = std::max(sx * sx + sy * sy, tx * tx + ty * ty);
+            return rho > 0.0f ? 0.5f * std::log2(rho) : 0.0f;
+        }
+
+        // linear RGBA
+        glm::vec4 Sample(glm::vec2 uv, float lod = 0.0f) const {
+            if (levels.empty()) {
+                return glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+            }
+            if (lod <= 0.0f || levels.size() < 2) {
+                return bilinear(levels[0], uv);
+            }
+            float last = (float)(levels.size() - 1);
+            lod = std::min(lod, last);
+            int level = (int)lod;
+            float t = lod - (float)level;
+            glm::vec4 fine = bilinear(levels[level], uv);
+            if (t <= 0.0f || level + 1 > (int)last) {
+                return fine;
+            }
+            return fine + (bilinear(levels[level + 1], uv) - fine) * t;
+        }
+
+    private:
+        struct Level {
+            int width = 0, height = 0;
+            std::vector<unsigned char> texels; // RGBA
+        };
+
+        std::vector<Level> levels;
+
+        static const float* srgbTable() {
+            static const std::vector<float> table = []() {
+                std::vector<float> values(256);
+                for (int i = 0; i < 256; i++) {
+                    float c = i / 255.0f;
+                    values[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+                }
+                return values;
+            }();
+            return table.data();
+        }
+
+        static unsigned char encodeSrgb(float c) {
+            c = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+            return (unsigned char)std::lround(std::min(std::max(c, 0.0f), 1.0f) * 255.0f);
+        }
+
+        glm::vec4 texel(const Level& level, int x, int y) const {
+            if (repeat) {
+                x = ((x % level.width) + level.width) % level.width;
+                y = ((y % level.height) + level.height) % level.height;
+            } else {
+                x = std::min(std::max(x, 0), level.width - 1);
+                y = std::min(std::max(y, 0), level.height - 1);
+            }
+            const unsigned char* t = &level.texels[((size_t)y * level.width + x) * 4];
+            if (srgb) {
+                const float* table = srgbTable();
+                return glm::vec4(table[t[0]], table[t[1]], table[t[2]], t[3] / 255.0f);
+            }
+            return glm::vec4(t[0], t[1], t[2], t[3]) * (1.0f / 255.0f);
+        }
+
+        glm::vec4 bilinear(const Level& level, glm::vec2 uv) const {
+            float x = uv.x * level.width - 0.5f;
+            float y = uv.y * level.height - 0.5f;
+            float fx = std::floor(x), fy = std::floor(y);
+            int x0 = (int)fx, y0 = (int)fy;
+            float tx = x - fx, ty = y - fy;
+            glm::vec4 top = texel(level, x0, y0) * (1.0f - tx) + texel(level, x0 + 1, y0) * tx;
+            glm::vec4 bottom = texel(level, x0, y0 + 1) * (1.0f - tx) + texel(level, x0 + 1, y0 + 1) * tx;
+            return top * (1.0f - ty) + bottom * ty;
+        }
+
+        // 2x2 box, averaged in linear space for sRGB textures; odd edges repeat their last texel
+        Level downsample(const Level& source) const {
+            Level level;
+            level.width = std::max(1, source.width / 2);
+            level.height = std::max(1, source.height / 2);
+            level.texels.resize((size_t)level.width * level.height * 4);
+            const float* table = srgbTable();
+            for (int y = 0; y < level.height; y++) {
+                for (int x = 0; x < level.width; x++) {
+                    float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+                    for (int i = 0; i < 4; i++) {
+                        int sx = std::min(2 * x + (i & 1), source.width - 1);
+                        int sy = std::min(2 * y + (i >> 1), source.height - 1);
+                        const unsigned char* t = &source.texels[((size_t)sy * source.width + sx) * 4];
+                        for (int c = 0; c < 4; c++) {
+                            sum[c] += srgb && c < 3 ? table[t[c]] : t[c] / 255.0f;
+                        }
+                    }
+                    unsigned char* out = &level.texels[((size_t)y * level.width + x) * 4];
+                    for (int c = 0; c < 4; c++) {
+                        float value = sum[c] * 0.25f;
+                        out[c] = srgb && c < 3 ? encodeSrgb(value) : (unsigned char)std::lround(value * 255.0f);
+                    }
+                }
+            }
+            return level;
+        }
+    };
+
+    // six SoftTextures addressed like a GL cubemap, faces in +x, -x, +y, -y, +z, -z order
+    class SoftCubemap {
+    public:
+        bool Load(const std::vector<std::string>& paths) {
+            bool loaded = paths.size() == 6;
+            for (size_t i = 0; i < 6 && loaded; i++) {
+                faces[i].srgb = true;
+                faces[i].repeat = false;
+                faces[i].mipmapped = false;
+                loaded = faces[i].Load(paths[i]);
+            }
+            return loaded;
+        }
+
+        // face selection and face coordinates from the GL spec's major axis table; no filtering
+        // across face edges
+        glm::vec3 Sample(const glm::vec3& direction) const {
+            glm::vec3 a = glm::abs(direction);
+            int face;
+            float sc, tc, ma;
+            if (a.x >= a.y && a.x >= a.z) {
+                face = direction.x > 0.0f ? 0 : 1;
+                sc = direction.x > 0.0f ? -direction.z : direction.z;
+                tc = -direction.y;
+                ma = a.x;
+            } else if (a.y >= a.z) {
+                face = direction.y > 0.0f ? 2 : 3;
+                sc = direction.x;
+                tc = direction.y > 0.0f ? direction.z : -direction.z;
+                ma = a.y;
+            } else {
+                face = direction.z > 0.0f ? 4 : 5;
+                sc = direction.z > 0.0f ? direction.x : -direction.x;
+                tc = -direction.y;
+                ma = a.z;
+            }
+            if (ma <= 0.0f) {
+                return glm::vec3(0.0f);
+            }
+            glm::vec2 uv((sc / ma + 1.0f) * 0.5f, (tc / ma + 1.0f) * 0.5f);
+            return glm::vec3(faces[face].Sample(uv));
+        }
+
+    private:
+        SoftTexture faces[6];
+    };
+
+};
+
+#endif //PROJECT_BASE_SOFTTEXTURE_H
@@ -0,0 +1,76 @@
+#ifndef PROJECT_BASE_SPSCQUEUE_H
+#define PROJECT_BASE_SPSCQUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+
+namespace rg {
+
+    // Bounded single-producer single-consumer ring. Exactly one thread may push and exactly one
+    // other thread may pop; neither side ever takes a lock. Capacity must be a power of two.
+    template<typename T, size_t Capacity>
+    class SpscQueue {
+        static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+    public:
+        // producer side, false when the queue is full
+        bool TryPush(const T& value) {
+            size_t tail = tailIndex.load(std::memory_order_relaxed);
+            if (tail - headIndex.load(std::memory_order_acquire) == Capacity) {
+                return false;
+            }
+            items[tail & (Capacity - 1)] = value;
+            tailIndex.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // consumer side, false when the queue is empty
+        bool TryPop(T& value) {
+            size_t head = headIndex.load(std::memory_order_relaxed);
+            if (head == tailIndex.load(std::memory_order_acquire)) {
+                return false;
+            }
+            value = items[head & (Capacity - 1)];
+            headIndex.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        // only a hint when read from a thread that is neither the producer nor the consumer
+        size_t Size() const {
+            return tailIndex.load(std::memory_order_acquire) - headIndex.load(std::memory_order_acquire);
+        }
+
+    private:
+        T items[Capacity];
+        // kept on separate cache lines so the two sides do not invalidate each other on every call
+        alignas(64) std::atomic<size_t> headIndex{0};
+        alignas(64) std::atomic<size_t> tailIndex{0};
+    };
+
+    // Waiting strategy for polling a lock-free queue: spin a little, then yield, then sleep in
+    // short steps so an idle side does not keep a core busy.
+    class Backoff {
+    public:
+        void Pause() {
+            if (spins < 16) {
+                ++spins;
+            } else if (spins < 64) {
+                ++spins;
+                std::this_thread::yield();
+            } else {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+        }
+
+        void Reset() {
+            spins = 0;
+        }
+
+    private:
+        int spins = 0;
+    };
+
+};
+
+#endif //PROJECT_BASE_SPSCQUEUE_H
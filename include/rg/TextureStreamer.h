@@ -0,0 +1,364 @@
+#ifndef PROJECT_BASE_TEXTURESTREAMER_H
+#define PROJECT_BASE_TEXTURESTREAMER_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <common.h>
+#include <rg/Error.h>
+#include <rg/Profiler.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace rg {
+
+    // how finely a texture is seen this frame: texels per UV unit it takes to get one texel per
+    // pixel, per pixel of render target height (the renderer scales it by its height)
+    struct TextureDemand {
+        unsigned int texture = 0;
+        float density = 0.0f;
+    };
+
+    // Mip streaming for textures loaded from image files. Each texture keeps its small mips (up
+    // to FloorSize) resident from the start; larger ones are loaded when the demands of a frame
+    // ask for them and dropped again when they don't, within budgetBytes. The sampled range is
+    // clamped with GL_TEXTURE_BASE_LEVEL and dropped levels are respecified empty, so their
+    // memory goes back to the driver while the texture object, and every mesh holding its id,
+    // stays the same.
+    //
+    // Image files can't be read at a lower resolution, so streaming a texture in decodes it
+    // again and filters it down on a background thread, one texture at a time; the decoded
+    // pixels are freed as soon as the levels are uploaded.
+    class TextureStreamer {
+    public:
+        static const int FloorSize = 256; // mips of at most this size are always resident
+
+        size_t budgetBytes = 64u << 20;   // for every level above the floor, of all textures
+        float bias = 0.0f;                // added to the wanted mip, positive is blurrier
+
+        TextureStreamer() = default;
+        TextureStreamer(const TextureStreamer&) = delete;
+        TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+        ~TextureStreamer() {
+            if (loader.joinable()) {
+                loader.join();
+            }
+        }
+
+        // decodes the file once and uploads the floor mips; returns the GL texture, or an empty
+        // one (like TextureFromFile) when the file can't be read
+        unsigned int Load(const std::string& path) {
+            RG_PROFILE_SCOPE("TextureStreamer::Load");
+            std::unique_ptr<Streamed> texture(new Streamed);
+            texture->path = path;
+            glGenTextures(1, &texture->id);
+            Levels levels;
+            if (!decode(path, 0, *texture, levels, true)) {
+                std::cout << "Texture failed to load at path: " << path << std::endl;
+                return texture->id;
+            }
+            texture->residentBase = texture->floorBase;
+            texture->target = texture->floorBase;
+            glBindTexture(GL_TEXTURE_2D, texture->id);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, texture->levelCount - 1);
+            upload(*texture, levels);
+            glBindTexture(GL_TEXTURE_2D, 0);
+            unsigned int id = texture->id;
+            byId[id] = textures.size();
+            textures.push_back(std::move(texture));
+            return id;
+        }
+
+        // GL thread, once per frame: picks the mips to keep from the demands under the budget,
+        // drops what is no longer wanted, uploads a finished load and starts the next one.
+        // renderHeight converts the demand densities into texels
+        void Update(const std::vector<TextureDemand>& demands, int renderHeight) {
+            RG_PROFILE_SCOPE("TextureStreamer::Update");
+            for (std::unique_ptr<Streamed>& texture : textures) {
+                texture->wanted = texture->floorBase;
+            }
+            for (const TextureDemand& demand : demands) {
+                auto found = byId.find(demand.texture);
+                if (found == byId.end() || demand.density <= 0.0f) {
+                    continue;
+                }
+                Streamed& texture = *textures[found->second];
+                float texels = demand.density * renderHeight;
+                float mip = std::log2((float)std::max(texture.width, texture.height) / texels) + bias;
+                int level = std::max(0, std::min(texture.floorBase, (int)std::floor(mip)));
+                texture.wanted = std::min(texture.wanted, level);
+            }
+
+            // under the budget: coarsen whichever texture costs the most at its target until it fits
+            size_t total = 0;
+            for (std::unique_ptr<Streamed>& texture : textures) {
+                texture->target = texture->wanted;
+                total += streamedBytes(*texture, texture->target);
+            }
+            while (total > budgetBytes) {
+                Streamed* largest = nullptr;
+                for (std::unique_ptr<Streamed>& texture : textures) {
+                    if (texture->target < texture->floorBase &&
+                        (!largest || levelBytes(*texture, texture->target) > levelBytes(*largest, largest->target))) {
+                        largest = texture.get();
+                    }
+                }
+                if (!largest) {
+                    break;
+                }
+                total -= levelBytes(*largest, largest->target);
+                largest->target++;
+            }
+
+            for (std::unique_ptr<Streamed>& texture : textures) {
+                if (texture->residentBase < texture->target) {
+                    evict(*texture, texture->target);
+                }
+            }
+
+            if (loading && loadDone.load()) {
+                loader.join();
+                Streamed& texture = *loading;
+                bool decoded = !loadedLevels.empty();
+                // the target may have moved while it loaded, only take what is still wanted
+                while (!loadedLevels.empty() && loadedFirst < texture.target) {
+                    loadedLevels.erase(loadedLevels.begin());
+                    loadedFirst++;
+                }
+                if (!decoded) {
+                    // the file went away since Load(), leave the texture at what it has
+                    std::cout << "Texture failed to stream in from " << texture.path << std::endl;
+                    texture.failed = true;
+                } else if (!loadedLevels.empty() && loadedFirst < texture.residentBase) {
+                    loadedLevels.resize(texture.residentBase - loadedFirst);
+                    glBindTexture(GL_TEXTURE_2D, texture.id);
+                    upload(texture, loadedLevels, loadedFirst);
+                    glBindTexture(GL_TEXTURE_2D, 0);
+                }
+                loadedLevels.clear();
+                loading = nullptr;
+                streamIns.fetch_add(1, std::memory_order_relaxed);
+            }
+            if (!loading) {
+                // the texture furthest from its target first
+                Streamed* next = nullptr;
+                for (std::unique_ptr<Streamed>& texture : textures) {
+                    if (texture->target < texture->residentBase && !texture->failed &&
+                        (!next || texture->residentBase - texture->target > next->residentBase - next->target)) {
+                        next = texture.get();
+                    }
+                }
+                if (next) {
+                    startLoad(*next);
+                }
+            }
+            residentBytes.store(total, std::memory_order_relaxed);
+            streamedResident.store(currentBytes(), std::memory_order_relaxed);
+        }
+
+        // GL thread: Update, then waits for every load it starts until each texture sits at its
+        // target, so what is resident stops depending on how fast the loader thread was. For the
+        // regress and bench tools; the demo streams in the background
+        void Flush(const std::vector<TextureDemand>& demands, int renderHeight) {
+            RG_PROFILE_SCOPE("TextureStreamer::Flush");
+            Update(demands, renderHeight);
+            while (loading) {
+                while (!loadDone.load()) {
+                    std::this_thread::yield();
+                }
+                Update(demands, renderHeight);
+            }
+        }
+
+        // memory of the levels above the floor: wanted within the budget, and resident right now;
+        // callable from any thread
+        size_t TargetBytes() const {
+            return residentBytes.load(std::memory_order_relaxed);
+        }
+
+        size_t ResidentBytes() const {
+            return streamedResident.load(std::memory_order_relaxed);
+        }
+
+        int StreamIns() const {
+            return streamIns.load(std::memory_order_relaxed);
+        }
+
+        int Evictions() const {
+            return evictions.load(std::memory_order_relaxed);
+        }
+
+    private:
+        typedef std::vector<std::vector<unsigned char>> Levels;
+
+        struct Streamed {
+            std::string path;
+            unsigned int id = 0;
+            int width = 0, height = 0, channels = 0;
+            int levelCount = 1;
+            int floorBase = 0;    // first level of at most FloorSize
+            int residentBase = 0; // finest level uploaded
+            int wanted = 0;       // finest level the demands ask for
+            int target = 0;       // wanted, coarsened to fit the budget
+            bool failed = false;  // streaming in failed, don't retry
+        };
+
+        std::vector<std::unique_ptr<Streamed>> textures;
+        std::unordered_map<unsigned int, size_t> byId;
+
+        std::thread loader;
+        Streamed* loading = nullptr;
+        std::atomic<bool> loadDone{false};
+        Levels loadedLevels;
+        int loadedFirst = 0;
+
+        std::atomic<size_t> residentBytes{0};
+        std::atomic<size_t> streamedResident{0};
+        std::atomic<int> streamIns{0};
+        std::atomic<int> evictions{0};
+
+        static int levelWidth(const Streamed& texture, int level) {
+            return std::max(1, texture.width >> level);
+        }
+
+        static int levelHeight(const Streamed& texture, int level) {
+            return std::max(1, texture.height >> level);
+        }
+
+        // drivers pad RGB to four bytes per texel
+        static size_t levelBytes(const Streamed& texture, int level) {
+            return (size_t)levelWidth(texture, level) * levelHeight(texture, level) * (texture.channels == 3 ? 4 : texture.channels);
+        }
+
+        // bytes of the levels from base up to the floor
+        static size_t streamedBytes(const Streamed& texture, int base) {
+            size_t bytes = 0;
+            for (int level = base; level < texture.floorBase; level++) {
+                bytes += levelBytes(texture, level);
+            }
+            return bytes;
+        }
+
+        size_t currentBytes() const {
+            size_t bytes = 0;
+            for (const std::unique_ptr<Streamed>& texture : textures) {
+                bytes += streamedBytes(*texture, texture->residentBase);
+            }
+            return bytes;
+        }
+
+        // decodes the file and box filters it down, keeping the levels from first on (the whole
+        // chain when first is 0); setup also fills in the size and level counts
+        static bool decode(const std::string& path, int first, Streamed& texture, Levels& levels, bool setup) {
+            int width, height, channels;
+            unsigned char* data = loadImageFile(path, &width, &height, &channels);
+            if (!data) {
+                return false;
+            }
+            if (setup) {
+                texture.width = width;
+                texture.height = height;
+                texture.channels = channels;
+                texture.levelCount = 1 + (int)std::floor(std::log2((float)std::max(width, height)));
+                texture.floorBase = 0;
+                while (std::max(levelWidth(texture, texture.floorBase), levelHeight(texture, texture.floorBase)) > FloorSize) {
+                    texture.floorBase++;
+                }
+                first = texture.floorBase;
+            }
+            int last = setup ? texture.levelCount : texture.residentBase;
+            std::vector<unsigned char> current(data, data + (size_t)width * height * channels);
+            stbi_image_free(data);
+            levels.clear();
+            for (int level = 0; level < last; level++) {
+                if (level >= first) {
+                    levels.push_back(current);
+                }
+                if (level + 1 < last) {
+                    current = downsample(current, levelWidth(texture, level), levelHeight(texture, level), channels);
+                }
+            }
+            return true;
+        }
+
+        // 2x2 box filter; odd sizes repeat their last row or column
+        static std::vector<unsigned char> downsample(const std::vector<unsigned char>& source, int width, int height, int channels) {
+            int outWidth = std::max(1, width / 2), outHeight = std::max(1, height / 2);
+            std::vector<unsigned char> out((size_t)outWidth * outHeight * channels);
+            for (int y = 0; y < outHeight; y++) {
+                int y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+                for (int x = 0; x < outWidth; x++) {
+                    int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+                    for (int c = 0; c < channels; c++) {
+                        int sum = source[((size_t)y0 * width + x0) * channels + c] + source[((size_t)y0 * width + x1) * channels + c] +
+                                  source[((size_t)y1 * width + x0) * channels + c] + source[((size_t)y1 * width + x1) * channels + c];
+                        out[((size_t)y * outWidth + x) * channels + c] = (unsigned char)((sum + 2) / 4);
+                    }
+                }
+            }
+            return out;
+        }
+
+        static GLenum format(const Streamed& texture) {
+            return texture.channels == 1 ? GL_RED : texture.channels == 2 ? GL_RG : texture.channels == 3 ? GL_RGB : GL_RGBA;
+        }
+
+        // uploads levels starting at first (the floor when not given) and moves the base level
+        // down to it; the texture must be bound
+        void upload(Streamed& texture, const Levels& levels, int first = -1) {
+            first = first < 0 ? texture.floorBase : first;
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            for (size_t i = 0; i < levels.size(); i++) {
+                int level = first + (int)i;
+                GLCALL(glTexImage2D(GL_TEXTURE_2D, level, format(texture), levelWidth(texture, level), levelHeight(texture, level), 0,
+                                    format(texture), GL_UNSIGNED_BYTE, levels[i].data()));
+            }
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            texture.residentBase = std::min(texture.residentBase, first);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, texture.residentBase);
+        }
+
+        // raises the base level first so the texture stays complete, then frees the levels below it
+        void evict(Streamed& texture, int base) {
+            glBindTexture(GL_TEXTURE_2D, texture.id);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, base);
+            for (int level = texture.residentBase; level < base; level++) {
+                GLCALL(glTexImage2D(GL_TEXTURE_2D, level, format(texture), 0, 0, 0, format(texture), GL_UNSIGNED_BYTE, NULL));
+            }
+            glBindTexture(GL_TEXTURE_2D, 0);
+            texture.residentBase = base;
+            evictions.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void startLoad(Streamed& texture) {
+            loading = &texture;
+            loadDone.store(false);
+            loadedFirst = texture.target;
+            // the thread only touches its own output and the texture's fixed fields
+            Streamed snapshot = texture;
+            loader = std::thread([this, snapshot]() mutable {
+                if (!decode(snapshot.path, loadedFirst, snapshot, loadedLevels, false)) {
+                    loadedLevels.clear();
+                }
+                loadDone.store(true);
+            });
+        }
+    };
+
+};
+
+#endif //PROJECT_BASE_TEXTURESTREAMER_H
@@ -0,0 +1,323 @@
+#ifndef PROJECT_BASE_WORLD_H
+#define PROJECT_BASE_WORLD_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/model.h>
+#include <rg/JobSystem.h>
+#include <rg/LightClusters.h>
+#include <rg/Occlusion.h>
+#include <rg/Renderer.h>
+#include <rg/Scene.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace rg {
+
+    // The demo scene on the CPU side: entity placement, occluders and the per-frame task graph
+    // (transforms, occlusion, culling, sorting, lights). Shared by the interactive app and the
+    // tools so they all simulate exactly the same scene. Needs the models for bounds and
+    // occluder geometry, but never touches GL.
+    class World {
+    public:
+        SceneStore scene;
+        Entity dam = 0;
+        OcclusionCuller culler;
+        LightClusters lightClusters;
+        uint64_t staticVersion = 1; // bumped whenever static shadow casters (the dam) move
+
+        // inputs of the next Update()
+        glm::vec3 damPosition = glm::vec3(0.0f);
+        float damScale = 1.0f;
+        bool occlusionCulling = true;
+        int extraLights = 0; // generated point lights on top of the scene's, for testing the clustering
+        glm::mat4 projection = glm::mat4(1.0f);
+        glm::mat4 view = glm::mat4(1.0f);
+        glm::vec3 eye = glm::vec3(0.0f);
+
+        World(Model& damModel, const Model& moonModel) : damModel(damModel), moonModel(moonModel) {
+            dam = scene.Create(RenderKind::Dam, ModelBounds(damModel));
+            damDensities = texelDensities(damModel);
+            moonDensities = texelDensities(moonModel);
+
+            glm::vec3 pointLightPositions[] = {
+                    glm::vec3( -35.0f,  10.0f,  2.0f),
+                    glm::vec3( -15.0f, 10.0f, 2.0f),
+                    glm::vec3(10.0f, 10.0f, 2.0f),
+                    glm::vec3( 35.0f,  10.0f, 2.0f),
+            };
+            for (const glm::vec3& position : pointLightPositions) {
+                Entity light = scene.Create(RenderKind::PointLight);
+                scene.SetPosition(light, position);
+            }
+
+            glm::vec3 vegetationPositions[] = {
+                    glm::vec3(-15.0f, 1.0f, 24.0f),
+                    glm::vec3(-17.0f, 1.0f, 24.0f),
+                    glm::vec3(-20.0f, 0.5f, 24.0f),
+                    glm::vec3(-22.0f, 0.0f, 24.0f),
+            };
+            AABB grassBounds;
+            grassBounds.min = glm::vec3(0.0f, -0.5f, -0.01f);
+            grassBounds.max = glm::vec3(1.0f, 0.5f, 0.01f);
+            for (const glm::vec3& position : vegetationPositions) {
+                Entity grass = scene.Create(RenderKind::Grass, grassBounds);
+                scene.SetPosition(grass, position);
+                scene.SetScale(grass, glm::vec3(5.0f, 5.0f, 1.0f));
+            }
+
+            glm::vec3 boxPositions[] = {
+                    glm::vec3(-15.0f, 7.0f, -9.0f),
+                    glm::vec3(-14.3f, 8.0f, -9.0f),
+                    glm::vec3(-13.85f, 7.0f, -9.0f),
+            };
+            float boxAngles[] = { 0.0f, 15.0f, -10.0f };
+            AABB boxBounds;
+            boxBounds.min = glm::vec3(-0.5f);
+            boxBounds.max = glm::vec3(0.5f);
+            for (int i = 0; i < 3; i++) {
+                Entity box = scene.Create(RenderKind::Box, boxBounds);
+                scene.SetPosition(box, boxPositions[i]);
+                scene.SetRotation(box, glm::radians(boxAngles[i]), glm::vec3(0.0f, 1.0f, 0.0f));
+            }
+
+            Entity moon = scene.Create(RenderKind::Moon, ModelBounds(moonModel));
+            scene.SetPosition(moon, glm::vec3(3.0f, 65.0f, 70.0f));
+            scene.SetRotation(moon, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+            scene.SetScale(moon, glm::vec3(2.0f));
+
+            // the dam is the only large occluder and its meshes are small enough to rasterize as they are
+            for (const Mesh& mesh : damModel.meshes) {
+                std::vector<glm::vec3> positions;
+                positions.reserve(mesh.vertices.size());
+                for (const Vertex& vertex : mesh.vertices) {
+                    positions.push_back(vertex.Position);
+                }
+                damOccluders.push_back(culler.AddOccluder(positions, mesh.indices));
+            }
+
+            buildFrameGraph();
+        }
+
+        World(const World&) = delete;
+        World& operator=(const World&) = delete;
+
+        // runs the frame graph; afterwards the visible lists and lights are up to date
+        void Update(JobSystem& jobs) {
+            this->jobs = &jobs;
+            graph.Run(jobs);
+        }
+
+        const std::vector<Entity>& Visible(RenderKind kind) const {
+            return visible[(int)kind];
+        }
+
+        // copies the draw list and light state of the last Update() into a packet
+        void Fill(FramePacket& packet) const {
+            packet.pointLights = lights;
+            packet.lightClusters = lightClusters.Lists();
+            packet.dam = scene.worldMatrices[dam];
+            packet.damNodes = damModel.nodes.world;
+            packet.moonNodes = moonModel.nodes.world;
+            packet.staticVersion = staticVersion;
+            packet.textureDemands = textureDemands;
+            fillMatrices(packet.grass, RenderKind::Grass);
+            fillMatrices(packet.boxes, RenderKind::Box);
+            fillMatrices(packet.moons, RenderKind::Moon);
+            // shadows fall from boxes the camera can't see, so these skip the culling
+            packet.boxCasters.clear();
+            for (Entity e : scene.EntitiesOf(RenderKind::Box)) {
+                packet.boxCasters.push_back(scene.worldMatrices[e]);
+            }
+        }
+
+        // object space bounds of a whole model, node transforms included
+        static AABB ModelBounds(const Model& model) {
+            AABB bounds;
+            bool first = true;
+            for (unsigned int i = 0; i < model.meshes.size(); i++) {
+                const glm::mat4& node = model.nodes.world[model.meshNodes[i]];
+                for (const Vertex& vertex : model.meshes[i].vertices) {
+                    glm::vec3 position = glm::vec3(node * glm::vec4(vertex.Position, 1.0f));
+                    if (first) {
+                        bounds.min = bounds.max = position;
+                        first = false;
+                    }
+                    bounds.min = glm::min(bounds.min, position);
+                    bounds.max = glm::max(bounds.max, position);
+                }
+            }
+            return bounds;
+        }
+
+    private:
+        // what a mesh needs to estimate how finely its textures are seen
+        struct MeshDensity {
+            AABB bounds;             // mesh space
+            float worldPerUv = 0.0f; // mesh space length covered by one UV unit, 0 without UVs
+            std::vector<unsigned int> textures;
+        };
+
+        Model& damModel;
+        const Model& moonModel;
+        std::vector<MeshDensity> damDensities, moonDensities;
+        std::vector<TextureDemand> textureDemands;
+        std::vector<int> damOccluders;
+        std::vector<Entity> visible[(int)RenderKind::Count];
+        std::vector<PointLight> lights;
+        TaskGraph graph;
+        JobSystem* jobs = nullptr;
+        glm::vec3 lastDamPosition = glm::vec3(0.0f);
+        float lastDamScale = 1.0f;
+
+        // small colored lights scattered over the area in front of the dam, the same for a given index
+        static PointLight extraLight(int index) {
+            auto random = [index](uint32_t salt) {
+                uint32_t h = (uint32_t)index * 2654435761u ^ salt * 2246822519u;
+                h ^= h >> 15;
+                h *= 2246822519u;
+                h ^= h >> 13;
+                return (h & 0xffffff) / (float)0x1000000;
+            };
+            PointLight light;
+            light.position = glm::vec3(-45.0f + 90.0f * random(1), 0.5f + 12.0f * random(2), -15.0f + 45.0f * random(3));
+            glm::vec3 color = glm::vec3(0.3f) + 0.7f * glm::vec3(random(4), random(5), random(6));
+            light.ambient = 0.02f * color;
+            light.diffuse = color;
+            light.specular = 0.5f * color;
+            light.linear = 0.35f;
+            light.quadratic = 0.44f;
+            return light;
+        }
+
+        // average ratio of surface area to UV area, per mesh
+        static std::vector<MeshDensity> texelDensities(const Model& model) {
+            std::vector<MeshDensity> densities;
+            for (const Mesh& mesh : model.meshes) {
+                MeshDensity density;
+                double area = 0.0, uvArea = 0.0;
+                for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+                    const Vertex& a = mesh.vertices[mesh.indices[i]];
+                    const Vertex& b = mesh.vertices[mesh.indices[i + 1]];
+                    const Vertex& c = mesh.vertices[mesh.indices[i + 2]];
+                    area += 0.5 * glm::length(glm::cross(b.Position - a.Position, c.Position - a.Position));
+                    glm::vec2 u = b.TexCoords - a.TexCoords, v = c.TexCoords - a.TexCoords;
+                    uvArea += 0.5 * std::abs(u.x * v.y - u.y * v.x);
+                }
+                for (size_t i = 0; i < mesh.vertices.size(); i++) {
+                    const glm::vec3& position = mesh.vertices[i].Position;
+                    density.bounds.min = i == 0 ? position : glm::min(density.bounds.min, position);
+                    density.bounds.max = i == 0 ? position : glm::max(density.bounds.max, position);
+                }
+                density.worldPerUv = uvArea > 0.0 ? (float)std::sqrt(area / uvArea) : 0.0f;
+                for (const Texture& texture : mesh.textures) {
+                    density.textures.push_back(texture.id);
+                }
+                densities.push_back(density);
+            }
+            return densities;
+        }
+
+        // texels per UV unit, per pixel of screen height, at the point of the mesh bounds nearest
+        // the eye; the finest any of the mesh's texels is seen
+        void addDemands(const Model& model, const std::vector<MeshDensity>& densities, const glm::mat4& world,
+                        const std::vector<glm::mat4>& nodeWorld) {
+            for (size_t i = 0; i < densities.size(); i++) {
+                const MeshDensity& density = densities[i];
+                if (density.worldPerUv <= 0.0f) {
+                    continue;
+                }
+                glm::mat4 transform = world * nodeWorld[model.meshNodes[i]];
+                AABB bounds = TransformBounds(density.bounds, transform);
+                glm::vec3 nearest = glm::max(bounds.min, glm::min(eye, bounds.max));
+                float distance = std::max(glm::length(eye - nearest), 0.1f);
+                float scale = std::max(glm::length(glm::vec3(transform[0])),
+                                       std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+                float perPixel = density.worldPerUv * scale * projection[1][1] / (2.0f * distance);
+                for (unsigned int texture : density.textures) {
+                    TextureDemand demand;
+                    demand.texture = texture;
+                    demand.density = perPixel;
+                    textureDemands.push_back(demand);
+                }
+            }
+        }
+
+        void fillMatrices(std::vector<glm::mat4>& out, RenderKind kind) const {
+            out.clear();
+            for (Entity e : visible[(int)kind]) {
+                out.push_back(scene.worldMatrices[e]);
+            }
+        }
+
+        // per-frame CPU stages as a task graph, built once and run every frame on the job system;
+        // independent stages run in parallel
+        void buildFrameGraph() {
+            TaskGraph::Task updateTransforms = graph.Add("transforms", [this]() {
+                // only entities whose transform changed since the last frame get recomputed
+                if (damPosition != lastDamPosition || damScale != lastDamScale) {
+                    lastDamPosition = damPosition;
+                    lastDamScale = damScale;
+                    staticVersion++;
+                }
+                scene.SetPosition(dam, damPosition);
+                scene.SetScale(dam, glm::vec3(damScale));
+                scene.Update();
+                damModel.UpdateNodeTransforms();
+            });
+            TaskGraph::Task occlusion = graph.Add("occlusion", [this]() {
+                // rasterize the occluders and build the depth pyramid before anything is culled
+                for (unsigned int i = 0; i < damOccluders.size(); i++) {
+                    culler.SetOccluderTransform(damOccluders[i], scene.worldMatrices[dam] * damModel.nodes.world[damModel.meshNodes[i]]);
+                }
+                culler.Render(projection * view, *jobs);
+            }, {updateTransforms});
+            auto cull = [this](RenderKind kind) {
+                return [this, kind]() {
+                    std::vector<Entity>& list = visible[(int)kind];
+                    list.clear();
+                    for (Entity e : scene.EntitiesOf(kind)) {
+                        if (!occlusionCulling || culler.IsVisible(scene.worldBounds[e])) {
+                            list.push_back(e);
+                        }
+                    }
+                };
+            };
+            graph.Add("cull grass", cull(RenderKind::Grass), {occlusion});
+            TaskGraph::Task cullMoon = graph.Add("cull moon", cull(RenderKind::Moon), {occlusion});
+            graph.Add("texture demand", [this]() {
+                textureDemands.clear();
+                addDemands(damModel, damDensities, scene.worldMatrices[dam], damModel.nodes.world);
+                for (Entity moon : visible[(int)RenderKind::Moon]) {
+                    addDemands(moonModel, moonDensities, scene.worldMatrices[moon], moonModel.nodes.world);
+                }
+            }, {cullMoon});
+            TaskGraph::Task cullBoxes = graph.Add("cull boxes", cull(RenderKind::Box), {occlusion});
+            graph.Add("sort boxes", [this]() {
+                // front to back, so the depth test rejects hidden box fragments early
+                std::vector<Entity>& boxes = visible[(int)RenderKind::Box];
+                std::sort(boxes.begin(), boxes.end(), [this](Entity a, Entity b) {
+                    return glm::length(scene.Position(a) - eye) < glm::length(scene.Position(b) - eye);
+                });
+            }, {cullBoxes});
+            graph.Add("lights", [this]() {
+                const std::vector<Entity>& pointLights = scene.EntitiesOf(RenderKind::PointLight);
+                lights.resize(pointLights.size() + std::max(0, extraLights));
+                for (unsigned int i = 0; i < pointLights.size(); i++) {
+                    lights[i] = PointLight();
+                    lights[i].position = scene.Position(pointLights[i]);
+                    lights[i].baked = true;
+                }
+                for (int i = 0; i < extraLights; i++) {
+                    lights[pointLights.size() + i] = extraLight(i);
+                }
+                lightClusters.Build(lights, view, projection, *jobs);
+            }, {updateTransforms});
+        }
+    };
+
+};
+
+#endif //PROJECT_BASE_WORLD_H
@@ -1,13 +1,16 @@
 #version 330 core
 
 layout (location = 0) out vec4 FragColor;
-layout (location = 1) out vec4 BrightColor;
 
 struct Material {
-
-    sampler2D diffuse;
-    sampler2D specular;
+    // bound by Mesh::Draw under the names it gives each texture type; the Renderer points the
+    // specular map at a default texture, the dam has none
+    sampler2D texture_diffuse1;
+    sampler2D texture_specular1;
     float shininess;
+    // used by the PBR path
+    sampler2D texture_roughness1;
+    sampler2D texture_metallic1;
 };
 
 struct DirLight {
@@ -27,8 +30,12 @@ struct PointLight {
     vec3 ambient;
     vec3 diffuse;
     vec3 specular;
+    bool baked; // in the lightmap
 };
-#define NR_POINT_LIGHTS 4
+// must match LightClusters
+#define CLUSTER_TILES_X 16
+#define CLUSTER_TILES_Y 9
+#define CLUSTER_SLICES 24
 struct Spotlight {
     vec3 position;
     vec3 direction;
@@ -49,26 +56,83 @@ struct Spotlight {
 in vec3 Normal;
 in vec3 FragPos;
 in vec2 texCoords;
+in vec2 lightmapCoords;
 
 uniform DirLight dirLight;
 uniform Material material;
 uniform vec3 viewPos;
 uniform Spotlight spotlight;
-uniform PointLight pointLights[NR_POINT_LIGHTS];
+uniform samplerBuffer lightData;      // 4 texels per light
+uniform usamplerBuffer clusterRanges; // offset and count into clusterLights, per cluster
+uniform usamplerBuffer clusterLights; // light indices
+uniform vec2 clusterTileScale;        // clusters per pixel
+uniform vec2 clusterSlicing;          // slice = log(view depth) * x + y
+uniform mat4 view;
 uniform bool spotlightOn;
 uniform bool changeTheSetting;
-vec3 calcDirLight(DirLight light, vec3 norm, vec3 viewDir) {
+
+// static light baked offline by project_base_lightbake: the diffuse light of the sun and the
+// baked point lights, direct and bounced, and ambient occlusion
+uniform bool lightmapped;
+uniform sampler2D lightmap;
+uniform sampler2D occlusionMap;
+
+// must match ShadowMaps
+#define SHADOW_CASCADES 3
+uniform sampler2DArrayShadow cascadeShadows;
+uniform mat4 cascadeMatrices[SHADOW_CASCADES];
+uniform bool sunShadows;
+uniform sampler2DShadow spotShadow;
+uniform mat4 spotMatrix;
+uniform bool spotShadows;
+
+// 3x3 taps of hardware compared, bilinear filtered depth
+float sunShadow(vec3 fragPos) {
+    if (!sunShadows)
+        return 1.0;
+    for (int i = 0; i < SHADOW_CASCADES; i++) {
+        vec3 c = (cascadeMatrices[i] * vec4(fragPos, 1.0)).xyz * 0.5 + 0.5;
+        // the first cascade that holds the fragment, with a texel of margin for the filter
+        if (all(greaterThan(c.xy, vec2(0.002))) && all(lessThan(c.xy, vec2(0.998))) && c.z < 1.0) {
+            vec2 texel = 1.0 / vec2(textureSize(cascadeShadows, 0).xy);
+            float lit = 0.0;
+            for (int x = -1; x <= 1; x++)
+                for (int y = -1; y <= 1; y++)
+                    lit += texture(cascadeShadows, vec4(c.xy + vec2(x, y) * texel, float(i), c.z - 0.0005));
+            return lit / 9.0;
+        }
+    }
+    return 1.0;
+}
+
+float spotShadowFactor(vec3 fragPos) {
+    if (!spotShadows)
+        return 1.0;
+    vec4 p = spotMatrix * vec4(fragPos, 1.0);
+    vec3 c = p.xyz / p.w * 0.5 + 0.5;
+    if (p.w <= 0.0 || any(lessThan(c.xy, vec2(0.0))) || any(greaterThan(c.xy, vec2(1.0))) || c.z >= 1.0)
+        return 1.0;
+    return texture(spotShadow, vec3(c.xy, c.z - 0.0002));
+}
+vec3 calcDirLight(DirLight light, vec3 norm, vec3 viewDir, float shadow) {
     vec3 lightDir = normalize(-light.direction);
 
     float diff = max(dot(norm, lightDir), 0.0);
     vec3 halfwayDir = normalize(lightDir + viewDir);
     float spec = pow(max(dot(norm, halfwayDir), 0.0), material.shininess);
 
-    vec3 ambient = texture(material.diffuse, texCoords).rgb * light.ambient;
-    vec3 diffuse = light.diffuse * diff * texture(material.diffuse, texCoords).rgb;
-    vec3 specular = light.specular * spec * texture(material.specular, texCoords).rgb;
+    vec3 ambient = texture(material.texture_diffuse1, texCoords).rgb * light.ambient;
+    vec3 diffuse = light.diffuse * diff * texture(material.texture_diffuse1, texCoords).rgb;
+    vec3 specular = light.specular * spec * texture(material.texture_specular1, texCoords).rgb;
 
-    return (ambient + diffuse + specular);
+    return (ambient + shadow * (diffuse + specular));
+}
+
+// the sun's highlight, the part of it the lightmap doesn't hold
+vec3 calcDirSpecular(DirLight light, vec3 norm, vec3 viewDir, float shadow) {
+    vec3 halfwayDir = normalize(normalize(-light.direction) + viewDir);
+    float spec = pow(max(dot(norm, halfwayDir), 0.0), material.shininess);
+    return shadow * light.specular * spec * texture(material.texture_specular1, texCoords).rgb;
 }
 
 vec3 calcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir) {
@@ -81,9 +145,9 @@ vec3 calcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir) {
     float d = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear*d + light.quadratic*(d*d));
 
-    vec3 ambient = texture(material.diffuse, texCoords).rgb * light.ambient;
-    vec3 diffuse = light.diffuse * diff * texture(material.diffuse, texCoords).rgb;
-    vec3 specular = light.specular * spec * texture(material.specular, texCoords).rgb;
+    vec3 ambient = texture(material.texture_diffuse1, texCoords).rgb * light.ambient;
+    vec3 diffuse = light.diffuse * diff * texture(material.texture_diffuse1, texCoords).rgb;
+    vec3 specular = light.specular * spec * texture(material.texture_specular1, texCoords).rgb;
     ambient *= attenuation;
     diffuse *= attenuation;
     specular *= attenuation;
@@ -91,7 +155,32 @@ vec3 calcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir) {
     return (ambient + diffuse + specular);
 }
 
-vec3 calcSpotlight(Spotlight light, vec3 normal, vec3 fragPos, vec3 viewDir) {
+PointLight fetchLight(int index) {
+    vec4 a = texelFetch(lightData, 4 * index);
+    vec4 b = texelFetch(lightData, 4 * index + 1);
+    vec4 c = texelFetch(lightData, 4 * index + 2);
+    vec4 d = texelFetch(lightData, 4 * index + 3);
+    PointLight light;
+    light.position = a.xyz;
+    light.constant = a.w;
+    light.ambient = b.rgb;
+    light.linear = b.w;
+    light.diffuse = c.rgb;
+    light.quadratic = c.w;
+    light.specular = d.rgb;
+    light.baked = d.w > 0.5;
+    return light;
+}
+
+// the lights of the cluster this fragment falls in
+uvec2 clusterRange() {
+    float depth = max(-(view * vec4(FragPos, 1.0)).z, 0.0001);
+    ivec3 cell = ivec3(ivec2(gl_FragCoord.xy * clusterTileScale), int(floor(log(depth) * clusterSlicing.x + clusterSlicing.y)));
+    cell = clamp(cell, ivec3(0), ivec3(CLUSTER_TILES_X - 1, CLUSTER_TILES_Y - 1, CLUSTER_SLICES - 1));
+    return texelFetch(clusterRanges, cell.x + CLUSTER_TILES_X * (cell.y + CLUSTER_TILES_Y * cell.z)).rg;
+}
+
+vec3 calcSpotlight(Spotlight light, vec3 normal, vec3 fragPos, vec3 viewDir, float shadow) {
 
     vec3 lightDir = normalize(light.position - fragPos);
 
@@ -107,33 +196,130 @@ vec3 calcSpotlight(Spotlight light, vec3 normal, vec3 fragPos, vec3 viewDir) {
     float epsilon = light.cutOff - light.outerCutOff;
     float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
 
-    vec3 diffuse = light.diffuse * diff * texture(material.diffuse, texCoords).rgb;
-    vec3 specular = light.specular * spec * texture(material.specular, texCoords).rgb;
-    vec3 ambient = texture(material.diffuse, texCoords).rgb * light.ambient;
+    vec3 diffuse = light.diffuse * diff * texture(material.texture_diffuse1, texCoords).rgb;
+    vec3 specular = light.specular * spec * texture(material.texture_specular1, texCoords).rgb;
+    vec3 ambient = texture(material.texture_diffuse1, texCoords).rgb * light.ambient;
     diffuse *= intensity * attenuation;
     specular *= intensity* attenuation;
     ambient *= intensity* attenuation ;
-    return (diffuse + specular + ambient);
+    return (shadow * (diffuse + specular) + ambient);
+
+}
+// metallic/roughness path; the ambient term is image based lighting baked offline by
+// project_base_iblbake, so it costs three fetches and no convolution
+uniform bool pbr;
+uniform samplerCube irradianceMap;
+uniform samplerCube prefilteredMap;
+uniform sampler2D brdfLut;
+uniform float prefilteredMaxLod;
+uniform float iblIntensity;
+const float PI = 3.14159265359;
+
+float distributionGGX(float nDotH, float roughness) {
+    float a = roughness * roughness;
+    float a2 = a * a;
+    float d = nDotH * nDotH * (a2 - 1.0) + 1.0;
+    return a2 / (PI * d * d);
+}
+
+float geometrySmith(float nDotV, float nDotL, float roughness) {
+    float r = roughness + 1.0;
+    float k = r * r / 8.0;
+    return nDotV / (nDotV * (1.0 - k) + k) * nDotL / (nDotL * (1.0 - k) + k);
+}
+
+vec3 fresnelSchlick(float cosTheta, vec3 f0) {
+    return f0 + (1.0 - f0) * pow(clamp(1.0 - cosTheta, 0.0, 1.0), 5.0);
+}
+
+vec3 fresnelSchlickRoughness(float cosTheta, vec3 f0, float roughness) {
+    return f0 + (max(vec3(1.0 - roughness), f0) - f0) * pow(clamp(1.0 - cosTheta, 0.0, 1.0), 5.0);
+}
 
+// Cook-Torrance for one light; the Phong diffuse colors are used as radiance over pi, which
+// keeps the Lambert term as bright as before. Without diffuse only the highlight is left, for
+// lights whose diffuse part is in the lightmap
+vec3 pbrLight(vec3 radiance, vec3 lightDir, vec3 normal, vec3 viewDir, vec3 albedo, float metallic, float roughness,
+              bool diffuse) {
+    vec3 halfway = normalize(lightDir + viewDir);
+    float nDotL = max(dot(normal, lightDir), 0.0);
+    float nDotV = max(dot(normal, viewDir), 0.0001);
+    vec3 f0 = mix(vec3(0.04), albedo, metallic);
+    vec3 f = fresnelSchlick(max(dot(halfway, viewDir), 0.0), f0);
+    vec3 specular = distributionGGX(max(dot(normal, halfway), 0.0), roughness) * geometrySmith(nDotV, nDotL, roughness) * f
+                    / (4.0 * nDotV * nDotL + 0.0001);
+    vec3 kD = diffuse ? (1.0 - f) * (1.0 - metallic) : vec3(0.0);
+    return (kD * albedo / PI + specular) * radiance * PI * nDotL;
+}
+
+vec3 pbrShade(vec3 normal, vec3 viewDir) {
+    vec3 albedo = texture(material.texture_diffuse1, texCoords).rgb;
+    float metallic = texture(material.texture_metallic1, texCoords).r;
+    float roughness = clamp(texture(material.texture_roughness1, texCoords).r, 0.04, 1.0);
+
+    // with a lightmap the sun's diffuse light and the baked point lights come from it
+    vec3 result = pbrLight(dirLight.diffuse, normalize(-dirLight.direction), normal, viewDir, albedo, metallic, roughness,
+                           !lightmapped) * sunShadow(FragPos);
+    if (!changeTheSetting) {
+        uvec2 range = clusterRange();
+        for (uint i = 0u; i < range.y; i++) {
+            PointLight light = fetchLight(int(texelFetch(clusterLights, int(range.x + i)).r));
+            if (lightmapped && light.baked)
+                continue;
+            float d = length(light.position - FragPos);
+            float attenuation = 1.0 / (light.constant + light.linear * d + light.quadratic * d * d);
+            result += pbrLight(light.diffuse * attenuation, normalize(light.position - FragPos), normal, viewDir, albedo, metallic, roughness,
+                               true);
+        }
+    }
+    if (spotlightOn && !changeTheSetting) {
+        vec3 lightDir = normalize(spotlight.position - FragPos);
+        float d = length(spotlight.position - FragPos);
+        float attenuation = 1.0 / (spotlight.constant + spotlight.linear * d + spotlight.quadratic * d * d);
+        float intensity = clamp((dot(lightDir, normalize(-spotlight.direction)) - spotlight.outerCutOff)
+                                / (spotlight.cutOff - spotlight.outerCutOff), 0.0, 1.0);
+        result += pbrLight(spotlight.diffuse * attenuation * intensity, lightDir, normal, viewDir, albedo, metallic, roughness,
+                           true) * spotShadowFactor(FragPos);
+    }
+
+    // split sum image based lighting; the baked irradiance, bounces and ambient included, stands
+    // in for the diffuse part when there is a lightmap
+    float nDotV = max(dot(normal, viewDir), 0.0);
+    vec3 f0 = mix(vec3(0.04), albedo, metallic);
+    vec3 f = fresnelSchlickRoughness(nDotV, f0, roughness);
+    vec3 kD = (1.0 - f) * (1.0 - metallic);
+    vec3 prefiltered = textureLod(prefilteredMap, reflect(-viewDir, normal), roughness * prefilteredMaxLod).rgb;
+    vec2 brdf = texture(brdfLut, vec2(nDotV, roughness)).rg;
+    vec3 specular = prefiltered * (f * brdf.x + brdf.y) * iblIntensity;
+    if (lightmapped)
+        return result + kD * albedo * texture(lightmap, lightmapCoords).rgb + specular * texture(occlusionMap, lightmapCoords).r;
+    return result + kD * texture(irradianceMap, normal).rgb * albedo * iblIntensity + specular;
 }
 void main() {
     vec3 norm = normalize(Normal);
     vec3 viewDir = normalize(viewPos - FragPos);
-    vec3 result = calcDirLight(dirLight, norm, viewDir);
+    if (pbr) {
+        FragColor = vec4(pbrShade(norm, viewDir), 1.0);
+        return;
+    }
+    vec3 result;
+    if (lightmapped)
+        result = texture(material.texture_diffuse1, texCoords).rgb * texture(lightmap, lightmapCoords).rgb
+                 + calcDirSpecular(dirLight, norm, viewDir, sunShadow(FragPos));
+    else
+        result = calcDirLight(dirLight, norm, viewDir, sunShadow(FragPos));
    // vec3 result = vec3(0.0f);
-    for(int i = 0; i < NR_POINT_LIGHTS; i++){
-        if(!changeTheSetting)
-            result += calcPointLight(pointLights[i], norm, FragPos, viewDir);
+    if(!changeTheSetting){
+        uvec2 range = clusterRange();
+        for(uint i = 0u; i < range.y; i++) {
+            PointLight light = fetchLight(int(texelFetch(clusterLights, int(range.x + i)).r));
+            if (!(lightmapped && light.baked))
+                result += calcPointLight(light, norm, FragPos, viewDir);
+        }
         }
     if(spotlightOn && !changeTheSetting)
-         result += calcSpotlight(spotlight, norm, FragPos, viewDir);
+         result += calcSpotlight(spotlight, norm, FragPos, viewDir, spotShadowFactor(FragPos));
 
    FragColor = vec4(result, 1.0);
-   float brightness = dot(FragColor.rgb, vec3(0.2126, 0.7152, 0.0722));
-
-   if(brightness > 1.0)
-        BrightColor = vec4(FragColor.rgb, 1.0);
-    else
-        BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
 
 }
\ No newline at end of file
@@ -3,10 +3,12 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+layout (location = 5) in vec2 aLightmapCoords;
 
 out vec2 texCoords;
 out vec3 Normal;
 out vec3 FragPos;
+out vec2 lightmapCoords;
 
 uniform mat4 model;
 uniform mat4 view;
@@ -15,7 +17,8 @@ uniform mat4 projection;
 void main()
 {
     FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = aNormal;
+    Normal = mat3(transpose(inverse(model))) * aNormal;
     texCoords = aTexCoords;
+    lightmapCoords = aLightmapCoords;
     gl_Position = projection * view * vec4(FragPos, 1.0);
 }
\ No newline at end of file
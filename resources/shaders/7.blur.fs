@@ -6,26 +6,35 @@ in vec2 TexCoords;
 uniform sampler2D image;
 
 uniform bool horizontal;
+uniform bool brightPass; // first pass reads the scene itself and keeps only what should bloom
 uniform float weight[5] = float[] (0.2270270270, 0.1945945946, 0.1216216216, 0.0540540541, 0.0162162162);
 
+vec3 fetch(vec2 uv)
+{
+    vec3 color = texture(image, uv).rgb;
+    if(brightPass && dot(color, vec3(0.2126, 0.7152, 0.0722)) <= 1.0)
+        return vec3(0.0);
+    return color;
+}
+
 void main()
 {             
      vec2 tex_offset = 1.0 / textureSize(image, 0); // gets size of single texel
-     vec3 result = texture(image, TexCoords).rgb * weight[0];
+     vec3 result = fetch(TexCoords) * weight[0];
      if(horizontal)
      {
          for(int i = 1; i < 5; ++i)
          {
-            result += texture(image, TexCoords + vec2(tex_offset.x * i, 0.0)).rgb * weight[i];
-            result += texture(image, TexCoords - vec2(tex_offset.x * i, 0.0)).rgb * weight[i];
+            result += fetch(TexCoords + vec2(tex_offset.x * i, 0.0)) * weight[i];
+            result += fetch(TexCoords - vec2(tex_offset.x * i, 0.0)) * weight[i];
          }
      }
      else
      {
          for(int i = 1; i < 5; ++i)
          {
-             result += texture(image, TexCoords + vec2(0.0, tex_offset.y * i)).rgb * weight[i];
-             result += texture(image, TexCoords - vec2(0.0, tex_offset.y * i)).rgb * weight[i];
+             result += fetch(TexCoords + vec2(0.0, tex_offset.y * i)) * weight[i];
+             result += fetch(TexCoords - vec2(0.0, tex_offset.y * i)) * weight[i];
          }
      }
      FragColor = vec4(result, 1.0);
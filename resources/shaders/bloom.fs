@@ -6,17 +6,37 @@ in vec2 TexCoords;
 uniform sampler2D scene;
 uniform sampler2D bloomBlur;
 uniform bool bloom;
+uniform float bloomStrength;
+uniform float sharpness;
 uniform float exposure;
+uniform bool autoExposure;
+uniform sampler2D adaptedLuminance; // 1x1, written by the auto exposure passes on the GPU
+uniform float exposureKey;
+uniform float minExposure;
+uniform float maxExposure;
 
 void main()
 {
     const float gamma = 2.2;
     vec3 hdrColor = texture(scene, TexCoords).rgb;
+    if(sharpness > 0.0)
+    {
+        // unsharp mask against the four neighbours, recovers some detail lost to the upscale
+        vec2 texel = 1.0 / vec2(textureSize(scene, 0));
+        vec3 neighbours = texture(scene, TexCoords + vec2(texel.x, 0.0)).rgb
+                        + texture(scene, TexCoords - vec2(texel.x, 0.0)).rgb
+                        + texture(scene, TexCoords + vec2(0.0, texel.y)).rgb
+                        + texture(scene, TexCoords - vec2(0.0, texel.y)).rgb;
+        hdrColor = max(hdrColor + (hdrColor - neighbours * 0.25) * sharpness, vec3(0.0));
+    }
     vec3 bloomColor = texture(bloomBlur, TexCoords).rgb;
     if(bloom)
-        hdrColor += bloomColor; // additive blending
+        hdrColor += bloomColor * bloomStrength; // additive blending
     // tone mapping
-    vec3 result = vec3(1.0) - exp(-hdrColor * exposure);
+    float sceneExposure = exposure;
+    if(autoExposure)
+        sceneExposure = clamp(exposureKey / max(texture(adaptedLuminance, vec2(0.5)).r, 0.0001), minExposure, maxExposure);
+    vec3 result = vec3(1.0) - exp(-hdrColor * sceneExposure);
     // also gamma correct while we're at it
     result = pow(result, vec3(1.0 / gamma));
     FragColor = vec4(result, 1.0);
@@ -0,0 +1,81 @@
+#version 330 core
+out vec3 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D source;
+uniform bool thirteenTap;
+uniform bool karisAverage;
+uniform bool brightPass; // the first level reads the scene itself and keeps only what should bloom
+
+float luma(vec3 c)
+{
+    return dot(c, vec3(0.2126, 0.7152, 0.0722));
+}
+
+vec3 fetch(vec2 uv)
+{
+    vec3 color = texture(source, uv).rgb;
+    if (brightPass && luma(color) <= 1.0)
+        return vec3(0.0);
+    return color;
+}
+
+// weight of a group in the Karis average, so a single very bright texel can't dominate
+float karisWeight(vec3 group)
+{
+    return karisAverage ? 1.0 / (1.0 + luma(group)) : 1.0;
+}
+
+void main()
+{
+    vec2 texel = 1.0 / vec2(textureSize(source, 0));
+    float x = texel.x;
+    float y = texel.y;
+
+    if (!thirteenTap)
+    {
+        // 4 bilinear taps, a 4x4 box in source texels
+        vec3 a = fetch(TexCoords + vec2(-x, -y));
+        vec3 b = fetch(TexCoords + vec2( x, -y));
+        vec3 c = fetch(TexCoords + vec2(-x,  y));
+        vec3 d = fetch(TexCoords + vec2( x,  y));
+        float wa = karisWeight(a), wb = karisWeight(b), wc = karisWeight(c), wd = karisWeight(d);
+        FragColor = (a * wa + b * wb + c * wc + d * wd) / (wa + wb + wc + wd);
+        return;
+    }
+
+    // 13 taps in five overlapping 4x4 boxes:
+    // a - b - c
+    // - j - k -
+    // d - e - f
+    // - l - m -
+    // g - h - i
+    vec3 a = fetch(TexCoords + vec2(-2.0 * x,  2.0 * y));
+    vec3 b = fetch(TexCoords + vec2( 0.0,      2.0 * y));
+    vec3 c = fetch(TexCoords + vec2( 2.0 * x,  2.0 * y));
+    vec3 d = fetch(TexCoords + vec2(-2.0 * x,  0.0));
+    vec3 e = fetch(TexCoords);
+    vec3 f = fetch(TexCoords + vec2( 2.0 * x,  0.0));
+    vec3 g = fetch(TexCoords + vec2(-2.0 * x, -2.0 * y));
+    vec3 h = fetch(TexCoords + vec2( 0.0,     -2.0 * y));
+    vec3 i = fetch(TexCoords + vec2( 2.0 * x, -2.0 * y));
+    vec3 j = fetch(TexCoords + vec2(-x,  y));
+    vec3 k = fetch(TexCoords + vec2( x,  y));
+    vec3 l = fetch(TexCoords + vec2(-x, -y));
+    vec3 m = fetch(TexCoords + vec2( x, -y));
+
+    // the center box counts half, the four corner boxes an eighth each
+    vec3 center = (j + k + l + m) * 0.25;
+    vec3 topLeft = (a + b + d + e) * 0.25;
+    vec3 topRight = (b + c + e + f) * 0.25;
+    vec3 bottomLeft = (d + e + g + h) * 0.25;
+    vec3 bottomRight = (e + f + h + i) * 0.25;
+    float w0 = 0.5 * karisWeight(center);
+    float w1 = 0.125 * karisWeight(topLeft);
+    float w2 = 0.125 * karisWeight(topRight);
+    float w3 = 0.125 * karisWeight(bottomLeft);
+    float w4 = 0.125 * karisWeight(bottomRight);
+    FragColor = (center * w0 + topLeft * w1 + topRight * w2 + bottomLeft * w3 + bottomRight * w4)
+              / (w0 + w1 + w2 + w3 + w4);
+}
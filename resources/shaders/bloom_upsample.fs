@@ -0,0 +1,25 @@
+#version 330 core
+out vec3 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D source;
+
+// 3x3 tent over the smaller level, added onto the larger one by blending
+void main()
+{
+    vec2 texel = 1.0 / vec2(textureSize(source, 0));
+    float x = texel.x;
+    float y = texel.y;
+
+    vec3 result = texture(source, TexCoords).rgb * 4.0;
+    result += (texture(source, TexCoords + vec2(-x, 0.0)).rgb
+             + texture(source, TexCoords + vec2( x, 0.0)).rgb
+             + texture(source, TexCoords + vec2(0.0, -y)).rgb
+             + texture(source, TexCoords + vec2(0.0,  y)).rgb) * 2.0;
+    result += texture(source, TexCoords + vec2(-x, -y)).rgb
+            + texture(source, TexCoords + vec2( x, -y)).rgb
+            + texture(source, TexCoords + vec2(-x,  y)).rgb
+            + texture(source, TexCoords + vec2( x,  y)).rgb;
+    FragColor = result / 16.0;
+}
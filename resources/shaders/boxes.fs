@@ -1,7 +1,6 @@
 #version 330 core
 
 layout (location = 0) out vec4 FragColor;
-layout (location = 1) out vec4 BrightColor;
 
 struct Material {
     sampler2D diffuse;
@@ -44,7 +43,45 @@ uniform vec3 viewPos;
 uniform Spotlight spotlight;
 uniform bool spotlightOn;
 uniform bool changeTheSetting;
-vec3 calcDirLight(DirLight light, vec3 norm, vec3 viewDir) {
+
+// must match ShadowMaps
+#define SHADOW_CASCADES 3
+uniform sampler2DArrayShadow cascadeShadows;
+uniform mat4 cascadeMatrices[SHADOW_CASCADES];
+uniform bool sunShadows;
+uniform sampler2DShadow spotShadow;
+uniform mat4 spotMatrix;
+uniform bool spotShadows;
+
+// 3x3 taps of hardware compared, bilinear filtered depth
+float sunShadow(vec3 fragPos) {
+    if (!sunShadows)
+        return 1.0;
+    for (int i = 0; i < SHADOW_CASCADES; i++) {
+        vec3 c = (cascadeMatrices[i] * vec4(fragPos, 1.0)).xyz * 0.5 + 0.5;
+        // the first cascade that holds the fragment, with a texel of margin for the filter
+        if (all(greaterThan(c.xy, vec2(0.002))) && all(lessThan(c.xy, vec2(0.998))) && c.z < 1.0) {
+            vec2 texel = 1.0 / vec2(textureSize(cascadeShadows, 0).xy);
+            float lit = 0.0;
+            for (int x = -1; x <= 1; x++)
+                for (int y = -1; y <= 1; y++)
+                    lit += texture(cascadeShadows, vec4(c.xy + vec2(x, y) * texel, float(i), c.z - 0.0005));
+            return lit / 9.0;
+        }
+    }
+    return 1.0;
+}
+
+float spotShadowFactor(vec3 fragPos) {
+    if (!spotShadows)
+        return 1.0;
+    vec4 p = spotMatrix * vec4(fragPos, 1.0);
+    vec3 c = p.xyz / p.w * 0.5 + 0.5;
+    if (p.w <= 0.0 || any(lessThan(c.xy, vec2(0.0))) || any(greaterThan(c.xy, vec2(1.0))) || c.z >= 1.0)
+        return 1.0;
+    return texture(spotShadow, vec3(c.xy, c.z - 0.0002));
+}
+vec3 calcDirLight(DirLight light, vec3 norm, vec3 viewDir, float shadow) {
     vec3 lightDir = normalize(-light.direction);
 
     float diff = max(dot(norm, lightDir), 0.0);
@@ -55,11 +92,11 @@ vec3 calcDirLight(DirLight light, vec3 norm, vec3 viewDir) {
     vec3 diffuse = light.diffuse * diff * texture(material.diffuse, texCoords).rgb;
     vec3 specular = light.specular * spec * texture(material.specular, texCoords).rgb;
 
-    return (ambient + diffuse + specular);
+    return (ambient + shadow * (diffuse + specular));
 }
 
 
-vec3 calcSpotlight(Spotlight light, vec3 normal, vec3 fragPos, vec3 viewDir) {
+vec3 calcSpotlight(Spotlight light, vec3 normal, vec3 fragPos, vec3 viewDir, float shadow) {
 
     vec3 lightDir = normalize(light.position - fragPos);
 
@@ -81,21 +118,15 @@ vec3 calcSpotlight(Spotlight light, vec3 normal, vec3 fragPos, vec3 viewDir) {
     diffuse *= intensity * attenuation;
     specular *= intensity* attenuation;
     ambient *= intensity* attenuation ;
-    return (diffuse + specular + ambient);
+    return (shadow * (diffuse + specular) + ambient);
 
 }
 void main() {
     vec3 norm = normalize(Normal);
     vec3 viewDir = normalize(viewPos - FragPos);
-   vec3 result = calcDirLight(dirLight, norm, viewDir);
+   vec3 result = calcDirLight(dirLight, norm, viewDir, sunShadow(FragPos));
  //   vec3 result = vec3(0.0f);
     if(spotlightOn && !changeTheSetting)
-        result += calcSpotlight(spotlight, norm, FragPos, viewDir);
+        result += calcSpotlight(spotlight, norm, FragPos, viewDir, spotShadowFactor(FragPos));
     FragColor = vec4(result, 1.0);
-
-    float brightness = dot(FragColor.rgb, vec3(0.2126, 0.7152, 0.0722));
-    if(brightness > 1.0)
-        BrightColor = vec4(FragColor.rgb, 1.0);
-	else
-		BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
 }
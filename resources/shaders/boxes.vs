@@ -14,7 +14,7 @@ uniform mat4 model;
 
 void main() {
     FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = aNormals;
+    Normal = mat3(transpose(inverse(model))) * aNormals;
     texCoords = aTex;
     gl_Position = projection * view * vec4(FragPos, 1.0);
 }
\ No newline at end of file
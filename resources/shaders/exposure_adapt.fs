@@ -0,0 +1,22 @@
+#version 330 core
+out float FragColor;
+
+uniform sampler2D averageLog; // 1x1, mean log luminance of this frame
+uniform sampler2D previous;   // 1x1, adapted luminance of the last frame
+uniform bool reset;
+uniform float deltaTime;
+uniform float speedUp;
+uniform float speedDown;
+
+void main()
+{
+    float measured = exp(texture(averageLog, vec2(0.5)).r);
+    if (reset)
+    {
+        FragColor = measured;
+        return;
+    }
+    float adapted = texture(previous, vec2(0.5)).r;
+    float speed = measured > adapted ? speedUp : speedDown;
+    FragColor = adapted + (measured - adapted) * (1.0 - exp(-deltaTime * speed));
+}
@@ -0,0 +1,21 @@
+#version 330 core
+out float FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D scene;
+uniform float outputTexel; // size of one texel of the target in texture coordinates
+
+float logLuma(vec2 uv)
+{
+    float luma = dot(texture(scene, uv).rgb, vec3(0.2126, 0.7152, 0.0722));
+    return log(max(luma, 0.0001));
+}
+
+void main()
+{
+    // one bilinear tap per quadrant of the output texel, the logarithm taken before averaging
+    float d = 0.25 * outputTexel;
+    FragColor = 0.25 * (logLuma(TexCoords + vec2(-d, -d)) + logLuma(TexCoords + vec2( d, -d))
+                      + logLuma(TexCoords + vec2(-d,  d)) + logLuma(TexCoords + vec2( d,  d)));
+}
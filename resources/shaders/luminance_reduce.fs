@@ -0,0 +1,17 @@
+#version 330 core
+out float FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D source;
+
+void main()
+{
+    // the target is a quarter of the source per side; each bilinear tap lands between four texels,
+    // so four taps average the whole 4x4 block exactly
+    vec2 texel = 1.0 / vec2(textureSize(source, 0));
+    FragColor = 0.25 * (texture(source, TexCoords + vec2(-texel.x, -texel.y)).r
+                      + texture(source, TexCoords + vec2( texel.x, -texel.y)).r
+                      + texture(source, TexCoords + vec2(-texel.x,  texel.y)).r
+                      + texture(source, TexCoords + vec2( texel.x,  texel.y)).r);
+}
@@ -1,6 +1,5 @@
 #version 330 core
 layout (location = 0) out vec4 FragColor;
-layout (location = 1) out vec4 BrightColor;
 
 in vec2 texCoords;
 in vec3 Normal;
@@ -15,11 +14,5 @@ void main()
      texColor = texColor * lightColor;
 //     vec3 mapped = texColor / (texColor + vec3(1.0));
     FragColor = vec4(texColor, 1.0);
-
-    float brightness = dot(FragColor.rgb, vec3(0.2126, 0.7152, 0.0722));
-    if(brightness > 1.0)
-        BrightColor = vec4(FragColor.rgb, 1.0);
-	else
-		BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
   //  FragColor = vec4(texColor, 1.0);
 }
\ No newline at end of file
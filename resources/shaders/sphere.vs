@@ -14,7 +14,7 @@ uniform mat4 projection;
 void main()
 {
     FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = aNormal;
+    Normal = mat3(transpose(inverse(model))) * aNormal;
     texCoords = aTexCoords;
     gl_Position = projection * view * vec4(FragPos, 1.0);
 }
\ No newline at end of file
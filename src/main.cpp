@@ -13,26 +13,54 @@
 #include <learnopengl/shader.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
+#include <rg/CameraPath.h>
+#include <rg/DynamicResolution.h>
+#include <rg/Error.h>
+#include <rg/JobSystem.h>
+#include <rg/FramePacer.h>
+#include <rg/GpuProfiler.h>
+#include <rg/Profiler.h>
+#include <rg/Renderer.h>
+#include <rg/SpscQueue.h>
+#include <rg/World.h>
+#include <atomic>
+#include <cmath>
 #include <iostream>
+#include <thread>
 
 bool bloom = true;
+rg::BloomMode bloomMode = rg::BloomMode::MipChain;
+rg::BloomQuality bloomQuality = rg::BloomQuality::Medium;
+float sharpness = 0.2f;
+bool compactHdr = false;
 bool bloomKeyPressed = false;
 float exposure = 0.4f;
+bool autoExposure = true;
+bool exposureForDay = false; // which preset the manual exposure was last reset to
+rg::ExposureSettings exposureSettings;
 bool spotlightOn = false;
+bool shadows = true;
+bool pbr = true;
+int textureBudgetMb = 64;
+float textureBias = 0.0f;
 bool speedUp = false;
 bool changeTheSetting = false;
+bool predictiveSkyPrewarm = true;
+double skySwitchTime = -1e9; // when M was last pressed
+const double SkyPrewarmSeconds = 20.0; // after a switch, switching back is likely for this long
+bool recordingCameraPath = false;
 
-unsigned int loadTexture(char const* path);
-unsigned int loadCubemap(vector<std::string> faces);
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
 void mouse_callback(GLFWwindow *window, double xpos, double ypos);
 void scroll_callback(GLFWwindow *window, double xoffset, double yoffset);
 void processInput(GLFWwindow *window);
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods);
-void renderQuad();
 // settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
+// written by the resize callback, read when the next frame packet is built
+int framebufferWidth = SCR_WIDTH;
+int framebufferHeight = SCR_HEIGHT;
 
 // camera
 
@@ -42,7 +70,6 @@ bool firstMouse = true;
 
 // timing
 float deltaTime = 0.0f;
-float lastFrame = 0.0f;
 
 struct ProgramState {
     glm::vec3 clearColor = glm::vec3(0);
@@ -51,6 +78,7 @@ struct ProgramState {
     bool CameraMouseMovementUpdateEnabled = true;
     glm::vec3 damPosition = glm::vec3(0.0f);
     float damScale = 1.0f;
+    bool OcclusionCulling = true;
     //PointLight pointLight;
     ProgramState()
             : camera(glm::vec3(0.0f, 2.0f, 3.0f)) {}
@@ -91,16 +119,54 @@ void ProgramState::LoadFromFile(std::string filename) {
 }
 
 ProgramState *programState;
+rg::World *world;
+rg::Renderer *renderer;
+rg::FramePacer *framePacer;
+rg::GpuProfiler *gpuProfiler;
+rg::DynamicResolution *dynamicResolution;
 
 void DrawImGui(ProgramState *programState);
 
+// ImGui draw data deep-copied on the main thread, so the render thread can submit it while the
+// main thread already builds the next UI frame
+struct ImGuiSnapshot {
+    ImDrawData data;
+    std::vector<ImDrawList*> lists;
+
+    void Capture(const ImDrawData* source) {
+        Clear();
+        for (int i = 0; i < source->CmdListsCount; i++)
+            lists.push_back(source->CmdLists[i]->CloneOutput());
+        data = *source;
+        data.CmdLists = lists.data();
+    }
+
+    // frees the copies; only called on the main thread, once the packet came back
+    void Clear() {
+        for (ImDrawList* list : lists)
+            IM_DELETE(list);
+        lists.clear();
+        data.Clear();
+    }
+};
+
+// one frame in flight: the scene packet plus the UI drawn on top of it
+struct FrameSlot {
+    rg::FramePacket packet;
+    ImGuiSnapshot ui;
+};
+
 int main() {
+    rg::Profiler::Instance().SetThreadName("main");
     // glfw: initialize and configure
     // ------------------------------
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#if defined(RG_GL_DEBUG)
+    glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+#endif
 
 #ifdef __APPLE__
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
@@ -128,6 +194,8 @@ int main() {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    // driver side error reports, only in RG_GL_DEBUG builds
+    rg::GlDebugOutput::Enable((GLADloadproc) glfwGetProcAddress);
 
     programState = new ProgramState;
     programState->LoadFromFile("resources/program_state.txt");
@@ -142,596 +210,219 @@ int main() {
 
     ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplOpenGL3_Init("#version 330 core");
-    //skybox vertices
-    float skyboxVertices[] = {
-            // positions
-            -1.0f,  1.0f, -1.0f,
-            -1.0f, -1.0f, -1.0f,
-            1.0f, -1.0f, -1.0f,
-            1.0f, -1.0f, -1.0f,
-            1.0f,  1.0f, -1.0f,
-            -1.0f,  1.0f, -1.0f,
-
-            -1.0f, -1.0f,  1.0f,
-            -1.0f, -1.0f, -1.0f,
-            -1.0f,  1.0f, -1.0f,
-            -1.0f,  1.0f, -1.0f,
-            -1.0f,  1.0f,  1.0f,
-            -1.0f, -1.0f,  1.0f,
-
-            1.0f, -1.0f, -1.0f,
-            1.0f, -1.0f,  1.0f,
-            1.0f,  1.0f,  1.0f,
-            1.0f,  1.0f,  1.0f,
-            1.0f,  1.0f, -1.0f,
-            1.0f, -1.0f, -1.0f,
-
-            -1.0f, -1.0f,  1.0f,
-            -1.0f,  1.0f,  1.0f,
-            1.0f,  1.0f,  1.0f,
-            1.0f,  1.0f,  1.0f,
-            1.0f, -1.0f,  1.0f,
-            -1.0f, -1.0f,  1.0f,
-
-            -1.0f,  1.0f, -1.0f,
-            1.0f,  1.0f, -1.0f,
-            1.0f,  1.0f,  1.0f,
-            1.0f,  1.0f,  1.0f,
-            -1.0f,  1.0f,  1.0f,
-            -1.0f,  1.0f, -1.0f,
-
-            -1.0f, -1.0f, -1.0f,
-            -1.0f, -1.0f,  1.0f,
-            1.0f, -1.0f, -1.0f,
-            1.0f, -1.0f, -1.0f,
-            -1.0f, -1.0f,  1.0f,
-            1.0f, -1.0f,  1.0f
-    };
-    float vertices[] = {
-            // positions          // normals           // texture coords
-            -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f,  0.0f,
-            0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f,  0.0f,
-            0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f,  1.0f,
-            0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f,  1.0f,
-            -0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f,  1.0f,
-            -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f,  0.0f,
-
-            -0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f,  0.0f,
-            0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f,  0.0f,
-            0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f,  1.0f,
-            0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f,  1.0f,
-            -0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f,  1.0f,
-            -0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f,  0.0f,
-
-            -0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
-            -0.5f,  0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  1.0f,  1.0f,
-            -0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
-            -0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
-            -0.5f, -0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  0.0f,  0.0f,
-            -0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
-
-            0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
-            0.5f,  0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  1.0f,  1.0f,
-            0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
-            0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
-            0.5f, -0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  0.0f,  0.0f,
-            0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
-
-            -0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f,  1.0f,
-            0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  1.0f,  1.0f,
-            0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f,  0.0f,
-            0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f,  0.0f,
-            -0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  0.0f,  0.0f,
-            -0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f,  1.0f,
-
-            -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f,  1.0f,
-            0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  1.0f,  1.0f,
-            0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f,  0.0f,
-            0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f,  0.0f,
-            -0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  0.0f,  0.0f,
-            -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f,  1.0f
-    };
-
-
-    float cubeVertices[] = {
-            // Back face
-            -0.5f, -0.5f, -0.5f,  0.0f, 0.0f, // Bottom-left
-            0.5f,  0.5f, -0.5f,  1.0f, 1.0f, // top-right
-            0.5f, -0.5f, -0.5f,  1.0f, 0.0f, // bottom-right
-            0.5f,  0.5f, -0.5f,  1.0f, 1.0f, // top-right
-            -0.5f, -0.5f, -0.5f,  0.0f, 0.0f, // bottom-left
-            -0.5f,  0.5f, -0.5f,  0.0f, 1.0f, // top-left
-            // Front face
-            -0.5f, -0.5f,  0.5f,  0.0f, 0.0f, // bottom-left
-            0.5f, -0.5f,  0.5f,  1.0f, 0.0f, // bottom-right
-            0.5f,  0.5f,  0.5f,  1.0f, 1.0f, // top-right
-            0.5f,  0.5f,  0.5f,  1.0f, 1.0f, // top-right
-            -0.5f,  0.5f,  0.5f,  0.0f, 1.0f, // top-left
-            -0.5f, -0.5f,  0.5f,  0.0f, 0.0f, // bottom-left
-            // Left face
-            -0.5f,  0.5f,  0.5f,  1.0f, 0.0f, // top-right
-            -0.5f,  0.5f, -0.5f,  1.0f, 1.0f, // top-left
-            -0.5f, -0.5f, -0.5f,  0.0f, 1.0f, // bottom-left
-            -0.5f, -0.5f, -0.5f,  0.0f, 1.0f, // bottom-left
-            -0.5f, -0.5f,  0.5f,  0.0f, 0.0f, // bottom-right
-            -0.5f,  0.5f,  0.5f,  1.0f, 0.0f, // top-right
-            // Right face
-            0.5f,  0.5f,  0.5f,  1.0f, 0.0f, // top-left
-            0.5f, -0.5f, -0.5f,  0.0f, 1.0f, // bottom-right
-            0.5f,  0.5f, -0.5f,  1.0f, 1.0f, // top-right
-            0.5f, -0.5f, -0.5f,  0.0f, 1.0f, // bottom-right
-            0.5f,  0.5f,  0.5f,  1.0f, 0.0f, // top-left
-            0.5f, -0.5f,  0.5f,  0.0f, 0.0f, // bottom-left
-            // Bottom face
-            -0.5f, -0.5f, -0.5f,  0.0f, 1.0f, // top-right
-            0.5f, -0.5f, -0.5f,  1.0f, 1.0f, // top-left
-            0.5f, -0.5f,  0.5f,  1.0f, 0.0f, // bottom-left
-            0.5f, -0.5f,  0.5f,  1.0f, 0.0f, // bottom-left
-            -0.5f, -0.5f,  0.5f,  0.0f, 0.0f, // bottom-right
-            -0.5f, -0.5f, -0.5f,  0.0f, 1.0f, // top-right
-            // Top face
-            -0.5f,  0.5f, -0.5f,  0.0f, 1.0f, // top-left
-            0.5f,  0.5f,  0.5f,  1.0f, 0.0f, // bottom-right
-            0.5f,  0.5f, -0.5f,  1.0f, 1.0f, // top-right
-            0.5f,  0.5f,  0.5f,  1.0f, 0.0f, // bottom-right
-            -0.5f,  0.5f, -0.5f,  0.0f, 1.0f, // top-left
-            -0.5f,  0.5f,  0.5f,  0.0f, 0.0f  // bottom-left
-    };
-
-    float transparentVertices[] = {
-            // positions         // texture Coords (swapped y coordinates because texture is flipped upside down)
-            0.0f,  0.5f,  0.0f,  0.0f,  0.0f,
-            0.0f, -0.5f,  0.0f,  0.0f,  1.0f,
-            1.0f, -0.5f,  0.0f,  1.0f,  1.0f,
-
-            0.0f,  0.5f,  0.0f,  0.0f,  0.0f,
-            1.0f, -0.5f,  0.0f,  1.0f,  1.0f,
-            1.0f,  0.5f,  0.0f,  1.0f,  0.0f
-    };
-    glm::vec3 pointLightPositions[] = {
-            glm::vec3( -35.0f,  10.0f,  2.0f),
-            glm::vec3( -15.0f, 10.0f, 2.0f),
-            glm::vec3(10.0f, 10.0f, 2.0f),
-            glm::vec3( 35.0f,  10.0f, 2.0f),
-            glm::vec3(3.0f, 65.0f, 70.0f),
-    };
-
-    glm::vec3 vegetationPositions[] = {
-            glm::vec3(-15.0f, 1.0f, 24.0f),
-            glm::vec3(-17.0f, 1.0f, 24.0f),
-            glm::vec3(-20.0f, 0.5f, 24.0f),
-            glm::vec3(-22.0f, 0.0f, 24.0f),
-    };
-
-    glm::vec3 boxPositions[] = {
-            glm::vec3(-15.0f, 7.0f, -9.0f),
-            glm::vec3(-14.3f, 8.0f, -9.0f),
-            glm::vec3(-13.85f, 7.0f, -9.0f),
-    };
-    // configure global opengl state
-    // -----------------------------
-    glEnable(GL_DEPTH_TEST);
-
-    // build and compile shaders
-    // -------------------------
-    Shader ourShader("resources/shaders/2.model_lighting.vs", "resources/shaders/2.model_lighting.fs");
-    //skybox shader load
-    Shader skybox("resources/shaders/skybox_daylight.vs", "resources/shaders/skybox_daylight.fs");
-    //vegetation shader load
-    Shader vegetation("resources/shaders/vegetation.vs", "resources/shaders/vegetation.fs");
-    //boxes shader load
-    Shader boxes("resources/shaders/boxes.vs", "resources/shaders/boxes.fs");
-    //sphere shader load
-    Shader sphere("resources/shaders/sphere.vs", "resources/shaders/sphere.fs");
-    //blur shader load
-    Shader blurShader("resources/shaders/7.blur.vs", "resources/shaders/7.blur.fs");
-    //bloom shader load
-    Shader bloomShader("resources/shaders/bloom.vs", "resources/shaders/bloom.fs");
-
-    // load models
-    // -----------
-    Model ourModel("resources/objects/dam_obj/dam1.obj");
-    Model sphereModel("resources/objects/sphere/moon.obj");
-    sphereModel.SetShaderTextureNamePrefix("material.");
-    ourModel.SetShaderTextureNamePrefix("material.");
-
-    // skybox load
-    // ---------
-
-    //the loading must follow the order
-    //right - px
-    //left - nx
-    //top - py
-    //bottom - ny
-    //front - pz
-    //back - nz
-    vector<std::string> faces
-            {
-                    FileSystem::getPath("resources/cubemaps/clouds/graycloud_lf.jpg"),
-                    FileSystem::getPath("resources/cubemaps/clouds/graycloud_rt.jpg"),
-                    FileSystem::getPath("resources/cubemaps/clouds/graycloud_up.jpg"),
-                    FileSystem::getPath("resources/cubemaps/clouds/graycloud_dn.jpg"),
-                    FileSystem::getPath("resources/cubemaps/clouds/graycloud_ft.jpg"),
-                    FileSystem::getPath("resources/cubemaps/clouds/graycloud_bk.jpg")
-            };
-
-    vector<std::string> faces2
+    // the renderer loads every GL resource while this thread still owns the context;
+    // the ImGui backend creates its font texture and shaders on its first NewFrame
+    ImGui_ImplOpenGL3_NewFrame();
+    // a pack built with project_base_assetpack replaces the loose files under resources
+    if (FileSystem::mount(FileSystem::getPath("resources.pack"))) {
+        std::cout << "Loading assets from resources.pack" << std::endl;
+    }
+    renderer = new rg::Renderer();
+    Model& ourModel = renderer->damModel;
+    Model& sphereModel = renderer->moonModel;
+
+    // scene content and the per-frame CPU stages; independent stages run in parallel on the
+    // job system and GL submission happens on the render thread
+    // ------------------------------------------------------------------------------------------
+    world = new rg::World(ourModel, sphereModel);
+    rg::JobSystem jobs;
+    float aspect = (float) SCR_WIDTH / (float) SCR_HEIGHT;
+
+    // camera path recording for the benchmark, toggled with C
+    rg::CameraPath recordedPath;
+    bool wasRecording = false;
+    double recordingStart = 0.0;
+
+    // the render thread owns the GL context from here on; packets travel to it through one
+    // lock-free queue and come back through another, three packets allow two frames in flight
+    FrameSlot frameSlots[3];
+    rg::SpscQueue<int, 2> submittedFrames;
+    rg::SpscQueue<int, 4> releasedFrames;
+    for (int i = 0; i < 3; i++)
+        releasedFrames.TryPush(i);
+    std::atomic<bool> rendering(true);
+    uint64_t frameIndex = 0;
+    rg::Backoff backoff;
+
+    framePacer = new rg::FramePacer;
+    gpuProfiler = new rg::GpuProfiler;
+    dynamicResolution = new rg::DynamicResolution;
+    glfwMakeContextCurrent(NULL);
+    std::thread renderThread([&]() {
+        rg::Profiler::Instance().SetThreadName("render");
+        glfwMakeContextCurrent(window);
+        rg::GlDebugOutput::AttachThread();
+        int swapInterval = -1;
+        rg::Backoff idle;
+        while (true) {
+            int slot;
+            if (!submittedFrames.TryPop(slot)) {
+                if (!rendering)
+                    break;
+                framePacer->Poll();
+                idle.Pause();
+                continue;
+            }
+            idle.Reset();
+            if (framePacer->SwapInterval() != swapInterval) {
+                swapInterval = framePacer->SwapInterval();
+                glfwSwapInterval(swapInterval);
+            }
+            double inputTime = frameSlots[slot].packet.inputTime;
+            gpuProfiler->BeginFrame(frameSlots[slot].packet.frameIndex);
+            renderer->Render(frameSlots[slot].packet, gpuProfiler);
+            if (frameSlots[slot].ui.data.Valid) {
+                RG_PROFILE_SCOPE("imgui draw");
+                rg::GpuScope scope(gpuProfiler, "imgui");
+                ImGui_ImplOpenGL3_RenderDrawData(&frameSlots[slot].ui.data);
+            }
+            gpuProfiler->EndFrame();
             {
-                    FileSystem::getPath("resources/cubemaps/cubemap/px.png"),
-                    FileSystem::getPath("resources/cubemaps/cubemap/nx.png"),
-                    FileSystem::getPath("resources/cubemaps/cubemap/py.png"),
-                    FileSystem::getPath("resources/cubemaps/cubemap/ny.png"),
-                    FileSystem::getPath("resources/cubemaps/cubemap/pz.png"),
-                    FileSystem::getPath("resources/cubemaps/cubemap/nz.png")
-            };
-
-    unsigned int cubemapTexture = loadCubemap(faces);
-    unsigned int cubemapTexture2 = loadCubemap(faces2);
-
-    skybox.use();
-    skybox.setInt("skybox", 0);
-    unsigned int basicTex = loadTexture(FileSystem::getPath("resources/textures/v2.png").c_str());
-    unsigned int boxTex_diffuse = loadTexture(FileSystem::getPath("resources/textures/8640003215_50cc68f8cf_b.jpg").c_str());
-    unsigned int boxTex_specular = loadTexture(FileSystem::getPath("resources/textures/container3_specular.jpg").c_str());
-
-    // configure (floating point) framebuffers
-    // ---------------------------------------
-    unsigned int hdrFBO;
-    glGenFramebuffers(1, &hdrFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
-    unsigned int colorBuffers[2];
-    glGenTextures(2, colorBuffers);
-    for (unsigned int i = 0; i < 2; i++)
-    {
-        glBindTexture(GL_TEXTURE_2D, colorBuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, colorBuffers[i], 0);
-    }
-    // create and attach depth buffer (renderbuffer)
-    unsigned int rboDepth;
-    glGenRenderbuffers(1, &rboDepth);
-    glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, SCR_WIDTH, SCR_HEIGHT);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
-    unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
-    glDrawBuffers(2, attachments);
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        std::cout << "Framebuffer not complete!" << std::endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    // ping-pong-framebuffer for blurring
-    unsigned int pingpongFBO[2];
-    unsigned int pingpongColorbuffers[2];
-    glGenFramebuffers(2, pingpongFBO);
-    glGenTextures(2, pingpongColorbuffers);
-    for (unsigned int i = 0; i < 2; i++)
-    {
-        glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[i]);
-        glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pingpongColorbuffers[i], 0);
-        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-            std::cout << "Framebuffer not complete!" << std::endl;
-    }
-    //setting the buffers
-
-    unsigned int vVAO, vVBO;
-
-    glGenVertexArrays(1, &vVAO);
-    glGenBuffers(1, &vVBO);
-    glBindVertexArray(vVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, vVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(transparentVertices), &transparentVertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-
-    unsigned int boxVAO, boxVBO;
-
-    glGenVertexArrays(1, &boxVAO);
-    glGenBuffers(1, &boxVBO);
-    glBindVertexArray(boxVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, boxVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), &vertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8*sizeof(float), (void*)0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8*sizeof(float), (void*)(sizeof(float) * 3));
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8*sizeof(float), (void*)(sizeof(float)*6));
-
-    unsigned int skyboxVAO, skyboxVBO;
-
-    glGenVertexArrays(1, &skyboxVAO);
-    glGenBuffers(1, &skyboxVBO);
-    glBindVertexArray(skyboxVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-
-    ourShader.use();
-    ourShader.setInt("material.diffuse", 0);
-    ourShader.setInt("material.specular", 1);
-
-    boxes.use();
-    boxes.setInt("material.diffuse", 0);
-    boxes.setInt("material.specular", 1);
-
-    blurShader.use();
-    blurShader.setInt("image", 0);
-    bloomShader.use();
-    bloomShader.setInt("scene", 0);
-    bloomShader.setInt("bloomBlur", 1);
-
-//    // draw in wireframe
-//    //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);7
-//
-//    // render loop
+                RG_PROFILE_SCOPE("glfwSwapBuffers");
+                glfwSwapBuffers(window);
+            }
+            releasedFrames.TryPush(slot);
+            // fences the frame and blocks while too many frames are queued on the GPU
+            RG_PROFILE_SCOPE("wait for GPU");
+            framePacer->FrameSubmitted(inputTime);
+        }
+        framePacer->Flush();
+        gpuProfiler->Release();
+        glfwMakeContextCurrent(NULL);
+    });
+
+    // render loop
     // -----------
     while (!glfwWindowShouldClose(window)) {
-        // per-frame time logic
-        // --------------------
-        float currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
-
-        // input
-        // -----
-        processInput(window);
-        // render
-        // ------
-        glClearColor(programState->clearColor.r, programState->clearColor.g, programState->clearColor.b, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        //1. render scene into floating point framebuffers
-        glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        glm::mat4 model = glm::mat4(1.0f);
-        glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom),(float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
-        glm::mat4 view = programState->camera.GetViewMatrix();
-
-        //rendering the dam (main model)
-        //setting up the lights first
-        ourShader.use();
-        glEnable(GL_CULL_FACE);
+        // per-frame time logic: wait as the pacing mode requires, then take a smoothed delta
+        // ----------------------------------------------------------------------------------
+        {
+            RG_PROFILE_SCOPE("pacing");
+            deltaTime = framePacer->BeginFrame();
+        }
+        RG_PROFILE_SCOPE("frame");
 
-        //setting up lights
+        // glfw: poll IO events (keys pressed/released, mouse moved etc.) and handle input
+        // -------------------------------------------------------------------------------
+        glfwPollEvents();
+        processInput(window);
+        double inputTime = framePacer->Now();
 
-        //directional light
-        if(!changeTheSetting) {
-            ourShader.setVec3("dirLight.direction", -0.2f, -1.0f, -0.3f);
-            ourShader.setVec3("dirLight.ambient", 0.01f, 0.01f, 0.09f);
-            ourShader.setVec3("dirLight.diffuse", 0.0f, 0.0f, 0.05f);
-            ourShader.setVec3("dirLight.specular", 0.05f, 0.05f, 0.05f);
-            exposure = 0.4f;
-        } else {
-            ourShader.setVec3("dirLight.direction", -0.2f, -1.0f, -0.3f);
-            ourShader.setVec3("dirLight.ambient", 0.1f, 0.1f, 0.1f);
-            ourShader.setVec3("dirLight.diffuse", 0.5f, 0.5f, 0.5f);
-            ourShader.setVec3("dirLight.specular", 0.1f, 0.1f, 0.1f);
-            exposure = 0.7f;
+        // wait for a packet the render thread is done with; this is what bounds the frames in flight
+        int slot;
+        {
+            RG_PROFILE_SCOPE("wait for packet");
+            while (!releasedFrames.TryPop(slot))
+                backoff.Pause();
+            backoff.Reset();
         }
-        //NOTE: both point lights and spotlight are active only if the night skybox is active
-        //toggling daylight and night skybox is done by pressing key M
-
-        //point light 1
-        ourShader.setVec3("pointLights[0].position", pointLightPositions[0]);
-        ourShader.setVec3("pointLights[0].ambient", 0.05f, 0.05f, 0.05f);
-        ourShader.setVec3("pointLights[0].diffuse", 0.7f, 0.7f, 1.1f);
-        ourShader.setVec3("pointLights[0].specular", 0.3f, 0.3f, 0.3f);
-        ourShader.setFloat("pointLights[0].constant", 1.0f);
-        ourShader.setFloat("pointLights[0].linear", 0.07f);
-        ourShader.setFloat("pointLights[0].quadratic", 0.17f);
-        // point light 2
-        ourShader.setVec3("pointLights[1].position", pointLightPositions[1]);
-        ourShader.setVec3("pointLights[1].ambient", 0.05f, 0.05f, 0.05f);
-        ourShader.setVec3("pointLights[1].diffuse", 0.7f, 0.7f, 1.1f);
-        ourShader.setVec3("pointLights[1].specular", 0.3f, 0.3f, 0.3f);
-        ourShader.setFloat("pointLights[1].constant", 1.0f);
-        ourShader.setFloat("pointLights[1].linear", 0.07f);
-        ourShader.setFloat("pointLights[1].quadratic", 0.17f);
-       //  point light 3
-        ourShader.setVec3("pointLights[2].position", pointLightPositions[2]);
-        ourShader.setVec3("pointLights[2].ambient", 0.05f, 0.05f, 0.05f);
-        ourShader.setVec3("pointLights[2].diffuse", 0.7f, 0.7f, 1.1f);
-        ourShader.setVec3("pointLights[2].specular", 0.3f, 0.3f, 0.3f);
-        ourShader.setFloat("pointLights[2].constant", 1.0f);
-        ourShader.setFloat("pointLights[2].linear", 0.07f);
-        ourShader.setFloat("pointLights[2].quadratic", 0.17f);
-
-        ourShader.setVec3("pointLights[3].position", pointLightPositions[3]);
-        ourShader.setVec3("pointLights[3].ambient", 0.05f, 0.05f, 0.05f);
-        ourShader.setVec3("pointLights[3].diffuse", 0.7f, 0.7f, 1.1f);
-        ourShader.setVec3("pointLights[3].specular", 0.3f, 0.3f, 0.3f);
-        ourShader.setFloat("pointLights[3].constant", 1.0f);
-        ourShader.setFloat("pointLights[3].linear", 0.07f);
-        ourShader.setFloat("pointLights[3].quadratic", 0.17f);
-
-        ourShader.setVec3("spotlight.position", programState->camera.Position);
-        ourShader.setVec3("spotlight.direction", programState->camera.Front);
-        ourShader.setVec3("spotlight.ambient", 0.0f, 0.0f, 0.0f);
-        ourShader.setVec3("spotlight.diffuse", 0.5f, 0.5f, 0.8f);
-        ourShader.setVec3("spotlight.specular", 0.3f, 0.5f, 0.9f);
-        ourShader.setFloat("spotlight.constant", 1.0f);
-        ourShader.setFloat("spotlight.linear", 0.014f);
-        ourShader.setFloat("spotlight.quadratic", 0.0007f);
-        ourShader.setFloat("spotlight.cutOff", glm::cos(glm::radians(12.5f)));
-        ourShader.setFloat("spotlight.outerCutOff", glm::cos(glm::radians(17.5f)));
-        ourShader.setBool("spotlightOn", spotlightOn);
-        ourShader.setVec3("viewPos", programState->camera.Position);
-        ourShader.setFloat("material.shininess", 128.0f);
-        ourShader.setBool("changeTheSetting", changeTheSetting);
-
-        // view/projection transformations
-        view = programState->camera.GetViewMatrix();
-        ourShader.setMat4("projection", projection);
-        ourShader.setMat4("view", view);
-
-        // render the loaded model
-        model = glm::translate(model,programState->damPosition);
-        model = glm::scale(model, glm::vec3(programState->damScale));
-        ourShader.setMat4("model", model);
-        ourModel.Draw(ourShader);
-
-        glDisable(GL_CULL_FACE);
-
-        //render the grass texture
-        vegetation.use();
-
-        glBindTexture(GL_TEXTURE_2D, basicTex);
-        glActiveTexture(basicTex);
-
-        glBindVertexArray(vVAO);
-        for(int i = 0; i < 4; i++) {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, vegetationPositions[i]);
-            model = glm::scale(model, glm::vec3(5.0f, 5.0f, 1.0f));
-            vegetation.setMat4("model", model);
-            vegetation.setMat4("view", view);
-            vegetation.setMat4("projection", projection);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
 
-        }
-        //box texture and shader
-        boxes.use();
-        boxes.setVec3("dirLight.direction", -0.2f, -1.0f, -0.3f);
-        if(!changeTheSetting) {
-            boxes.setVec3("dirLight.ambient", 0.01f, 0.01f, 0.1f);
-            boxes.setVec3("dirLight.diffuse", 0.05f, 0.05f, 0.05f);
-            boxes.setVec3("dirLight.specular", 0.05f, 0.05f, 0.05f);
-        } else {
-            boxes.setVec3("dirLight.ambient", 0.1f, 0.1f, 0.1f);
-            boxes.setVec3("dirLight.diffuse", 0.5f, 0.5f, 0.5f);
-            boxes.setVec3("dirLight.specular", 0.1f, 0.1f, 0.1f);
-        }
-        boxes.setVec3("spotlight.position", programState->camera.Position);
-        boxes.setVec3("spotlight.direction", programState->camera.Front);
-        boxes.setVec3("spotlight.ambient", 0.0f, 0.0f, 0.0f);
-        boxes.setVec3("spotlight.diffuse", 0.5f, 0.5f, 0.8f);
-        boxes.setVec3("spotlight.specular", 0.3f, 0.5f, 0.9f);
-        boxes.setFloat("spotlight.constant", 1.0f);
-        boxes.setFloat("spotlight.linear", 0.014f);
-        boxes.setFloat("spotlight.quadratic", 0.0007f);
-        boxes.setFloat("spotlight.cutOff", glm::cos(glm::radians(12.5f)));
-        boxes.setFloat("spotlight.outerCutOff", glm::cos(glm::radians(17.5f)));
-        boxes.setBool("spotlightOn", spotlightOn);
-        boxes.setVec3("viewPos", programState->camera.Position);
-        boxes.setFloat("material.shininess", 128.0f);
-        boxes.setBool("changeTheSetting", changeTheSetting);
-
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, boxTex_diffuse);
-        // bind specular map
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, boxTex_specular);
-
-        glBindVertexArray(boxVAO);
-        //set model, view and projection for the box(es)
-        for(int i = 0; i < 3; i++) {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, boxPositions[i]);
-            if(i == 1) {
-                model = glm::rotate(model, glm::radians(15.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-            }
-            else if(i == 2) {
-                model = glm::rotate(model, glm::radians(-10.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        if (recordingCameraPath) {
+            if (!wasRecording) {
+                recordedPath.keys.clear();
+                recordingStart = inputTime;
             }
-            else {
-            }
-            boxes.setMat4("model", model);
-            boxes.setMat4("view", view);
-            boxes.setMat4("projection", projection);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+            rg::CameraKey key;
+            key.time = (float)(inputTime - recordingStart);
+            key.position = programState->camera.Position;
+            key.yaw = programState->camera.Yaw;
+            key.pitch = programState->camera.Pitch;
+            key.zoom = programState->camera.Zoom;
+            recordedPath.Add(key);
+        } else if (wasRecording) {
+            // not the tracked camera_path.txt the benchmark flies by default
+            if (recordedPath.Save("resources/camera_path_recorded.txt"))
+                std::cout << "Camera path saved to resources/camera_path_recorded.txt, replay it with "
+                             "project_base_bench --path resources/camera_path_recorded.txt" << std::endl;
         }
-        //sphere (moon/sun) shader and render
-        sphere.use();
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(3.0f, 65.0f, 70.0f));
-        model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::scale(model, glm::vec3(2.0f, 2.0f, 2.0f));
-        if(!changeTheSetting) {
-            sphere.setVec3("lightColor", glm::vec3(5.0f, 5.0f, 8.0f));
-        } else {
-            sphere.setVec3("lightColor", glm::vec3(13.0f, 12.0f, 10.0f));
+        wasRecording = recordingCameraPath;
 
+        // the window's real shape; a minimized window has a 0 height, keep the last aspect then
+        if (framebufferWidth > 0 && framebufferHeight > 0)
+            aspect = (float) framebufferWidth / (float) framebufferHeight;
+        glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom), aspect, 0.1f, 100.0f);
+        glm::mat4 view = programState->camera.GetViewMatrix();
+        world->damPosition = programState->damPosition;
+        world->damScale = programState->damScale;
+        world->occlusionCulling = programState->OcclusionCulling;
+        world->projection = projection;
+        world->view = view;
+        world->eye = programState->camera.Position;
+        world->Update(jobs);
+
+        // GPU times arrive a few frames late, the controller skips frames it has already seen
+        rg::GpuProfiler::FrameTimes latest;
+        if (gpuProfiler->LatestFrame(latest)) {
+            float gpuMs = 0.0f;
+            for (float ms : latest.ms)
+                if (ms >= 0.0f)
+                    gpuMs += ms;
+            dynamicResolution->Update(latest.frameIndex, gpuMs);
         }
-        sphere.setMat4("model", model);
-        sphere.setMat4("view", view);
-        sphere.setMat4("projection", projection);
-        sphereModel.Draw(sphere);
-
-        //skybox render
-        glDepthFunc(GL_LEQUAL);
-        glDepthMask(GL_FALSE);
 
-        skybox.use();
-        view = glm::mat4(glm::mat3(programState->camera.GetViewMatrix()));
-        skybox.setMat4("view", view);
+        // the manual exposure starts from a preset per mode, Q/E adjust it from there
+        if (changeTheSetting != exposureForDay) {
+            exposure = changeTheSetting ? 0.7f : 0.4f;
+            exposureForDay = changeTheSetting;
+        }
 
-        skybox.setMat4("projection", projection);
+        // capture everything the render thread needs, after this the packet is not touched until it comes back
+        rg::FramePacket& packet = frameSlots[slot].packet;
+        packet.frameIndex = frameIndex++;
+        packet.inputTime = inputTime;
+        packet.deltaTime = deltaTime;
+        packet.viewportWidth = framebufferWidth;
+        packet.viewportHeight = framebufferHeight;
+        packet.renderScale = dynamicResolution->Scale();
+        packet.sharpness = sharpness;
+        packet.projection = projection;
+        packet.view = view;
+        packet.cameraPosition = programState->camera.Position;
+        packet.cameraFront = programState->camera.Front;
+        packet.clearColor = programState->clearColor;
+        packet.changeTheSetting = changeTheSetting;
+        // the sky just switched away from stays resident for a while, the one before that is evicted
+        packet.prewarmSky = predictiveSkyPrewarm && glfwGetTime() - skySwitchTime < SkyPrewarmSeconds;
+        packet.spotlightOn = spotlightOn;
+        packet.shadows = shadows;
+        packet.pbr = pbr;
+        packet.textureBudgetBytes = (size_t)textureBudgetMb << 20;
+        packet.textureBias = textureBias;
+        packet.bloom = bloom;
+        packet.bloomMode = bloomMode;
+        packet.bloomQuality = bloomQuality;
+        packet.compactHdr = compactHdr;
+        packet.exposure = exposure;
+        packet.autoExposure = autoExposure;
+        packet.exposureSettings = exposureSettings;
+        world->Fill(packet);
 
-        glBindVertexArray(skyboxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        if(changeTheSetting)
-            glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-        else
-            glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture2);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-        glDepthMask(GL_TRUE);
-        glDepthFunc(GL_LESS);
-//
-       glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        // 2. blur bright fragments with two-pass Gaussian Blur
-        // --------------------------------------------------
-        bool horizontal = true, first_iteration = true;
-        unsigned int amount = 10;
-        blurShader.use();
-        for (unsigned int i = 0; i < amount; i++)
-        {
-            glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[horizontal]);
-            blurShader.setInt("horizontal", horizontal);
-            glBindTexture(GL_TEXTURE_2D, first_iteration ? colorBuffers[1] : pingpongColorbuffers[!horizontal]);  // bind texture of other framebuffer (or scene if first iteration)
-            renderQuad();
-            horizontal = !horizontal;
-            if (first_iteration)
-                first_iteration = false;
-        }
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-        // 3. now render floating point color buffer to 2D quad and tonemap HDR colors to default framebuffer's (clamped) color range
-        // --------------------------------------------------------------------------------------------------------------------------
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        bloomShader.use();
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, colorBuffers[0]);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[!horizontal]);
-        bloomShader.setInt("bloom", bloom);
-        bloomShader.setFloat("exposure", exposure);
-        renderQuad();
-
-        if (programState->ImGuiEnabled)
+        if (programState->ImGuiEnabled) {
+            RG_PROFILE_SCOPE("imgui build");
             DrawImGui(programState);
-        // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-        // -------------------------------------------------------------------------------
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+            frameSlots[slot].ui.Capture(ImGui::GetDrawData());
+        } else {
+            frameSlots[slot].ui.Clear();
+        }
+
+        // never fails: the render thread can hold at most the other two packets
+        submittedFrames.TryPush(slot);
+        framePacer->FrameQueued();
     }
 
+    rendering = false;
+    renderThread.join();
+    glfwMakeContextCurrent(window);
+    rg::GlDebugOutput::AttachThread();
+    for (FrameSlot& frameSlot : frameSlots)
+        frameSlot.ui.Clear();
     programState->SaveToFile("resources/program_state.txt");
     delete programState;
+    delete world;
+    delete renderer;
+    delete framePacer;
+    delete gpuProfiler;
+    delete dynamicResolution;
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -762,9 +453,10 @@ void processInput(GLFWwindow *window) {
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
 // ---------------------------------------------------------------------------------------------
 void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
-    // make sure the viewport matches the new window dimensions; note that width and
-    // height will be significantly larger than specified on retina displays.
-    glViewport(0, 0, width, height);
+    // the render thread owns the context, it sets the viewport from the next packet; note that
+    // width and height will be significantly larger than specified on retina displays.
+    framebufferWidth = width;
+    framebufferHeight = height;
 }
 
 //// glfw: whenever the mouse moves, this callback is called
@@ -792,8 +484,8 @@ void scroll_callback(GLFWwindow *window, double xoffset, double yoffset) {
     programState->camera.ProcessMouseScroll(yoffset);
 }
 
+// builds the UI for this frame; the draw data is submitted later, on the render thread
 void DrawImGui(ProgramState *programState) {
-    ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
 
@@ -805,6 +497,11 @@ void DrawImGui(ProgramState *programState) {
         ImGui::Text("press M to switch from day/night");
         ImGui::Text("press SHIFT to move faster/slower");
         ImGui::Text("press SPACE to turn bloom on/off");
+        ImGui::Text("press B to switch between Gaussian and mip chain bloom");
+        ImGui::Text("press X to switch between automatic and manual (Q/E) exposure");
+        ImGui::Text("press P to switch the frame pacing mode");
+        ImGui::Text("press T to write a CPU trace to cpu_trace.json");
+        ImGui::Text("press C to start/stop recording a benchmark camera path");
 
         ImGui::End();
     }
@@ -819,8 +516,137 @@ void DrawImGui(ProgramState *programState) {
         ImGui::End();
     }
 
+    {
+        ImGui::Begin("Culling");
+        ImGui::Checkbox("Occlusion culling", &programState->OcclusionCulling);
+        ImGui::Text("Occluder triangles: %d", world->culler.TriangleCount());
+        ImGui::Text("Culled: %d / %d", world->culler.CulledCount(), world->culler.TestedCount());
+        ImGui::End();
+    }
+
+    {
+        ImGui::Begin("Lights");
+        ImGui::Checkbox("PBR dam material (baked IBL)", &pbr);
+        ImGui::SliderInt("Extra point lights", &world->extraLights, 0, 1024);
+        ImGui::Text("Point lights: %d (night mode only)", world->lightClusters.LightCount());
+        ImGui::Text("Per cluster: %.2f avg, %d max", world->lightClusters.AveragePerCluster(),
+                    world->lightClusters.MaxPerCluster());
+        ImGui::End();
+    }
+
+    {
+        ImGui::Begin("Skybox");
+        ImGui::Checkbox("Keep the previous sky after a switch", &predictiveSkyPrewarm);
+        const rg::SkyboxCache& skyboxes = renderer->Skyboxes();
+        ImGui::Text("Resident: %.1f MB", skyboxes.ResidentBytes() / (1024.0 * 1024.0));
+        ImGui::Text("Loads: %d, evictions: %d", skyboxes.Loads(), skyboxes.Evictions());
+        ImGui::End();
+    }
+
+    {
+        ImGui::Begin("Texture streaming");
+        ImGui::SliderInt("Budget (MB)", &textureBudgetMb, 0, 256);
+        ImGui::SliderFloat("Mip bias", &textureBias, -1.0f, 3.0f, "%.1f");
+        const rg::TextureStreamer& streamer = renderer->textureStreamer;
+        ImGui::Text("Wanted: %.1f MB, resident: %.1f MB", streamer.TargetBytes() / (1024.0 * 1024.0),
+                    streamer.ResidentBytes() / (1024.0 * 1024.0));
+        ImGui::Text("Stream-ins: %d, evictions: %d", streamer.StreamIns(), streamer.Evictions());
+        ImGui::End();
+    }
+
+    {
+        ImGui::Begin("Shadows");
+        ImGui::Checkbox("Shadows", &shadows);
+        ImGui::Text("Static caster renders: %d this frame, %d total", renderer->ShadowStaticRenders(),
+                    renderer->ShadowTotalStaticRenders());
+        ImGui::End();
+    }
+
+    {
+        ImGui::Begin("Frame pacing");
+        int mode = (int)framePacer->Mode();
+        if (ImGui::Combo("Mode", &mode, "VSync\0Capped\0Low latency\0"))
+            framePacer->SetMode((rg::PacingMode)mode);
+        float fps = framePacer->TargetFps();
+        if (ImGui::SliderFloat("Target FPS", &fps, 30.0f, 240.0f, "%.0f"))
+            framePacer->SetTargetFps(fps);
+        ImGui::Text("Frame: %.2f ms (jitter %.2f ms)", framePacer->FrameMs(), framePacer->JitterMs());
+        ImGui::Text("Input to GPU done: %.2f ms", framePacer->LatencyMs());
+        ImGui::Text("GPU frames in flight: %d", framePacer->GpuFramesInFlight());
+        ImGui::End();
+    }
+
+    {
+        ImGui::Begin("Bloom");
+        int mode = (int)bloomMode;
+        if (ImGui::Combo("Mode", &mode, "Gaussian\0Mip chain\0"))
+            bloomMode = (rg::BloomMode)mode;
+        int quality = (int)bloomQuality;
+        if (ImGui::Combo("Mip chain quality", &quality, "Low\0Medium\0High\0"))
+            bloomQuality = (rg::BloomQuality)quality;
+        // both paths keep their history, so switching back and forth compares them directly
+        for (const rg::GpuProfiler::PassStats& pass : gpuProfiler->Stats()) {
+            if (pass.name == "blur")
+                ImGui::Text("Gaussian:  %.3f ms avg, %.3f ms p99", pass.avgMs, pass.p99Ms);
+            else if (pass.name == "bloom_mips")
+                ImGui::Text("Mip chain: %.3f ms avg, %.3f ms p99", pass.avgMs, pass.p99Ms);
+        }
+        ImGui::End();
+    }
+
+    {
+        ImGui::Begin("Exposure");
+        ImGui::Checkbox("Automatic", &autoExposure);
+        ImGui::SliderFloat("Key", &exposureSettings.key, 0.05f, 1.0f, "%.2f");
+        ImGui::SliderFloat("Min exposure", &exposureSettings.minExposure, 0.01f, 1.0f, "%.2f");
+        ImGui::SliderFloat("Max exposure", &exposureSettings.maxExposure, 0.5f, 8.0f, "%.2f");
+        ImGui::SliderFloat("Brighten speed", &exposureSettings.speedUp, 0.1f, 10.0f, "%.1f /s");
+        ImGui::SliderFloat("Darken speed", &exposureSettings.speedDown, 0.1f, 10.0f, "%.1f /s");
+        // the GPU applies the adapted value directly, this is the delayed copy read back for display
+        float luminance = renderer->AdaptedLuminance();
+        if (autoExposure && luminance >= 0.0f) {
+            float applied = glm::clamp(exposureSettings.key / std::max(luminance, 0.0001f),
+                                       exposureSettings.minExposure, exposureSettings.maxExposure);
+            ImGui::Text("Adapted luminance: %.4f, exposure %.3f", luminance, applied);
+        } else {
+            ImGui::Text("Manual exposure: %.3f", exposure);
+        }
+        ImGui::End();
+    }
+
+    {
+        ImGui::Begin("Dynamic resolution");
+        ImGui::Checkbox("Enabled", &dynamicResolution->enabled);
+        ImGui::SliderFloat("GPU budget (ms)", &dynamicResolution->targetMs, 4.0f, 33.0f, "%.1f");
+        ImGui::SliderFloat("Minimum scale", &dynamicResolution->minScale, 0.25f, 1.0f, "%.2f");
+        ImGui::SliderFloat("Sharpness", &sharpness, 0.0f, 1.0f, "%.2f");
+        float scale = dynamicResolution->Scale();
+        ImGui::Text("Scale: %.2f (%d x %d)", scale, (int)std::lround(framebufferWidth * scale),
+                    (int)std::lround(framebufferHeight * scale));
+        ImGui::Text("GPU time: %.2f ms smoothed", dynamicResolution->SmoothedMs());
+        ImGui::End();
+    }
+
+    {
+        ImGui::Begin("GPU passes");
+        ImGui::Text("%-10s %8s %8s %8s %8s", "pass", "last", "min", "avg", "p99");
+        for (const rg::GpuProfiler::PassStats& pass : gpuProfiler->Stats())
+            ImGui::Text("%-10s %8.3f %8.3f %8.3f %8.3f", pass.name.c_str(), pass.lastMs, pass.minMs, pass.avgMs, pass.p99Ms);
+        rg::PostGraph::Stats post = renderer->PostStats();
+        ImGui::Text("Post passes: %d run, %d culled", post.passes - post.culledPasses, post.culledPasses);
+        ImGui::Text("Post targets: %d declared, %d textures", post.resources, post.textures);
+        ImGui::Text("Post VRAM: %.1f MB (%.1f MB without aliasing)",
+                    post.pooledBytes / (1024.0 * 1024.0), post.declaredBytes / (1024.0 * 1024.0));
+        // the scene pass time above is the measured side of the switch, the traffic the estimated one
+        ImGui::Checkbox("R11G11B10F scene color", &compactHdr);
+        ImGui::Text("Target traffic: %.1f MB written, %.1f MB read per frame",
+                    post.writtenBytes / (1024.0 * 1024.0), post.readBytes / (1024.0 * 1024.0));
+        if (ImGui::Button("Write gpu_passes.csv"))
+            gpuProfiler->WriteCsv("gpu_passes.csv");
+        ImGui::End();
+    }
+
     ImGui::Render();
-    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
 
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
@@ -860,116 +686,26 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
     }
     if(glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS){
         changeTheSetting = !changeTheSetting;
+        skySwitchTime = glfwGetTime();
     }
-}
-unsigned int loadTexture(char const* path)
-{
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_2D, textureID);
-
-    int width, height, nrChannels;
-    unsigned char *data = stbi_load(path, &width, &height, &nrChannels, 0);
-    GLenum format, internalFormat;
-    if (nrChannels == 1)
-        format = internalFormat = GL_RED;
-    else if (nrChannels == 3){
-        format = GL_RGB;
-        internalFormat = GL_SRGB;
-    }
-    else if (nrChannels == 4){
-        format = GL_RGBA;
-        internalFormat = GL_SRGB_ALPHA;
-    }
-
-    if (data)
-    {
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glGenerateMipmap(GL_TEXTURE_2D);
-        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-        stbi_image_free(data);
+    if (key == GLFW_KEY_C && action == GLFW_PRESS) {
+        recordingCameraPath = !recordingCameraPath;
+        std::cout << (recordingCameraPath ? "Recording camera path" : "Camera path recording stopped") << std::endl;
     }
-    else {
-        std::cout << "Cubemap texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+    if (key == GLFW_KEY_T && action == GLFW_PRESS) {
+        if (rg::Profiler::Instance().WriteChromeTrace("cpu_trace.json"))
+            std::cout << "CPU trace written to cpu_trace.json" << std::endl;
     }
-
-    return textureID;
-}
-unsigned int loadCubemap(vector<std::string> faces)
-{
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-    int width, height, nrChannels;
-    for (unsigned int i = 0; i < faces.size(); i++)
-    {
-        unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data)
-        {
-            GLenum internalFormat;
-            GLenum dataFormat;
-            if (nrChannels == 1) {
-                internalFormat = dataFormat = GL_RED;
-            } else if (nrChannels == 3) {
-                internalFormat = GL_SRGB;
-                dataFormat = GL_RGB;
-            } else if (nrChannels == 4) {
-                internalFormat = GL_SRGB_ALPHA;
-                dataFormat = GL_RGBA;
-            }
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, internalFormat, width, height, 0, dataFormat, GL_UNSIGNED_BYTE, data);
-
-            stbi_image_free(data);
-        }
-        else
-        {
-            std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-            stbi_image_free(data);
-        }
+    if (key == GLFW_KEY_X && action == GLFW_PRESS) {
+        autoExposure = !autoExposure;
+    }
+    if (key == GLFW_KEY_B && action == GLFW_PRESS) {
+        bloomMode = bloomMode == rg::BloomMode::Gaussian ? rg::BloomMode::MipChain : rg::BloomMode::Gaussian;
+        std::cout << "Bloom: " << rg::BloomModeName(bloomMode) << std::endl;
+    }
+    if (key == GLFW_KEY_P && action == GLFW_PRESS) {
+        int next = ((int)framePacer->Mode() + 1) % (int)rg::PacingMode::Count;
+        framePacer->SetMode((rg::PacingMode)next);
+        std::cout << "Frame pacing: " << rg::PacingModeName((rg::PacingMode)next) << std::endl;
     }
-
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-    return textureID;
 }
-
-unsigned int quadVAO = 0;
-unsigned int quadVBO;
-void renderQuad()
-{
-    if (quadVAO == 0)
-    {
-        float quadVertices[] = {
-                // positions        // texture Coords
-                -1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
-                -1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
-                1.0f,  1.0f, 0.0f, 1.0f, 1.0f,
-                1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
-        };
-        // setup plane VAO
-        glGenVertexArrays(1, &quadVAO);
-        glGenBuffers(1, &quadVBO);
-        glBindVertexArray(quadVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-    }
-    glBindVertexArray(quadVAO);
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    glBindVertexArray(0);
-}
\ No newline at end of file
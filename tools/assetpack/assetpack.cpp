@@ -0,0 +1,219 @@
+// Asset packer: writes the files under the given paths into one pack FileSystem can mount, with
+// a sorted index and every entry aligned for direct use from the mapping. Entries that shrink
+// enough are LZ4 compressed, on every core with the job system; already compressed formats
+// (PNG, JPEG) stay stored and are handed to the loaders without a copy.
+//
+//   project_base_assetpack [--store] [--min-saving PERCENT] out.pack path...
+//
+// Run it from the repository root, entries are named by the path they were found under, e.g.
+//   ./project_base_assetpack resources.pack resources
+
+#include <rg/AssetPack.h>
+#include <rg/JobSystem.h>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+    const uint32_t Alignment = 64; // a cache line, and more than any loader needs
+
+    struct Options {
+        std::string out;
+        std::vector<std::string> paths;
+        bool store = false;   // no compression at all
+        int minSaving = 12;   // percent an entry has to shrink by to be kept compressed
+    };
+
+    struct File {
+        std::string name;
+        std::vector<unsigned char> bytes; // as stored in the pack
+        uint64_t size = 0;                // before compression
+        uint32_t compression = rg::AssetPack::Stored;
+    };
+
+    bool parseOptions(int argc, char** argv, Options& options) {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--store") {
+                options.store = true;
+            } else if (arg == "--min-saving") {
+                if (i + 1 >= argc) {
+                    std::cerr << "missing value for " << arg << std::endl;
+                    return false;
+                }
+                options.minSaving = std::min(100, std::max(0, std::atoi(argv[++i])));
+            } else if (options.out.empty()) {
+                options.out = arg;
+            } else {
+                options.paths.push_back(arg);
+            }
+        }
+        return !options.out.empty() && !options.paths.empty();
+    }
+
+    // editor backups and dotfiles are never assets
+    bool skipped(const std::string& name) {
+        return name.empty() || name[0] == '.' || name.back() == '~';
+    }
+
+    void collect(const std::string& path, std::vector<std::string>& files) {
+        struct stat info;
+        if (::stat(path.c_str(), &info) != 0) {
+            std::cerr << "skipping " << path << ": not found" << std::endl;
+            return;
+        }
+        if (S_ISREG(info.st_mode)) {
+            files.push_back(path);
+            return;
+        }
+        if (!S_ISDIR(info.st_mode)) {
+            return;
+        }
+        DIR* directory = ::opendir(path.c_str());
+        if (!directory) {
+            return;
+        }
+        while (dirent* entry = ::readdir(directory)) {
+            std::string name = entry->d_name;
+            if (!skipped(name)) {
+                collect(path + '/' + name, files);
+            }
+        }
+        ::closedir(directory);
+    }
+
+    std::string normalized(std::string path) {
+        while (path.compare(0, 2, "./") == 0) {
+            path = path.substr(2);
+        }
+        return path;
+    }
+
+    void pad(std::ofstream& out, uint64_t& offset) {
+        static const char zeros[Alignment] = {};
+        uint64_t padding = (Alignment - offset % Alignment) % Alignment;
+        out.write(zeros, (std::streamsize)padding);
+        offset += padding;
+    }
+
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << "usage: project_base_assetpack [--store] [--min-saving PERCENT] out.pack path..." << std::endl;
+        return 2;
+    }
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::string> paths;
+    for (const std::string& path : options.paths) {
+        collect(path, paths);
+    }
+    std::vector<File> files;
+    for (const std::string& path : paths) {
+        File file;
+        file.name = normalized(path);
+        if (file.name == normalized(options.out)) {
+            continue; // an older pack inside the packed tree
+        }
+        rg::AssetData data;
+        if (!rg::ReadLooseFile(path, data)) {
+            std::cerr << "Failed to read " << path << std::endl;
+            return 1;
+        }
+        file.bytes.assign(data.Data(), data.Data() + data.Size());
+        file.size = file.bytes.size();
+        files.push_back(std::move(file));
+    }
+    // the runtime finds entries by binary search over the names as bytes
+    std::sort(files.begin(), files.end(), [](const File& a, const File& b) {
+        return a.name < b.name;
+    });
+    for (size_t i = 1; i < files.size(); i++) {
+        if (files[i].name == files[i - 1].name) {
+            std::cerr << files[i].name << " is given twice" << std::endl;
+            return 1;
+        }
+    }
+
+    if (!options.store) {
+        rg::JobSystem jobs;
+        jobs.ParallelFor(files.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                File& file = files[i];
+                if (file.bytes.empty() || file.bytes.size() > UINT32_MAX) {
+                    continue;
+                }
+                std::vector<unsigned char> compressed = rg::Lz4Compress(file.bytes.data(), file.bytes.size());
+                if (compressed.size() * 100 <= file.bytes.size() * (size_t)(100 - options.minSaving)) {
+                    file.bytes.swap(compressed);
+                    file.compression = rg::AssetPack::Lz4;
+                }
+            }
+        });
+    }
+
+    std::ofstream out(options.out, std::ios::binary);
+    if (!out) {
+        std::cerr << "Failed to write " << options.out << std::endl;
+        return 1;
+    }
+    rg::AssetPack::Header header = {};
+    std::memcpy(header.magic, rg::AssetPack::Magic(), 8);
+    header.entryCount = (uint32_t)files.size();
+    header.alignment = Alignment;
+    out.write((const char*)&header, sizeof(header));
+    uint64_t offset = sizeof(header);
+
+    std::vector<rg::AssetPack::Entry> entries(files.size());
+    std::string names;
+    uint64_t rawBytes = 0, storedBytes = 0;
+    int compressedCount = 0;
+    for (size_t i = 0; i < files.size(); i++) {
+        File& file = files[i];
+        rg::AssetPack::Entry& entry = entries[i];
+        pad(out, offset);
+        entry.offset = offset;
+        entry.storedSize = file.bytes.size();
+        entry.size = file.size;
+        entry.compression = file.compression;
+        entry.nameOffset = (uint32_t)names.size();
+        entry.nameLength = (uint32_t)file.name.size();
+        names += file.name;
+        out.write((const char*)file.bytes.data(), (std::streamsize)file.bytes.size());
+        offset += file.bytes.size();
+
+        rawBytes += entry.size;
+        storedBytes += entry.storedSize;
+        compressedCount += file.compression == rg::AssetPack::Lz4;
+    }
+    pad(out, offset);
+    header.indexOffset = offset;
+    out.write((const char*)entries.data(), (std::streamsize)(entries.size() * sizeof(rg::AssetPack::Entry)));
+    offset += entries.size() * sizeof(rg::AssetPack::Entry);
+    header.namesOffset = offset;
+    out.write(names.data(), (std::streamsize)names.size());
+    out.seekp(0);
+    out.write((const char*)&header, sizeof(header));
+    if (!out) {
+        std::cerr << "Failed to write " << options.out << std::endl;
+        return 1;
+    }
+    out.close();
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "packed " << files.size() << " files (" << compressedCount << " LZ4), " << rawBytes / 1024 << " KB into "
+              << storedBytes / 1024 << " KB in " << ms << " ms" << std::endl;
+    return 0;
+}
@@ -0,0 +1,323 @@
+// Headless benchmark: loads the demo scene into an EGL context, plays back a camera path with a
+// fixed timestep and reports per-frame CPU and GPU times plus a load-time breakdown.
+//
+//   project_base_bench [--frames N] [--warmup N] [--path file] [--width W] [--height H]
+//                      [--dt seconds] [--csv file] [--json file] [--hdr rgba16f|r11g11b10f]
+//                      [--lights N] [--pack file]
+//
+// Runs from the repository root like the demo, resources are loaded by relative path.
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/camera.h>
+#include <rg/CameraPath.h>
+#include <rg/GpuProfiler.h>
+#include <rg/HeadlessContext.h>
+#include <rg/JobSystem.h>
+#include <rg/Profiler.h>
+#include <rg/Renderer.h>
+#include <rg/World.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+    struct Options {
+        int frames = 600;
+        int warmup = 30; // rendered but not measured, lets shader compilation and caches settle
+        int width = 1280;
+        int height = 720;
+        float timestep = 1.0f / 60.0f;
+        std::string path = "resources/camera_path.txt";
+        std::string csv = "bench_frames.csv";
+        std::string json = "bench_summary.json";
+        bool compactHdr = false; // scene color in R11F_G11F_B10F instead of RGBA16F
+        int lights = 0;          // extra point lights, see World::extraLights
+        std::string pack;        // asset pack to load from instead of the loose files
+    };
+
+    struct FrameRecord {
+        uint64_t frameIndex = 0;
+        double simMs = 0.0;    // world update and packet fill
+        double submitMs = 0.0; // CPU time issuing GL commands
+        double frameMs = 0.0;  // whole frame, glFinish included
+        std::vector<float> gpuMs;
+    };
+
+    struct Summary {
+        double mean = 0.0, p50 = 0.0, p90 = 0.0, p99 = 0.0, max = 0.0;
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    double millisecondsSince(Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    bool parseOptions(int argc, char** argv, Options& options) {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                std::cerr << "missing value for " << arg << std::endl;
+                return false;
+            }
+            const char* value = argv[++i];
+            if (arg == "--frames") {
+                options.frames = std::max(1, std::atoi(value));
+            } else if (arg == "--warmup") {
+                options.warmup = std::max(0, std::atoi(value));
+            } else if (arg == "--width") {
+                options.width = std::max(1, std::atoi(value));
+            } else if (arg == "--height") {
+                options.height = std::max(1, std::atoi(value));
+            } else if (arg == "--dt") {
+                options.timestep = (float)std::atof(value);
+            } else if (arg == "--path") {
+                options.path = value;
+            } else if (arg == "--csv") {
+                options.csv = value;
+            } else if (arg == "--json") {
+                options.json = value;
+            } else if (arg == "--lights") {
+                options.lights = std::max(0, std::atoi(value));
+            } else if (arg == "--pack") {
+                options.pack = value;
+            } else if (arg == "--hdr") {
+                if (std::strcmp(value, "rgba16f") != 0 && std::strcmp(value, "r11g11b10f") != 0) {
+                    std::cerr << "unknown HDR format " << value << std::endl;
+                    return false;
+                }
+                options.compactHdr = std::strcmp(value, "r11g11b10f") == 0;
+            } else {
+                std::cerr << "unknown option " << arg << std::endl;
+                return false;
+            }
+        }
+        return options.timestep > 0.0f;
+    }
+
+    Summary summarize(std::vector<double> samples) {
+        Summary summary;
+        if (samples.empty()) {
+            return summary;
+        }
+        std::sort(samples.begin(), samples.end());
+        double sum = 0.0;
+        for (double sample : samples) {
+            sum += sample;
+        }
+        auto percentile = [&samples](double p) {
+            size_t rank = (size_t)std::ceil(samples.size() * p);
+            return samples[std::min(std::max<size_t>(rank, 1), samples.size()) - 1];
+        };
+        summary.mean = sum / samples.size();
+        summary.p50 = percentile(0.50);
+        summary.p90 = percentile(0.90);
+        summary.p99 = percentile(0.99);
+        summary.max = samples.back();
+        return summary;
+    }
+
+    void writeSummary(std::ostream& out, const std::string& name, const Summary& summary, bool last) {
+        out << "    \"" << name << "\": {\"mean\": " << summary.mean << ", \"p50\": " << summary.p50
+            << ", \"p90\": " << summary.p90 << ", \"p99\": " << summary.p99 << ", \"max\": " << summary.max
+            << "}" << (last ? "\n" : ",\n");
+    }
+
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << "usage: project_base_bench [--frames N] [--warmup N] [--path file] [--width W] [--height H]"
+                     " [--dt seconds] [--csv file] [--json file] [--hdr rgba16f|r11g11b10f] [--lights N]"
+                     " [--pack file]" << std::endl;
+        return 2;
+    }
+    rg::Profiler::Instance().SetThreadName("main");
+
+    rg::CameraPath path;
+    if (!path.Load(options.path)) {
+        std::cerr << "Failed to load camera path " << options.path << std::endl;
+        return 1;
+    }
+
+    Clock::time_point start = Clock::now();
+    rg::HeadlessContext context;
+    if (!context.Create(options.width, options.height)) {
+        std::cerr << "Failed to create headless context: " << context.Error() << std::endl;
+        return 1;
+    }
+    double contextMs = millisecondsSince(start);
+    std::cout << "GL renderer: " << rg::HeadlessContext::RendererName() << std::endl;
+
+    start = Clock::now();
+    if (!options.pack.empty() && !FileSystem::mount(options.pack)) {
+        std::cerr << "Failed to mount asset pack " << options.pack << std::endl;
+        return 1;
+    }
+    rg::Renderer renderer;
+    double rendererMs = millisecondsSince(start);
+
+    start = Clock::now();
+    rg::World world(renderer.damModel, renderer.moonModel);
+    rg::JobSystem jobs;
+    world.extraLights = options.lights;
+    double worldMs = millisecondsSince(start);
+    // taken now, before the frame zones start filling the rings
+    std::map<std::string, rg::Profiler::ZoneTotal> loadZones = rg::Profiler::Instance().Totals();
+
+    int totalFrames = options.warmup + options.frames;
+    rg::GpuProfiler gpuProfiler(totalFrames + rg::GpuProfiler::FrameLatency);
+    std::vector<FrameRecord> records;
+    records.reserve(options.frames);
+
+    rg::FramePacket packet;
+    packet.viewportWidth = options.width;
+    packet.viewportHeight = options.height;
+    packet.compactHdr = options.compactHdr;
+    float aspect = (float)options.width / (float)options.height;
+    for (int frame = 0; frame < totalFrames; ++frame) {
+        Clock::time_point frameStart = Clock::now();
+        FrameRecord record;
+        record.frameIndex = (uint64_t)frame;
+
+        // fixed timestep, so every run sees the same camera at the same frame
+        rg::CameraKey key = path.Sample(frame * options.timestep);
+        Camera camera(key.position, glm::vec3(0.0f, 1.0f, 0.0f), key.yaw, key.pitch);
+        camera.Zoom = key.zoom;
+        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), aspect, 0.1f, 100.0f);
+        glm::mat4 view = camera.GetViewMatrix();
+
+        world.projection = projection;
+        world.view = view;
+        world.eye = camera.Position;
+        world.Update(jobs);
+        packet.frameIndex = (uint64_t)frame;
+        packet.projection = projection;
+        packet.view = view;
+        packet.cameraPosition = camera.Position;
+        packet.cameraFront = camera.Front;
+        world.Fill(packet);
+        record.simMs = millisecondsSince(frameStart);
+        // streams what this frame wants before it is timed, so no run times background uploads
+        Clock::time_point flushStart = Clock::now();
+        renderer.FlushTextureStreaming(packet);
+        double flushMs = millisecondsSince(flushStart);
+
+        Clock::time_point submitStart = Clock::now();
+        gpuProfiler.BeginFrame((uint64_t)frame);
+        renderer.Render(packet, &gpuProfiler);
+        gpuProfiler.EndFrame();
+        record.submitMs = millisecondsSince(submitStart);
+
+        // no swap chain to pace against, wait for the GPU so frame time is the real cost
+        glFinish();
+        record.frameMs = millisecondsSince(frameStart) - flushMs;
+        if (frame >= options.warmup) {
+            records.push_back(record);
+        }
+    }
+    gpuProfiler.Finish();
+
+    std::vector<std::string> passes = gpuProfiler.PassNames();
+    std::vector<rg::GpuProfiler::FrameTimes> gpuFrames = gpuProfiler.History();
+    for (const rg::GpuProfiler::FrameTimes& times : gpuFrames) {
+        if (times.frameIndex >= (uint64_t)options.warmup) {
+            size_t index = (size_t)(times.frameIndex - options.warmup);
+            if (index < records.size()) {
+                records[index].gpuMs = times.ms;
+            }
+        }
+    }
+    gpuProfiler.Release();
+
+    std::ofstream csv(options.csv);
+    if (!csv) {
+        std::cerr << "Failed to write " << options.csv << std::endl;
+        return 1;
+    }
+    csv << "frame,sim_ms,submit_ms,frame_ms";
+    for (const std::string& pass : passes) {
+        csv << ",gpu_" << pass << "_ms";
+    }
+    csv << ",gpu_total_ms\n";
+    std::vector<double> simMs, submitMs, frameMs, gpuTotalMs;
+    std::vector<std::vector<double>> passMs(passes.size());
+    for (const FrameRecord& record : records) {
+        csv << record.frameIndex << ',' << record.simMs << ',' << record.submitMs << ',' << record.frameMs;
+        simMs.push_back(record.simMs);
+        submitMs.push_back(record.submitMs);
+        frameMs.push_back(record.frameMs);
+        double total = 0.0;
+        for (size_t pass = 0; pass < passes.size(); ++pass) {
+            csv << ',';
+            if (pass < record.gpuMs.size() && record.gpuMs[pass] >= 0.0f) {
+                csv << record.gpuMs[pass];
+                passMs[pass].push_back(record.gpuMs[pass]);
+                total += record.gpuMs[pass];
+            }
+        }
+        csv << ',';
+        if (!record.gpuMs.empty()) {
+            csv << total;
+            gpuTotalMs.push_back(total);
+        }
+        csv << '\n';
+    }
+
+    std::ofstream json(options.json);
+    if (!json) {
+        std::cerr << "Failed to write " << options.json << std::endl;
+        return 1;
+    }
+    json << "{\n  \"renderer\": \"" << rg::HeadlessContext::RendererName() << "\",\n"
+         << "  \"frames\": " << records.size() << ",\n"
+         << "  \"width\": " << options.width << ",\n"
+         << "  \"height\": " << options.height << ",\n"
+         << "  \"timestep\": " << options.timestep << ",\n"
+         << "  \"path\": \"" << options.path << "\",\n"
+         << "  \"hdr_format\": \"" << (options.compactHdr ? "r11g11b10f" : "rgba16f") << "\",\n"
+         << "  \"extra_lights\": " << options.lights << ",\n"
+         << "  \"asset_pack\": \"" << options.pack << "\",\n"
+         << "  \"load_ms\": {\n"
+         << "    \"context\": " << contextMs << ",\n"
+         << "    \"renderer\": " << rendererMs << ",\n"
+         << "    \"world\": " << worldMs << ",\n"
+         << "    \"zones\": {";
+    bool firstZone = true;
+    for (const auto& zone : loadZones) {
+        json << (firstZone ? "\n" : ",\n") << "      \"" << zone.first << "\": {\"count\": " << zone.second.count
+             << ", \"ms\": " << zone.second.totalMs << "}";
+        firstZone = false;
+    }
+    json << "\n    }\n  },\n  \"cpu_ms\": {\n";
+    writeSummary(json, "sim", summarize(simMs), false);
+    writeSummary(json, "submit", summarize(submitMs), false);
+    writeSummary(json, "frame", summarize(frameMs), true);
+    json << "  },\n  \"gpu_ms\": {\n";
+    for (size_t pass = 0; pass < passes.size(); ++pass) {
+        writeSummary(json, passes[pass], summarize(passMs[pass]), false);
+    }
+    writeSummary(json, "total", summarize(gpuTotalMs), true);
+    json << "  }\n}\n";
+
+    Summary frame = summarize(frameMs);
+    Summary gpu = summarize(gpuTotalMs);
+    std::cout << "load: context " << contextMs << " ms, renderer " << rendererMs << " ms, world " << worldMs << " ms\n"
+              << records.size() << " frames: frame p50 " << frame.p50 << " ms, p99 " << frame.p99
+              << " ms; gpu p50 " << gpu.p50 << " ms, p99 " << gpu.p99 << " ms\n"
+              << "wrote " << options.csv << " and " << options.json << std::endl;
+    return 0;
+}
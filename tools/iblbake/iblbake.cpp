@@ -0,0 +1,400 @@
+// Offline image based lighting bake: convolves a skybox cubemap on the CPU into the diffuse
+// irradiance and GGX prefiltered specular maps the PBR material path samples, or writes the
+// environment independent BRDF lookup table. All of it is per texel independent work, spread
+// over every core with the job system.
+//
+//   project_base_iblbake [--irradiance N] [--specular N] [--mips N] [--samples N] out.ibl +x -x +y -y +z -z
+//   project_base_iblbake --lut out.lut [--size N] [--samples N]
+//
+// Faces are the same images, in the same order, the renderer loads for the skybox. The results
+// are checked in under resources/ibl, rerun this when a skybox changes.
+
+#include <glm/glm.hpp>
+#include <stb_image.h>
+
+#include <rg/Ibl.h>
+#include <rg/JobSystem.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+    const float Pi = 3.14159265358979f;
+
+    struct Options {
+        std::string out;
+        std::vector<std::string> faces;
+        bool lut = false;
+        int irradianceSize = 32;
+        int specularSize = 128;
+        int specularMips = 5;
+        int lutSize = 128;
+        int samples = 512; // GGX samples per texel
+    };
+
+    // one face of one mip, linear RGB
+    struct FaceImage {
+        int size = 0;
+        std::vector<glm::vec3> texels;
+
+        const glm::vec3& At(int x, int y) const {
+            return texels[(size_t)y * size + x];
+        }
+    };
+
+    // a cubemap with its box filtered mip chain, mips[level][face]
+    struct Cubemap {
+        std::vector<std::vector<FaceImage>> mips;
+    };
+
+    bool parseOptions(int argc, char** argv, Options& options) {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--lut" || arg == "--irradiance" || arg == "--specular" || arg == "--mips" ||
+                arg == "--samples" || arg == "--size") {
+                if (i + 1 >= argc) {
+                    std::cerr << "missing value for " << arg << std::endl;
+                    return false;
+                }
+                const char* value = argv[++i];
+                if (arg == "--lut") {
+                    options.lut = true;
+                    options.out = value;
+                } else if (arg == "--irradiance") {
+                    options.irradianceSize = std::min(std::max(1, std::atoi(value)), (int)rg::IblEnvironment::MaxSize);
+                } else if (arg == "--specular") {
+                    options.specularSize = std::min(std::max(1, std::atoi(value)), (int)rg::IblEnvironment::MaxSize);
+                } else if (arg == "--mips") {
+                    options.specularMips = std::max(1, std::atoi(value));
+                } else if (arg == "--samples") {
+                    options.samples = std::max(1, std::atoi(value));
+                } else {
+                    options.lutSize = std::max(1, std::atoi(value));
+                }
+            } else if (!options.lut && options.out.empty()) {
+                options.out = arg;
+            } else {
+                options.faces.push_back(arg);
+            }
+        }
+        return options.lut ? options.faces.empty() : !options.out.empty() && options.faces.size() == 6;
+    }
+
+    float srgbToLinear(unsigned char value) {
+        float c = value / 255.0f;
+        return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+    }
+
+    // direction through texel (x, y) of a face, GL cubemap conventions
+    glm::vec3 texelDirection(int face, int x, int y, int size) {
+        float s = 2.0f * (x + 0.5f) / size - 1.0f;
+        float t = 2.0f * (y + 0.5f) / size - 1.0f;
+        switch (face) {
+            case 0: return glm::normalize(glm::vec3(1.0f, -t, -s));
+            case 1: return glm::normalize(glm::vec3(-1.0f, -t, s));
+            case 2: return glm::normalize(glm::vec3(s, 1.0f, t));
+            case 3: return glm::normalize(glm::vec3(s, -1.0f, -t));
+            case 4: return glm::normalize(glm::vec3(s, -t, 1.0f));
+            default: return glm::normalize(glm::vec3(-s, -t, -1.0f));
+        }
+    }
+
+    // face and [0, 1] coordinates a direction hits, the inverse of texelDirection
+    int directionTexel(const glm::vec3& d, float& u, float& v) {
+        glm::vec3 a = glm::abs(d);
+        int face;
+        float sc, tc, ma;
+        if (a.x >= a.y && a.x >= a.z) {
+            face = d.x > 0.0f ? 0 : 1;
+            sc = d.x > 0.0f ? -d.z : d.z;
+            tc = -d.y;
+            ma = a.x;
+        } else if (a.y >= a.z) {
+            face = d.y > 0.0f ? 2 : 3;
+            sc = d.x;
+            tc = d.y > 0.0f ? d.z : -d.z;
+            ma = a.y;
+        } else {
+            face = d.z > 0.0f ? 4 : 5;
+            sc = d.z > 0.0f ? d.x : -d.x;
+            tc = -d.y;
+            ma = a.z;
+        }
+        u = 0.5f * (sc / ma + 1.0f);
+        v = 0.5f * (tc / ma + 1.0f);
+        return face;
+    }
+
+    // bilinear within the face, clamped at its edges
+    glm::vec3 sample(const Cubemap& cube, const glm::vec3& direction, int level) {
+        level = std::min(std::max(level, 0), (int)cube.mips.size() - 1);
+        float u, v;
+        const FaceImage& image = cube.mips[level][directionTexel(direction, u, v)];
+        float x = u * image.size - 0.5f, y = v * image.size - 0.5f;
+        int x0 = (int)std::floor(x), y0 = (int)std::floor(y);
+        float fx = x - x0, fy = y - y0;
+        auto at = [&image](int px, int py) {
+            return image.At(std::min(std::max(px, 0), image.size - 1), std::min(std::max(py, 0), image.size - 1));
+        };
+        return glm::mix(glm::mix(at(x0, y0), at(x0 + 1, y0), fx), glm::mix(at(x0, y0 + 1), at(x0 + 1, y0 + 1), fx), fy);
+    }
+
+    // solid angle of a texel, for weighting whole-cubemap sums
+    float texelSolidAngle(int x, int y, int size) {
+        auto areaElement = [](float s, float t) {
+            return std::atan2(s * t, std::sqrt(s * s + t * t + 1.0f));
+        };
+        float s0 = 2.0f * x / size - 1.0f, s1 = 2.0f * (x + 1) / size - 1.0f;
+        float t0 = 2.0f * y / size - 1.0f, t1 = 2.0f * (y + 1) / size - 1.0f;
+        return areaElement(s0, t0) - areaElement(s0, t1) - areaElement(s1, t0) + areaElement(s1, t1);
+    }
+
+    bool loadCubemap(const std::vector<std::string>& paths, Cubemap& cube) {
+        cube.mips.assign(1, std::vector<FaceImage>(6));
+        for (int face = 0; face < 6; face++) {
+            int width, height, channels;
+            unsigned char* data = stbi_load(paths[face].c_str(), &width, &height, &channels, 3);
+            if (!data || width != height || (face > 0 && width != cube.mips[0][0].size)) {
+                std::cerr << "Failed to load square face " << paths[face] << std::endl;
+                stbi_image_free(data);
+                return false;
+            }
+            FaceImage& image = cube.mips[0][face];
+            image.size = width;
+            image.texels.resize((size_t)width * height);
+            for (size_t i = 0; i < image.texels.size(); i++) {
+                image.texels[i] = glm::vec3(srgbToLinear(data[3 * i]), srgbToLinear(data[3 * i + 1]), srgbToLinear(data[3 * i + 2]));
+            }
+            stbi_image_free(data);
+        }
+        // 2x2 box filtered mips down to one texel
+        while (cube.mips.back()[0].size > 1) {
+            const std::vector<FaceImage>& previous = cube.mips.back();
+            std::vector<FaceImage> next(6);
+            for (int face = 0; face < 6; face++) {
+                const FaceImage& source = previous[face];
+                FaceImage& image = next[face];
+                image.size = source.size / 2;
+                image.texels.resize((size_t)image.size * image.size);
+                for (int y = 0; y < image.size; y++) {
+                    for (int x = 0; x < image.size; x++) {
+                        image.texels[(size_t)y * image.size + x] = 0.25f * (source.At(2 * x, 2 * y) + source.At(2 * x + 1, 2 * y) +
+                                                                              source.At(2 * x, 2 * y + 1) + source.At(2 * x + 1, 2 * y + 1));
+                    }
+                }
+            }
+            cube.mips.push_back(std::move(next));
+        }
+        return true;
+    }
+
+    float radicalInverse(uint32_t bits) {
+        bits = (bits << 16u) | (bits >> 16u);
+        bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+        bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+        bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+        bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+        return (float)bits * 2.3283064365386963e-10f;
+    }
+
+    // GGX distributed half vector around n for the i-th of count Hammersley points
+    glm::vec3 importanceSampleGgx(int i, int count, const glm::vec3& n, float roughness) {
+        float a = roughness * roughness;
+        float u = (float)i / count, v = radicalInverse((uint32_t)i);
+        float phi = 2.0f * Pi * u;
+        float cosTheta = std::sqrt((1.0f - v) / (1.0f + (a * a - 1.0f) * v));
+        float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+        glm::vec3 h(std::cos(phi) * sinTheta, std::sin(phi) * sinTheta, cosTheta);
+        glm::vec3 up = std::abs(n.z) < 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+        glm::vec3 tangent = glm::normalize(glm::cross(up, n));
+        glm::vec3 bitangent = glm::cross(n, tangent);
+        return glm::normalize(tangent * h.x + bitangent * h.y + n * h.z);
+    }
+
+    float distributionGgx(float nDotH, float roughness) {
+        float a2 = roughness * roughness * roughness * roughness;
+        float d = nDotH * nDotH * (a2 - 1.0f) + 1.0f;
+        return a2 / (Pi * d * d);
+    }
+
+    float geometrySmithIbl(float nDotV, float nDotL, float roughness) {
+        float k = roughness * roughness / 2.0f;
+        return nDotV / (nDotV * (1.0f - k) + k) * nDotL / (nDotL * (1.0f - k) + k);
+    }
+
+    void store(std::vector<uint16_t>& out, size_t offset, const glm::vec3& color) {
+        out[offset] = rg::FloatToHalf(color.r);
+        out[offset + 1] = rg::FloatToHalf(color.g);
+        out[offset + 2] = rg::FloatToHalf(color.b);
+    }
+
+    // cosine weighted sum over every texel of a small mip, weighted by its solid angle
+    void bakeIrradiance(const Cubemap& cube, rg::IblEnvironment& ibl, rg::JobSystem& jobs) {
+        int level = 0;
+        while (level + 1 < (int)cube.mips.size() && cube.mips[level][0].size > 64) {
+            level++;
+        }
+        const std::vector<FaceImage>& source = cube.mips[level];
+        int sourceSize = source[0].size;
+        std::vector<glm::vec3> directions;
+        std::vector<glm::vec3> weighted; // radiance times solid angle
+        for (int face = 0; face < 6; face++) {
+            for (int y = 0; y < sourceSize; y++) {
+                for (int x = 0; x < sourceSize; x++) {
+                    directions.push_back(texelDirection(face, x, y, sourceSize));
+                    weighted.push_back(source[face].At(x, y) * texelSolidAngle(x, y, sourceSize));
+                }
+            }
+        }
+
+        int size = ibl.irradianceSize;
+        ibl.irradiance.assign((size_t)6 * size * size * 3, 0);
+        jobs.ParallelFor((size_t)6 * size, 1, [&](size_t begin, size_t end) {
+            for (size_t row = begin; row < end; row++) {
+                int face = (int)(row / size), y = (int)(row % size);
+                for (int x = 0; x < size; x++) {
+                    glm::vec3 n = texelDirection(face, x, y, size);
+                    glm::vec3 sum(0.0f);
+                    for (size_t i = 0; i < directions.size(); i++) {
+                        float cosine = glm::dot(n, directions[i]);
+                        if (cosine > 0.0f) {
+                            sum += weighted[i] * cosine;
+                        }
+                    }
+                    // E / pi, so the shader multiplies by albedo alone
+                    store(ibl.irradiance, (((size_t)face * size + y) * size + x) * 3, sum / Pi);
+                }
+            }
+        });
+    }
+
+    // GGX importance sampling with n = v = r, reading the mip whose texels match each sample's
+    // footprint so few samples don't alias ("filtered importance sampling")
+    void bakeSpecular(const Cubemap& cube, rg::IblEnvironment& ibl, int samples, rg::JobSystem& jobs) {
+        int sourceSize = cube.mips[0][0].size;
+        float sourceTexelAngle = 4.0f * Pi / (6.0f * sourceSize * sourceSize);
+        ibl.specular.assign(ibl.SpecularOffset(ibl.specularMips, 0), 0);
+        for (int mip = 0; mip < ibl.specularMips; mip++) {
+            int size = ibl.MipSize(mip);
+            float roughness = ibl.specularMips > 1 ? (float)mip / (ibl.specularMips - 1) : 0.0f;
+            jobs.ParallelFor((size_t)6 * size, 1, [&, mip, size, roughness](size_t begin, size_t end) {
+                for (size_t row = begin; row < end; row++) {
+                    int face = (int)(row / size), y = (int)(row % size);
+                    for (int x = 0; x < size; x++) {
+                        glm::vec3 n = texelDirection(face, x, y, size);
+                        glm::vec3 color(0.0f);
+                        if (mip == 0) {
+                            // a mirror, the source filtered down to this size
+                            float texelAngle = 4.0f * Pi / (6.0f * size * size);
+                            color = sample(cube, n, (int)std::round(0.5f * std::log2(texelAngle / sourceTexelAngle)));
+                        } else {
+                            float weight = 0.0f;
+                            for (int i = 0; i < samples; i++) {
+                                glm::vec3 h = importanceSampleGgx(i, samples, n, roughness);
+                                glm::vec3 l = 2.0f * glm::dot(n, h) * h - n;
+                                float nDotL = glm::dot(n, l);
+                                if (nDotL <= 0.0f) {
+                                    continue;
+                                }
+                                float nDotH = std::max(glm::dot(n, h), 0.0f);
+                                float pdf = distributionGgx(nDotH, roughness) / 4.0f + 0.0001f;
+                                float sampleAngle = 1.0f / (samples * pdf);
+                                float level = 0.5f * std::log2(sampleAngle / sourceTexelAngle) + 1.0f;
+                                color += sample(cube, l, (int)std::ceil(level)) * nDotL;
+                                weight += nDotL;
+                            }
+                            color /= std::max(weight, 0.0001f);
+                        }
+                        store(ibl.specular, ibl.SpecularOffset(mip, face) + ((size_t)y * size + x) * 3, color);
+                    }
+                }
+            });
+        }
+    }
+
+    void bakeLut(rg::BrdfLut& lut, int samples, rg::JobSystem& jobs) {
+        int size = lut.size;
+        lut.rg.assign((size_t)size * size * 2, 0);
+        jobs.ParallelFor((size_t)size, 1, [&](size_t begin, size_t end) {
+            for (size_t y = begin; y < end; y++) {
+                float roughness = (y + 0.5f) / size;
+                for (int x = 0; x < size; x++) {
+                    float nDotV = (x + 0.5f) / size;
+                    glm::vec3 v(std::sqrt(1.0f - nDotV * nDotV), 0.0f, nDotV);
+                    glm::vec3 n(0.0f, 0.0f, 1.0f);
+                    float scale = 0.0f, bias = 0.0f;
+                    for (int i = 0; i < samples; i++) {
+                        glm::vec3 h = importanceSampleGgx(i, samples, n, roughness);
+                        glm::vec3 l = 2.0f * glm::dot(v, h) * h - v;
+                        float nDotL = std::max(l.z, 0.0f);
+                        float nDotH = std::max(h.z, 0.0f);
+                        float vDotH = std::max(glm::dot(v, h), 0.0f);
+                        if (nDotL > 0.0f) {
+                            float visibility = geometrySmithIbl(nDotV, nDotL, roughness) * vDotH / (nDotH * nDotV);
+                            float fresnel = std::pow(1.0f - vDotH, 5.0f);
+                            scale += (1.0f - fresnel) * visibility;
+                            bias += fresnel * visibility;
+                        }
+                    }
+                    size_t offset = ((size_t)y * size + x) * 2;
+                    lut.rg[offset] = rg::FloatToHalf(scale / samples);
+                    lut.rg[offset + 1] = rg::FloatToHalf(bias / samples);
+                }
+            }
+        });
+    }
+
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << "usage: project_base_iblbake [--irradiance N] [--specular N] [--mips N] [--samples N] out.ibl +x -x +y -y +z -z\n"
+                     "       project_base_iblbake --lut out.lut [--size N] [--samples N]" << std::endl;
+        return 2;
+    }
+    rg::JobSystem jobs;
+    auto start = std::chrono::steady_clock::now();
+    auto elapsedMs = [&start]() {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    if (options.lut) {
+        rg::BrdfLut lut;
+        lut.size = options.lutSize;
+        bakeLut(lut, options.samples, jobs);
+        if (!lut.Write(options.out)) {
+            std::cerr << "Failed to write " << options.out << std::endl;
+            return 1;
+        }
+        std::cout << "baked " << lut.size << "x" << lut.size << " BRDF LUT in " << elapsedMs() << " ms" << std::endl;
+        return 0;
+    }
+
+    Cubemap cube;
+    if (!loadCubemap(options.faces, cube)) {
+        return 1;
+    }
+    double loadMs = elapsedMs();
+    rg::IblEnvironment ibl;
+    ibl.irradianceSize = options.irradianceSize;
+    ibl.specularSize = options.specularSize;
+    ibl.specularMips = std::min(options.specularMips, (int)std::log2(options.specularSize) + 1);
+    bakeIrradiance(cube, ibl, jobs);
+    double irradianceMs = elapsedMs() - loadMs;
+    bakeSpecular(cube, ibl, options.samples, jobs);
+    double specularMs = elapsedMs() - loadMs - irradianceMs;
+    if (!ibl.Write(options.out)) {
+        std::cerr << "Failed to write " << options.out << std::endl;
+        return 1;
+    }
+    std::cout << "baked " << options.out << " on " << jobs.ThreadCount() << " threads: load " << loadMs
+              << " ms, irradiance " << irradianceMs << " ms, specular " << specularMs << " ms" << std::endl;
+    return 0;
+}
@@ -0,0 +1,800 @@
+// Offline lightmap bake for the dam: unwraps its meshes into a lightmap atlas, then path traces
+// the light of the static lights for every texel against a BVH of the static scene (the dam and
+// the boxes) on every core. Each texel gets direct light with ray traced shadows, light bounced
+// off the scene and ambient occlusion, once for the day and once for the night setup of
+// Renderer's Blinn-Phong path. The hemisphere rays of a texel are traced four at a time as SIMD
+// packets; they leave from one point, so the packets stay coherent.
+//
+//   project_base_lightbake [--texels-per-unit N] [--max-size N] [--samples N] [--bounces N]
+//                          [--ao-distance D] [--albedo A] [out.lmap]
+//
+// Writes resources/lightmaps/dam.lmap by default, which the renderer picks up. The bake holds
+// for the scene's four point lights, the default sun direction and the dam where World puts it;
+// rerun it when any of them change. Runs from the repository root like the demo.
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <stb_image.h>
+
+#include <common.h>
+#include <learnopengl/model.h>
+#include <rg/Bvh.h>
+#include <rg/JobSystem.h>
+#include <rg/Lightmap.h>
+#include <rg/Primitives.h>
+#include <rg/Renderer.h>
+#include <rg/World.h>
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+    const float Pi = 3.14159265358979f;
+    const int Padding = 2; // texels around every chart, filled by dilation for bilinear filtering
+
+    struct Options {
+        std::string out = "resources/lightmaps/dam.lmap";
+        float texelsPerUnit = 4.0f;
+        int maxSize = 2048;
+        int samples = 128;   // hemisphere rays per texel, rounded up to whole packets
+        int bounces = 2;     // indirect bounces after the first hit
+        float aoDistance = 4.0f;
+        float albedo = 0.8f; // of the dam, its material's Kd; the base color map isn't shipped
+    };
+
+    // the light of one setup, as Renderer sets the uniforms
+    struct LightSetup {
+        glm::vec3 sunDirection;
+        glm::vec3 sunAmbient;
+        glm::vec3 sunDiffuse;
+        std::vector<rg::PointLight> pointLights; // only the baked ones, only at night
+    };
+
+    // world space triangle soup of everything static, three entries per triangle
+    struct BakeScene {
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec3> normals;
+        std::vector<glm::vec3> albedo; // per triangle
+        rg::Bvh bvh;
+    };
+
+    // one mesh of the lightmapped model; vertex indices as in the Mesh
+    struct MeshInput {
+        std::vector<glm::vec3> positions; // world space
+        std::vector<glm::vec3> normals;
+        std::vector<unsigned int> indices;
+    };
+
+    // lightmapped triangle: its mesh, its first index, and its corners in atlas texels
+    struct AtlasTriangle {
+        uint32_t mesh;
+        uint32_t first;
+        glm::vec2 corners[3];
+    };
+
+    struct Atlas {
+        int width = 0, height = 0;
+        int charts = 0;
+        float texelsPerUnit = 0.0f;
+        std::vector<AtlasTriangle> triangles;
+    };
+
+    struct Texel {
+        uint32_t triangle; // into the bake scene, dam triangles come first
+        float u, v;        // barycentrics of the second and third corner
+    };
+
+    struct Radiance {
+        glm::vec3 layers[rg::Lightmap::Layers];
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    bool parseOptions(int argc, char** argv, Options& options) {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg.compare(0, 2, "--") != 0) {
+                options.out = arg;
+                continue;
+            }
+            if (i + 1 >= argc) {
+                std::cerr << "missing value for " << arg << std::endl;
+                return false;
+            }
+            const char* value = argv[++i];
+            if (arg == "--texels-per-unit") {
+                options.texelsPerUnit = std::max(0.01f, (float)std::atof(value));
+            } else if (arg == "--max-size") {
+                options.maxSize = std::min(16384, std::max(16, std::atoi(value)));
+            } else if (arg == "--samples") {
+                options.samples = std::max(4, std::atoi(value));
+            } else if (arg == "--bounces") {
+                options.bounces = std::max(0, std::atoi(value));
+            } else if (arg == "--ao-distance") {
+                options.aoDistance = std::max(0.01f, (float)std::atof(value));
+            } else if (arg == "--albedo") {
+                options.albedo = std::min(1.0f, std::max(0.0f, (float)std::atof(value)));
+            } else {
+                std::cerr << "unknown option " << arg << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // xorshift, seeded per texel so a bake is reproducible whatever the thread count
+    struct Random {
+        uint32_t state;
+
+        explicit Random(uint32_t seed) : state(seed * 2654435761u + 0x9e3779b9u) {
+            if (state == 0) {
+                state = 1;
+            }
+        }
+
+        float Next() {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            return (state >> 8) * (1.0f / 16777216.0f);
+        }
+    };
+
+    // cosine weighted around the normal, so the estimator of the (1/pi normalized) irradiance
+    // is the plain average of what the rays see
+    glm::vec3 cosineDirection(const glm::vec3& normal, float r1, float r2) {
+        float sign = normal.z >= 0.0f ? 1.0f : -1.0f;
+        float a = -1.0f / (sign + normal.z);
+        float b = normal.x * normal.y * a;
+        glm::vec3 tangent(1.0f + sign * normal.x * normal.x * a, sign * b, -sign * normal.x);
+        glm::vec3 bitangent(b, sign + normal.y * normal.y * a, -normal.y);
+        float phi = 2.0f * Pi * r1;
+        float r = std::sqrt(r2);
+        return glm::normalize(tangent * (r * std::cos(phi)) + bitangent * (r * std::sin(phi)) + normal * std::sqrt(1.0f - r2));
+    }
+
+    // rays leave a little above the surface so they don't hit it again
+    glm::vec3 offsetOrigin(const glm::vec3& position, const glm::vec3& normal) {
+        float scale = std::max(1.0f, std::max(std::fabs(position.x), std::max(std::fabs(position.y), std::fabs(position.z))));
+        return position + normal * (1e-4f * scale);
+    }
+
+    glm::vec3 faceNormal(const BakeScene& scene, uint32_t triangle) {
+        const glm::vec3* p = &scene.positions[3 * triangle];
+        glm::vec3 n = glm::cross(p[1] - p[0], p[2] - p[0]);
+        float length = glm::length(n);
+        return length > 0.0f ? n / length : glm::vec3(0.0f, 1.0f, 0.0f);
+    }
+
+    // position, and shading and geometric normal facing the side the surface is seen from
+    void surface(const BakeScene& scene, uint32_t triangle, float u, float v, const glm::vec3& from,
+                 glm::vec3& position, glm::vec3& normal, glm::vec3& geometric) {
+        const glm::vec3* p = &scene.positions[3 * triangle];
+        const glm::vec3* n = &scene.normals[3 * triangle];
+        float w = 1.0f - u - v;
+        position = p[0] * w + p[1] * u + p[2] * v;
+        normal = n[0] * w + n[1] * u + n[2] * v;
+        float length = glm::length(normal);
+        geometric = faceNormal(scene, triangle);
+        normal = length > 0.0f ? normal / length : geometric;
+        if (glm::dot(geometric, from) < 0.0f) {
+            geometric = -geometric;
+        }
+        if (glm::dot(normal, geometric) < 0.0f) {
+            normal = -normal;
+        }
+    }
+
+    // the ambient terms of the shaders: the sun's, and each point light's attenuated
+    glm::vec3 ambient(const LightSetup& setup, const glm::vec3& position) {
+        glm::vec3 result = setup.sunAmbient;
+        for (const rg::PointLight& light : setup.pointLights) {
+            float d = glm::length(light.position - position);
+            result += light.ambient / (light.constant + light.linear * d + light.quadratic * d * d);
+        }
+        return result;
+    }
+
+    // the diffuse terms, shadowed by the scene
+    glm::vec3 direct(const BakeScene& scene, const LightSetup& setup, const glm::vec3& position, const glm::vec3& normal,
+                     const glm::vec3& geometric, std::atomic<uint64_t>& rays) {
+        glm::vec3 result(0.0f);
+        glm::vec3 origin = offsetOrigin(position, geometric);
+        glm::vec3 toSun = glm::normalize(-setup.sunDirection);
+        float nDotL = glm::dot(normal, toSun);
+        if (nDotL > 0.0f && glm::length(setup.sunDiffuse) > 0.0f) {
+            rg::Ray ray;
+            ray.origin = origin;
+            ray.direction = toSun;
+            rays++;
+            if (!scene.bvh.Occluded(ray)) {
+                result += setup.sunDiffuse * nDotL;
+            }
+        }
+        for (const rg::PointLight& light : setup.pointLights) {
+            glm::vec3 toLight = light.position - position;
+            float d = glm::length(toLight);
+            toLight /= d;
+            nDotL = glm::dot(normal, toLight);
+            if (nDotL <= 0.0f) {
+                continue;
+            }
+            rg::Ray ray;
+            ray.origin = origin;
+            ray.direction = toLight;
+            ray.tMax = d;
+            rays++;
+            if (!scene.bvh.Occluded(ray)) {
+                result += light.diffuse * nDotL / (light.constant + light.linear * d + light.quadratic * d * d);
+            }
+        }
+        return result;
+    }
+
+    // what a surface hit by a hemisphere ray sends back: its own lighting times its albedo,
+    // plus further bounces, in every layer at once since the path doesn't depend on the light
+    Radiance bounce(const BakeScene& scene, const std::vector<LightSetup>& setups, const rg::RayHit& hit,
+                    const glm::vec3& direction, int bounces, Random& random, std::atomic<uint64_t>& rays) {
+        Radiance result;
+        for (glm::vec3& layer : result.layers) {
+            layer = glm::vec3(0.0f);
+        }
+        glm::vec3 throughput(1.0f);
+        rg::RayHit current = hit;
+        glm::vec3 incoming = direction;
+        for (int depth = 0; ; depth++) {
+            glm::vec3 position, normal, geometric;
+            surface(scene, current.triangle, current.u, current.v, -incoming, position, normal, geometric);
+            throughput *= scene.albedo[current.triangle];
+            for (size_t layer = 0; layer < setups.size(); layer++) {
+                result.layers[layer] += throughput * (ambient(setups[layer], position) +
+                                                      direct(scene, setups[layer], position, normal, geometric, rays));
+            }
+            if (depth >= bounces) {
+                break;
+            }
+            rg::Ray ray;
+            ray.origin = offsetOrigin(position, geometric);
+            ray.direction = cosineDirection(normal, random.Next(), random.Next());
+            rays++;
+            rg::RayHit next;
+            if (!scene.bvh.Intersect(ray, next)) {
+                break;
+            }
+            current = next;
+            incoming = ray.direction;
+        }
+        return result;
+    }
+
+    struct Group {
+        std::vector<uint32_t> triangles;
+        glm::vec3 normal = glm::vec3(0.0f); // area weighted
+    };
+
+    // Charts of triangles that face about the same way, grown over shared edges and projected
+    // onto their seed's plane, then packed into shelves. Triangles sharing a vertex always land
+    // in the same chart, a vertex has one lightmap coordinate; assimp's OBJ import shares none.
+    Atlas unwrap(const std::vector<MeshInput>& meshes, float texelsPerUnit, int maxSize) {
+        struct Source {
+            uint32_t mesh, first;
+            glm::vec3 normal;
+            float area;
+        };
+        std::vector<Source> sources;
+        for (uint32_t mesh = 0; mesh < meshes.size(); mesh++) {
+            const MeshInput& input = meshes[mesh];
+            for (uint32_t first = 0; first + 2 < input.indices.size(); first += 3) {
+                const glm::vec3& a = input.positions[input.indices[first]];
+                glm::vec3 n = glm::cross(input.positions[input.indices[first + 1]] - a, input.positions[input.indices[first + 2]] - a);
+                float length = glm::length(n);
+                sources.push_back(Source{mesh, first, length > 0.0f ? n / length : glm::vec3(0.0f), 0.5f * length});
+            }
+        }
+
+        // triangles sharing a vertex are one group
+        std::vector<uint32_t> parent(sources.size());
+        std::iota(parent.begin(), parent.end(), 0u);
+        std::function<uint32_t(uint32_t)> find = [&](uint32_t i) {
+            while (parent[i] != i) {
+                parent[i] = parent[parent[i]];
+                i = parent[i];
+            }
+            return i;
+        };
+        std::map<std::pair<uint32_t, unsigned int>, uint32_t> owner;
+        for (uint32_t i = 0; i < sources.size(); i++) {
+            for (int k = 0; k < 3; k++) {
+                auto key = std::make_pair(sources[i].mesh, meshes[sources[i].mesh].indices[sources[i].first + k]);
+                auto found = owner.emplace(key, i);
+                if (!found.second) {
+                    parent[find(i)] = find(found.first->second);
+                }
+            }
+        }
+        std::map<uint32_t, uint32_t> groupOf;
+        std::vector<Group> groups;
+        std::vector<uint32_t> triangleGroup(sources.size());
+        for (uint32_t i = 0; i < sources.size(); i++) {
+            auto found = groupOf.emplace(find(i), (uint32_t)groups.size());
+            if (found.second) {
+                groups.push_back(Group());
+            }
+            Group& group = groups[found.first->second];
+            group.triangles.push_back(i);
+            group.normal += sources[i].normal * sources[i].area;
+            triangleGroup[i] = found.first->second;
+        }
+
+        // edges between welded positions connect the groups
+        std::map<std::tuple<int64_t, int64_t, int64_t>, uint32_t> welded;
+        auto weld = [&welded](const glm::vec3& p) {
+            auto key = std::make_tuple((int64_t)std::llround(p.x * 1e4), (int64_t)std::llround(p.y * 1e4), (int64_t)std::llround(p.z * 1e4));
+            return welded.emplace(key, (uint32_t)welded.size()).first->second;
+        };
+        std::map<std::pair<uint32_t, uint32_t>, std::vector<uint32_t>> edges;
+        for (uint32_t i = 0; i < sources.size(); i++) {
+            const MeshInput& input = meshes[sources[i].mesh];
+            uint32_t ids[3];
+            for (int k = 0; k < 3; k++) {
+                ids[k] = weld(input.positions[input.indices[sources[i].first + k]]);
+            }
+            for (int k = 0; k < 3; k++) {
+                uint32_t a = ids[k], b = ids[(k + 1) % 3];
+                edges[std::make_pair(std::min(a, b), std::max(a, b))].push_back(triangleGroup[i]);
+            }
+        }
+        std::vector<std::vector<uint32_t>> neighbours(groups.size());
+        for (const auto& edge : edges) {
+            for (uint32_t a : edge.second) {
+                for (uint32_t b : edge.second) {
+                    if (a != b) {
+                        neighbours[a].push_back(b);
+                    }
+                }
+            }
+        }
+
+        // grow charts from the largest groups down, a group joins when all of it faces the seed's way
+        const float maxAngleCos = 0.8f;
+        std::vector<uint32_t> order(groups.size());
+        std::iota(order.begin(), order.end(), 0u);
+        std::sort(order.begin(), order.end(), [&groups](uint32_t a, uint32_t b) {
+            return glm::length(groups[a].normal) > glm::length(groups[b].normal);
+        });
+        std::vector<int> chartOf(groups.size(), -1);
+        std::vector<std::vector<uint32_t>> charts;
+        std::vector<glm::vec3> chartNormals;
+        for (uint32_t seed : order) {
+            if (chartOf[seed] >= 0) {
+                continue;
+            }
+            float length = glm::length(groups[seed].normal);
+            glm::vec3 normal = length > 0.0f ? groups[seed].normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+            int chart = (int)charts.size();
+            charts.push_back(std::vector<uint32_t>());
+            chartNormals.push_back(normal);
+            std::vector<uint32_t> pending = {seed};
+            chartOf[seed] = chart;
+            while (!pending.empty()) {
+                uint32_t group = pending.back();
+                pending.pop_back();
+                charts[chart].push_back(group);
+                for (uint32_t next : neighbours[group]) {
+                    if (chartOf[next] >= 0) {
+                        continue;
+                    }
+                    bool facing = true;
+                    for (uint32_t triangle : groups[next].triangles) {
+                        facing = facing && (sources[triangle].area == 0.0f || glm::dot(sources[triangle].normal, normal) >= maxAngleCos);
+                    }
+                    if (facing) {
+                        chartOf[next] = chart;
+                        pending.push_back(next);
+                    }
+                }
+            }
+        }
+
+        // planar projection per chart, then shelves sorted by height; shrink the density until it fits
+        Atlas atlas;
+        atlas.charts = (int)charts.size();
+        for (float density = texelsPerUnit; ; density *= 0.85f) {
+            struct Placed {
+                glm::vec2 min, size;
+                glm::vec3 tangent, bitangent;
+                glm::ivec2 origin;
+            };
+            std::vector<Placed> placed(charts.size());
+            double area = 0.0;
+            int widest = 0;
+            for (size_t chart = 0; chart < charts.size(); chart++) {
+                Placed& p = placed[chart];
+                glm::vec3 n = chartNormals[chart];
+                glm::vec3 axis = std::fabs(n.y) < 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+                p.tangent = glm::normalize(glm::cross(axis, n)) * density;
+                p.bitangent = glm::cross(n, glm::normalize(glm::cross(axis, n))) * density;
+                glm::vec2 min(std::numeric_limits<float>::max()), max(-std::numeric_limits<float>::max());
+                for (uint32_t group : charts[chart]) {
+                    for (uint32_t triangle : groups[group].triangles) {
+                        const MeshInput& input = meshes[sources[triangle].mesh];
+                        for (int k = 0; k < 3; k++) {
+                            const glm::vec3& position = input.positions[input.indices[sources[triangle].first + k]];
+                            glm::vec2 uv(glm::dot(position, p.tangent), glm::dot(position, p.bitangent));
+                            min = glm::min(min, uv);
+                            max = glm::max(max, uv);
+                        }
+                    }
+                }
+                p.min = min;
+                p.size = glm::vec2(std::ceil(max.x - min.x), std::ceil(max.y - min.y)) + glm::vec2(2.0f * Padding);
+                area += (double)p.size.x * p.size.y;
+                widest = std::max(widest, (int)p.size.x);
+            }
+            std::vector<uint32_t> byHeight(charts.size());
+            std::iota(byHeight.begin(), byHeight.end(), 0u);
+            std::sort(byHeight.begin(), byHeight.end(), [&placed](uint32_t a, uint32_t b) {
+                return placed[a].size.y > placed[b].size.y;
+            });
+            int width = std::max(widest, (int)std::ceil(std::sqrt(area * 1.15)));
+            width = (width + 3) & ~3;
+            int x = 0, y = 0, shelf = 0;
+            for (uint32_t chart : byHeight) {
+                Placed& p = placed[chart];
+                if (x + (int)p.size.x > width) {
+                    x = 0;
+                    y += shelf;
+                    shelf = 0;
+                }
+                p.origin = glm::ivec2(x, y);
+                x += (int)p.size.x;
+                shelf = std::max(shelf, (int)p.size.y);
+            }
+            int height = (y + shelf + 3) & ~3;
+            if ((width > maxSize || height > maxSize) && density > 0.01f) {
+                continue;
+            }
+
+            atlas.width = std::max(width, 4);
+            atlas.height = std::max(height, 4);
+            atlas.texelsPerUnit = density;
+            atlas.triangles.resize(sources.size());
+            for (size_t chart = 0; chart < charts.size(); chart++) {
+                const Placed& p = placed[chart];
+                glm::vec2 offset = glm::vec2(p.origin) + glm::vec2((float)Padding) - p.min;
+                for (uint32_t group : charts[chart]) {
+                    for (uint32_t triangle : groups[group].triangles) {
+                        const Source& source = sources[triangle];
+                        const MeshInput& input = meshes[source.mesh];
+                        AtlasTriangle& out = atlas.triangles[triangle];
+                        out.mesh = source.mesh;
+                        out.first = source.first;
+                        for (int k = 0; k < 3; k++) {
+                            const glm::vec3& position = input.positions[input.indices[source.first + k]];
+                            out.corners[k] = glm::vec2(glm::dot(position, p.tangent), glm::dot(position, p.bitangent)) + offset;
+                        }
+                    }
+                }
+            }
+            return atlas;
+        }
+    }
+
+    // the texel centers each atlas triangle covers; atlas triangle i is bake scene triangle i
+    std::vector<int64_t> rasterizeAtlas(const Atlas& atlas, std::vector<Texel>& texels) {
+        std::vector<int64_t> owner((size_t)atlas.width * atlas.height, -1);
+        for (uint32_t i = 0; i < atlas.triangles.size(); i++) {
+            const glm::vec2* c = atlas.triangles[i].corners;
+            float area = (c[1].x - c[0].x) * (c[2].y - c[0].y) - (c[2].x - c[0].x) * (c[1].y - c[0].y);
+            if (std::fabs(area) < 1e-12f) {
+                continue;
+            }
+            int x0 = std::max(0, (int)std::floor(std::min(c[0].x, std::min(c[1].x, c[2].x))));
+            int x1 = std::min(atlas.width - 1, (int)std::ceil(std::max(c[0].x, std::max(c[1].x, c[2].x))));
+            int y0 = std::max(0, (int)std::floor(std::min(c[0].y, std::min(c[1].y, c[2].y))));
+            int y1 = std::min(atlas.height - 1, (int)std::ceil(std::max(c[0].y, std::max(c[1].y, c[2].y))));
+            for (int y = y0; y <= y1; y++) {
+                for (int x = x0; x <= x1; x++) {
+                    glm::vec2 p(x + 0.5f, y + 0.5f);
+                    float u = ((p.x - c[0].x) * (c[2].y - c[0].y) - (c[2].x - c[0].x) * (p.y - c[0].y)) / area;
+                    float v = ((c[1].x - c[0].x) * (p.y - c[0].y) - (p.x - c[0].x) * (c[1].y - c[0].y)) / area;
+                    const float epsilon = -1e-4f;
+                    size_t index = (size_t)y * atlas.width + x;
+                    if (u < epsilon || v < epsilon || u + v > 1.0f - epsilon || owner[index] >= 0) {
+                        continue;
+                    }
+                    owner[index] = (int64_t)texels.size();
+                    texels.push_back(Texel{i, u, v});
+                }
+            }
+        }
+        return owner;
+    }
+
+    // spreads the values of covered texels into the empty ones around them, so bilinear
+    // filtering at a chart's edge doesn't pull in black
+    template <typename T, typename Average>
+    void dilate(std::vector<T>& values, std::vector<bool> covered, int width, int height, int passes, Average average) {
+        for (int pass = 0; pass < passes; pass++) {
+            std::vector<bool> next = covered;
+            std::vector<T> result = values;
+            for (int y = 0; y < height; y++) {
+                for (int x = 0; x < width; x++) {
+                    size_t index = (size_t)y * width + x;
+                    if (covered[index]) {
+                        continue;
+                    }
+                    std::vector<T> around;
+                    for (int dy = -1; dy <= 1; dy++) {
+                        for (int dx = -1; dx <= 1; dx++) {
+                            int nx = x + dx, ny = y + dy;
+                            if (nx >= 0 && ny >= 0 && nx < width && ny < height && covered[(size_t)ny * width + nx]) {
+                                around.push_back(values[(size_t)ny * width + nx]);
+                            }
+                        }
+                    }
+                    if (!around.empty()) {
+                        result[index] = average(around);
+                        next[index] = true;
+                    }
+                }
+            }
+            values.swap(result);
+            covered.swap(next);
+        }
+    }
+
+    // light per layer and unoccluded fraction of every texel. The hemisphere rays of a texel go
+    // four at a time; hits within aoDistance count as occlusion, every hit bounces
+    void bakeTexels(const BakeScene& scene, const std::vector<LightSetup>& setups, const std::vector<Texel>& texels,
+                    const Options& options, rg::JobSystem& jobs, std::vector<Radiance>& light,
+                    std::vector<float>& occlusion, std::atomic<uint64_t>& rays) {
+        int packets = (options.samples + 3) / 4;
+        float sampleWeight = 1.0f / (packets * 4);
+        light.assign(texels.size(), Radiance());
+        occlusion.assign(texels.size(), 0.0f);
+        std::atomic<size_t> done(0);
+        jobs.ParallelFor(texels.size(), 64, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                const Texel& texel = texels[i];
+                glm::vec3 position, normal, geometric;
+                const glm::vec3 up = faceNormal(scene, texel.triangle);
+                surface(scene, texel.triangle, texel.u, texel.v, up, position, normal, geometric);
+                glm::vec3 origin = offsetOrigin(position, geometric);
+                Random random((uint32_t)i);
+
+                Radiance indirect;
+                for (glm::vec3& layer : indirect.layers) {
+                    layer = glm::vec3(0.0f);
+                }
+                int open = 0;
+                for (int p = 0; p < packets; p++) {
+                    rg::RayPacket hemisphere;
+                    for (int lane = 0; lane < 4; lane++) {
+                        // stratified over the packets' lanes
+                        float r1 = (p + random.Next()) / packets;
+                        float r2 = (lane + random.Next()) / 4.0f;
+                        rg::Ray ray;
+                        ray.origin = origin;
+                        ray.direction = cosineDirection(normal, r1, r2);
+                        if (glm::dot(ray.direction, geometric) <= 0.0f) {
+                            ray.direction = glm::reflect(ray.direction, geometric);
+                        }
+                        hemisphere.Set(lane, ray);
+                    }
+                    scene.bvh.Intersect(hemisphere);
+                    rays += 4;
+                    for (int lane = 0; lane < 4; lane++) {
+                        const rg::RayHit& hit = hemisphere.hits[lane];
+                        if (!hit.Hit()) {
+                            open++;
+                            continue;
+                        }
+                        open += hit.t >= options.aoDistance;
+                        glm::vec3 direction(hemisphere.dx[lane], hemisphere.dy[lane], hemisphere.dz[lane]);
+                        Radiance bounced = bounce(scene, setups, hit, direction, options.bounces, random, rays);
+                        for (int layer = 0; layer < rg::Lightmap::Layers; layer++) {
+                            indirect.layers[layer] += bounced.layers[layer];
+                        }
+                    }
+                }
+                occlusion[i] = open * sampleWeight;
+                for (int layer = 0; layer < rg::Lightmap::Layers; layer++) {
+                    light[i].layers[layer] = ambient(setups[layer], position) * occlusion[i] +
+                                             direct(scene, setups[layer], position, normal, geometric, rays) +
+                                             indirect.layers[layer] * sampleWeight;
+                }
+                size_t finished = ++done;
+                if (finished % 20000 == 0) {
+                    std::cout << finished * 100 / texels.size() << "%" << std::endl;
+                }
+            }
+        });
+    }
+
+    // average linear color of a texture, the albedo the boxes bounce light with
+    glm::vec3 averageColor(const std::string& path) {
+        int width, height, channels;
+        unsigned char* data = loadImageFile(path, &width, &height, &channels);
+        if (!data) {
+            return glm::vec3(0.5f);
+        }
+        double sum[3] = {0.0, 0.0, 0.0};
+        size_t count = (size_t)width * height;
+        for (size_t i = 0; i < count; i++) {
+            for (int c = 0; c < 3; c++) {
+                sum[c] += std::pow(data[i * channels + std::min(c, channels - 1)] / 255.0, 2.2);
+            }
+        }
+        stbi_image_free(data);
+        return glm::vec3((float)(sum[0] / count), (float)(sum[1] / count), (float)(sum[2] / count));
+    }
+
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << "usage: project_base_lightbake [--texels-per-unit N] [--max-size N] [--samples N] [--bounces N]"
+                     " [--ao-distance D] [--albedo A] [out.lmap]" << std::endl;
+        return 2;
+    }
+    Clock::time_point start = Clock::now();
+
+    // the scene as World places it, meshes kept on the CPU
+    auto noTextures = [](const std::string&, const std::string&) {
+        return 0u;
+    };
+    Model damModel("resources/objects/dam_obj/dam1.obj", false, noTextures, false);
+    Model moonModel("resources/objects/sphere/moon.obj", false, noTextures, false);
+    if (damModel.meshes.empty()) {
+        std::cerr << "Failed to load the dam model" << std::endl;
+        return 1;
+    }
+    rg::JobSystem jobs;
+    rg::World world(damModel, moonModel);
+    world.projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+    world.Update(jobs);
+    rg::FramePacket packet;
+    world.Fill(packet);
+
+    std::vector<LightSetup> setups(rg::Lightmap::Layers);
+    // day, then night, with the sun the renderer gives the dam
+    for (size_t layer = 0; layer < setups.size(); layer++) {
+        rg::DirLight sun = rg::DirLight::Dam(layer == 0);
+        setups[layer].sunDirection = packet.sunDirection;
+        setups[layer].sunAmbient = sun.ambient;
+        setups[layer].sunDiffuse = sun.diffuse;
+    }
+    for (const rg::PointLight& light : packet.pointLights) {
+        if (light.baked) {
+            setups[1].pointLights.push_back(light);
+        }
+    }
+
+    // dam triangles first, in mesh order, then the boxes
+    BakeScene scene;
+    std::vector<MeshInput> meshes(damModel.meshes.size());
+    for (size_t i = 0; i < damModel.meshes.size(); i++) {
+        const Mesh& mesh = damModel.meshes[i];
+        glm::mat4 model = packet.dam * packet.damNodes[damModel.meshNodes[i]];
+        glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+        MeshInput& input = meshes[i];
+        for (const Vertex& vertex : mesh.vertices) {
+            input.positions.push_back(glm::vec3(model * glm::vec4(vertex.Position, 1.0f)));
+            input.normals.push_back(normalMatrix * vertex.Normal);
+        }
+        input.indices = mesh.indices;
+        for (size_t first = 0; first + 2 < mesh.indices.size(); first += 3) {
+            for (int k = 0; k < 3; k++) {
+                scene.positions.push_back(input.positions[mesh.indices[first + k]]);
+                scene.normals.push_back(input.normals[mesh.indices[first + k]]);
+            }
+            scene.albedo.push_back(glm::vec3(options.albedo));
+        }
+    }
+    size_t damTriangles = scene.albedo.size();
+    glm::vec3 boxAlbedo = averageColor(FileSystem::getPath("resources/textures/8640003215_50cc68f8cf_b.jpg"));
+    for (const glm::mat4& model : packet.boxCasters) {
+        glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+        for (int i = 0; i < rg::BoxVertexCount; i++) {
+            const float* v = rg::BoxVertices + i * 8;
+            scene.positions.push_back(glm::vec3(model * glm::vec4(v[0], v[1], v[2], 1.0f)));
+            scene.normals.push_back(normalMatrix * glm::vec3(v[3], v[4], v[5]));
+            if (i % 3 == 2) {
+                scene.albedo.push_back(boxAlbedo);
+            }
+        }
+    }
+    scene.bvh.Build(scene.positions);
+    std::cout << scene.albedo.size() << " triangles (" << damTriangles << " lightmapped), "
+              << scene.bvh.NodeCount() << " BVH nodes" << std::endl;
+
+    Atlas atlas = unwrap(meshes, options.texelsPerUnit, options.maxSize);
+    std::vector<Texel> texels;
+    std::vector<int64_t> owner = rasterizeAtlas(atlas, texels);
+    std::cout << atlas.charts << " charts in a " << atlas.width << "x" << atlas.height << " atlas at "
+              << atlas.texelsPerUnit << " texels per unit, " << texels.size() << " texels to bake" << std::endl;
+
+    std::vector<Radiance> light;
+    std::vector<float> occlusion;
+    std::atomic<uint64_t> rays(0);
+    bakeTexels(scene, setups, texels, options, jobs, light, occlusion, rays);
+    double bakeSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    rg::Lightmap lightmap;
+    lightmap.width = atlas.width;
+    lightmap.height = atlas.height;
+    lightmap.transform = packet.dam;
+    for (const MeshInput& input : meshes) {
+        lightmap.coords.push_back(std::vector<glm::vec2>(input.positions.size(), glm::vec2(0.0f)));
+    }
+    for (const AtlasTriangle& triangle : atlas.triangles) {
+        for (int k = 0; k < 3; k++) {
+            unsigned int vertex = meshes[triangle.mesh].indices[triangle.first + k];
+            lightmap.coords[triangle.mesh][vertex] = triangle.corners[k] / glm::vec2((float)atlas.width, (float)atlas.height);
+        }
+    }
+    std::vector<bool> covered(owner.size());
+    for (size_t i = 0; i < owner.size(); i++) {
+        covered[i] = owner[i] >= 0;
+    }
+    for (int layer = 0; layer < rg::Lightmap::Layers; layer++) {
+        std::vector<glm::vec3> values(owner.size(), glm::vec3(0.0f));
+        for (size_t i = 0; i < owner.size(); i++) {
+            if (owner[i] >= 0) {
+                values[i] = light[owner[i]].layers[layer];
+            }
+        }
+        dilate(values, covered, atlas.width, atlas.height, Padding + 1, [](const std::vector<glm::vec3>& around) {
+            glm::vec3 sum(0.0f);
+            for (const glm::vec3& value : around) {
+                sum += value;
+            }
+            return sum / (float)around.size();
+        });
+        lightmap.light[layer].resize(values.size());
+        for (size_t i = 0; i < values.size(); i++) {
+            lightmap.light[layer][i] = rg::PackRgb9e5(values[i]);
+        }
+    }
+    std::vector<float> ao(owner.size(), 1.0f);
+    for (size_t i = 0; i < owner.size(); i++) {
+        if (owner[i] >= 0) {
+            ao[i] = occlusion[owner[i]];
+        }
+    }
+    dilate(ao, covered, atlas.width, atlas.height, Padding + 1, [](const std::vector<float>& around) {
+        return std::accumulate(around.begin(), around.end(), 0.0f) / around.size();
+    });
+    lightmap.occlusion.resize(ao.size());
+    for (size_t i = 0; i < ao.size(); i++) {
+        lightmap.occlusion[i] = (uint8_t)std::lround(std::min(std::max(ao[i], 0.0f), 1.0f) * 255.0f);
+    }
+
+    std::string directory = options.out.substr(0, options.out.find_last_of('/'));
+    if (directory != options.out) {
+        mkdir(directory.c_str(), 0755);
+    }
+    if (!lightmap.Write(options.out)) {
+        std::cerr << "Failed to write " << options.out << std::endl;
+        return 1;
+    }
+    std::cout << "wrote " << options.out << ": " << rays.load() << " rays in " << bakeSeconds << " s ("
+              << rays.load() / std::max(bakeSeconds, 1e-6) / 1e6 << " Mrays/s)" << std::endl;
+    return 0;
+}
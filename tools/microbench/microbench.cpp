@@ -0,0 +1,315 @@
+// Microbenchmarks for the CPU hot paths of the engine, on Google Benchmark. Every benchmark
+// reports ns/op, allocations/op (counted by the operator new below) and, where it means
+// something, throughput. GL-backed cases run in a headless EGL context and are skipped when
+// none can be created or the build has no EGL (RG_HAVE_EGL unset).
+//
+//   project_base_microbench [--benchmark_filter=regex] [--benchmark_format=json] ...
+//
+// Runs from the repository root like the demo, the fixtures are the shipped assets.
+
+#include <benchmark/benchmark.h>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <stb_image.h>
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+
+#include <learnopengl/camera.h>
+#include <learnopengl/filesystem.h>
+#include <learnopengl/mesh.h>
+#include <learnopengl/model.h>
+#include <learnopengl/shader.h>
+#include <rg/JobSystem.h>
+#include <rg/LightClusters.h>
+#ifdef RG_HAVE_EGL
+#include <rg/HeadlessContext.h>
+#endif
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <new>
+
+namespace {
+
+    std::atomic<uint64_t> allocationCount{0};
+    bool haveContext = false;
+
+    // counts the allocations between construction and Report(), reported per iteration
+    class AllocationCounter {
+    public:
+        AllocationCounter() : start(allocationCount.load(std::memory_order_relaxed)) {}
+
+        void Report(benchmark::State& state) const {
+            double count = (double)(allocationCount.load(std::memory_order_relaxed) - start);
+            state.counters["allocs/op"] = benchmark::Counter(count, benchmark::Counter::kAvgIterations);
+        }
+
+    private:
+        uint64_t start;
+    };
+
+    // the dam, imported once with the same flags as Model, without touching GL
+    const aiMesh* damMesh() {
+        static Assimp::Importer importer;
+        static const aiScene* scene = importer.ReadFile("resources/objects/dam_obj/dam1.obj",
+                aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        if (!scene || scene->mNumMeshes == 0) {
+            return nullptr;
+        }
+        const aiMesh* largest = scene->mMeshes[0];
+        for (unsigned int i = 1; i < scene->mNumMeshes; i++) {
+            if (scene->mMeshes[i]->mNumVertices > largest->mNumVertices) {
+                largest = scene->mMeshes[i];
+            }
+        }
+        return largest;
+    }
+
+    // the dam shader is the one with the most uniforms set per frame
+    Shader* damShader() {
+        static std::unique_ptr<Shader> shader(new Shader("resources/shaders/2.model_lighting.vs",
+                                                         "resources/shaders/2.model_lighting.fs"));
+        return shader.get();
+    }
+
+    bool requireContext(benchmark::State& state) {
+        if (!haveContext) {
+            state.SkipWithError("no GL context");
+        }
+        return haveContext;
+    }
+
+}
+
+void* operator new(std::size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+// vertex conversion of processMesh
+static void BM_ModelExtractVertices(benchmark::State& state) {
+    const aiMesh* mesh = damMesh();
+    if (!mesh) {
+        state.SkipWithError("failed to import resources/objects/dam_obj/dam1.obj");
+        return;
+    }
+    AllocationCounter allocations;
+    for (auto _ : state) {
+        vector<Vertex> vertices = Model::ExtractVertices(mesh);
+        benchmark::DoNotOptimize(vertices.data());
+    }
+    allocations.Report(state);
+    state.SetItemsProcessed(state.iterations() * mesh->mNumVertices);
+    state.SetBytesProcessed(state.iterations() * mesh->mNumVertices * sizeof(Vertex));
+}
+BENCHMARK(BM_ModelExtractVertices);
+
+// index flattening of processMesh
+static void BM_ModelExtractIndices(benchmark::State& state) {
+    const aiMesh* mesh = damMesh();
+    if (!mesh) {
+        state.SkipWithError("failed to import resources/objects/dam_obj/dam1.obj");
+        return;
+    }
+    AllocationCounter allocations;
+    for (auto _ : state) {
+        vector<unsigned int> indices = Model::ExtractIndices(mesh);
+        benchmark::DoNotOptimize(indices.data());
+    }
+    allocations.Report(state);
+    state.SetItemsProcessed(state.iterations() * mesh->mNumFaces);
+}
+BENCHMARK(BM_ModelExtractIndices);
+
+// name lookup plus upload, the path every Shader::set* takes
+static void BM_ShaderSetFloat(benchmark::State& state) {
+    if (!requireContext(state)) {
+        return;
+    }
+    Shader* shader = damShader();
+    shader->use();
+    AllocationCounter allocations;
+    for (auto _ : state) {
+        shader->setFloat("material.shininess", 32.0f);
+    }
+    allocations.Report(state);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ShaderSetFloat);
+
+static void BM_ShaderSetVec3(benchmark::State& state) {
+    if (!requireContext(state)) {
+        return;
+    }
+    Shader* shader = damShader();
+    shader->use();
+    AllocationCounter allocations;
+    for (auto _ : state) {
+        shader->setVec3("dirLight.diffuse", 0.6f, 0.6f, 0.6f);
+    }
+    allocations.Report(state);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ShaderSetVec3);
+
+static void BM_ShaderSetMat4(benchmark::State& state) {
+    if (!requireContext(state)) {
+        return;
+    }
+    Shader* shader = damShader();
+    shader->use();
+    glm::mat4 model = glm::mat4(1.0f);
+    AllocationCounter allocations;
+    for (auto _ : state) {
+        shader->setMat4("model", model);
+    }
+    allocations.Report(state);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ShaderSetMat4);
+
+// sampler names a mesh builds at construction and again when its prefix changes
+static void BM_MeshSamplerNames(benchmark::State& state) {
+    vector<Vertex> vertices(3);
+    vector<unsigned int> indices = {0, 1, 2};
+    vector<Texture> textures;
+    const char* types[] = {"texture_diffuse", "texture_specular", "texture_normal", "texture_height"};
+    for (const char* type : types) {
+        Texture texture;
+        texture.id = 0;
+        texture.type = type;
+        textures.push_back(texture);
+    }
+    Mesh mesh(vertices, indices, textures, false);
+    mesh.glslIdentifierPrefix = "material.";
+    AllocationCounter allocations;
+    for (auto _ : state) {
+        vector<string> names = mesh.SamplerNames();
+        benchmark::DoNotOptimize(names.data());
+    }
+    allocations.Report(state);
+    state.SetItemsProcessed(state.iterations() * textures.size());
+}
+BENCHMARK(BM_MeshSamplerNames);
+
+// per-cluster light lists for N lights scattered around the camera, on the job system
+static void BM_LightClustersBuild(benchmark::State& state) {
+    static rg::JobSystem jobs;
+    std::vector<rg::PointLight> lights(state.range(0));
+    uint32_t seed = 1;
+    auto random = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) / (float)(1 << 24);
+    };
+    for (rg::PointLight& light : lights) {
+        light.position = glm::vec3(-40.0f + 80.0f * random(), 12.0f * random(), -40.0f + 80.0f * random());
+        light.linear = 0.35f;
+        light.quadratic = 0.44f;
+    }
+    Camera camera(glm::vec3(0.0f, 5.0f, 30.0f));
+    glm::mat4 view = camera.GetViewMatrix();
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+    rg::LightClusters clusters;
+    clusters.Build(lights, view, projection, jobs);
+    AllocationCounter allocations;
+    for (auto _ : state) {
+        clusters.Build(lights, view, projection, jobs);
+        benchmark::DoNotOptimize(clusters.Lists().indices.data());
+    }
+    allocations.Report(state);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.counters["lights/cluster"] = clusters.AveragePerCluster();
+}
+BENCHMARK(BM_LightClustersBuild)->Arg(16)->Arg(256)->Arg(1024)->Unit(benchmark::kMicrosecond);
+
+static void BM_CameraGetViewMatrix(benchmark::State& state) {
+    Camera camera(glm::vec3(0.0f, 2.0f, 3.0f));
+    AllocationCounter allocations;
+    for (auto _ : state) {
+        glm::mat4 view = camera.GetViewMatrix();
+        benchmark::DoNotOptimize(view);
+    }
+    allocations.Report(state);
+}
+BENCHMARK(BM_CameraGetViewMatrix);
+
+// updateCameraVectors is private, mouse movement is its cheapest caller
+static void BM_CameraUpdateVectors(benchmark::State& state) {
+    Camera camera(glm::vec3(0.0f, 2.0f, 3.0f));
+    AllocationCounter allocations;
+    for (auto _ : state) {
+        camera.ProcessMouseMovement(0.01f, 0.0f);
+        benchmark::DoNotOptimize(camera.Front);
+    }
+    allocations.Report(state);
+}
+BENCHMARK(BM_CameraUpdateVectors);
+
+static void BM_FileSystemGetPath(benchmark::State& state) {
+    const std::string path = "resources/textures/container2_specular.png";
+    AllocationCounter allocations;
+    for (auto _ : state) {
+        std::string resolved = FileSystem::getPath(path);
+        benchmark::DoNotOptimize(resolved.data());
+    }
+    allocations.Report(state);
+}
+BENCHMARK(BM_FileSystemGetPath);
+
+// decode of a shipped texture, throughput in decoded bytes; stb_image allocates with malloc,
+// which the allocation counter does not see
+static void BM_StbiLoad(benchmark::State& state) {
+    const char* path = "resources/textures/container2_specular.png";
+    int64_t decodedBytes = 0;
+    AllocationCounter allocations;
+    for (auto _ : state) {
+        int width, height, components;
+        unsigned char* data = stbi_load(path, &width, &height, &components, 0);
+        if (!data) {
+            state.SkipWithError("failed to decode resources/textures/container2_specular.png");
+            break;
+        }
+        decodedBytes += (int64_t)width * height * components;
+        stbi_image_free(data);
+    }
+    allocations.Report(state);
+    state.SetBytesProcessed(decodedBytes);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_StbiLoad)->Unit(benchmark::kMillisecond);
+
+int main(int argc, char** argv) {
+#ifdef RG_HAVE_EGL
+    rg::HeadlessContext context;
+    haveContext = context.Create(64, 64);
+    if (!haveContext) {
+        std::cerr << "No GL context (" << context.Error() << "), GL benchmarks are skipped" << std::endl;
+    }
+#else
+    std::cerr << "Built without EGL, GL benchmarks are skipped" << std::endl;
+#endif
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
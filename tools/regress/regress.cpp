@@ -0,0 +1,344 @@
+// Golden-image and frame budget regression check. Renders every viewpoint of
+// resources/regress/viewpoints.txt headless in night/day mode with bloom on and off, and once
+// more on the Blinn-Phong path without shadows, lightmap and bloom (the _phong cases, the
+// references of project_base_softrender --compare), compares each image against its reference
+// with PSNR and SSIM, and checks the median CPU/GPU times of every pass against
+// resources/regress/budgets.txt. Exits with 1 when anything fails.
+//
+//   project_base_regress [--update] [--dir dir] [--budgets file] [--out dir]
+//                        [--width W] [--height H] [--frames N]
+//
+// --update rewrites the references from the current build instead of comparing; a case without a
+// reference fails otherwise. Runs from the repository root like the demo, resources are loaded by
+// relative path.
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/camera.h>
+#include <rg/CameraPath.h>
+#include <rg/GpuProfiler.h>
+#include <rg/HeadlessContext.h>
+#include <rg/Image.h>
+#include <rg/JobSystem.h>
+#include <rg/Renderer.h>
+#include <rg/World.h>
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+    struct Options {
+        bool update = false;
+        std::string dir = "resources/regress";
+        std::string budgets; // defaults to <dir>/budgets.txt
+        std::string out = "regress_out";
+        int width = 640;
+        int height = 360;
+        int frames = 10; // timed frames per case, the median is checked against the budget
+    };
+
+    // limits read from the budgets file; times are milliseconds
+    struct Budgets {
+        double minPsnr = 30.0;
+        double minSsim = 0.97;
+        std::map<std::string, double> maxMs; // cpu.sim, cpu.submit, cpu.frame, gpu.<pass>, gpu.total
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    double millisecondsSince(Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    double median(std::vector<double> samples) {
+        if (samples.empty()) {
+            return 0.0;
+        }
+        std::sort(samples.begin(), samples.end());
+        return samples[samples.size() / 2];
+    }
+
+    bool parseOptions(int argc, char** argv, Options& options) {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--update") {
+                options.update = true;
+                continue;
+            }
+            if (i + 1 >= argc) {
+                std::cerr << "missing value for " << arg << std::endl;
+                return false;
+            }
+            const char* value = argv[++i];
+            if (arg == "--dir") {
+                options.dir = value;
+            } else if (arg == "--budgets") {
+                options.budgets = value;
+            } else if (arg == "--out") {
+                options.out = value;
+            } else if (arg == "--width") {
+                options.width = std::max(8, std::atoi(value));
+            } else if (arg == "--height") {
+                options.height = std::max(8, std::atoi(value));
+            } else if (arg == "--frames") {
+                options.frames = std::max(1, std::atoi(value));
+            } else {
+                std::cerr << "unknown option " << arg << std::endl;
+                return false;
+            }
+        }
+        if (options.budgets.empty()) {
+            options.budgets = options.dir + "/budgets.txt";
+        }
+        return true;
+    }
+
+    // one "name value" pair per line, # starts a comment
+    bool loadBudgets(const std::string& path, Budgets& budgets) {
+        std::ifstream in(path);
+        if (!in) {
+            return false;
+        }
+        std::string line;
+        while (std::getline(in, line)) {
+            line = line.substr(0, line.find('#'));
+            std::istringstream fields(line);
+            std::string name;
+            double value;
+            if (!(fields >> name >> value)) {
+                continue;
+            }
+            if (name == "min_psnr") {
+                budgets.minPsnr = value;
+            } else if (name == "min_ssim") {
+                budgets.minSsim = value;
+            } else {
+                budgets.maxMs[name] = value;
+            }
+        }
+        return true;
+    }
+
+    // the default framebuffer, flipped to top-down rows
+    rg::Image readFramebuffer(int width, int height) {
+        rg::Image image(width, height);
+        std::vector<uint8_t> pixels(image.rgb.size());
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+        size_t row = (size_t)width * 3;
+        for (int y = 0; y < height; ++y) {
+            std::copy(pixels.begin() + (height - 1 - y) * row, pixels.begin() + (height - y) * row,
+                      image.rgb.begin() + y * row);
+        }
+        return image;
+    }
+
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << "usage: project_base_regress [--update] [--dir dir] [--budgets file] [--out dir]"
+                     " [--width W] [--height H] [--frames N]" << std::endl;
+        return 2;
+    }
+
+    rg::CameraPath viewpoints;
+    if (!viewpoints.Load(options.dir + "/viewpoints.txt")) {
+        std::cerr << "Failed to load " << options.dir << "/viewpoints.txt" << std::endl;
+        return 2;
+    }
+    Budgets budgets;
+    if (!options.update && !loadBudgets(options.budgets, budgets)) {
+        std::cerr << "Failed to load budgets " << options.budgets << std::endl;
+        return 2;
+    }
+
+    rg::HeadlessContext context;
+    if (!context.Create(options.width, options.height)) {
+        std::cerr << "Failed to create headless context: " << context.Error() << std::endl;
+        return 2;
+    }
+    std::cout << "GL renderer: " << rg::HeadlessContext::RendererName() << std::endl;
+
+    rg::Renderer renderer;
+    rg::World world(renderer.damModel, renderer.moonModel);
+    rg::JobSystem jobs;
+
+    std::string referenceDir = options.dir + "/reference";
+    mkdir(referenceDir.c_str(), 0755);
+    if (!options.update) {
+        mkdir(options.out.c_str(), 0755);
+    }
+
+    // worst median per metric over all cases, checked against the budgets at the end
+    std::map<std::string, double> worstMs;
+    std::map<std::string, std::string> worstCase;
+    int failures = 0;
+    uint64_t frameIndex = 0;
+    float aspect = (float)options.width / (float)options.height;
+
+    for (size_t view = 0; view < viewpoints.keys.size(); ++view) {
+        const rg::CameraKey& key = viewpoints.keys[view];
+        Camera camera(key.position, glm::vec3(0.0f, 1.0f, 0.0f), key.yaw, key.pitch);
+        camera.Zoom = key.zoom;
+
+        for (int mode = 0; mode < 6; ++mode) {
+            bool day = (mode & 1) != 0;
+            bool phong = mode >= 4;
+            bool bloom = !phong && (mode & 2) == 0;
+            std::string name = "view" + std::to_string(view) + (day ? "_day" : "_night") +
+                               (phong ? "_phong" : bloom ? "_bloom" : "_nobloom");
+
+            rg::FramePacket packet;
+            packet.viewportWidth = options.width;
+            packet.viewportHeight = options.height;
+            packet.projection = glm::perspective(glm::radians(camera.Zoom), aspect, 0.1f, 100.0f);
+            packet.view = camera.GetViewMatrix();
+            packet.cameraPosition = camera.Position;
+            packet.cameraFront = camera.Front;
+            packet.changeTheSetting = day;
+            packet.exposure = day ? 0.7f : 0.4f;
+            packet.bloom = bloom;
+            packet.pbr = !phong;
+            packet.shadows = !phong;
+            packet.lightmap = !phong;
+
+            // one untimed frame first, so shader and texture first-use costs stay out of the budget
+            rg::GpuProfiler profiler(options.frames + rg::GpuProfiler::FrameLatency);
+            std::vector<double> simMs, submitMs, frameMs;
+            for (int frame = 0; frame <= options.frames; ++frame) {
+                Clock::time_point frameStart = Clock::now();
+                world.projection = packet.projection;
+                world.view = packet.view;
+                world.eye = packet.cameraPosition;
+                world.Update(jobs);
+                packet.frameIndex = frameIndex;
+                world.Fill(packet);
+                double sim = millisecondsSince(frameStart);
+                if (frame == 0) {
+                    // the same mips resident whatever the machine and the case order
+                    renderer.FlushTextureStreaming(packet);
+                }
+
+                Clock::time_point submitStart = Clock::now();
+                profiler.BeginFrame(frameIndex++);
+                renderer.Render(packet, &profiler);
+                profiler.EndFrame();
+                double submit = millisecondsSince(submitStart);
+                glFinish();
+                if (frame > 0) {
+                    simMs.push_back(sim);
+                    submitMs.push_back(submit);
+                    frameMs.push_back(millisecondsSince(frameStart));
+                }
+            }
+            rg::Image image = readFramebuffer(options.width, options.height);
+            profiler.Finish();
+
+            std::map<std::string, double> caseMs;
+            caseMs["cpu.sim"] = median(simMs);
+            caseMs["cpu.submit"] = median(submitMs);
+            caseMs["cpu.frame"] = median(frameMs);
+            std::vector<std::string> passes = profiler.PassNames();
+            std::vector<rg::GpuProfiler::FrameTimes> history = profiler.History();
+            std::vector<std::vector<double>> passMs(passes.size());
+            std::vector<double> totalMs;
+            for (const rg::GpuProfiler::FrameTimes& times : history) {
+                if (times.frameIndex == frameIndex - options.frames - 1) {
+                    continue; // the untimed frame
+                }
+                double total = 0.0;
+                for (size_t pass = 0; pass < times.ms.size(); ++pass) {
+                    if (times.ms[pass] >= 0.0f) {
+                        passMs[pass].push_back(times.ms[pass]);
+                        total += times.ms[pass];
+                    }
+                }
+                totalMs.push_back(total);
+            }
+            profiler.Release();
+            for (size_t pass = 0; pass < passes.size(); ++pass) {
+                caseMs["gpu." + passes[pass]] = median(passMs[pass]);
+            }
+            caseMs["gpu.total"] = median(totalMs);
+            for (const auto& metric : caseMs) {
+                if (metric.second >= worstMs[metric.first]) {
+                    worstMs[metric.first] = metric.second;
+                    worstCase[metric.first] = name;
+                }
+            }
+
+            std::string referencePath = referenceDir + "/" + name + ".ppm";
+            if (options.update) {
+                if (!image.WritePpm(referencePath)) {
+                    std::cerr << "Failed to write " << referencePath << std::endl;
+                    return 2;
+                }
+                std::cout << "updated " << referencePath << std::endl;
+                continue;
+            }
+
+            rg::Image reference;
+            if (!reference.ReadPpm(referencePath)) {
+                std::cout << "FAIL " << name << ": no reference at " << referencePath << ", record it with --update" << std::endl;
+                image.WritePpm(options.out + "/" + name + ".ppm");
+                failures++;
+                continue;
+            }
+            if (reference.width != image.width || reference.height != image.height) {
+                std::cout << "FAIL " << name << ": reference is " << reference.width << "x" << reference.height
+                          << ", rendered " << image.width << "x" << image.height << std::endl;
+                failures++;
+                continue;
+            }
+            double psnr = rg::Image::Psnr(image, reference);
+            double ssim = rg::Image::Ssim(image, reference);
+            bool passed = psnr >= budgets.minPsnr && ssim >= budgets.minSsim;
+            std::cout << (passed ? "ok   " : "FAIL ") << name << ": psnr " << psnr << " dB, ssim " << ssim
+                      << ", frame " << caseMs["cpu.frame"] << " ms, gpu " << caseMs["gpu.total"] << " ms" << std::endl;
+            if (!passed) {
+                // the rendered image and an amplified difference, next to each other for inspection
+                image.WritePpm(options.out + "/" + name + ".ppm");
+                rg::Image::Difference(image, reference).WritePpm(options.out + "/" + name + "_diff.ppm");
+                failures++;
+            }
+        }
+    }
+
+    if (options.update) {
+        std::cout << "references updated, budgets are not checked with --update" << std::endl;
+        return 0;
+    }
+
+    for (const auto& budget : budgets.maxMs) {
+        auto measured = worstMs.find(budget.first);
+        if (measured == worstMs.end()) {
+            std::cout << "FAIL budget " << budget.first << ": never measured" << std::endl;
+            failures++;
+            continue;
+        }
+        bool passed = measured->second <= budget.second;
+        std::cout << (passed ? "ok   " : "FAIL ") << "budget " << budget.first << ": " << measured->second
+                  << " ms (" << worstCase[budget.first] << ") of " << budget.second << " ms" << std::endl;
+        if (!passed) {
+            failures++;
+        }
+    }
+
+    std::cout << (failures ? std::to_string(failures) + " check(s) failed" : std::string("all checks passed")) << std::endl;
+    return failures ? 1 : 0;
+}
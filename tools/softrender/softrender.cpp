@@ -0,0 +1,208 @@
+// Renders the regression viewpoints with the CPU rasterizer, no GPU or GL context needed. Every
+// viewpoint of resources/regress/viewpoints.txt is drawn in night and day mode and written as a
+// PPM, with the median frame time and its split over the stages. With --compare the images are
+// checked with PSNR and SSIM against the _phong references of project_base_regress, which the GL
+// renderer draws on the same Blinn-Phong path without shadows, lightmap and bloom, and the exit
+// code is 1 when a case has no reference or falls below --min-psnr or --min-ssim. The defaults
+// leave some room under what llvmpipe measures, at least 44 dB and 0.996.
+//
+//   project_base_softrender [--dir dir] [--out dir] [--width W] [--height H] [--frames N]
+//                           [--threads N] [--compare] [--min-psnr dB] [--min-ssim S]
+//
+// Runs from the repository root like the demo, resources are loaded by relative path.
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/camera.h>
+#include <rg/CameraPath.h>
+#include <rg/Image.h>
+#include <rg/JobSystem.h>
+#include <rg/SoftRenderer.h>
+#include <rg/World.h>
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+    struct Options {
+        std::string dir = "resources/regress";
+        std::string out = "softrender_out";
+        int width = 640;
+        int height = 360;
+        int frames = 5;  // timed frames per case, the median is reported
+        int threads = 0; // job system workers, 0 for one per core
+        bool compare = false;
+        double minPsnr = 40.0;
+        double minSsim = 0.99;
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    double millisecondsSince(Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    double median(std::vector<double> samples) {
+        if (samples.empty()) {
+            return 0.0;
+        }
+        std::sort(samples.begin(), samples.end());
+        return samples[samples.size() / 2];
+    }
+
+    bool parseOptions(int argc, char** argv, Options& options) {
+        const int maxDimension = rg::SoftRenderer::MaxDimension;
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--compare") {
+                options.compare = true;
+                continue;
+            }
+            if (i + 1 >= argc) {
+                std::cerr << "missing value for " << arg << std::endl;
+                return false;
+            }
+            const char* value = argv[++i];
+            if (arg == "--dir") {
+                options.dir = value;
+            } else if (arg == "--out") {
+                options.out = value;
+            } else if (arg == "--width") {
+                options.width = std::min(maxDimension, std::max(8, std::atoi(value)));
+            } else if (arg == "--height") {
+                options.height = std::min(maxDimension, std::max(8, std::atoi(value)));
+            } else if (arg == "--frames") {
+                options.frames = std::max(1, std::atoi(value));
+            } else if (arg == "--threads") {
+                options.threads = std::max(0, std::atoi(value));
+            } else if (arg == "--min-psnr") {
+                options.minPsnr = std::atof(value);
+            } else if (arg == "--min-ssim") {
+                options.minSsim = std::atof(value);
+            } else {
+                std::cerr << "unknown option " << arg << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << "usage: project_base_softrender [--dir dir] [--out dir] [--width W] [--height H]"
+                     " [--frames N] [--threads N] [--compare] [--min-psnr dB] [--min-ssim S]" << std::endl;
+        return 2;
+    }
+
+    rg::CameraPath viewpoints;
+    if (!viewpoints.Load(options.dir + "/viewpoints.txt")) {
+        std::cerr << "Failed to load " << options.dir << "/viewpoints.txt" << std::endl;
+        return 2;
+    }
+
+    Clock::time_point loadStart = Clock::now();
+    rg::SoftRenderer renderer;
+    rg::World world(renderer.damModel, renderer.moonModel);
+    std::unique_ptr<rg::JobSystem> jobs(options.threads > 0 ? new rg::JobSystem((unsigned int)options.threads)
+                                                            : new rg::JobSystem());
+    std::cout << "loaded in " << millisecondsSince(loadStart) << " ms" << std::endl;
+    mkdir(options.out.c_str(), 0755);
+
+    uint64_t frameIndex = 0;
+    float aspect = (float)options.width / (float)options.height;
+    int missing = 0;
+    int failed = 0;
+    for (size_t view = 0; view < viewpoints.keys.size(); ++view) {
+        const rg::CameraKey& key = viewpoints.keys[view];
+        Camera camera(key.position, glm::vec3(0.0f, 1.0f, 0.0f), key.yaw, key.pitch);
+        camera.Zoom = key.zoom;
+
+        for (int mode = 0; mode < 2; ++mode) {
+            bool day = mode == 1;
+            std::string name = "view" + std::to_string(view) + (day ? "_day" : "_night");
+
+            rg::FramePacket packet;
+            packet.viewportWidth = options.width;
+            packet.viewportHeight = options.height;
+            packet.projection = glm::perspective(glm::radians(camera.Zoom), aspect, 0.1f, 100.0f);
+            packet.view = camera.GetViewMatrix();
+            packet.cameraPosition = camera.Position;
+            packet.cameraFront = camera.Front;
+            packet.changeTheSetting = day;
+            packet.exposure = day ? 0.7f : 0.4f;
+            packet.bloom = false;
+            packet.pbr = false;
+            packet.shadows = false;
+            packet.lightmap = false;
+
+            // one untimed frame first, the sky of the mode is decoded on first use
+            rg::Image image;
+            std::vector<double> frameMs, geometryMs, rasterMs, resolveMs;
+            rg::SoftRenderer::Stats stats;
+            for (int frame = 0; frame <= options.frames; ++frame) {
+                world.projection = packet.projection;
+                world.view = packet.view;
+                world.eye = packet.cameraPosition;
+                world.Update(*jobs);
+                packet.frameIndex = frameIndex++;
+                world.Fill(packet);
+
+                Clock::time_point start = Clock::now();
+                image = renderer.Render(packet, *jobs);
+                double ms = millisecondsSince(start);
+                stats = renderer.LastStats();
+                if (frame > 0) {
+                    frameMs.push_back(ms);
+                    geometryMs.push_back(stats.geometryMs);
+                    rasterMs.push_back(stats.rasterMs);
+                    resolveMs.push_back(stats.resolveMs);
+                }
+            }
+
+            std::string path = options.out + "/" + name + ".ppm";
+            if (!image.WritePpm(path)) {
+                std::cerr << "Failed to write " << path << std::endl;
+                return 2;
+            }
+            std::cout << name << ": " << median(frameMs) << " ms (geometry " << median(geometryMs) << ", raster "
+                      << median(rasterMs) << ", resolve " << median(resolveMs) << "), " << stats.triangles
+                      << " triangles, " << stats.binned << " binned";
+
+            if (options.compare) {
+                std::string referencePath = options.dir + "/reference/" + name + "_phong.ppm";
+                rg::Image reference;
+                if (!reference.ReadPpm(referencePath) || reference.width != image.width || reference.height != image.height) {
+                    std::cout << ", no reference at this size in " << referencePath;
+                    missing++;
+                } else {
+                    double psnr = rg::Image::Psnr(image, reference);
+                    double ssim = rg::Image::Ssim(image, reference);
+                    std::cout << ", psnr " << psnr << " dB, ssim " << ssim;
+                    if (psnr < options.minPsnr || ssim < options.minSsim) {
+                        std::cout << " FAIL (min " << options.minPsnr << " dB, " << options.minSsim << ")";
+                        failed++;
+                    }
+                    rg::Image::Difference(image, reference).WritePpm(options.out + "/" + name + "_diff.ppm");
+                }
+            }
+            std::cout << std::endl;
+        }
+    }
+    if (options.compare && (missing || failed)) {
+        std::cout << missing << " case(s) without a reference, " << failed << " below the thresholds" << std::endl;
+        return 1;
+    }
+    return 0;
+}